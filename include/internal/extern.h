@@ -18,6 +18,38 @@ extern const struct attr_grp_bitmask {
 
 extern const set_filter_dump_attr	set_filter_dump_attr_array[];
 
+/* nested attributes that the parsers skip if none of their attributes is
+ * wanted, see nfct_handle_set_parse_mask(). */
+enum {
+	__PARSE_NAT_SEQ_ORIG = 0,
+	__PARSE_NAT_SEQ_REPL,
+	__PARSE_PROTOINFO,
+	__PARSE_COUNTERS_ORIG,
+	__PARSE_COUNTERS_REPL,
+	__PARSE_HELPER,
+	__PARSE_SECCTX,
+	__PARSE_TIMESTAMP,
+	__PARSE_LABELS,
+	__PARSE_MAX
+};
+
+extern const uint32_t parse_bitmask[__PARSE_MAX][__NFCT_BITSET];
+
+/* `want' is NULL if everything has to be parsed. */
+static inline int __parse_want(const uint32_t *want, int type)
+{
+	int i;
+
+	if (want == NULL)
+		return 1;
+
+	for (i = 0; i < __NFCT_BITSET; i++) {
+		if (want[i] & parse_bitmask[type][i])
+			return 1;
+	}
+	return 0;
+}
+
 /* for the snprintf infrastructure */
 extern const char *const l3proto2str[AF_MAX];
 extern const char *const proto2str[IPPROTO_MAX];
@@ -8,6 +8,8 @@
 
 #include <libnetfilter_conntrack/libnetfilter_conntrack.h>
 
+#define __NFCT_BITSET			3
+
 /*
  * nfct callback handler object
  */
@@ -34,6 +36,18 @@ struct nfct_handle {
 				       struct nf_conntrack *ct,
 				       void *data);
 
+	/* callback that receives a view instead of a conntrack object */
+	int			(*view_cb)(const struct nlmsghdr *nlh,
+					   enum nf_conntrack_msg_type type,
+					   struct nfct_view *view,
+					   void *data);
+
+	/* callback that receives arrays of conntrack objects */
+	int			(*batch_cb)(struct nfct_cb_item *items,
+					    unsigned int nitems,
+					    void *data);
+	struct __cb_batch	*cb_batch;
+
 	int			(*expect_cb)(enum nf_conntrack_msg_type type, 
 					     struct nf_expect *exp,
 					     void *data);
@@ -43,6 +57,45 @@ struct nfct_handle {
 					      enum nf_conntrack_msg_type type, 
 					      struct nf_expect *exp,
 					      void *data);
+
+	/* objects passed to the callbacks are taken from this pool */
+	struct nfct_pool	*pool;
+
+	/* attributes that the parser decodes, NULL means all of them */
+	const uint32_t		*parse_mask;
+	uint32_t		parse_want[__NFCT_BITSET];
+
+	unsigned int		flags;
+
+	/* object reused to parse events if NFCT_HF_SCRATCH is set */
+	struct nf_conntrack	*scratch;
+
+	/* batched receive ring used by nfct_catch(), NULL if disabled */
+	struct nfct_rx		*rx;
+
+	/* io_uring receive backend, it takes over from `rx' if set */
+	struct nfct_uring	*uring;
+
+	/* conntracks reported via events if NFCT_HF_RESYNC is set */
+	struct nfct_resync	*resync;
+
+	/* events held back to merge them, see nfct_handle_set_coalesce() */
+	struct nfct_coalesce	*coalesce;
+
+	/* requests in flight, see nfct_query_async() */
+	struct nfct_async	*async;
+
+	/* performance counters, see nfct_handle_stats() */
+	struct nfct_handle_stats stats;
+};
+
+/* conntracks accumulated for the batch callback */
+struct __cb_batch {
+	unsigned int		len;
+	unsigned int		max;
+	struct nfct_cb_item	*items;
+	/* objects are recycled between calls unless the callback keeps them */
+	struct nf_conntrack	**objs;
 };
 
 /* container used to pass data to nfnl callbacks */
@@ -151,30 +204,38 @@ struct __nfct_nat {
 struct nfct_tuple_head {
 	struct __nfct_tuple 	orig;
 
-#define __NFCT_BITSET			3
 	uint32_t               set[__NFCT_BITSET];
 };
 
-struct nf_conntrack {
-	struct nfct_tuple_head 	head;
-	struct __nfct_tuple	repl;
+/*
+ * The kernel supports up to 128 labels, bitmasks up to this size are stored
+ * in the object itself. This has the same layout as struct nfct_bitmask.
+ */
+#define __NFCT_LABELS_WORDS	4
+
+struct __nfct_labels {
+	unsigned int	words;
+	uint32_t	bits[__NFCT_LABELS_WORDS];
+};
+
+/*
+ * Attributes that are rarely set live in a separate extension that is only
+ * allocated once one of them is set, see cold_attr[] in cold.c.
+ */
+struct __nfct_cold {
 	struct __nfct_tuple	master;
 
-	uint32_t 	timeout;
-	uint32_t	mark;
 	uint32_t	secmark;
-	uint32_t 	status;
-	uint32_t	use;
-	uint32_t	id;
-	uint16_t	zone;
+	/* bits of the mark that an update changes */
+	uint32_t	mark_mask;
 
 	char 		helper_name[NFCT_HELPER_NAME_MAX];
 /* According to Eric Paris <eparis@redhat.com> this field can be up to 4096
  * bytes long. For that reason, we allocate this dynamically. */
 	char		*secctx;
+	/* bytes allocated for secctx, it may hold a shorter string */
+	size_t		secctx_size;
 
-	union __nfct_protoinfo 	protoinfo;
-	struct __nfct_counters 	counters[__DIR_MAX];
 	struct __nfct_nat 	snat;
 	struct __nfct_nat 	dnat;
 
@@ -192,8 +253,58 @@ struct nf_conntrack {
 	void *helper_info;
 	size_t helper_info_len;
 
+	/* point to the inline storage below or to a heap bitmask. */
 	struct nfct_bitmask *connlabels;
 	struct nfct_bitmask *connlabels_mask;
+	struct __nfct_labels connlabels_buf;
+	struct __nfct_labels connlabels_mask_buf;
+};
+
+struct nf_conntrack {
+	struct nfct_tuple_head 	head;
+	struct __nfct_tuple	repl;
+
+	uint32_t 	timeout;
+	uint32_t	mark;
+	uint32_t 	status;
+	uint32_t	use;
+	uint32_t	id;
+	uint16_t	zone;
+
+	union __nfct_protoinfo 	protoinfo;
+	struct __nfct_counters 	counters[__DIR_MAX];
+
+	/* NULL until a cold attribute is set, then kept until destroyed. */
+	struct __nfct_cold	*cold;
+
+	/* pool this object was taken from, NULL if it was malloc'ed. */
+	struct nfct_pool *pool;
+
+	/* set by nfct_new(), otherwise the object is in a buffer that also
+	 * holds the cold extension, see nfct_maxsize(). */
+	uint8_t		heap;
+};
+
+/*
+ * conntrack view object
+ */
+
+struct nfct_view {
+	const struct nlmsghdr	*nlh;
+	uint32_t		set[__NFCT_BITSET];
+
+	/* offset of the attribute payload from the start of the message */
+	uint16_t		off[ATTR_MAX];
+
+	/* values converted to host byte order upon request */
+	union {
+		uint8_t		u8;
+		uint16_t	u16;
+		uint32_t	u32;
+		uint64_t	u64;
+	} val[ATTR_MAX];
+
+	struct __nfct_labels	labels;
 };
 
 /*
@@ -238,32 +349,26 @@ struct nfct_filter {
 
 #define __FILTER_ADDR_SRC 0
 #define __FILTER_ADDR_DST 1
+#define __FILTER_ADDR_MIN 16
 
 	/*
-	 * FIXME: For IPv4 filtering, up to 127 IPs by now.
-	 * This limitation is related to the existing autogenerated BSF code
-	 * (two BSF lines per comparison) and the fact that the maximum 
-	 * jump offset is 0xff which is 255.
+	 * Addresses and masks for IPv4 and IPv6 filtering. There is no limit
+	 * but the size of the BSF program, they are compiled into a decision
+	 * tree, see bsf_add_addr_filter().
 	 */
 	uint32_t 		l3proto_elems[2];
+	uint32_t		l3proto_size[2];
 	struct {
-#define __FILTER_ADDR_MAX	127
 		uint32_t 	addr;
 		uint32_t 	mask;
-	} l3proto[2][__FILTER_ADDR_MAX];
+	} *l3proto[2];
 
-	/*
-	 * FIXME: For IPv6 filtering, up to 20 IPs/masks (12 BSF lines
-	 * per comparison). I think that it is not worthy to try to support
-	 * more than that for performance reasons. It seems that oprofile
-	 * shows bad numbers for very large BSF code.
-	 */
 	uint32_t 		l3proto_elems_ipv6[2];
+	uint32_t		l3proto_size_ipv6[2];
 	struct {
-#define __FILTER_IPV6_MAX	20
 		uint32_t 	addr[4];
 		uint32_t 	mask[4];
-	} l3proto_ipv6[2][__FILTER_IPV6_MAX];
+	} *l3proto_ipv6[2];
 
 	uint32_t 		mark_elems;
 	struct {
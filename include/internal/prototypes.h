@@ -7,8 +7,8 @@
 int __build_conntrack(struct nfnl_subsys_handle *ssh, struct nfnlhdr *req, size_t size, uint16_t type, uint16_t flags, const struct nf_conntrack *ct);
 void __build_tuple(struct nfnlhdr *req, size_t size, const struct __nfct_tuple *t, const int type);
 int __parse_message_type(const struct nlmsghdr *nlh);
-void __parse_conntrack(const struct nlmsghdr *nlh, struct nfattr *cda[], struct nf_conntrack *ct);
-void __parse_tuple(const struct nfattr *attr, struct __nfct_tuple *tuple, int dir, uint32_t *set);
+int __parse_conntrack(const struct nlmsghdr *nlh, struct nf_conntrack *ct, const uint32_t *want);
+void __parse_mask(uint32_t *want, const struct nfct_bitmask *attrs);
 int __snprintf_conntrack(char *buf, unsigned int len, const struct nf_conntrack *ct, unsigned int type, unsigned int msg_output, unsigned int flags, struct nfct_labelmap *);
 int __snprintf_address(char *buf, unsigned int len, const struct __nfct_tuple *tuple, const char *src_tag, const char *dst_tag);
 int __snprintf_protocol(char *buf, unsigned int len, const struct nf_conntrack *ct);
@@ -34,21 +34,179 @@ int __setobjopt(struct nf_conntrack *ct, unsigned int option);
 int __getobjopt(const struct nf_conntrack *ct, unsigned int option);
 int __compare(const struct nf_conntrack *ct1, const struct nf_conntrack *ct2, unsigned int flags);
 int __cmp_orig(const struct nf_conntrack *ct1, const struct nf_conntrack *ct2, unsigned int flags);
+uint32_t __hash_orig(const struct nf_conntrack *ct);
 void __copy_fast(struct nf_conntrack *ct1, const struct nf_conntrack *ct);
 
 int __setup_netlink_socket_filter(int fd, struct nfct_filter *filter);
+struct sock_filter;
+int __bsf_get(int fd, struct sock_filter **code);
+uint32_t __bsf_run(const struct sock_filter *code, unsigned int len,
+		   const void *msg, size_t size);
 
 void __build_filter_dump(struct nfnlhdr *req, size_t size, const struct nfct_filter_dump *filter_dump);
 
 int nfct_build_tuple(struct nlmsghdr *nlh, const struct __nfct_tuple *t, int type);
 int nfct_parse_tuple(const struct nlattr *attr, struct __nfct_tuple *tuple, int dir, uint32_t *set);
 
+/*
+ * shared ctnetlink decoder internal prototypes
+ */
+int __decode_conntrack(const void *payload, size_t len, uint16_t l3num, struct nf_conntrack *ct, const uint32_t *want);
+int __decode_tuple(const void *payload, size_t len, struct __nfct_tuple *tuple, int dir, uint32_t *set);
+int __decode_flow_key(const void *payload, size_t len, uint8_t l3num, struct nfct_flow_key *key);
+int __decode_expect(const void *payload, size_t len, uint16_t l3num, struct nf_expect *exp);
+
+/*
+ * batch callback internal prototypes
+ */
+struct __cb_batch *__callback_batch_create(unsigned int max);
+void __callback_batch_destroy(struct __cb_batch *b);
+int __callback_flush(struct nfct_handle *h);
+
+/*
+ * batched receive internal prototypes
+ */
+struct nfct_rx *__rx_create(unsigned int nbufs, size_t bufsiz);
+void __rx_destroy(struct nfct_rx *rx);
+int __rx_pending(const struct nfct_rx *rx);
+int __rx_catch(struct nfct_handle *h);
+int __rx_catch_budget(struct nfct_handle *h, unsigned int max_msgs,
+		      uint64_t max_ns);
+void __rx_drain(struct nfct_handle *h);
+
+/*
+ * event-loss recovery internal prototypes
+ */
+struct nfct_resync *__resync_create(void);
+void __resync_destroy(struct nfct_resync *r);
+void __resync_event(struct nfct_resync *r, unsigned int type,
+		    const struct nf_conntrack *ct);
+int __resync_run(struct nfct_handle *h);
+
+/*
+ * performance counters internal prototypes
+ */
+uint64_t __stats_now(const struct nfct_handle *h);
+void __stats_elapsed(const struct nfct_handle *h, uint64_t *ns,
+		     uint64_t start);
+void __stats_verdict(struct nfct_handle *h, int ret);
+
+/*
+ * event coalescing internal prototypes
+ */
+struct nfct_coalesce *__coalesce_create(unsigned int max_events,
+					uint64_t window_ns);
+void __coalesce_destroy(struct nfct_coalesce *c);
+int __coalesce_pending(const struct nfct_coalesce *c);
+int __coalesce_add(struct nfct_handle *h, unsigned int type,
+		   struct nf_conntrack *ct);
+int __coalesce_flush(struct nfct_handle *h);
+int __coalesce_expire(struct nfct_handle *h);
+int __coalesce_timeout(const struct nfct_coalesce *c);
+
+/*
+ * asynchronous query internal prototypes
+ */
+struct nfct_async *__async_create(void);
+void __async_destroy(struct nfct_async *a);
+unsigned int __async_pending(const struct nfct_async *a);
+int __async_send(struct nfct_handle *h, struct nfnlhdr *req_msg,
+		 const enum nf_conntrack_query qt,
+		 int (*cb)(int error, struct nf_conntrack *ct, void *data),
+		 void *data);
+int __async_match(struct nfct_async *a, const void *buf, size_t len);
+int __async_process(struct nfct_handle *h, const void *buf, size_t len);
+void __async_lost(struct nfct_handle *h);
+
+/*
+ * flush by filter internal prototypes
+ */
+int __flush_filter(struct nfct_handle *h,
+		   const struct nfct_filter_dump *filter,
+		   const struct nf_conntrack *tmpl, unsigned int flags);
+int __rewrite_filter(struct nfct_handle *h,
+		     const struct nfct_filter_dump *filter,
+		     const struct nf_conntrack *tmpl, unsigned int flags,
+		     uint32_t mark, uint32_t mark_mask,
+		     const struct nfct_bitmask *set,
+		     const struct nfct_bitmask *clear);
+struct nf_conntrack *__rewrite_request(uint32_t mark, uint32_t mark_mask,
+				       const struct nfct_bitmask *set,
+				       const struct nfct_bitmask *clear);
+int __rewrite_prepare(struct nf_conntrack *req, const struct nf_conntrack *ct,
+		      uint32_t mark, uint32_t mark_mask,
+		      const struct nfct_bitmask *set,
+		      const struct nfct_bitmask *clear);
+
+/*
+ * io_uring receive backend internal prototypes
+ */
+struct nfct_uring *__uring_create(unsigned int nbufs, size_t bufsiz);
+void __uring_destroy(struct nfct_uring *u);
+int __uring_pending(const struct nfct_uring *u);
+int __uring_catch(struct nfct_handle *h);
+int __uring_catch_budget(struct nfct_handle *h, unsigned int max_msgs,
+			 uint64_t max_ns);
+
+/*
+ * sharded event dispatcher internal prototypes
+ */
+struct nfct_dispatch *
+__dispatch_create(struct nfct_handle *h, unsigned int nworkers,
+		  unsigned int ring_size,
+		  int (*cb)(enum nf_conntrack_msg_type type,
+			    struct nf_conntrack *ct, void *data),
+		  void *data);
+void __dispatch_destroy(struct nfct_dispatch *d);
+struct nfct_handle *__dispatch_handle(const struct nfct_dispatch *d);
+int __dispatch_callback(enum nf_conntrack_msg_type type,
+			struct nf_conntrack *ct, void *data);
+
+/*
+ * conntrack cold extension internal prototypes
+ */
+struct __nfct_cold *__cold_get(struct nf_conntrack *ct);
+int __cold_prepare(struct nf_conntrack *ct, const int type);
+int __cold_prepare_grp(struct nf_conntrack *ct, const int type);
+void __cold_unset(struct nf_conntrack *ct);
+void __cold_release(struct nf_conntrack *ct);
+struct nfct_bitmask *__labels_alloc(struct nfct_bitmask **slot, struct __nfct_labels *buf, unsigned int words);
+void __labels_free(struct nfct_bitmask *b, struct __nfct_labels *buf);
+
+/*
+ * conntrack object pool internal prototypes
+ */
+struct nfct_pool *__pool_create(unsigned int batch);
+void __pool_destroy(struct nfct_pool *pool);
+struct nf_conntrack *__pool_get(struct nfct_pool *pool);
+void __pool_put(struct nfct_pool *pool, struct nf_conntrack *ct);
+int __pool_set_secctx(struct nf_conntrack *ct, const char *name);
+int __pool_set_helper_info(struct nf_conntrack *ct, const void *data, size_t len);
+int __pool_set_labels(struct nf_conntrack *ct, const void *data, size_t len);
+
+/*
+ * conntrack view internal prototypes
+ */
+void __view_init(struct nfct_view *v, const struct nlmsghdr *nlh);
+const void *__view_get_attr(struct nfct_view *v, int type);
+
+/*
+ * columnar table internal prototypes
+ */
+struct nfct_table *__table_new(void);
+void __table_destroy(struct nfct_table *t);
+void __table_reset(struct nfct_table *t);
+unsigned int __table_len(const struct nfct_table *t);
+const void *__table_column(const struct nfct_table *t, int col);
+int __table_add(struct nfct_table *t, const struct nlmsghdr *nlh);
+int __table_callback(struct nlmsghdr *nlh, struct nfattr *nfa[], void *data);
+
 /*
  * expectation internal prototypes
  */
 int __build_expect(struct nfnl_subsys_handle *ssh, struct nfnlhdr *req, size_t size, uint16_t type, uint16_t flags, const struct nf_expect *exp);
 int __parse_expect_message_type(const struct nlmsghdr *nlh);
-void __parse_expect(const struct nlmsghdr *nlh, struct nfattr *cda[], struct nf_expect *exp);
+int __parse_expect(const struct nlmsghdr *nlh, struct nf_expect *exp);
 int __expect_callback(struct nlmsghdr *nlh, struct nfattr *nfa[], void *data);
 int __cmp_expect(const struct nf_expect *exp1, const struct nf_expect *exp2, unsigned int flags);
 int __snprintf_expect(char *buf, unsigned int len, const struct nf_expect *exp, unsigned int type, unsigned int msg_output, unsigned int flags);
@@ -53,6 +53,51 @@ extern int nfct_close2(struct nfct_handle *cth, bool keep_fd);
 extern int nfct_fd(struct nfct_handle *cth);
 extern const struct nfnl_handle *nfct_nfnlh(struct nfct_handle *cth);
 
+/* handle flags */
+enum {
+	NFCT_HF_SCRATCH_BIT = 0,
+	NFCT_HF_SCRATCH = (1 << NFCT_HF_SCRATCH_BIT),
+
+	NFCT_HF_RESYNC_BIT = 1,
+	NFCT_HF_RESYNC = (1 << NFCT_HF_RESYNC_BIT),
+
+	NFCT_HF_TIMING_BIT = 2,
+	NFCT_HF_TIMING = (1 << NFCT_HF_TIMING_BIT),
+};
+
+extern int nfct_handle_set_flags(struct nfct_handle *cth, unsigned int flags);
+extern unsigned int nfct_handle_get_flags(const struct nfct_handle *cth);
+
+extern int nfct_handle_set_rx_batch(struct nfct_handle *cth,
+				    unsigned int nbufs, size_t bufsiz);
+extern int nfct_handle_set_uring(struct nfct_handle *cth,
+				 unsigned int nbufs, size_t bufsiz);
+extern int nfct_handle_set_coalesce(struct nfct_handle *cth,
+				    unsigned int max_events,
+				    uint64_t window_ns);
+struct nfct_bitmask;
+extern void nfct_handle_set_parse_mask(struct nfct_handle *cth,
+				       const struct nfct_bitmask *attrs);
+
+/* performance counters */
+struct nfct_handle_stats {
+	uint64_t	datagrams;	/* received by nfct_catch*() */
+	uint64_t	bytes;
+	uint64_t	enobufs;	/* overruns reported by nfct_catch*() */
+	uint64_t	msgs_new;	/* messages processed, per type */
+	uint64_t	msgs_update;
+	uint64_t	msgs_destroy;
+	uint64_t	msgs_unknown;
+	uint64_t	filtered;	/* messages skipped by the type mask */
+	uint64_t	cb_stop;	/* callback verdicts */
+	uint64_t	cb_stolen;
+	uint64_t	parse_ns;	/* only with NFCT_HF_TIMING */
+	uint64_t	callback_ns;
+};
+
+extern void nfct_handle_stats(const struct nfct_handle *cth,
+			      struct nfct_handle_stats *stats);
+
 /* 
  * NEW libnetfilter_conntrack API 
  */
@@ -146,6 +191,7 @@ enum nf_conntrack_attr {
 	ATTR_REPL_ZONE,				/* u16 bits */
 	ATTR_SNAT_IPV6,				/* u128 bits */
 	ATTR_DNAT_IPV6,				/* u128 bits */
+	ATTR_MARK_MASK,				/* u32 bits */
 	ATTR_MAX
 };
 
@@ -224,6 +270,15 @@ extern void nfct_destroy(struct nf_conntrack *ct);
 /* clone */
 struct nf_conntrack *nfct_clone(const struct nf_conntrack *ct);
 
+/* object pool */
+struct nfct_pool;
+
+extern struct nfct_pool *nfct_pool_create(unsigned int batch);
+extern void nfct_pool_destroy(struct nfct_pool *pool);
+extern struct nf_conntrack *nfct_pool_new(struct nfct_pool *pool);
+extern void nfct_pool_put(struct nfct_pool *pool, struct nf_conntrack *ct);
+extern void nfct_pool_attach(struct nfct_handle *h, struct nfct_pool *pool);
+
 /* object size */
 extern __attribute__((deprecated)) size_t nfct_sizeof(const struct nf_conntrack *ct);
 
@@ -278,6 +333,74 @@ extern int nfct_callback_register2(struct nfct_handle *h,
 
 extern void nfct_callback_unregister2(struct nfct_handle *h);
 
+/* conntrack message view */
+struct nfct_view;
+
+extern struct nfct_view *nfct_view_new(void);
+extern void nfct_view_destroy(struct nfct_view *view);
+extern int nfct_view_parse(struct nfct_view *view, const struct nlmsghdr *nlh);
+
+extern const void *nfct_view_get_attr(struct nfct_view *view,
+				      const enum nf_conntrack_attr type);
+
+extern uint8_t nfct_view_get_attr_u8(struct nfct_view *view,
+				     const enum nf_conntrack_attr type);
+
+extern uint16_t nfct_view_get_attr_u16(struct nfct_view *view,
+				       const enum nf_conntrack_attr type);
+
+extern uint32_t nfct_view_get_attr_u32(struct nfct_view *view,
+				       const enum nf_conntrack_attr type);
+
+extern uint64_t nfct_view_get_attr_u64(struct nfct_view *view,
+				       const enum nf_conntrack_attr type);
+
+extern int nfct_view_attr_is_set(const struct nfct_view *view,
+				 const enum nf_conntrack_attr type);
+
+/* register / unregister callback: view version, no object is built */
+
+extern int nfct_callback_register_view(struct nfct_handle *h,
+				       enum nf_conntrack_msg_type type,
+				       int (*cb)(const struct nlmsghdr *nlh,
+						 enum nf_conntrack_msg_type type,
+						 struct nfct_view *view,
+						 void *data),
+				       void *data);
+
+extern void nfct_callback_unregister_view(struct nfct_handle *h);
+
+/* register / unregister callback: batch version, arrays of conntracks */
+struct nfct_cb_item {
+	enum nf_conntrack_msg_type	type;
+	struct nf_conntrack		*ct;
+};
+
+extern int nfct_callback_register_batch(struct nfct_handle *h,
+					enum nf_conntrack_msg_type type,
+					int (*cb)(struct nfct_cb_item *items,
+						  unsigned int nitems,
+						  void *data),
+					unsigned int max,
+					void *data);
+
+extern void nfct_callback_unregister_batch(struct nfct_handle *h);
+
+/* sharded event dispatcher, callbacks run in a pool of worker threads */
+struct nfct_dispatch;
+
+extern struct nfct_dispatch *
+nfct_dispatch_create(struct nfct_handle *h,
+		     enum nf_conntrack_msg_type type,
+		     unsigned int nworkers,
+		     unsigned int ring_size,
+		     int (*cb)(enum nf_conntrack_msg_type type,
+			       struct nf_conntrack *ct,
+			       void *data),
+		     void *data);
+
+extern void nfct_dispatch_destroy(struct nfct_dispatch *d);
+
 /* callback verdict */
 enum {
 	NFCT_CB_FAILURE = -1,   /* failure */
@@ -299,6 +422,7 @@ void nfct_bitmask_unset_bit(struct nfct_bitmask *, unsigned int bit);
 void nfct_bitmask_destroy(struct nfct_bitmask *);
 void nfct_bitmask_clear(struct nfct_bitmask *);
 bool nfct_bitmask_equal(const struct nfct_bitmask *, const struct nfct_bitmask *);
+void nfct_bitmask_set_attr_grp(struct nfct_bitmask *, enum nf_conntrack_attr_grp type);
 
 /* connlabel name <-> bit translation mapping */
 struct nfct_labelmap;
@@ -464,8 +588,96 @@ extern int nfct_send(struct nfct_handle *h,
 		     const enum nf_conntrack_query query,
 		     const void *data);
 
+extern int nfct_query_async(struct nfct_handle *h,
+			    const enum nf_conntrack_query qt,
+			    const void *data,
+			    int (*cb)(int error, struct nf_conntrack *ct,
+				      void *cb_data),
+			    void *cb_data);
+
+extern unsigned int nfct_query_async_pending(const struct nfct_handle *h);
+
 extern int nfct_catch(struct nfct_handle *h);
 
+extern int nfct_catch_budget(struct nfct_handle *h, unsigned int max_msgs,
+			     uint64_t max_ns);
+
+extern int nfct_resync(struct nfct_handle *h);
+
+extern int nfct_coalesce_flush(struct nfct_handle *h);
+
+/* columnar conntrack table */
+struct nfct_table;
+
+enum nfct_table_col {
+	NFCT_COL_L3PROTO = 0,			/* u8 bits */
+	NFCT_COL_L4PROTO,			/* u8 bits */
+	NFCT_COL_ORIG_SRC,			/* u128 bits, IPv4 in first u32 */
+	NFCT_COL_ORIG_DST,			/* u128 bits, IPv4 in first u32 */
+	NFCT_COL_REPL_SRC = 4,			/* u128 bits, IPv4 in first u32 */
+	NFCT_COL_REPL_DST,			/* u128 bits, IPv4 in first u32 */
+	NFCT_COL_ORIG_PORT_SRC,			/* u16 bits, network byte order */
+	NFCT_COL_ORIG_PORT_DST,			/* u16 bits, network byte order */
+	NFCT_COL_REPL_PORT_SRC = 8,		/* u16 bits, network byte order */
+	NFCT_COL_REPL_PORT_DST,			/* u16 bits, network byte order */
+	NFCT_COL_STATUS,			/* u32 bits */
+	NFCT_COL_MARK,				/* u32 bits */
+	NFCT_COL_ZONE = 12,			/* u16 bits */
+	NFCT_COL_TIMEOUT,			/* u32 bits */
+	NFCT_COL_ID,				/* u32 bits */
+	NFCT_COL_ORIG_PACKETS,			/* u64 bits */
+	NFCT_COL_ORIG_BYTES = 16,		/* u64 bits */
+	NFCT_COL_REPL_PACKETS,			/* u64 bits */
+	NFCT_COL_REPL_BYTES,			/* u64 bits */
+	NFCT_COL_MAX
+};
+
+extern struct nfct_table *nfct_table_new(void);
+extern void nfct_table_destroy(struct nfct_table *t);
+extern void nfct_table_reset(struct nfct_table *t);
+extern unsigned int nfct_table_len(const struct nfct_table *t);
+extern const void *nfct_table_column(const struct nfct_table *t,
+				     const enum nfct_table_col col);
+extern int nfct_table_add_nlmsg(struct nfct_table *t,
+				const struct nlmsghdr *nlh);
+extern int nfct_table_dump(struct nfct_handle *h, struct nfct_table *t,
+			   uint32_t family);
+
+/* batched queries */
+struct nfct_batch;
+
+extern struct nfct_batch *nfct_batch_create(struct nfct_handle *h,
+					    size_t size);
+extern void nfct_batch_destroy(struct nfct_batch *b);
+extern void nfct_batch_reset(struct nfct_batch *b);
+extern unsigned int nfct_batch_len(const struct nfct_batch *b);
+extern int nfct_batch_add(struct nfct_batch *b,
+			  const enum nf_conntrack_query qt,
+			  const struct nf_conntrack *ct);
+extern int nfct_batch_send(struct nfct_batch *b);
+extern int nfct_batch_error(const struct nfct_batch *b, unsigned int index);
+
+/* message templates */
+struct nfct_template;
+
+extern struct nfct_template *nfct_template_compile(const struct nf_conntrack *ct);
+extern void nfct_template_destroy(struct nfct_template *t);
+extern int nfct_template_set_attr(struct nfct_template *t,
+				  const enum nf_conntrack_attr type,
+				  const void *value);
+extern int nfct_template_set_attr_u16(struct nfct_template *t,
+				      const enum nf_conntrack_attr type,
+				      uint16_t value);
+extern int nfct_template_set_attr_u32(struct nfct_template *t,
+				      const enum nf_conntrack_attr type,
+				      uint32_t value);
+extern int nfct_template_build(const struct nfct_template *t,
+			       struct nlmsghdr *nlh);
+extern uint8_t nfct_template_family(const struct nfct_template *t);
+extern int nfct_batch_add_template(struct nfct_batch *b,
+				   const enum nf_conntrack_query qt,
+				   const struct nfct_template *t);
+
 /* copy */
 enum {
 	NFCT_CP_ALL = 0,
@@ -562,6 +774,24 @@ void nfct_filter_dump_set_attr_u8(struct nfct_filter_dump *filter_dump,
 				  const enum nfct_filter_dump_attr type,
 				  uint8_t data);
 
+extern int nfct_flush_filter(struct nfct_handle *h,
+			     const struct nfct_filter_dump *filter,
+			     const struct nf_conntrack *tmpl,
+			     unsigned int flags);
+
+extern int nfct_remark_filter(struct nfct_handle *h,
+			      const struct nfct_filter_dump *filter,
+			      const struct nf_conntrack *tmpl,
+			      unsigned int flags,
+			      uint32_t mark, uint32_t mask);
+
+extern int nfct_relabel_filter(struct nfct_handle *h,
+			       const struct nfct_filter_dump *filter,
+			       const struct nf_conntrack *tmpl,
+			       unsigned int flags,
+			       const struct nfct_bitmask *set,
+			       const struct nfct_bitmask *clear);
+
 /* low level API: netlink functions */
 
 extern __attribute__((deprecated)) int
@@ -589,6 +819,30 @@ int nfct_build_query(struct nfnl_subsys_handle *ssh,
 extern int nfct_nlmsg_build(struct nlmsghdr *nlh, const struct nf_conntrack *ct);
 extern int nfct_nlmsg_parse(const struct nlmsghdr *nlh, struct nf_conntrack *ct);
 extern int nfct_payload_parse(const void *payload, size_t payload_len, uint16_t l3num, struct nf_conntrack *ct);
+extern int nfct_payload_parse_mask(const void *payload, size_t payload_len, uint16_t l3num, struct nf_conntrack *ct, const struct nfct_bitmask *attrs);
+
+/* flow key, see nfct_nlmsg_extract_key() */
+struct nfct_flow_tuple {
+	uint32_t	src[4];		/* network byte order, IPv4 in src[0] */
+	uint32_t	dst[4];
+	uint16_t	sport;		/* network byte order, ICMP identifier */
+	uint16_t	dport;		/* network byte order */
+	uint8_t		l4proto;
+	uint8_t		icmp_type;
+	uint8_t		icmp_code;
+	uint8_t		pad;
+};
+
+struct nfct_flow_key {
+	struct nfct_flow_tuple	orig;
+	struct nfct_flow_tuple	reply;
+	uint32_t		id;
+	uint16_t		zone;
+	uint8_t			l3proto;
+	uint8_t			pad;
+};
+
+extern int nfct_nlmsg_extract_key(const struct nlmsghdr *nlh, struct nfct_flow_key *key);
 
 /*
  * NEW expectation API
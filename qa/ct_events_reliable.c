@@ -34,7 +34,7 @@ static void sighandler(int foo)
 	exit(EXIT_SUCCESS);
 }
 
-int main(void)
+int main(int argc, char *argv[])
 {
 	int ret;
 	struct nfct_handle *h;
@@ -53,6 +53,12 @@ int main(void)
 	setsockopt(nfct_fd(h), SOL_NETLINK,
 			NETLINK_NO_ENOBUFS, &on, sizeof(int));
 
+	/* optional: number of io_uring receive buffers */
+	if (argc > 1 && nfct_handle_set_uring(h, atoi(argv[1]), 0) == -1) {
+		perror("nfct_handle_set_uring");
+		return 0;
+	}
+
 	nfct_callback_register(h, NFCT_T_ALL, event_cb, NULL);
 
 	printf("TEST: waiting for events...\n");
@@ -0,0 +1,235 @@
+/* check that nfct_flush_filter() and nfct_remark_filter() act on the
+   conntracks that the dump reports, and not on their twins in another
+   zone: the same tuple is created in zone 0 and in zone 7, and only the
+   latter has to change. nfct_relabel_filter() is checked too, if the
+   conntracks have room for labels.
+
+   This talks to the kernel, you need CAP_NET_ADMIN and conntrack zones.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#include <libnetfilter_conntrack/libnetfilter_conntrack.h>
+#include <libnetfilter_conntrack/libnetfilter_conntrack_tcp.h>
+
+static struct nf_conntrack *ct_new(uint16_t sport)
+{
+	struct nf_conntrack *ct;
+
+	ct = nfct_new();
+	assert(ct);
+	nfct_set_attr_u8(ct, ATTR_L3PROTO, AF_INET);
+	nfct_set_attr_u32(ct, ATTR_IPV4_SRC, inet_addr("10.99.0.1"));
+	nfct_set_attr_u32(ct, ATTR_IPV4_DST, inet_addr("10.99.0.2"));
+	nfct_set_attr_u8(ct, ATTR_L4PROTO, IPPROTO_TCP);
+	nfct_set_attr_u16(ct, ATTR_PORT_SRC, htons(sport));
+	nfct_set_attr_u16(ct, ATTR_PORT_DST, htons(80));
+	nfct_setobjopt(ct, NFCT_SOPT_SETUP_REPLY);
+	nfct_set_attr_u8(ct, ATTR_TCP_STATE, TCP_CONNTRACK_ESTABLISHED);
+	nfct_set_attr_u32(ct, ATTR_TIMEOUT, 100);
+
+	return ct;
+}
+
+static void ct_create(struct nfct_handle *h, uint16_t sport,
+		      enum nf_conntrack_attr zone_attr, uint16_t zone,
+		      uint32_t mark)
+{
+	struct nf_conntrack *ct = ct_new(sport);
+
+	if (zone)
+		nfct_set_attr_u16(ct, zone_attr, zone);
+	nfct_set_attr_u32(ct, ATTR_MARK, mark);
+
+	/* leftovers of a previous run. */
+	nfct_query(h, NFCT_Q_DESTROY, ct);
+	if (nfct_query(h, NFCT_Q_CREATE, ct) == -1) {
+		perror("nfct_query(NFCT_Q_CREATE)");
+		exit(EXIT_FAILURE);
+	}
+	nfct_destroy(ct);
+}
+
+static int get_cb(enum nf_conntrack_msg_type type, struct nf_conntrack *ct,
+		  void *data)
+{
+	nfct_copy(data, ct, NFCT_CP_OVERRIDE);
+	return NFCT_CB_CONTINUE;
+}
+
+/* the conntrack as the kernel reports it, NULL if there is none. */
+static struct nf_conntrack *ct_get(struct nfct_handle *h, uint16_t sport,
+				   enum nf_conntrack_attr zone_attr,
+				   uint16_t zone)
+{
+	struct nf_conntrack *ct = ct_new(sport), *res;
+
+	if (zone)
+		nfct_set_attr_u16(ct, zone_attr, zone);
+
+	res = nfct_new();
+	assert(res);
+	nfct_callback_register(h, NFCT_T_ALL, get_cb, res);
+	if (nfct_query(h, NFCT_Q_GET, ct) == -1) {
+		assert(errno == ENOENT);
+		nfct_destroy(res);
+		res = NULL;
+	}
+	nfct_callback_unregister(h);
+	nfct_destroy(ct);
+
+	return res;
+}
+
+/* the mark of the conntrack, 0 if there is none. */
+static uint32_t ct_mark(struct nfct_handle *h, uint16_t sport,
+			enum nf_conntrack_attr zone_attr, uint16_t zone)
+{
+	struct nf_conntrack *ct = ct_get(h, sport, zone_attr, zone);
+	uint32_t mark = 0;
+
+	if (ct) {
+		mark = nfct_get_attr_u32(ct, ATTR_MARK);
+		nfct_destroy(ct);
+	}
+	return mark;
+}
+
+/* whether the label is set on the conntrack. */
+static int ct_label(struct nfct_handle *h, uint16_t sport,
+		    enum nf_conntrack_attr zone_attr, uint16_t zone,
+		    unsigned int bit)
+{
+	struct nf_conntrack *ct = ct_get(h, sport, zone_attr, zone);
+	const struct nfct_bitmask *b;
+	int ret = 0;
+
+	assert(ct);
+	b = nfct_get_attr(ct, ATTR_CONNLABELS);
+	if (b && bit <= nfct_bitmask_maxbit(b))
+		ret = nfct_bitmask_test_bit(b, bit);
+	nfct_destroy(ct);
+
+	return ret;
+}
+
+static void ct_delete(struct nfct_handle *h, uint16_t sport,
+		      enum nf_conntrack_attr zone_attr, uint16_t zone)
+{
+	struct nf_conntrack *ct = ct_new(sport);
+
+	if (zone)
+		nfct_set_attr_u16(ct, zone_attr, zone);
+	nfct_query(h, NFCT_Q_DESTROY, ct);
+	nfct_destroy(ct);
+}
+
+static void test_flush(struct nfct_handle *h, struct nf_conntrack *tmpl)
+{
+	printf("== test flush by filter across zones ==\n");
+
+	ct_create(h, 1000, ATTR_ZONE, 0, 0x11);
+	ct_create(h, 1000, ATTR_ZONE, 7, 0x77);
+	/* a zone in the reply direction only. */
+	ct_create(h, 1001, ATTR_REPL_ZONE, 9, 0x77);
+
+	assert(nfct_flush_filter(h, NULL, tmpl, NFCT_CMP_ALL) == 2);
+	assert(ct_mark(h, 1000, ATTR_ZONE, 0) == 0x11);
+	assert(ct_mark(h, 1000, ATTR_ZONE, 7) == 0);
+	assert(ct_mark(h, 1001, ATTR_REPL_ZONE, 9) == 0);
+
+	ct_delete(h, 1000, ATTR_ZONE, 0);
+	printf("OK\n");
+}
+
+static void test_remark(struct nfct_handle *h, struct nf_conntrack *tmpl)
+{
+	printf("== test remark by filter across zones ==\n");
+
+	ct_create(h, 1000, ATTR_ZONE, 0, 0x11);
+	ct_create(h, 1000, ATTR_ZONE, 7, 0x77);
+	ct_create(h, 1001, ATTR_REPL_ZONE, 9, 0x77);
+
+	assert(nfct_remark_filter(h, NULL, tmpl, NFCT_CMP_ALL,
+				  0x100, 0xf00) == 2);
+	assert(ct_mark(h, 1000, ATTR_ZONE, 0) == 0x11);
+	assert(ct_mark(h, 1000, ATTR_ZONE, 7) == 0x177);
+	assert(ct_mark(h, 1001, ATTR_REPL_ZONE, 9) == 0x177);
+
+	/* nothing left to change. */
+	assert(nfct_remark_filter(h, NULL, tmpl, NFCT_CMP_ALL,
+				  0x100, 0xf00) == 0);
+
+	ct_delete(h, 1000, ATTR_ZONE, 0);
+	ct_delete(h, 1000, ATTR_ZONE, 7);
+	ct_delete(h, 1001, ATTR_REPL_ZONE, 9);
+	printf("OK\n");
+}
+
+static void test_relabel(struct nfct_handle *h, struct nf_conntrack *tmpl)
+{
+	struct nfct_bitmask *set;
+	int ret;
+
+	printf("== test relabel by filter across zones ==\n");
+
+	set = nfct_bitmask_new(127);
+	assert(set);
+	nfct_bitmask_set_bit(set, 5);
+
+	ct_create(h, 1000, ATTR_ZONE, 0, 0x11);
+	ct_create(h, 1000, ATTR_ZONE, 7, 0x77);
+
+	ret = nfct_relabel_filter(h, NULL, tmpl, NFCT_CMP_ALL, set, NULL);
+	if (ret == -1 && errno == ENOSPC) {
+		printf("SKIP: no room for labels, no label user yet\n");
+	} else {
+		assert(ret == 1);
+		assert(!ct_label(h, 1000, ATTR_ZONE, 0, 5));
+		assert(ct_label(h, 1000, ATTR_ZONE, 7, 5));
+
+		/* nothing left to change. */
+		assert(nfct_relabel_filter(h, NULL, tmpl, NFCT_CMP_ALL,
+					   set, NULL) == 0);
+
+		/* and back. */
+		assert(nfct_relabel_filter(h, NULL, tmpl, NFCT_CMP_ALL,
+					   NULL, set) == 1);
+		assert(!ct_label(h, 1000, ATTR_ZONE, 7, 5));
+		printf("OK\n");
+	}
+
+	ct_delete(h, 1000, ATTR_ZONE, 0);
+	ct_delete(h, 1000, ATTR_ZONE, 7);
+	nfct_bitmask_destroy(set);
+}
+
+int main(void)
+{
+	struct nfct_handle *h;
+	struct nf_conntrack *tmpl;
+
+	h = nfct_open(CONNTRACK, 0);
+	if (h == NULL) {
+		perror("nfct_open");
+		exit(EXIT_FAILURE);
+	}
+
+	tmpl = nfct_new();
+	assert(tmpl);
+	nfct_set_attr_u32(tmpl, ATTR_MARK, 0x77);
+
+	test_flush(h, tmpl);
+	test_remark(h, tmpl);
+	test_relabel(h, tmpl);
+
+	nfct_destroy(tmpl);
+	nfct_close(h);
+
+	exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,174 @@
+/* simple tool to measure the cost of decoding a ctnetlink message into a
+   conntrack object, both through the libmnl based path (nfct_nlmsg_parse)
+   and the libnfnetlink one (nfct_parse_conntrack), and into a flow key
+   (nfct_nlmsg_extract_key).
+
+   The message carries what a typical TCP event with accounting and
+   timestamping enabled carries.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
+#include <arpa/inet.h>
+#include <time.h>
+
+#include <libmnl/libmnl.h>
+#include <libnetfilter_conntrack/libnetfilter_conntrack.h>
+#include <libnetfilter_conntrack/libnetfilter_conntrack_tcp.h>
+
+static uint64_t now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void put_counters(struct nlmsghdr *nlh, uint16_t type,
+			 uint64_t packets, uint64_t bytes)
+{
+	struct nlattr *nest;
+
+	nest = mnl_attr_nest_start(nlh, type);
+	mnl_attr_put_u64(nlh, CTA_COUNTERS_PACKETS, htobe64(packets));
+	mnl_attr_put_u64(nlh, CTA_COUNTERS_BYTES, htobe64(bytes));
+	mnl_attr_nest_end(nlh, nest);
+}
+
+static struct nlmsghdr *build(char *buf)
+{
+	struct nlmsghdr *nlh;
+	struct nfgenmsg *nfh;
+	struct nf_conntrack *ct;
+	struct nlattr *nest;
+
+	ct = nfct_new();
+	if (ct == NULL) {
+		perror("nfct_new");
+		exit(EXIT_FAILURE);
+	}
+	nfct_set_attr_u8(ct, ATTR_L3PROTO, AF_INET);
+	nfct_set_attr_u32(ct, ATTR_IPV4_SRC, inet_addr("1.1.1.1"));
+	nfct_set_attr_u32(ct, ATTR_IPV4_DST, inet_addr("2.2.2.2"));
+	nfct_set_attr_u8(ct, ATTR_L4PROTO, IPPROTO_TCP);
+	nfct_set_attr_u16(ct, ATTR_PORT_SRC, htons(1025));
+	nfct_set_attr_u16(ct, ATTR_PORT_DST, htons(80));
+	nfct_setobjopt(ct, NFCT_SOPT_SETUP_REPLY);
+	nfct_set_attr_u8(ct, ATTR_TCP_STATE, TCP_CONNTRACK_ESTABLISHED);
+	nfct_set_attr_u32(ct, ATTR_TIMEOUT, 432000);
+	nfct_set_attr_u32(ct, ATTR_STATUS, IPS_ASSURED | IPS_CONFIRMED);
+	nfct_set_attr_u32(ct, ATTR_MARK, 0x10);
+	nfct_set_attr_u16(ct, ATTR_ZONE, 1);
+
+	nlh = mnl_nlmsg_put_header(buf);
+	nlh->nlmsg_type = (NFNL_SUBSYS_CTNETLINK << 8) | IPCTNL_MSG_CT_NEW;
+	nlh->nlmsg_flags = NLM_F_CREATE;
+	nfh = mnl_nlmsg_put_extra_header(nlh, sizeof(struct nfgenmsg));
+	nfh->nfgen_family = AF_INET;
+	nfh->version = NFNETLINK_V0;
+
+	if (nfct_nlmsg_build(nlh, ct) < 0) {
+		perror("nfct_nlmsg_build");
+		exit(EXIT_FAILURE);
+	}
+	nfct_destroy(ct);
+
+	/* what the kernel adds on top of what we can build. */
+	put_counters(nlh, CTA_COUNTERS_ORIG, 10, 1500);
+	put_counters(nlh, CTA_COUNTERS_REPLY, 8, 9000);
+	mnl_attr_put_u32(nlh, CTA_USE, htonl(1));
+	mnl_attr_put_u32(nlh, CTA_ID, htonl(0x12345678));
+	nest = mnl_attr_nest_start(nlh, CTA_TIMESTAMP);
+	mnl_attr_put_u64(nlh, CTA_TIMESTAMP_START, htobe64(1000000000ULL));
+	mnl_attr_nest_end(nlh, nest);
+
+	return nlh;
+}
+
+static struct nlmsghdr *nlh;
+static struct nf_conntrack *ct;
+static struct nfct_flow_key key;
+
+static void run_nlmsg_parse(void)
+{
+	nfct_nlmsg_parse(nlh, ct);
+}
+
+/* deprecated, but it is the path of the callbacks. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+static void run_parse_conntrack(void)
+{
+	nfct_parse_conntrack(NFCT_T_ALL, nlh, ct);
+}
+#pragma GCC diagnostic pop
+
+static void run_extract_key(void)
+{
+	nfct_nlmsg_extract_key(nlh, &key);
+}
+
+/*
+ * The best of several short batches, a long single run mostly measures
+ * whatever else the box is busy with.
+ */
+#define BATCHES	200
+
+static double bench(void (*run)(void), unsigned int n)
+{
+	uint64_t start, elapsed, best = UINT64_MAX;
+	unsigned int i, j;
+
+	for (i = 0; i < BATCHES; i++) {
+		start = now();
+		for (j = 0; j < n; j++)
+			run();
+		elapsed = now() - start;
+		if (elapsed < best)
+			best = elapsed;
+	}
+	return (double)best / n;
+}
+
+int main(int argc, char *argv[])
+{
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	unsigned int n = 10000;
+
+	if (argc > 1)
+		n = atoi(argv[1]);
+	if (n == 0) {
+		fprintf(stderr, "Usage: %s [iterations per batch]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	nlh = build(buf);
+
+	ct = nfct_new();
+	if (ct == NULL) {
+		perror("nfct_new");
+		exit(EXIT_FAILURE);
+	}
+
+	/* warm up, and make sure that the message is valid. */
+	if (nfct_nlmsg_parse(nlh, ct) < 0) {
+		perror("nfct_nlmsg_parse");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%u batches of %u messages of %u bytes\n",
+	       BATCHES, n, nlh->nlmsg_len);
+	printf("nfct_nlmsg_parse:     %6.1f ns/msg\n",
+	       bench(run_nlmsg_parse, n));
+	printf("nfct_parse_conntrack: %6.1f ns/msg\n",
+	       bench(run_parse_conntrack, n));
+	printf("nfct_nlmsg_extract_key: %4.1f ns/msg\n",
+	       bench(run_extract_key, n));
+
+	nfct_destroy(ct);
+
+	exit(EXIT_SUCCESS);
+}
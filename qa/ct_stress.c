@@ -4,6 +4,9 @@
    we hit ENOMEM at some point.
 
    You have to use conntrack_events_reliable together with this tool.
+
+   The flows are created in batches, see nfct_batch_send(), out of one
+   message template whose addresses are patched for every flow.
 */
 
 #include <stdio.h>
@@ -21,7 +24,10 @@ int main(int argc, char *argv[])
 	time_t t;
 	int ret, i, j, r;
 	struct nfct_handle *h;
+	struct nfct_batch *b;
+	struct nfct_template *tmpl;
 	struct nf_conntrack *ct;
+	uint32_t src, dst;
 
 	if (argc < 2) {
 		fprintf(stderr, "Usage: %s [ct_table_size]\n", argv[0]);
@@ -45,28 +51,67 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
-	for (i = r, j = 0;i < (r + atoi(argv[1]) * 2); i++, j++) {
-		nfct_set_attr_u8(ct, ATTR_L3PROTO, AF_INET);
-		nfct_set_attr_u32(ct, ATTR_IPV4_SRC, inet_addr("1.1.1.1") + i);
-		nfct_set_attr_u32(ct, ATTR_IPV4_DST, inet_addr("2.2.2.2") + i);
+	b = nfct_batch_create(h, 0);
+	if (!b) {
+		perror("nfct_batch_create");
+		nfct_close(h);
+		nfct_destroy(ct);
+		return -1;
+	}
 
-		nfct_set_attr_u8(ct, ATTR_L4PROTO, IPPROTO_TCP);
-		nfct_set_attr_u16(ct, ATTR_PORT_SRC, htons(10));
-		nfct_set_attr_u16(ct, ATTR_PORT_DST, htons(20));
+	nfct_set_attr_u8(ct, ATTR_L3PROTO, AF_INET);
+	nfct_set_attr_u32(ct, ATTR_IPV4_SRC, inet_addr("1.1.1.1"));
+	nfct_set_attr_u32(ct, ATTR_IPV4_DST, inet_addr("2.2.2.2"));
 
-		nfct_setobjopt(ct, NFCT_SOPT_SETUP_REPLY);
+	nfct_set_attr_u8(ct, ATTR_L4PROTO, IPPROTO_TCP);
+	nfct_set_attr_u16(ct, ATTR_PORT_SRC, htons(10));
+	nfct_set_attr_u16(ct, ATTR_PORT_DST, htons(20));
 
-		nfct_set_attr_u8(ct, ATTR_TCP_STATE, TCP_CONNTRACK_ESTABLISHED);
-		nfct_set_attr_u32(ct, ATTR_TIMEOUT, 1000);
-		nfct_set_attr_u32(ct, ATTR_STATUS, IPS_ASSURED);
+	nfct_setobjopt(ct, NFCT_SOPT_SETUP_REPLY);
 
-		if (i % 10000 == 0)
-			printf("added %d flow entries\n", j);
+	nfct_set_attr_u8(ct, ATTR_TCP_STATE, TCP_CONNTRACK_ESTABLISHED);
+	nfct_set_attr_u32(ct, ATTR_TIMEOUT, 1000);
+	nfct_set_attr_u32(ct, ATTR_STATUS, IPS_ASSURED);
 
-		ret = nfct_query(h, NFCT_Q_CREATE, ct);
-		if (ret == -1)
-			perror("nfct_query: ");
+	tmpl = nfct_template_compile(ct);
+	if (!tmpl) {
+		perror("nfct_template_compile");
+		nfct_batch_destroy(b);
+		nfct_close(h);
+		nfct_destroy(ct);
+		return -1;
+	}
+
+	for (i = r, j = 0;i < (r + atoi(argv[1]) * 2); i++, j++) {
+		src = inet_addr("1.1.1.1") + i;
+		dst = inet_addr("2.2.2.2") + i;
+
+		nfct_template_set_attr_u32(tmpl, ATTR_ORIG_IPV4_SRC, src);
+		nfct_template_set_attr_u32(tmpl, ATTR_ORIG_IPV4_DST, dst);
+		nfct_template_set_attr_u32(tmpl, ATTR_REPL_IPV4_SRC, dst);
+		nfct_template_set_attr_u32(tmpl, ATTR_REPL_IPV4_DST, src);
+
+		if (nfct_batch_add_template(b, NFCT_Q_CREATE, tmpl) == -1)
+			perror("nfct_batch_add_template: ");
+
+		if (i % 10000 == 0) {
+			ret = nfct_batch_send(b);
+			if (ret == -1)
+				perror("nfct_batch_send: ");
+			else if (ret > 0)
+				printf("%d flow entries failed\n", ret);
+			nfct_batch_reset(b);
+			printf("added %d flow entries\n", j);
+		}
 	}
+	ret = nfct_batch_send(b);
+	if (ret == -1)
+		perror("nfct_batch_send: ");
+	else if (ret > 0)
+		printf("%d flow entries failed\n", ret);
+
+	nfct_template_destroy(tmpl);
+	nfct_batch_destroy(b);
 	nfct_close(h);
 
 	nfct_destroy(ct);
@@ -11,6 +11,7 @@
 #include <sys/wait.h>
 #include <time.h>
 #include <errno.h>
+#include <endian.h>
 
 #include <libnetfilter_conntrack/libnetfilter_conntrack.h>
 
@@ -143,6 +144,694 @@ static void test_nfct_bitmask(void)
 	printf("OK\n");
 }
 
+static void test_nfct_pool(void)
+{
+	struct nf_conntrack *ct[256], *clone;
+	struct nfct_pool *pool;
+	const char *helper = "ftp";
+	int i;
+
+	printf("== test nfct_pool_* API ==\n");
+
+	pool = nfct_pool_create(16);
+	assert(pool);
+
+	for (i = 0; i < 256; i++) {
+		ct[i] = nfct_pool_new(pool);
+		assert(ct[i]);
+		assert(!nfct_attr_is_set(ct[i], ATTR_MARK));
+		nfct_set_attr_u32(ct[i], ATTR_MARK, i);
+		nfct_set_attr_l(ct[i], ATTR_HELPER_INFO, helper, strlen(helper));
+	}
+	for (i = 0; i < 256; i++)
+		assert(nfct_get_attr_u32(ct[i], ATTR_MARK) == i);
+
+	/* clones are not pool objects, they can outlive the pool. */
+	clone = nfct_clone(ct[0]);
+	assert(clone);
+
+	for (i = 0; i < 128; i++)
+		nfct_pool_put(pool, ct[i]);
+	for (i = 128; i < 256; i++)
+		nfct_destroy(ct[i]);
+
+	/* recycled objects come back without attributes set. */
+	for (i = 0; i < 256; i++) {
+		ct[i] = nfct_pool_new(pool);
+		assert(ct[i]);
+		assert(!nfct_attr_is_set(ct[i], ATTR_MARK));
+		assert(!nfct_attr_is_set(ct[i], ATTR_HELPER_INFO));
+	}
+	for (i = 0; i < 256; i++)
+		nfct_destroy(ct[i]);
+
+	nfct_pool_destroy(pool);
+
+	assert(nfct_get_attr_u32(clone, ATTR_MARK) == 0);
+	assert(memcmp(nfct_get_attr(clone, ATTR_HELPER_INFO), helper,
+		      strlen(helper)) == 0);
+	nfct_destroy(clone);
+	printf("OK\n");
+}
+
+/* nfct_sizeof() and nfct_maxsize() are deprecated, but still tested. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+static void test_nfct_cold(void)
+{
+	struct nf_conntrack *ct, *ct2;
+	char *buf;
+
+	printf("== test nfct cold attributes ==\n");
+
+	ct = nfct_new();
+	assert(ct);
+	assert(nfct_sizeof(ct) < nfct_maxsize());
+
+	nfct_set_attr_u32(ct, ATTR_MARK, 1);
+	assert(nfct_sizeof(ct) < nfct_maxsize());
+
+	nfct_set_attr(ct, ATTR_HELPER_NAME, "ftp");
+	assert(nfct_sizeof(ct) == nfct_maxsize());
+
+	ct2 = nfct_new();
+	assert(ct2);
+	nfct_copy(ct2, ct, NFCT_CP_META);
+	assert(nfct_sizeof(ct2) == nfct_maxsize());
+	assert(strcmp(nfct_get_attr(ct2, ATTR_HELPER_NAME), "ftp") == 0);
+
+	/* the extension is kept, but its attributes are gone. */
+	nfct_set_attr_u32(ct, ATTR_MARK, 2);
+	nfct_attr_unset(ct, ATTR_HELPER_NAME);
+	nfct_copy(ct2, ct, NFCT_CP_OVERRIDE);
+	assert(nfct_get_attr_u32(ct2, ATTR_MARK) == 2);
+	assert(!nfct_attr_is_set(ct2, ATTR_HELPER_NAME));
+
+	/* objects that are not from nfct_new() keep it in their buffer. */
+	buf = malloc(nfct_maxsize());
+	assert(buf);
+	memset(buf, 0, nfct_maxsize());
+	nfct_set_attr(ct, ATTR_HELPER_NAME, "ftp");
+	nfct_copy((struct nf_conntrack *)buf, ct, NFCT_CP_OVERRIDE);
+	assert(nfct_sizeof((struct nf_conntrack *)buf) == nfct_maxsize());
+	assert(strcmp(nfct_get_attr((struct nf_conntrack *)buf,
+				    ATTR_HELPER_NAME), "ftp") == 0);
+	nfct_set_attr_u32((struct nf_conntrack *)buf, ATTR_SECMARK, 3);
+	assert(nfct_get_attr_u32((struct nf_conntrack *)buf, ATTR_SECMARK) == 3);
+	free(buf);
+
+	nfct_destroy(ct2);
+	nfct_destroy(ct);
+	printf("OK\n");
+}
+
+#pragma GCC diagnostic pop
+
+static void test_nfct_labels(void)
+{
+	struct nf_conntrack *ct, *clone;
+	struct nfct_bitmask *b;
+	const struct nfct_bitmask *c;
+	unsigned int max;
+
+	printf("== test nfct labels storage ==\n");
+
+	/* 128 bits are stored inline by clones, 256 bits go to the heap. */
+	for (max = 127; max <= 255; max += 128) {
+		ct = nfct_new();
+		assert(ct);
+		b = nfct_bitmask_new(max);
+		assert(b);
+		nfct_bitmask_set_bit(b, 3);
+		nfct_bitmask_set_bit(b, max);
+		nfct_set_attr(ct, ATTR_CONNLABELS, b);
+
+		clone = nfct_clone(ct);
+		assert(clone);
+		c = nfct_get_attr(clone, ATTR_CONNLABELS);
+		assert(c && c != b);
+		assert(nfct_bitmask_test_bit(c, 3));
+		assert(nfct_bitmask_test_bit(c, max));
+		assert(nfct_cmp(ct, clone, NFCT_CMP_ALL) == 1);
+
+		nfct_bitmask_unset_bit(b, max);
+		assert(nfct_cmp(ct, clone, NFCT_CMP_ALL) == 0);
+
+		nfct_destroy(clone);
+		nfct_destroy(ct);
+	}
+	printf("OK\n");
+}
+
+static void test_nfct_view(void)
+{
+	char buf[4096];
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	struct nfgenmsg *nfh;
+	struct nf_conntrack *ct, *parsed;
+	struct nfct_bitmask *b;
+	struct nfct_view *view;
+	int i;
+
+	printf("== test nfct_view_* API ==\n");
+
+	ct = nfct_new();
+	assert(ct);
+	nfct_set_attr_u8(ct, ATTR_L3PROTO, AF_INET);
+	nfct_set_attr_u32(ct, ATTR_IPV4_SRC, htonl(0x0a000001));
+	nfct_set_attr_u32(ct, ATTR_IPV4_DST, htonl(0x0a000002));
+	nfct_set_attr_u32(ct, ATTR_REPL_IPV4_SRC, htonl(0x0a000002));
+	nfct_set_attr_u32(ct, ATTR_REPL_IPV4_DST, htonl(0x0a000001));
+	nfct_set_attr_u8(ct, ATTR_REPL_L3PROTO, AF_INET);
+	nfct_set_attr_u8(ct, ATTR_L4PROTO, IPPROTO_TCP);
+	nfct_set_attr_u8(ct, ATTR_REPL_L4PROTO, IPPROTO_TCP);
+	nfct_set_attr_u16(ct, ATTR_PORT_SRC, htons(1024));
+	nfct_set_attr_u16(ct, ATTR_PORT_DST, htons(80));
+	nfct_set_attr_u16(ct, ATTR_REPL_PORT_SRC, htons(80));
+	nfct_set_attr_u16(ct, ATTR_REPL_PORT_DST, htons(1024));
+	nfct_set_attr_u8(ct, ATTR_TCP_STATE, 3);
+	nfct_set_attr_u32(ct, ATTR_STATUS, 0x1a);
+	nfct_set_attr_u32(ct, ATTR_TIMEOUT, 100);
+	nfct_set_attr_u32(ct, ATTR_MARK, 0xdeadbeef);
+	nfct_set_attr_u16(ct, ATTR_ZONE, 7);
+	nfct_set_attr(ct, ATTR_HELPER_NAME, "ftp");
+	b = nfct_bitmask_new(127);
+	nfct_bitmask_set_bit(b, 1);
+	nfct_bitmask_set_bit(b, 100);
+	nfct_set_attr(ct, ATTR_CONNLABELS, b);
+
+	memset(buf, 0, sizeof(buf));
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+	nlh->nlmsg_type = (NFNL_SUBSYS_CTNETLINK << 8) | IPCTNL_MSG_CT_NEW;
+	nfh = NLMSG_DATA(nlh);
+	nfh->nfgen_family = AF_INET;
+	nfh->version = NFNETLINK_V0;
+	assert(nfct_nlmsg_build(nlh, ct) == 0);
+
+	parsed = nfct_new();
+	assert(parsed);
+	assert(nfct_nlmsg_parse(nlh, parsed) == 0);
+
+	view = nfct_view_new();
+	assert(view);
+	assert(nfct_view_parse(view, nlh) == 0);
+
+	for (i = 0; i < ATTR_MAX; i++) {
+		const void *a = nfct_get_attr(parsed, i);
+		const void *v = nfct_view_get_attr(view, i);
+
+		if (a == NULL) {
+			assert(v == NULL);
+			continue;
+		}
+		assert(v != NULL);
+		switch (i) {
+		case ATTR_HELPER_NAME:
+			assert(strcmp(a, v) == 0);
+			break;
+		case ATTR_CONNLABELS:
+			assert(nfct_bitmask_equal(a, v));
+			break;
+		default:
+			/* a single byte differing is enough */
+			assert(memcmp(a, v, 1) == 0);
+			break;
+		}
+	}
+	assert(nfct_view_get_attr_u32(view, ATTR_MARK) == 0xdeadbeef);
+	assert(nfct_view_get_attr_u32(view, ATTR_TIMEOUT) == 100);
+	assert(nfct_view_get_attr_u16(view, ATTR_ZONE) == 7);
+	assert(nfct_view_get_attr_u16(view, ATTR_PORT_DST) == htons(80));
+	assert(nfct_view_attr_is_set(view, ATTR_ID) == 0);
+
+	nfct_view_destroy(view);
+	nfct_destroy(parsed);
+	nfct_destroy(ct);
+	printf("OK\n");
+}
+
+/* append an attribute to the message, nests are closed by the caller. */
+static struct nlattr *test_put_attr(struct nlmsghdr *nlh, uint16_t type,
+				    const void *data, uint16_t len)
+{
+	struct nlattr *a = (struct nlattr *)((char *)nlh +
+					     NLMSG_ALIGN(nlh->nlmsg_len));
+
+	a->nla_type = type;
+	a->nla_len = NLA_HDRLEN + len;
+	if (len)
+		memcpy((char *)a + NLA_HDRLEN, data, len);
+	nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + NLA_ALIGN(a->nla_len);
+
+	return a;
+}
+
+static void test_nfct_counters(void)
+{
+	char buf[4096];
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	struct nfgenmsg *nfh;
+	struct nf_conntrack *ct;
+	struct nfct_view *view;
+	struct nlattr *nest;
+	uint32_t u32, start;
+	uint64_t u64;
+
+	printf("== test 64 bits counters precedence ==\n");
+
+	memset(buf, 0, sizeof(buf));
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+	nlh->nlmsg_type = (NFNL_SUBSYS_CTNETLINK << 8) | IPCTNL_MSG_CT_NEW;
+	nfh = NLMSG_DATA(nlh);
+	nfh->nfgen_family = AF_INET;
+	nfh->version = NFNETLINK_V0;
+
+	/* the 32 bits counter first, then the 64 bits one, and backwards. */
+	start = nlh->nlmsg_len;
+	nest = test_put_attr(nlh, CTA_COUNTERS_ORIG | NLA_F_NESTED, NULL, 0);
+	u32 = htonl(1);
+	test_put_attr(nlh, CTA_COUNTERS32_PACKETS, &u32, sizeof(u32));
+	u64 = htobe64(0x100000001ULL);
+	test_put_attr(nlh, CTA_COUNTERS_PACKETS, &u64, sizeof(u64));
+	u64 = htobe64(0x200000002ULL);
+	test_put_attr(nlh, CTA_COUNTERS_BYTES, &u64, sizeof(u64));
+	u32 = htonl(2);
+	test_put_attr(nlh, CTA_COUNTERS32_BYTES, &u32, sizeof(u32));
+	nest->nla_len = (char *)nlh + nlh->nlmsg_len - (char *)nest;
+
+	/* only the 32 bits counters. */
+	nest = test_put_attr(nlh, CTA_COUNTERS_REPLY | NLA_F_NESTED, NULL, 0);
+	u32 = htonl(3);
+	test_put_attr(nlh, CTA_COUNTERS32_PACKETS, &u32, sizeof(u32));
+	u32 = htonl(4);
+	test_put_attr(nlh, CTA_COUNTERS32_BYTES, &u32, sizeof(u32));
+	nest->nla_len = (char *)nlh + nlh->nlmsg_len - (char *)nest;
+
+	ct = nfct_new();
+	assert(ct);
+	assert(nfct_nlmsg_parse(nlh, ct) == 0);
+	assert(nfct_get_attr_u64(ct, ATTR_ORIG_COUNTER_PACKETS) ==
+	       0x100000001ULL);
+	assert(nfct_get_attr_u64(ct, ATTR_ORIG_COUNTER_BYTES) ==
+	       0x200000002ULL);
+	assert(nfct_get_attr_u64(ct, ATTR_REPL_COUNTER_PACKETS) == 3);
+	assert(nfct_get_attr_u64(ct, ATTR_REPL_COUNTER_BYTES) == 4);
+
+	/* the 32 bits counters are decoded again, since the 64 bits ones
+	 * are not in this message. */
+	nlh->nlmsg_len = start;
+	nest = test_put_attr(nlh, CTA_COUNTERS_ORIG | NLA_F_NESTED, NULL, 0);
+	u32 = htonl(5);
+	test_put_attr(nlh, CTA_COUNTERS32_PACKETS, &u32, sizeof(u32));
+	nest->nla_len = (char *)nlh + nlh->nlmsg_len - (char *)nest;
+	assert(nfct_nlmsg_parse(nlh, ct) == 0);
+	assert(nfct_get_attr_u64(ct, ATTR_ORIG_COUNTER_PACKETS) == 5);
+
+	view = nfct_view_new();
+	assert(view);
+	assert(nfct_view_parse(view, nlh) == 0);
+	assert(nfct_view_get_attr_u64(view, ATTR_ORIG_COUNTER_PACKETS) == 5);
+	nfct_view_destroy(view);
+
+	nfct_destroy(ct);
+	printf("OK\n");
+}
+
+static void test_nfct_secctx(void)
+{
+	char buf[4096];
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	struct nfgenmsg *nfh;
+	struct nf_conntrack *ct;
+	struct nlattr *nest;
+	const char *secctx;
+	uint32_t start;
+	int i;
+
+	printf("== test security context name ==\n");
+
+	memset(buf, 0, sizeof(buf));
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+	nlh->nlmsg_type = (NFNL_SUBSYS_CTNETLINK << 8) | IPCTNL_MSG_CT_NEW;
+	nfh = NLMSG_DATA(nlh);
+	nfh->nfgen_family = AF_INET;
+	nfh->version = NFNETLINK_V0;
+
+	start = nlh->nlmsg_len;
+	nest = test_put_attr(nlh, CTA_SECCTX | NLA_F_NESTED, NULL, 0);
+	test_put_attr(nlh, CTA_SECCTX_NAME, "system_u", sizeof("system_u"));
+	nest->nla_len = (char *)nlh + nlh->nlmsg_len - (char *)nest;
+
+	ct = nfct_new();
+	assert(ct);
+	assert(nfct_nlmsg_parse(nlh, ct) == 0);
+	assert(strcmp(nfct_get_attr(ct, ATTR_SECCTX), "system_u") == 0);
+
+	/* the buffer is reused, as long as the name fits in what it holds. */
+	secctx = nfct_get_attr(ct, ATTR_SECCTX);
+	for (i = 0; i < 2; i++) {
+		const char *name = i ? "system_u" : "u";
+
+		nlh->nlmsg_len = start;
+		nest = test_put_attr(nlh, CTA_SECCTX | NLA_F_NESTED, NULL, 0);
+		test_put_attr(nlh, CTA_SECCTX_NAME, name, strlen(name) + 1);
+		nest->nla_len = (char *)nlh + nlh->nlmsg_len - (char *)nest;
+		assert(nfct_nlmsg_parse(nlh, ct) == 0);
+		assert(strcmp(nfct_get_attr(ct, ATTR_SECCTX), name) == 0);
+		assert(nfct_get_attr(ct, ATTR_SECCTX) == secctx);
+	}
+
+	/* the name must be NUL-terminated within the attribute. */
+	nlh->nlmsg_len = start;
+	nest = test_put_attr(nlh, CTA_SECCTX | NLA_F_NESTED, NULL, 0);
+	test_put_attr(nlh, CTA_SECCTX_NAME, "system_u", strlen("system_u"));
+	nest->nla_len = (char *)nlh + nlh->nlmsg_len - (char *)nest;
+	errno = 0;
+	assert(nfct_nlmsg_parse(nlh, ct) == -1 && errno == ERANGE);
+
+	nfct_destroy(ct);
+	printf("OK\n");
+}
+
+static void test_nfct_parse_mask(void)
+{
+	char buf[4096];
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	struct nfgenmsg *nfh;
+	struct nf_conntrack *ct, *parsed;
+	struct nfct_bitmask *b, *mask;
+	void *payload;
+	size_t len;
+
+	printf("== test nfct parse mask ==\n");
+
+	ct = nfct_new();
+	assert(ct);
+	nfct_set_attr_u8(ct, ATTR_L3PROTO, AF_INET);
+	nfct_set_attr_u32(ct, ATTR_IPV4_SRC, htonl(0x0a000001));
+	nfct_set_attr_u32(ct, ATTR_IPV4_DST, htonl(0x0a000002));
+	nfct_set_attr_u8(ct, ATTR_L4PROTO, IPPROTO_TCP);
+	nfct_set_attr_u16(ct, ATTR_PORT_SRC, htons(1024));
+	nfct_set_attr_u16(ct, ATTR_PORT_DST, htons(80));
+	nfct_set_attr_u8(ct, ATTR_TCP_STATE, 3);
+	nfct_set_attr_u32(ct, ATTR_MARK, 0xdeadbeef);
+	nfct_set_attr(ct, ATTR_HELPER_NAME, "ftp");
+	b = nfct_bitmask_new(127);
+	nfct_bitmask_set_bit(b, 1);
+	nfct_set_attr(ct, ATTR_CONNLABELS, b);
+
+	memset(buf, 0, sizeof(buf));
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+	nlh->nlmsg_type = (NFNL_SUBSYS_CTNETLINK << 8) | IPCTNL_MSG_CT_NEW;
+	nfh = NLMSG_DATA(nlh);
+	nfh->nfgen_family = AF_INET;
+	nfh->version = NFNETLINK_V0;
+	assert(nfct_nlmsg_build(nlh, ct) == 0);
+
+	payload = (char *)nfh + sizeof(struct nfgenmsg);
+	len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(struct nfgenmsg));
+
+	/* tuple and mark only, nested attributes are skipped */
+	mask = nfct_bitmask_new(ATTR_MAX);
+	assert(mask);
+	nfct_bitmask_set_attr_grp(mask, ATTR_GRP_ORIG_IPV4);
+	nfct_bitmask_set_bit(mask, ATTR_MARK);
+
+	parsed = nfct_new();
+	assert(parsed);
+	assert(nfct_payload_parse_mask(payload, len, AF_INET, parsed, mask) == 0);
+	assert(nfct_attr_is_set(parsed, ATTR_IPV4_SRC));
+	assert(nfct_attr_is_set(parsed, ATTR_PORT_DST));
+	assert(nfct_get_attr_u32(parsed, ATTR_MARK) == 0xdeadbeef);
+	assert(!nfct_attr_is_set(parsed, ATTR_TCP_STATE));
+	assert(!nfct_attr_is_set(parsed, ATTR_HELPER_NAME));
+	assert(!nfct_attr_is_set(parsed, ATTR_CONNLABELS));
+	nfct_destroy(parsed);
+
+	/* one attribute is enough to decode its nested attribute */
+	nfct_bitmask_set_bit(mask, ATTR_TCP_STATE);
+	parsed = nfct_new();
+	assert(parsed);
+	assert(nfct_payload_parse_mask(payload, len, AF_INET, parsed, mask) == 0);
+	assert(nfct_get_attr_u8(parsed, ATTR_TCP_STATE) == 3);
+	assert(!nfct_attr_is_set(parsed, ATTR_CONNLABELS));
+	nfct_destroy(parsed);
+
+	nfct_bitmask_destroy(mask);
+	nfct_destroy(ct);
+	printf("OK\n");
+}
+
+static void test_nfct_flow_key(void)
+{
+	char buf[4096];
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	struct nfgenmsg *nfh;
+	struct nf_conntrack *ct;
+	struct nfct_flow_key key, key2;
+
+	printf("== test nfct flow key ==\n");
+
+	ct = nfct_new();
+	assert(ct);
+	nfct_set_attr_u8(ct, ATTR_L3PROTO, AF_INET);
+	nfct_set_attr_u32(ct, ATTR_IPV4_SRC, htonl(0x0a000001));
+	nfct_set_attr_u32(ct, ATTR_IPV4_DST, htonl(0x0a000002));
+	nfct_set_attr_u8(ct, ATTR_L4PROTO, IPPROTO_TCP);
+	nfct_set_attr_u16(ct, ATTR_PORT_SRC, htons(1024));
+	nfct_set_attr_u16(ct, ATTR_PORT_DST, htons(80));
+	nfct_setobjopt(ct, NFCT_SOPT_SETUP_REPLY);
+	nfct_set_attr_u16(ct, ATTR_ZONE, 7);
+	nfct_set_attr_u32(ct, ATTR_MARK, 0xdeadbeef);
+
+	memset(buf, 0, sizeof(buf));
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+	nlh->nlmsg_type = (NFNL_SUBSYS_CTNETLINK << 8) | IPCTNL_MSG_CT_NEW;
+	nfh = NLMSG_DATA(nlh);
+	nfh->nfgen_family = AF_INET;
+	nfh->version = NFNETLINK_V0;
+	assert(nfct_nlmsg_build(nlh, ct) == 0);
+
+	memset(&key, 0xff, sizeof(key));
+	assert(nfct_nlmsg_extract_key(nlh, &key) == 0);
+	assert(key.l3proto == AF_INET);
+	assert(key.zone == 7);
+	assert(key.id == 0);
+	assert(key.orig.src[0] == htonl(0x0a000001));
+	assert(key.orig.dst[0] == htonl(0x0a000002));
+	assert(key.orig.src[1] == 0 && key.orig.dst[3] == 0);
+	assert(key.orig.l4proto == IPPROTO_TCP);
+	assert(key.orig.sport == htons(1024));
+	assert(key.orig.dport == htons(80));
+	assert(key.reply.src[0] == htonl(0x0a000002));
+	assert(key.reply.sport == htons(80));
+	assert(key.reply.l4proto == IPPROTO_TCP);
+
+	/* the whole key is defined, equal messages give equal keys */
+	memset(&key2, 0, sizeof(key2));
+	assert(nfct_nlmsg_extract_key(nlh, &key2) == 0);
+	assert(memcmp(&key, &key2, sizeof(key)) == 0);
+
+	/* too short to carry the nfgenmsg header */
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct nfgenmsg)) - 1;
+	assert(nfct_nlmsg_extract_key(nlh, &key) == -1);
+
+	nfct_destroy(ct);
+	printf("OK\n");
+}
+
+static void test_nfct_template(void)
+{
+	char buf[4096];
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	struct nfgenmsg *nfh;
+	struct nf_conntrack *ct, *parsed;
+	struct nfct_template *t;
+
+	printf("== test nfct template ==\n");
+
+	ct = nfct_new();
+	assert(ct);
+	nfct_set_attr_u8(ct, ATTR_L3PROTO, AF_INET);
+	nfct_set_attr_u32(ct, ATTR_IPV4_SRC, htonl(0x0a000001));
+	nfct_set_attr_u32(ct, ATTR_IPV4_DST, htonl(0x0a000002));
+	nfct_set_attr_u8(ct, ATTR_L4PROTO, IPPROTO_TCP);
+	nfct_set_attr_u16(ct, ATTR_PORT_SRC, htons(1024));
+	nfct_set_attr_u16(ct, ATTR_PORT_DST, htons(80));
+	nfct_setobjopt(ct, NFCT_SOPT_SETUP_REPLY);
+	nfct_set_attr_u32(ct, ATTR_TIMEOUT, 100);
+	nfct_set_attr_u32(ct, ATTR_MARK, 1);
+
+	t = nfct_template_compile(ct);
+	assert(t);
+	assert(nfct_template_family(t) == AF_INET);
+
+	nfct_template_set_attr_u32(t, ATTR_ORIG_IPV4_SRC, htonl(0x0b000001));
+	nfct_template_set_attr_u32(t, ATTR_REPL_IPV4_DST, htonl(0x0b000001));
+	nfct_template_set_attr_u16(t, ATTR_ORIG_PORT_DST, htons(443));
+	nfct_template_set_attr_u16(t, ATTR_REPL_PORT_SRC, htons(443));
+	nfct_template_set_attr_u32(t, ATTR_TIMEOUT, 200);
+	assert(nfct_template_set_attr_u32(t, ATTR_MARK, 0xdeadbeef) == 0);
+
+	/* not in the conntrack, and cannot be patched */
+	assert(nfct_template_set_attr_u16(t, ATTR_ZONE, 1) == -1 &&
+	       errno == EINVAL);
+	assert(nfct_template_set_attr_u32(t, ATTR_ORIG_IPV6_SRC, 0) == -1 &&
+	       errno == ENOENT);
+
+	memset(buf, 0, sizeof(buf));
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+	nlh->nlmsg_type = (NFNL_SUBSYS_CTNETLINK << 8) | IPCTNL_MSG_CT_NEW;
+	nfh = NLMSG_DATA(nlh);
+	nfh->nfgen_family = nfct_template_family(t);
+	nfh->version = NFNETLINK_V0;
+	assert(nfct_template_build(t, nlh) == 0);
+
+	/* the template gives what the patched conntrack would give */
+	parsed = nfct_new();
+	assert(parsed);
+	assert(nfct_nlmsg_parse(nlh, parsed) == 0);
+	assert(nfct_get_attr_u32(parsed, ATTR_ORIG_IPV4_SRC) == htonl(0x0b000001));
+	assert(nfct_get_attr_u32(parsed, ATTR_ORIG_IPV4_DST) == htonl(0x0a000002));
+	assert(nfct_get_attr_u32(parsed, ATTR_REPL_IPV4_DST) == htonl(0x0b000001));
+	assert(nfct_get_attr_u16(parsed, ATTR_ORIG_PORT_DST) == htons(443));
+	assert(nfct_get_attr_u16(parsed, ATTR_REPL_PORT_SRC) == htons(443));
+	assert(nfct_get_attr_u16(parsed, ATTR_ORIG_PORT_SRC) == htons(1024));
+	assert(nfct_get_attr_u32(parsed, ATTR_TIMEOUT) == 200);
+	assert(nfct_get_attr_u32(parsed, ATTR_MARK) == 0xdeadbeef);
+
+	nfct_destroy(parsed);
+	nfct_template_destroy(t);
+	nfct_destroy(ct);
+	printf("OK\n");
+}
+
+static void test_nfct_table(void)
+{
+	char buf[4096];
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	struct nfgenmsg *nfh;
+	struct nf_conntrack *ct;
+	struct nfct_table *t;
+	const uint32_t *mark, *src;
+	const uint16_t *sport, *zone;
+	const uint8_t *l4proto;
+	const uint64_t *bytes;
+	unsigned int i;
+
+	printf("== test nfct_table_* API ==\n");
+
+	ct = nfct_new();
+	assert(ct);
+	nfct_set_attr_u8(ct, ATTR_L3PROTO, AF_INET);
+	nfct_set_attr_u32(ct, ATTR_IPV4_SRC, htonl(0x0a000001));
+	nfct_set_attr_u32(ct, ATTR_IPV4_DST, htonl(0x0a000002));
+	nfct_set_attr_u8(ct, ATTR_L4PROTO, IPPROTO_UDP);
+	nfct_set_attr_u16(ct, ATTR_PORT_DST, htons(53));
+
+	t = nfct_table_new();
+	assert(t);
+
+	/* enough entries to grow the columns a few times */
+	for (i = 0; i < 1000; i++) {
+		nfct_set_attr_u32(ct, ATTR_MARK, i);
+		nfct_set_attr_u16(ct, ATTR_PORT_SRC, htons(1024 + i));
+
+		memset(buf, 0, sizeof(buf));
+		nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+		nlh->nlmsg_type = (NFNL_SUBSYS_CTNETLINK << 8) | IPCTNL_MSG_CT_NEW;
+		nfh = NLMSG_DATA(nlh);
+		nfh->nfgen_family = AF_INET;
+		nfh->version = NFNETLINK_V0;
+		assert(nfct_nlmsg_build(nlh, ct) == 0);
+		assert(nfct_table_add_nlmsg(t, nlh) == 0);
+	}
+	assert(nfct_table_len(t) == 1000);
+
+	mark = nfct_table_column(t, NFCT_COL_MARK);
+	src = nfct_table_column(t, NFCT_COL_ORIG_SRC);
+	sport = nfct_table_column(t, NFCT_COL_ORIG_PORT_SRC);
+	zone = nfct_table_column(t, NFCT_COL_ZONE);
+	l4proto = nfct_table_column(t, NFCT_COL_L4PROTO);
+	bytes = nfct_table_column(t, NFCT_COL_ORIG_BYTES);
+	for (i = 0; i < 1000; i++) {
+		assert(mark[i] == i);
+		assert(src[i * 4] == htonl(0x0a000001) && src[i * 4 + 1] == 0);
+		assert(sport[i] == htons(1024 + i));
+		assert(zone[i] == 0);
+		assert(l4proto[i] == IPPROTO_UDP);
+		assert(bytes[i] == 0);
+	}
+	assert(nfct_table_column(t, NFCT_COL_MAX) == NULL);
+
+	nfct_table_reset(t);
+	assert(nfct_table_len(t) == 0);
+
+	nlh->nlmsg_type = (NFNL_SUBSYS_CTNETLINK_EXP << 8);
+	assert(nfct_table_add_nlmsg(t, nlh) == -1 && errno == EINVAL);
+
+	nfct_table_destroy(t);
+	nfct_destroy(ct);
+	printf("OK\n");
+}
+
+/*
+ * The batch does not fit in one datagram and it is sent without
+ * privileges, the kernel rejects every datagram as a whole, yet every
+ * message reports EPERM.
+ */
+#define BATCH_MSGS	200
+
+static void test_nfct_batch(void)
+{
+	struct nfct_handle *h;
+	struct nfct_batch *b;
+	struct nf_conntrack *ct;
+	int i, status;
+
+	printf("== test nfct_batch_* API ==\n");
+
+	if (fork() == 0) {
+		if (getuid() == 0)
+			assert(setgid(65534) == 0 && setuid(65534) == 0);
+
+		h = nfct_open(CONNTRACK, 0);
+		assert(h);
+		b = nfct_batch_create(h, 4096);
+		assert(b);
+
+		ct = nfct_new();
+		assert(ct);
+		nfct_set_attr_u8(ct, ATTR_L3PROTO, AF_INET);
+		nfct_set_attr_u32(ct, ATTR_IPV4_SRC, htonl(0xc0000201));
+		nfct_set_attr_u32(ct, ATTR_IPV4_DST, htonl(0xc0000202));
+		nfct_set_attr_u8(ct, ATTR_L4PROTO, IPPROTO_TCP);
+		nfct_set_attr_u16(ct, ATTR_PORT_SRC, htons(1));
+		for (i = 0; i < BATCH_MSGS; i++) {
+			nfct_set_attr_u16(ct, ATTR_PORT_DST, htons(1000 + i));
+			assert(nfct_batch_add(b, i % 2 ? NFCT_Q_DESTROY :
+							 NFCT_Q_UPDATE,
+					      ct) == i);
+		}
+		assert(nfct_batch_len(b) == BATCH_MSGS);
+
+		/* the replies to one datagram do not end the batch. */
+		assert(nfct_batch_send(b) == BATCH_MSGS);
+		for (i = 0; i < BATCH_MSGS; i++)
+			assert(nfct_batch_error(b, i) == EPERM);
+		assert(nfct_batch_error(b, BATCH_MSGS) == EINVAL);
+
+		nfct_destroy(ct);
+		nfct_batch_destroy(b);
+		nfct_close(h);
+		exit(0);
+	}
+	wait(&status);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	printf("OK\n");
+}
+
 /* These attributes cannot be set, ignore them. */
 static int attr_is_readonly(int attr)
 {
@@ -742,6 +1431,17 @@ int main(void)
 	printf("OK\n");
 
 	test_nfct_bitmask();
+	test_nfct_pool();
+	test_nfct_cold();
+	test_nfct_labels();
+	test_nfct_view();
+	test_nfct_counters();
+	test_nfct_secctx();
+	test_nfct_parse_mask();
+	test_nfct_flow_key();
+	test_nfct_template();
+	test_nfct_table();
+	test_nfct_batch();
 
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,734 @@
+/*
+ * Test for the BSF compiler: the program that nfct_filter_attach() attaches
+ * to a socket is read back and run in userspace over messages that
+ * nfct_nlmsg_build() makes, every verdict is compared with a plain lookup
+ * of the filter entries. The interpreter is checked against the kernel
+ * too, over known programs. Attaching a filter needs no privileges.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/filter.h>
+
+#include <libmnl/libmnl.h>
+#include "internal/internal.h"
+
+static struct sock_filter *code;
+static int code_len;
+
+/* attach the filter, then read the program back for bsf_verdict(). */
+static int bsf_attach(struct nfct_filter *f)
+{
+	int fd, ret;
+
+	fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_NETFILTER);
+	assert(fd >= 0);
+
+	ret = nfct_filter_attach(fd, f);
+	if (ret == 0) {
+		free(code);
+		code_len = __bsf_get(fd, &code);
+		assert(code_len > 0);
+	}
+	close(fd);
+
+	return ret;
+}
+
+/* the addresses and the mark, in host byte order. */
+struct probe {
+	int		family;
+	uint32_t	src[4];
+	uint32_t	dst[4];
+	uint32_t	mark;
+};
+
+static struct nlmsghdr *bsf_msg(char *buf, const struct probe *p)
+{
+	struct nf_conntrack *ct;
+	struct nlmsghdr *nlh;
+	struct nfgenmsg *nfh;
+	uint32_t addr[4];
+	int i;
+
+	ct = nfct_new();
+	assert(ct);
+	nfct_set_attr_u8(ct, ATTR_L3PROTO, p->family);
+	if (p->family == AF_INET) {
+		nfct_set_attr_u32(ct, ATTR_IPV4_SRC, htonl(p->src[0]));
+		nfct_set_attr_u32(ct, ATTR_IPV4_DST, htonl(p->dst[0]));
+	} else {
+		for (i = 0; i < 4; i++)
+			addr[i] = htonl(p->src[i]);
+		nfct_set_attr(ct, ATTR_IPV6_SRC, addr);
+		for (i = 0; i < 4; i++)
+			addr[i] = htonl(p->dst[i]);
+		nfct_set_attr(ct, ATTR_IPV6_DST, addr);
+	}
+	nfct_set_attr_u8(ct, ATTR_L4PROTO, IPPROTO_TCP);
+	nfct_set_attr_u16(ct, ATTR_PORT_SRC, htons(1025));
+	nfct_set_attr_u16(ct, ATTR_PORT_DST, htons(80));
+	nfct_set_attr_u32(ct, ATTR_MARK, p->mark);
+
+	nlh = mnl_nlmsg_put_header(buf);
+	nlh->nlmsg_type = (NFNL_SUBSYS_CTNETLINK << 8) | IPCTNL_MSG_CT_NEW;
+	nfh = mnl_nlmsg_put_extra_header(nlh, sizeof(struct nfgenmsg));
+	nfh->nfgen_family = p->family;
+	nfh->version = NFNETLINK_V0;
+	assert(nfct_nlmsg_build(nlh, ct) == 0);
+	nfct_destroy(ct);
+
+	return nlh;
+}
+
+static int bsf_verdict(const struct probe *p)
+{
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	struct nlmsghdr *nlh = bsf_msg(buf, p);
+
+	return __bsf_run(code, code_len, nlh, nlh->nlmsg_len) != 0;
+}
+
+static uint32_t rand32(void)
+{
+	return (uint32_t)rand() << 16 ^ rand();
+}
+
+struct entry {
+	uint32_t	addr[4];
+	uint32_t	mask[4];
+};
+
+static int entry_match(const struct entry *e, int n, const uint32_t *addr,
+		       int words)
+{
+	int i, w;
+
+	for (i = 0; i < n; i++) {
+		for (w = 0; w < words; w++) {
+			if ((addr[w] & e[i].mask[w]) !=
+			    (e[i].addr[w] & e[i].mask[w]))
+				break;
+		}
+		if (w == words)
+			return 1;
+	}
+	return 0;
+}
+
+/* run one probe, the verdict must follow the logic of the filter. */
+static void check_addr(const struct entry *e, int n, int logic, int dst,
+		       int family, const uint32_t *addr)
+{
+	struct probe p = {
+		.family	= family,
+	};
+	int words = family == AF_INET ? 1 : 4, match;
+
+	memcpy(dst ? p.dst : p.src, addr, words * sizeof(uint32_t));
+	match = entry_match(e, n, addr, words);
+	if (logic == NFCT_FILTER_LOGIC_NEGATIVE)
+		match = !match;
+
+	assert(bsf_verdict(&p) == match);
+}
+
+/* add one to the address, or subtract one, it wraps around. */
+static void addr_add(uint32_t *addr, int words, int delta)
+{
+	int w;
+
+	for (w = words - 1; w >= 0; w--) {
+		addr[w] += delta;
+		if (addr[w] != (delta > 0 ? 0 : 0xffffffff))
+			break;
+	}
+}
+
+/* the entries, the bounds of what they match, their neighbours and random
+ * addresses. */
+static void check_addrs(const struct entry *e, int n, int logic, int dst,
+			int family)
+{
+	int words = family == AF_INET ? 1 : 4, i, w;
+	struct probe p = {};
+	uint32_t addr[4];
+
+	for (i = 0; i < n; i++) {
+		memcpy(addr, e[i].addr, sizeof(addr));
+		check_addr(e, n, logic, dst, family, addr);
+
+		for (w = 0; w < words; w++)
+			addr[w] = e[i].addr[w] & e[i].mask[w];
+		check_addr(e, n, logic, dst, family, addr);
+		addr_add(addr, words, -1);
+		check_addr(e, n, logic, dst, family, addr);
+
+		for (w = 0; w < words; w++)
+			addr[w] = e[i].addr[w] | ~e[i].mask[w];
+		check_addr(e, n, logic, dst, family, addr);
+		addr_add(addr, words, 1);
+		check_addr(e, n, logic, dst, family, addr);
+	}
+	for (i = 0; i < 1000; i++) {
+		for (w = 0; w < words; w++)
+			addr[w] = rand32();
+		check_addr(e, n, logic, dst, family, addr);
+	}
+
+	/* the attribute is not there, whatever the logic. */
+	p.family = family == AF_INET ? AF_INET6 : AF_INET;
+	assert(bsf_verdict(&p) == 1);
+}
+
+static struct nfct_filter *filter_new(const struct entry *e, int n,
+				      int logic, int dst, int family)
+{
+	struct nfct_filter *f;
+	int i, attr;
+
+	if (family == AF_INET)
+		attr = dst ? NFCT_FILTER_DST_IPV4 : NFCT_FILTER_SRC_IPV4;
+	else
+		attr = dst ? NFCT_FILTER_DST_IPV6 : NFCT_FILTER_SRC_IPV6;
+
+	f = nfct_filter_create();
+	assert(f);
+	for (i = 0; i < n; i++) {
+		if (family == AF_INET) {
+			struct nfct_filter_ipv4 v4 = {
+				.addr	= e[i].addr[0],
+				.mask	= e[i].mask[0],
+			};
+			nfct_filter_add_attr(f, attr, &v4);
+		} else {
+			nfct_filter_add_attr(f, attr, &e[i]);
+		}
+	}
+	nfct_filter_set_logic(f, attr, logic);
+
+	return f;
+}
+
+static void check_filter(const struct entry *e, int n, int dst, int family)
+{
+	static const int logic[] = {
+		NFCT_FILTER_LOGIC_POSITIVE,
+		NFCT_FILTER_LOGIC_NEGATIVE,
+	};
+	struct nfct_filter *f;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(logic) / sizeof(logic[0]); i++) {
+		f = filter_new(e, n, logic[i], dst, family);
+		assert(bsf_attach(f) == 0);
+		nfct_filter_destroy(f);
+		check_addrs(e, n, logic[i], dst, family);
+	}
+}
+
+/* the longer filters reach the match label via trampolines. */
+static void test_bsf_ipv4(void)
+{
+	static const int sizes[] = { 1, 8, 9, 100, 2000 };
+	struct entry *e;
+	unsigned int i;
+	int j;
+
+	printf("== test IPv4 filters ==\n");
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		e = calloc(sizes[i], sizeof(struct entry));
+		assert(e);
+		/* half are hosts, the rest share a mask that is no prefix. */
+		for (j = 0; j < sizes[i]; j++) {
+			e[j].addr[0] = rand32();
+			e[j].mask[0] = j % 2 ? 0xffffffff : 0xffff00ff;
+		}
+		check_filter(e, sizes[i], 0, AF_INET);
+		if (sizes[i] == 2000)
+			assert(code_len > 2 * 255);
+		free(e);
+	}
+	printf("OK\n");
+}
+
+/* the addresses share their first words, as those of a network do. */
+static void test_bsf_ipv6(void)
+{
+	static const int sizes[] = { 1, 8, 9, 100, 300 };
+	static const uint32_t net[] = { 0x20010db8, 0xfe800000, 0x20020000 };
+	struct entry *e;
+	unsigned int i;
+	int j, w;
+
+	printf("== test IPv6 filters ==\n");
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		e = calloc(sizes[i], sizeof(struct entry));
+		assert(e);
+		/* most are in the same /64. */
+		for (j = 0; j < sizes[i]; j++) {
+			e[j].addr[0] = net[j % 8 ? 0 : rand() % 3];
+			e[j].addr[1] = j % 8 ? 0 : rand() % 4;
+			e[j].addr[2] = rand32();
+			e[j].addr[3] = rand32();
+			for (w = 0; w < 4; w++)
+				e[j].mask[w] = 0xffffffff;
+			/* a /96 and a mask that is no prefix. */
+			if (j % 5 == 1)
+				e[j].mask[3] = 0;
+			else if (j % 5 == 2)
+				e[j].mask[2] = 0xffff0000;
+		}
+		check_filter(e, sizes[i], 1, AF_INET6);
+		if (sizes[i] == 300)
+			assert(code_len > 255);
+		free(e);
+	}
+	printf("OK\n");
+}
+
+/* word w of the mask of a prefix that is len bits long. */
+static uint32_t prefix_word(int len, int w)
+{
+	if (len >= (w + 1) * 32)
+		return 0xffffffff;
+	if (len <= w * 32)
+		return 0;
+	return 0xffffffff << ((w + 1) * 32 - len);
+}
+
+/*
+ * Prefixes in a small network, so that they overlap: some cover others,
+ * some are the other half of a prefix, some start where another one ends.
+ * A few masks are not prefixes.
+ */
+static void prefix_fill(struct entry *e, int n, int words, int min)
+{
+	int j, w, len, bit;
+
+	for (j = 0; j < n; j++) {
+		len = min + rand() % (words * 32 - min + 1);
+
+		switch(j > 0 ? rand() % 6 : 0) {
+		case 0:
+		case 1:
+			/* somewhere in the network. */
+			memcpy(e[j].addr, e[0].addr, sizeof(e[j].addr));
+			for (w = 0; w < words; w++)
+				e[j].addr[w] |= rand32() & ~prefix_word(min, w);
+			break;
+		case 2:
+			/* the other half of the parent of the previous one. */
+			e[j] = e[j - 1];
+			for (len = 0, w = 0; w < words; w++)
+				len += __builtin_popcount(e[j].mask[w]);
+			if (len == 0)
+				continue;
+			bit = len - 1;
+			e[j].addr[bit / 32] ^= 1U << (31 - bit % 32);
+			break;
+		case 3:
+			/* a prefix that covers the previous one, or that the
+			 * previous one covers. */
+			memcpy(e[j].addr, e[j - 1].addr, sizeof(e[j].addr));
+			break;
+		case 4:
+			/* right after the previous one. */
+			for (w = 0; w < words; w++)
+				e[j].addr[w] = e[j - 1].addr[w] |
+					       ~e[j - 1].mask[w];
+			addr_add(e[j].addr, words, 1);
+			break;
+		case 5:
+			/* a mask that is no prefix. */
+			memcpy(e[j].addr, e[0].addr, sizeof(e[j].addr));
+			for (w = 0; w < words; w++) {
+				e[j].addr[w] |= rand32() & ~prefix_word(min, w);
+				e[j].mask[w] = prefix_word(min, w) |
+					       (rand32() & 0xff0ff0ff);
+			}
+			continue;
+		}
+		for (w = 0; w < words; w++)
+			e[j].mask[w] = prefix_word(len, w);
+	}
+}
+
+/* merged prefixes, and IPv4 ranges that adjacent prefixes make. */
+static void test_bsf_prefix(void)
+{
+	static const int sizes[] = { 2, 10, 100, 1000 };
+	static const struct entry edge[] = {
+		{ .addr = { 0xffffffff }, .mask = { 0xffffffff } },
+		{ .addr = { 0xfffffffe }, .mask = { 0xffffffff } },
+		{ .addr = { 0xffffff00 }, .mask = { 0xffffff00 } },
+		{ .addr = { 0x7fffffff }, .mask = { 0xffffffff } },
+		{ .addr = { 0x80000000 }, .mask = { 0xffffffff } },
+		{ .addr = { 0x00000000 }, .mask = { 0xffffffff } },
+		{ .addr = { 0x00000001 }, .mask = { 0xffffffff } },
+		{ .addr = { 0x00000000 }, .mask = { 0xff000000 } },
+	};
+	/* halves that merge, twice, and prefixes that are no halves. */
+	static const struct entry pair[] = {
+		{ .addr = { 0x0a000000 }, .mask = { 0xffffff00 } },
+		{ .addr = { 0x0a000300 }, .mask = { 0xffffff00 } },
+		{ .addr = { 0x0a000400 }, .mask = { 0xffffff00 } },
+		{ .addr = { 0x0a000500 }, .mask = { 0xffffff00 } },
+		{ .addr = { 0x0a000600 }, .mask = { 0xfffffe00 } },
+		{ .addr = { 0x0a000900 }, .mask = { 0xffffff00 } },
+		{ .addr = { 0x0a000a00 }, .mask = { 0xffffff00 } },
+		{ .addr = { 0x0a000c00 }, .mask = { 0xffffff80 } },
+		{ .addr = { 0x0a000c40 }, .mask = { 0xffffffc0 } },
+	};
+	static const struct entry any = {
+		.addr = { 0x0a000000 },
+	};
+	struct entry *e;
+	unsigned int i;
+
+	printf("== test IPv4 and IPv6 prefixes ==\n");
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		e = calloc(sizes[i], sizeof(struct entry));
+		assert(e);
+
+		/* 10.0.0.0/16 */
+		e[0].addr[0] = 0x0a000000;
+		prefix_fill(e, sizes[i], 1, 16);
+		check_filter(e, sizes[i], 0, AF_INET);
+
+		/* 2001:db8::/56 */
+		memset(e, 0, sizeof(struct entry));
+		e[0].addr[0] = 0x20010db8;
+		prefix_fill(e, sizes[i], 4, 56);
+		check_filter(e, sizes[i], 1, AF_INET6);
+
+		free(e);
+	}
+
+	check_filter(pair, sizeof(pair) / sizeof(pair[0]), 0, AF_INET);
+	check_filter(pair, sizeof(pair) / sizeof(pair[0]), 1, AF_INET6);
+
+	/* the ends of the address space, and /0 along with the rest. */
+	check_filter(edge, sizeof(edge) / sizeof(edge[0]), 0, AF_INET);
+	check_filter(edge, sizeof(edge) / sizeof(edge[0]), 0, AF_INET6);
+	e = calloc(11, sizeof(struct entry));
+	assert(e);
+	e[0].addr[0] = 0x0a000000;
+	prefix_fill(e, 10, 1, 16);
+	e[10] = any;
+	check_filter(e, 11, 0, AF_INET);
+	free(e);
+
+	printf("OK\n");
+}
+
+static void test_bsf_e2big(void)
+{
+	struct nfct_filter *f;
+	struct entry *e;
+	int j, n = 20000;
+
+	printf("== test filters that do not fit ==\n");
+
+	e = calloc(n, sizeof(struct entry));
+	assert(e);
+	for (j = 0; j < n; j++) {
+		e[j].addr[0] = rand32();
+		e[j].mask[0] = 0xffffffff;
+	}
+	f = filter_new(e, n, NFCT_FILTER_LOGIC_POSITIVE, 0, AF_INET);
+	assert(bsf_attach(f) == -1 && errno == E2BIG);
+	nfct_filter_destroy(f);
+	free(e);
+	printf("OK\n");
+}
+
+static void check_mark(const struct nfct_filter_dump_mark *m, int n,
+		       int logic, uint32_t mark)
+{
+	struct probe p = {
+		.family	= AF_INET,
+		.mark	= mark,
+	};
+	int i, match = 0;
+
+	for (i = 0; i < n; i++) {
+		if ((mark & m[i].mask) == (m[i].val & m[i].mask))
+			match = 1;
+	}
+	if (logic == NFCT_FILTER_LOGIC_NEGATIVE)
+		match = !match;
+
+	assert(bsf_verdict(&p) == match);
+}
+
+/* the matches of the first marks jump past all the others. */
+static void test_bsf_mark(void)
+{
+	static const int sizes[] = { 1, 85, 86, 127 };
+	struct nfct_filter_dump_mark m[127];
+	struct nfct_filter *f;
+	unsigned int i;
+	int j, logic;
+
+	printf("== test mark filters ==\n");
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		for (j = 0; j < sizes[i]; j++) {
+			m[j].val = rand32();
+			m[j].mask = j % 3 ? 0xffffffff : 0xff00;
+		}
+		for (logic = NFCT_FILTER_LOGIC_POSITIVE;
+		     logic <= NFCT_FILTER_LOGIC_NEGATIVE; logic++) {
+			f = nfct_filter_create();
+			assert(f);
+			for (j = 0; j < sizes[i]; j++)
+				nfct_filter_add_attr(f, NFCT_FILTER_MARK,
+						     &m[j]);
+			nfct_filter_set_logic(f, NFCT_FILTER_MARK, logic);
+			assert(bsf_attach(f) == 0);
+			nfct_filter_destroy(f);
+
+			for (j = 0; j < sizes[i]; j++) {
+				check_mark(m, sizes[i], logic, m[j].val);
+				check_mark(m, sizes[i], logic, m[j].val ^ 1);
+			}
+			for (j = 0; j < 1000; j++)
+				check_mark(m, sizes[i], logic, rand32());
+		}
+	}
+	printf("OK\n");
+}
+
+/* a socket that receives what the other one sends, through the program. */
+static int run_rx, run_tx;
+static struct sockaddr_nl run_addr;
+
+/*
+ * The kernel drops the message if the program returns 0, otherwise it
+ * trims the message to that length: both must agree with __bsf_run().
+ */
+static void check_run(struct sock_filter *prog, unsigned int len,
+		      const void *msg, size_t size)
+{
+	struct sock_fprog fprog = {
+		.len	= len,
+		.filter	= prog,
+	};
+	uint32_t verdict;
+	char buf[1];
+	ssize_t ret;
+
+	verdict = __bsf_run(prog, len, msg, size);
+
+	assert(setsockopt(run_rx, SOL_SOCKET, SO_ATTACH_FILTER,
+			  &fprog, sizeof(fprog)) == 0);
+	/* sendto() returns the length once trimmed by the filter. */
+	assert(sendto(run_tx, msg, size, 0, (struct sockaddr *)&run_addr,
+		      sizeof(run_addr)) >= 0);
+	ret = recv(run_rx, buf, sizeof(buf), MSG_DONTWAIT | MSG_TRUNC);
+	if (verdict == 0)
+		assert(ret == -1 && errno == EAGAIN);
+	else
+		assert(ret == (ssize_t)(verdict < size ? verdict : size));
+}
+
+/* the offset of attribute x, starting at offset a: in the message or in
+ * the nest at offset a. */
+static void check_nlattr(const void *msg, size_t size, uint32_t a,
+			 uint32_t x)
+{
+	struct sock_filter prog[] = {
+		BPF_STMT(BPF_LD|BPF_IMM, a),
+		BPF_STMT(BPF_LDX|BPF_IMM, x),
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS, SKF_AD_OFF + SKF_AD_NLATTR),
+		BPF_STMT(BPF_RET|BPF_A, 0),
+	};
+
+	check_run(prog, 4, msg, size);
+	prog[2].k = SKF_AD_OFF + SKF_AD_NLATTR_NEST;
+	check_run(prog, 4, msg, size);
+}
+
+/* loads at offset k + x, the value that was loaded is returned. */
+static void check_load(const void *msg, size_t size, uint16_t code,
+		       uint32_t k, uint32_t x)
+{
+	struct sock_filter prog[] = {
+		BPF_STMT(BPF_LDX|BPF_IMM, x),
+		BPF_STMT(code, k),
+		BPF_STMT(BPF_ALU|BPF_OR|BPF_K, 1),
+		BPF_STMT(BPF_RET|BPF_A, 0),
+	};
+
+	check_run(prog, 4, msg, size);
+}
+
+/*
+ * Attributes, some of them nested, that are not always well formed. The
+ * message is cut somewhere, so that what follows it looks like attributes.
+ */
+static size_t rand_msg(uint8_t *buf, size_t size)
+{
+	struct nlattr *nla;
+	size_t len = 0;
+
+	memset(buf, 0, size);
+	while (len + sizeof(struct nlattr) <= size) {
+		nla = (struct nlattr *)(buf + len);
+		nla->nla_type = rand() % 4;
+		switch(rand() % 8) {
+		case 0:
+			/* too short or too long */
+			nla->nla_len = rand() % 2 ? rand() % 4 : size - len + 1 +
+								 rand() % 8;
+			break;
+		case 1:
+		case 2:
+			/* a nest for the next ones, up to the end or so */
+			nla->nla_len = size - len - 4 + rand() % 9;
+			nla->nla_type |= NLA_F_NESTED;
+			len += sizeof(struct nlattr);
+			continue;
+		default:
+			nla->nla_len = sizeof(struct nlattr) + rand() % 9;
+			break;
+		}
+		len += NLA_ALIGN(nla->nla_len);
+	}
+	return 1 + rand() % size;
+}
+
+static void test_bsf_run(void)
+{
+	static const uint16_t loads[] = {
+		BPF_LD|BPF_W|BPF_ABS, BPF_LD|BPF_H|BPF_ABS,
+		BPF_LD|BPF_B|BPF_ABS, BPF_LD|BPF_W|BPF_IND,
+		BPF_LD|BPF_H|BPF_IND, BPF_LD|BPF_B|BPF_IND,
+	};
+	struct sock_filter div[] = {
+		BPF_STMT(BPF_LDX|BPF_IMM, 0),
+		BPF_STMT(BPF_LD|BPF_IMM, 100),
+		BPF_STMT(BPF_ALU|BPF_DIV|BPF_X, 0),
+		BPF_STMT(BPF_RET|BPF_A, 0),
+	};
+	struct sock_filter msh[] = {
+		BPF_STMT(BPF_LDX|BPF_B|BPF_MSH, 0),
+		BPF_STMT(BPF_MISC|BPF_TXA, 0),
+		BPF_STMT(BPF_ALU|BPF_OR|BPF_K, 1),
+		BPF_STMT(BPF_RET|BPF_A, 0),
+	};
+	struct sock_filter nest[] = {
+		BPF_STMT(BPF_LD|BPF_IMM, sizeof(struct nlmsghdr) +
+					 sizeof(struct nfgenmsg)),
+		BPF_STMT(BPF_LDX|BPF_IMM, CTA_TUPLE_ORIG),
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS, SKF_AD_OFF + SKF_AD_NLATTR),
+		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0, 3, 0),
+		BPF_STMT(BPF_LDX|BPF_IMM, CTA_TUPLE_IP),
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS,
+			 SKF_AD_OFF + SKF_AD_NLATTR_NEST),
+		BPF_STMT(BPF_RET|BPF_A, 0),
+		BPF_STMT(BPF_RET|BPF_K, 0),
+	};
+	struct sock_filter end[] = {
+		BPF_STMT(BPF_LD|BPF_IMM, 1),
+		BPF_JUMP(BPF_JMP|BPF_JA, 5, 0, 0),
+		BPF_STMT(BPF_RET|BPF_A, 0),
+	};
+	struct probe p = { .family = AF_INET, .src = { 1 }, .dst = { 2 } };
+	socklen_t addrlen = sizeof(run_addr);
+	uint8_t buf[MNL_SOCKET_BUFFER_SIZE];
+	struct nlmsghdr *nlh;
+	unsigned int i, j;
+	uint32_t a, x;
+	size_t size;
+
+	printf("== test the interpreter against the kernel ==\n");
+
+	run_rx = socket(AF_NETLINK, SOCK_RAW, NETLINK_NETFILTER);
+	run_tx = socket(AF_NETLINK, SOCK_RAW, NETLINK_NETFILTER);
+	assert(run_rx >= 0 && run_tx >= 0);
+	run_addr.nl_family = AF_NETLINK;
+	assert(bind(run_rx, (struct sockaddr *)&run_addr,
+		    sizeof(run_addr)) == 0);
+	assert(getsockname(run_rx, (struct sockaddr *)&run_addr,
+			   &addrlen) == 0);
+
+	/* a conntrack: its attributes, the nested ones and the bounds. */
+	nlh = bsf_msg((char *)buf, &p);
+	size = nlh->nlmsg_len;
+	for (a = 0; a <= size + 4; a++) {
+		for (x = 0; x <= CTA_MAX + 1; x++)
+			check_nlattr(buf, size, a, x);
+		check_nlattr(buf, size, a, NLA_F_NESTED | CTA_TUPLE_ORIG);
+	}
+	check_run(nest, 8, buf, size);
+	for (size = 0; size < nlh->nlmsg_len; size++)
+		check_run(nest, 8, buf, size + 1);
+
+	/* loads and the bounds of the message. */
+	size = nlh->nlmsg_len;
+	for (i = 0; i < sizeof(loads) / sizeof(loads[0]); i++) {
+		for (a = 0; a < 8; a++) {
+			check_load(buf, size, loads[i], 0, a);
+			check_load(buf, size, loads[i], size - a, 0);
+			check_load(buf, size, loads[i], size - 4, a);
+		}
+	}
+	for (a = 0; a < 8; a++) {
+		msh[0].k = size - a;
+		check_run(msh, 4, buf, size);
+	}
+
+	/* division by zero. */
+	check_run(div, 4, buf, size);
+	div[0].k = 3;
+	check_run(div, 4, buf, size);
+
+	/* the kernel does not take programs that do not return, we drop. */
+	assert(__bsf_run(end, 1, buf, size) == 0);
+	assert(__bsf_run(end, 3, buf, size) == 0);
+
+	/* attributes that are not well formed. */
+	for (i = 0; i < 100; i++) {
+		size = rand_msg(buf, 64);
+		for (j = 0; j < 20; j++) {
+			a = rand() % (size + 4);
+			for (x = 0; x < 4; x++)
+				check_nlattr(buf, size, a, x);
+		}
+	}
+
+	close(run_rx);
+	close(run_tx);
+
+	printf("OK\n");
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int seed = argc > 1 ? atoi(argv[1]) : 1;
+
+	printf("seed %u\n", seed);
+	srand(seed);
+
+	test_bsf_ipv4();
+	test_bsf_ipv6();
+	test_bsf_prefix();
+	test_bsf_e2big();
+	test_bsf_mark();
+	test_bsf_run();
+
+	free(code);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,193 @@
+/*
+ * Test for the merge rules of the event coalescing window: the events are
+ * added to the window as the receive path does, then it is flushed and the
+ * callback tells what was merged. This needs no kernel.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "internal/internal.h"
+
+#define MAX_CALLS	8
+
+struct call {
+	enum nf_conntrack_msg_type	type;
+	unsigned int			flow;
+	uint32_t			mark;
+	uint32_t			id;
+};
+
+static struct call calls[MAX_CALLS];
+static unsigned int ncalls;
+
+static int coalesce_cb(enum nf_conntrack_msg_type type,
+		       struct nf_conntrack *ct, void *data)
+{
+	struct call *c = &calls[ncalls++];
+
+	assert(ncalls <= MAX_CALLS);
+	c->type = type;
+	c->flow = ntohs(nfct_get_attr_u16(ct, ATTR_PORT_DST)) - 1000;
+	c->mark = nfct_get_attr_u32(ct, ATTR_MARK);
+	c->id = nfct_get_attr_u32(ct, ATTR_ID);
+	return NFCT_CB_CONTINUE;
+}
+
+/* one event for the flow, as the receive path parses it. */
+static void event(struct nfct_handle *h, enum nf_conntrack_msg_type type,
+		  unsigned int flow, uint32_t mark, uint32_t id)
+{
+	struct nf_conntrack *ct;
+
+	ct = nfct_new();
+	assert(ct);
+	nfct_set_attr_u8(ct, ATTR_L3PROTO, AF_INET);
+	nfct_set_attr_u32(ct, ATTR_IPV4_SRC, inet_addr("192.0.2.1"));
+	nfct_set_attr_u32(ct, ATTR_IPV4_DST, inet_addr("192.0.2.2"));
+	nfct_set_attr_u8(ct, ATTR_L4PROTO, IPPROTO_TCP);
+	nfct_set_attr_u16(ct, ATTR_PORT_SRC, htons(1));
+	nfct_set_attr_u16(ct, ATTR_PORT_DST, htons(1000 + flow));
+	nfct_set_attr_u32(ct, ATTR_MARK, mark);
+	if (id)
+		nfct_set_attr_u32(ct, ATTR_ID, id);
+
+	/* the window is large enough, nothing is passed yet. */
+	assert(__coalesce_add(h, type, ct) == NFCT_CB_CONTINUE);
+	assert(ncalls == 0);
+}
+
+static void flush(struct nfct_handle *h, unsigned int n)
+{
+	assert(nfct_coalesce_flush(h) == NFCT_CB_CONTINUE);
+	assert(ncalls == n);
+	assert(!__coalesce_pending(h->coalesce));
+}
+
+static void check(unsigned int i, enum nf_conntrack_msg_type type,
+		  unsigned int flow, uint32_t mark, uint32_t id)
+{
+	assert(calls[i].type == type);
+	assert(calls[i].flow == flow);
+	assert(calls[i].mark == mark);
+	assert(calls[i].id == id);
+}
+
+static struct nfct_handle *open_window(void)
+{
+	struct nfct_handle *h;
+
+	h = nfct_open(CONNTRACK, 0);
+	assert(h);
+	assert(nfct_handle_set_coalesce(h, 100, 0) == 0);
+	nfct_callback_register(h, NFCT_T_ALL, coalesce_cb, NULL);
+	ncalls = 0;
+	return h;
+}
+
+/* the updates refresh the state, the type is the one of the first event. */
+static void test_update(void)
+{
+	struct nfct_handle *h;
+
+	printf("== test that updates merge into the open entry ==\n");
+
+	h = open_window();
+	event(h, NFCT_T_NEW, 0, 1, 7);
+	event(h, NFCT_T_UPDATE, 0, 2, 7);
+	event(h, NFCT_T_UPDATE, 0, 3, 7);
+	flush(h, 1);
+	check(0, NFCT_T_NEW, 0, 3, 7);
+
+	/* an update without ID is the same conntrack. */
+	ncalls = 0;
+	event(h, NFCT_T_UPDATE, 0, 4, 7);
+	event(h, NFCT_T_UPDATE, 0, 5, 0);
+	flush(h, 1);
+	check(0, NFCT_T_UPDATE, 0, 5, 7);
+
+	nfct_close(h);
+	printf("OK\n");
+}
+
+/* created and destroyed within the window, reported once. */
+static void test_destroy(void)
+{
+	struct nfct_handle *h;
+
+	printf("== test that NEW followed by DESTROY becomes DESTROY ==\n");
+
+	h = open_window();
+	event(h, NFCT_T_NEW, 0, 1, 7);
+	event(h, NFCT_T_UPDATE, 0, 2, 7);
+	event(h, NFCT_T_DESTROY, 0, 3, 7);
+	flush(h, 1);
+	check(0, NFCT_T_DESTROY, 0, 3, 7);
+
+	/* the tuple is reused once the conntrack is gone. */
+	ncalls = 0;
+	event(h, NFCT_T_DESTROY, 0, 1, 7);
+	event(h, NFCT_T_NEW, 0, 2, 7);
+	flush(h, 2);
+	check(0, NFCT_T_DESTROY, 0, 1, 7);
+	check(1, NFCT_T_NEW, 0, 2, 7);
+
+	nfct_close(h);
+	printf("OK\n");
+}
+
+/* same tuple, another conntrack: the old entry is left as it is. */
+static void test_id(void)
+{
+	struct nfct_handle *h;
+
+	printf("== test that an ID change opens a new entry ==\n");
+
+	h = open_window();
+	event(h, NFCT_T_NEW, 0, 1, 7);
+	event(h, NFCT_T_NEW, 0, 2, 8);
+	event(h, NFCT_T_UPDATE, 0, 3, 8);
+	event(h, NFCT_T_DESTROY, 0, 4, 8);
+	flush(h, 2);
+	check(0, NFCT_T_NEW, 0, 1, 7);
+	check(1, NFCT_T_DESTROY, 0, 4, 8);
+
+	nfct_close(h);
+	printf("OK\n");
+}
+
+/* the entries are passed in the order they were opened. */
+static void test_order(void)
+{
+	struct nfct_handle *h;
+
+	printf("== test that callbacks run in arrival order ==\n");
+
+	h = open_window();
+	event(h, NFCT_T_NEW, 2, 1, 0);
+	event(h, NFCT_T_NEW, 0, 1, 0);
+	event(h, NFCT_T_UPDATE, 2, 2, 0);
+	event(h, NFCT_T_NEW, 1, 1, 0);
+	event(h, NFCT_T_DESTROY, 0, 2, 0);
+	event(h, NFCT_T_UPDATE, 3, 1, 0);
+	flush(h, 4);
+	check(0, NFCT_T_NEW, 2, 2, 0);
+	check(1, NFCT_T_DESTROY, 0, 2, 0);
+	check(2, NFCT_T_NEW, 1, 1, 0);
+	check(3, NFCT_T_UPDATE, 3, 1, 0);
+
+	nfct_close(h);
+	printf("OK\n");
+}
+
+int main(void)
+{
+	test_update();
+	test_destroy();
+	test_id();
+	test_order();
+	return EXIT_SUCCESS;
+}
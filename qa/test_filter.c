@@ -54,8 +54,8 @@ int main(void)
 	for (i=0; i<IPPROTO_MAX; i++)
 		nfct_filter_add_attr_u32(filter,NFCT_FILTER_L4PROTO,i);
 
-	/* up to 127 IP addresses, above that adding is noop */
-	for (i=0; i<128; i++) {
+	/* as many IP addresses as the BSF program can hold */
+	for (i=0; i<1024; i++) {
 		/* BSF always wants data in host-byte order */
 		struct nfct_filter_ipv4 fltr_ipv4 = {
 			.addr = ntohl(inet_addr("127.0.0.1")) + i,
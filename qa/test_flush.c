@@ -0,0 +1,176 @@
+/*
+ * Test for the update requests of nfct_remark_filter() and
+ * nfct_relabel_filter(): the request is prepared for a conntrack like the
+ * dump reports it, then it is built and its attributes are checked. This
+ * needs no kernel, see ct_flush_filter for that.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include <libmnl/libmnl.h>
+#include "internal/internal.h"
+
+static struct nf_conntrack *ct_dumped(uint32_t mark, unsigned int nlabels,
+				      const unsigned int *labels)
+{
+	struct nf_conntrack *ct;
+	struct nfct_bitmask *b;
+	unsigned int i;
+
+	ct = nfct_new();
+	assert(ct);
+	nfct_set_attr_u8(ct, ATTR_L3PROTO, AF_INET);
+	nfct_set_attr_u32(ct, ATTR_IPV4_SRC, inet_addr("192.0.2.1"));
+	nfct_set_attr_u32(ct, ATTR_IPV4_DST, inet_addr("192.0.2.2"));
+	nfct_set_attr_u8(ct, ATTR_L4PROTO, IPPROTO_TCP);
+	nfct_set_attr_u16(ct, ATTR_PORT_SRC, htons(1025));
+	nfct_set_attr_u16(ct, ATTR_PORT_DST, htons(80));
+	nfct_set_attr_u16(ct, ATTR_ZONE, 3);
+	nfct_set_attr_u32(ct, ATTR_MARK, mark);
+	nfct_set_attr_u32(ct, ATTR_TIMEOUT, 100);
+
+	if (nlabels > 0) {
+		b = nfct_bitmask_new(127);
+		assert(b);
+		for (i = 0; i < nlabels; i++)
+			nfct_bitmask_set_bit(b, labels[i]);
+		nfct_set_attr(ct, ATTR_CONNLABELS, b);
+	}
+	return ct;
+}
+
+static int parse_cb(const struct nlattr *attr, void *data)
+{
+	const struct nlattr **tb = data;
+
+	tb[mnl_attr_get_type(attr)] = attr;
+	return MNL_CB_OK;
+}
+
+/* build the request, its attributes are left in tb. */
+static void req_build(const struct nf_conntrack *req, char *buf,
+		      const struct nlattr **tb)
+{
+	struct nlmsghdr *nlh;
+	struct nfgenmsg *nfh;
+
+	nlh = mnl_nlmsg_put_header(buf);
+	nlh->nlmsg_type = (NFNL_SUBSYS_CTNETLINK << 8) | IPCTNL_MSG_CT_NEW;
+	nfh = mnl_nlmsg_put_extra_header(nlh, sizeof(struct nfgenmsg));
+	nfh->nfgen_family = AF_INET;
+	nfh->version = NFNETLINK_V0;
+	assert(nfct_nlmsg_build(nlh, req) == 0);
+
+	memset(tb, 0, (CTA_MAX + 1) * sizeof(tb[0]));
+	assert(mnl_attr_parse(nlh, sizeof(struct nfgenmsg), parse_cb,
+			      tb) == MNL_CB_OK);
+
+	/* what identifies the conntrack, nothing else of it. */
+	assert(tb[CTA_TUPLE_ORIG] && tb[CTA_ZONE]);
+	assert(ntohs(mnl_attr_get_u16(tb[CTA_ZONE])) == 3);
+	assert(tb[CTA_TIMEOUT] == NULL && tb[CTA_TUPLE_REPLY] == NULL);
+}
+
+/* the labels in the attribute, which is 16 bytes long. */
+static int labels_test(const struct nlattr *attr, unsigned int bit)
+{
+	const uint32_t *words = mnl_attr_get_payload(attr);
+
+	assert(mnl_attr_get_payload_len(attr) == 16);
+	return !!(words[bit / 32] & (1U << (bit % 32)));
+}
+
+static void test_remark(void)
+{
+	const struct nlattr *tb[CTA_MAX + 1];
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	struct nf_conntrack *req, *ct;
+
+	printf("== test the requests of nfct_remark_filter() ==\n");
+
+	req = __rewrite_request(0x1234abcd, 0x0000ff00, NULL, NULL);
+	assert(req);
+
+	/* the mark goes with its mask, the kernel keeps the other bits. */
+	ct = ct_dumped(0xffff00ff, 0, NULL);
+	assert(__rewrite_prepare(req, ct, 0x1234abcd, 0x0000ff00,
+				 NULL, NULL) == 1);
+	req_build(req, buf, tb);
+	assert(tb[CTA_MARK] && tb[CTA_MARK_MASK]);
+	assert(ntohl(mnl_attr_get_u32(tb[CTA_MARK])) == 0x0000ab00);
+	assert(ntohl(mnl_attr_get_u32(tb[CTA_MARK_MASK])) == 0x0000ff00);
+	assert(tb[CTA_LABELS] == NULL && tb[CTA_LABELS_MASK] == NULL);
+	nfct_destroy(ct);
+
+	/* the bits in the mask are right already. */
+	ct = ct_dumped(0x0000abff, 0, NULL);
+	assert(__rewrite_prepare(req, ct, 0x1234abcd, 0x0000ff00,
+				 NULL, NULL) == 0);
+	nfct_destroy(ct);
+
+	nfct_destroy(req);
+	printf("OK\n");
+}
+
+static void test_relabel(void)
+{
+	static const unsigned int labels[] = { 1, 5, 100 };
+	static const unsigned int done[] = { 1, 2 };
+	const struct nlattr *tb[CTA_MAX + 1];
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	struct nfct_bitmask *set, *clear;
+	struct nf_conntrack *req, *ct;
+	unsigned int i;
+
+	printf("== test the requests of nfct_relabel_filter() ==\n");
+
+	set = nfct_bitmask_new(2);
+	clear = nfct_bitmask_new(127);
+	assert(set && clear);
+	nfct_bitmask_set_bit(set, 2);
+	nfct_bitmask_set_bit(clear, 5);
+	nfct_bitmask_set_bit(clear, 127);
+
+	req = __rewrite_request(0, 0, set, clear);
+	assert(req);
+
+	/* label 2 is set, 5 is cleared, the mask tells the kernel so. */
+	ct = ct_dumped(7, 3, labels);
+	assert(__rewrite_prepare(req, ct, 0, 0, set, clear) == 1);
+	req_build(req, buf, tb);
+	assert(tb[CTA_LABELS] && tb[CTA_LABELS_MASK]);
+	assert(tb[CTA_MARK] == NULL && tb[CTA_MARK_MASK] == NULL);
+	for (i = 0; i < 128; i++) {
+		assert(labels_test(tb[CTA_LABELS], i) == (i == 2));
+		assert(labels_test(tb[CTA_LABELS_MASK], i) ==
+		       (i == 2 || i == 5 || i == 127));
+	}
+	nfct_destroy(ct);
+
+	/* without labels, clearing is a no-op and setting is not. */
+	ct = ct_dumped(7, 0, NULL);
+	assert(__rewrite_prepare(req, ct, 0, 0, NULL, clear) == 0);
+	assert(__rewrite_prepare(req, ct, 0, 0, set, clear) == 1);
+	nfct_destroy(ct);
+
+	/* label 2 is there, 5 and 127 are not. */
+	ct = ct_dumped(7, 2, done);
+	assert(__rewrite_prepare(req, ct, 0, 0, set, clear) == 0);
+	nfct_destroy(ct);
+
+	nfct_destroy(req);
+	nfct_bitmask_destroy(set);
+	nfct_bitmask_destroy(clear);
+	printf("OK\n");
+}
+
+int main(void)
+{
+	test_remark();
+	test_relabel();
+	return EXIT_SUCCESS;
+}
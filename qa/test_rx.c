@@ -0,0 +1,811 @@
+/*
+ * Test for the receive path: a unix datagram socket takes the place of the
+ * netlink socket, the replies of the kernel or the messages that we build
+ * are fed through it, so that we control how they are packed in datagrams.
+ * The conntracks do not exist, the kernel replies with ENOENT to requests
+ * for them, or with EPERM without privileges.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+
+#include <libnetfilter_conntrack/libnetfilter_conntrack.h>
+
+/*
+ * Replace the netlink socket of the handle by a unix datagram socket, the
+ * one that is returned feeds it. The name of the latter is as long as a
+ * netlink address and its bytes 2 to 5, nl_pid, are zero, thus the handle
+ * takes what we send as coming from the kernel.
+ */
+static int feed_open(struct nfct_handle *h)
+{
+	struct sockaddr_un sun = { .sun_family = AF_UNIX };
+	static unsigned char count;
+	pid_t pid = getpid();
+	int sv[2];
+
+	assert(socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) == 0);
+	sun.sun_path[1] = ++count;
+	memcpy(&sun.sun_path[6], &pid, sizeof(uint32_t));
+	assert(bind(sv[1], (struct sockaddr *)&sun,
+		    offsetof(struct sockaddr_un, sun_path) + 10) == 0);
+	assert(dup2(sv[0], nfct_fd(h)) == nfct_fd(h));
+	close(sv[0]);
+	return sv[1];
+}
+
+/* a message for the conntrack, as the kernel sends it. */
+static size_t ct_msg(char *buf, uint16_t type, uint16_t flags,
+		     const struct nf_conntrack *ct)
+{
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	struct nfgenmsg *nfh;
+
+	memset(buf, 0, NLMSG_LENGTH(sizeof(struct nfgenmsg)));
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+	nlh->nlmsg_type = (NFNL_SUBSYS_CTNETLINK << 8) | type;
+	nlh->nlmsg_flags = flags;
+	nfh = NLMSG_DATA(nlh);
+	nfh->nfgen_family = AF_INET;
+	nfh->version = NFNETLINK_V0;
+	assert(nfct_nlmsg_build(nlh, ct) == 0);
+	return nlh->nlmsg_len;
+}
+
+/* take the replies of the kernel until `n' requests were answered. */
+static size_t capture(struct nfct_handle *h, char *buf, size_t size, int n)
+{
+	const struct nlmsghdr *nlh;
+	size_t len = 0;
+	ssize_t ret;
+
+	while (n > 0) {
+		ret = recv(nfct_fd(h), buf + len, size - len, MSG_DONTWAIT);
+		assert(ret > 0);
+		for (nlh = (struct nlmsghdr *)(buf + len); NLMSG_OK(nlh, ret);
+		     nlh = NLMSG_NEXT(nlh, ret)) {
+			if (nlh->nlmsg_type == NLMSG_ERROR)
+				n--;
+		}
+		len = (char *)nlh - buf;
+	}
+	return len;
+}
+
+/* a conntrack that does not exist, the kernel fails to get it. */
+static struct nf_conntrack *ct_absent(int i)
+{
+	struct nf_conntrack *ct;
+
+	ct = nfct_new();
+	assert(ct);
+	nfct_set_attr_u8(ct, ATTR_L3PROTO, AF_INET);
+	nfct_set_attr_u32(ct, ATTR_IPV4_SRC, inet_addr("192.0.2.1"));
+	nfct_set_attr_u32(ct, ATTR_IPV4_DST, inet_addr("192.0.2.2"));
+	nfct_set_attr_u8(ct, ATTR_L4PROTO, IPPROTO_TCP);
+	nfct_set_attr_u16(ct, ATTR_PORT_SRC, htons(1));
+	nfct_set_attr_u16(ct, ATTR_PORT_DST, htons(1000 + i));
+	return ct;
+}
+
+#define ASYNC_REQS	4
+
+struct async_res {
+	int	order;
+	int	error;
+	int	verdict;
+};
+
+static int async_order;
+
+static int async_cb(int error, struct nf_conntrack *ct, void *data)
+{
+	struct async_res *res = data;
+
+	assert(res->order == 0);
+	res->order = ++async_order;
+	res->error = error;
+	return res->verdict;
+}
+
+static void async_send(struct nfct_handle *h, struct async_res *res)
+{
+	struct nf_conntrack *ct;
+	int i;
+
+	async_order = 0;
+	for (i = 0; i < ASYNC_REQS; i++) {
+		ct = ct_absent(i);
+		assert(nfct_query_async(h, NFCT_Q_GET, ct, async_cb,
+					&res[i]) == 0);
+		nfct_destroy(ct);
+	}
+	assert(nfct_query_async_pending(h) == ASYNC_REQS);
+}
+
+/* one reply per datagram, the callbacks stop us once none is pending. */
+static void test_async(void)
+{
+	struct async_res res[ASYNC_REQS] = {};
+	struct nfct_handle *h;
+	int i, ret;
+
+	printf("== test nfct_query_async() ==\n");
+
+	h = nfct_open(CONNTRACK, 0);
+	assert(h);
+
+	for (i = 0; i < ASYNC_REQS; i++)
+		res[i].verdict = i == ASYNC_REQS - 1 ? NFCT_CB_STOP :
+						       NFCT_CB_CONTINUE;
+	async_send(h, res);
+
+	ret = nfct_catch(h);
+	assert(ret == NFCT_CB_STOP);
+	assert(nfct_query_async_pending(h) == 0);
+	for (i = 0; i < ASYNC_REQS; i++) {
+		assert(res[i].order == i + 1);
+		assert(res[i].error == EPERM || res[i].error == ENOENT);
+	}
+
+	nfct_close(h);
+	printf("OK\n");
+}
+
+/* every reply in the datagram completes, even after a callback stops us. */
+static void test_async_datagram(void)
+{
+	struct async_res res[ASYNC_REQS] = {};
+	struct nfct_handle *h;
+	char buf[8192];
+	size_t len;
+	int i, fd, ret;
+
+	printf("== test nfct_query_async() with several replies "
+	       "in one datagram ==\n");
+
+	h = nfct_open(CONNTRACK, 0);
+	assert(h);
+
+	for (i = 0; i < ASYNC_REQS; i++)
+		res[i].verdict = i == 1 ? NFCT_CB_STOP : NFCT_CB_CONTINUE;
+	async_send(h, res);
+
+	len = capture(h, buf, sizeof(buf), ASYNC_REQS);
+	fd = feed_open(h);
+	assert(send(fd, buf, len, 0) == (ssize_t)len);
+
+	ret = nfct_catch(h);
+	assert(ret == NFCT_CB_STOP);
+	assert(nfct_query_async_pending(h) == 0);
+	for (i = 0; i < ASYNC_REQS; i++) {
+		assert(res[i].order == i + 1);
+		assert(res[i].error == EPERM || res[i].error == ENOENT);
+	}
+
+	close(fd);
+	nfct_close(h);
+	printf("OK\n");
+}
+
+/* what the callback got for the conntracks of ct_absent(). */
+#define RESYNC_CTS	4
+
+struct resync_res {
+	int	news;
+	int	destroys;
+};
+
+static int resync_cb(enum nf_conntrack_msg_type type,
+		     struct nf_conntrack *ct, void *data)
+{
+	struct resync_res *res = data;
+	unsigned int i;
+
+	if (nfct_get_attr_u32(ct, ATTR_IPV4_SRC) != inet_addr("192.0.2.1"))
+		return NFCT_CB_CONTINUE;
+
+	i = ntohs(nfct_get_attr_u16(ct, ATTR_PORT_DST)) - 1000;
+	assert(i < RESYNC_CTS);
+	if (type == NFCT_T_NEW)
+		res[i].news++;
+	else if (type == NFCT_T_DESTROY)
+		res[i].destroys++;
+	return NFCT_CB_CONTINUE;
+}
+
+/*
+ * The events for conntracks that the table does not have are fed, the
+ * dump tells that those that were not destroyed are gone.
+ */
+static void test_resync(void)
+{
+	struct resync_res res[RESYNC_CTS] = {};
+	struct nf_conntrack *ct;
+	struct nfct_handle *h;
+	char buf[8192];
+	size_t len = 0;
+	int i, fd;
+
+	printf("== test nfct_resync() ==\n");
+
+	h = nfct_open(CONNTRACK, 0);
+	assert(h);
+	assert(nfct_handle_set_flags(h, NFCT_HF_RESYNC) == 0);
+	nfct_callback_register(h, NFCT_T_ALL, resync_cb, res);
+
+	/* the table is reported, it is not ours to check. */
+	if (nfct_resync(h) == -1) {
+		printf("SKIP: cannot dump the table (%s)\n", strerror(errno));
+		nfct_close(h);
+		return;
+	}
+
+	for (i = 0; i < RESYNC_CTS; i++) {
+		ct = ct_absent(i);
+		len += ct_msg(buf + len, IPCTNL_MSG_CT_NEW,
+			      NLM_F_CREATE | NLM_F_EXCL, ct);
+		/* and the last one is gone */
+		if (i == RESYNC_CTS - 1)
+			len += ct_msg(buf + len, IPCTNL_MSG_CT_DELETE, 0, ct);
+		nfct_destroy(ct);
+	}
+	fd = feed_open(h);
+	assert(send(fd, buf, len, 0) == (ssize_t)len);
+	assert(nfct_catch_budget(h, 0, 0) == 0);
+	for (i = 0; i < RESYNC_CTS; i++) {
+		assert(res[i].news == 1);
+		assert(res[i].destroys == (i == RESYNC_CTS - 1));
+	}
+
+	memset(res, 0, sizeof(res));
+	assert(nfct_resync(h) == NFCT_CB_CONTINUE);
+	for (i = 0; i < RESYNC_CTS; i++) {
+		assert(res[i].news == 0);
+		assert(res[i].destroys == (i < RESYNC_CTS - 1));
+	}
+
+	/* once told, they are forgotten. */
+	memset(res, 0, sizeof(res));
+	assert(nfct_resync(h) == NFCT_CB_CONTINUE);
+	for (i = 0; i < RESYNC_CTS; i++)
+		assert(res[i].news == 0 && res[i].destroys == 0);
+
+	close(fd);
+	nfct_close(h);
+	printf("OK\n");
+}
+
+/* the events of each flow, the callback checks that they keep the order. */
+#define DISPATCH_FLOWS	16
+
+static const enum nf_conntrack_msg_type dispatch_order[] = {
+	NFCT_T_NEW, NFCT_T_UPDATE, NFCT_T_DESTROY,
+};
+
+struct dispatch_res {
+	int	next;
+	int	stolen;
+};
+
+static int dispatch_cb(enum nf_conntrack_msg_type type,
+		       struct nf_conntrack *ct, void *data)
+{
+	struct dispatch_res *res = data;
+	unsigned int i;
+
+	i = ntohs(nfct_get_attr_u16(ct, ATTR_PORT_DST)) - 1000;
+	assert(i < DISPATCH_FLOWS);
+	assert(res[i].next < 3 && dispatch_order[res[i].next] == type);
+	res[i].next++;
+
+	/* no stop, and the stolen objects are ours to release. */
+	if (type == NFCT_T_UPDATE)
+		return NFCT_CB_STOP;
+	if (type == NFCT_T_DESTROY && i % 2) {
+		res[i].stolen++;
+		nfct_destroy(ct);
+		return NFCT_CB_STOLEN;
+	}
+	return NFCT_CB_CONTINUE;
+}
+
+/*
+ * Small rings so that the producer waits for the workers, every event is
+ * handled once, and in order for each flow, whatever the verdict.
+ */
+static void test_dispatch(void)
+{
+	struct dispatch_res res[DISPATCH_FLOWS] = {};
+	struct nfct_dispatch *d;
+	struct nf_conntrack *ct;
+	struct nfct_handle *h;
+	char buf[8192];
+	size_t len;
+	int i, fd;
+
+	printf("== test nfct_dispatch_create() ==\n");
+
+	h = nfct_open(CONNTRACK, 0);
+	assert(h);
+	d = nfct_dispatch_create(h, NFCT_T_ALL, 3, 2, dispatch_cb, res);
+	assert(d);
+
+	fd = feed_open(h);
+	for (i = 0; i < DISPATCH_FLOWS; i++) {
+		ct = ct_absent(i);
+		len = ct_msg(buf, IPCTNL_MSG_CT_NEW,
+			     NLM_F_CREATE | NLM_F_EXCL, ct);
+		len += ct_msg(buf + len, IPCTNL_MSG_CT_NEW, 0, ct);
+		len += ct_msg(buf + len, IPCTNL_MSG_CT_DELETE, 0, ct);
+		assert(send(fd, buf, len, 0) == (ssize_t)len);
+		nfct_destroy(ct);
+	}
+	assert(nfct_catch_budget(h, 0, 0) == 0);
+
+	/* the queued events are handled before the workers exit. */
+	nfct_dispatch_destroy(d);
+	for (i = 0; i < DISPATCH_FLOWS; i++) {
+		assert(res[i].next == 3);
+		assert(res[i].stolen == i % 2);
+	}
+
+	close(fd);
+	nfct_close(h);
+	printf("OK\n");
+}
+
+/* the objects that the callback got, and the one it kept. */
+#define SCRATCH_CTS	4
+
+struct scratch_res {
+	struct nf_conntrack	*ct[SCRATCH_CTS];
+	struct nf_conntrack	*stolen;
+	int			n;
+};
+
+static int scratch_cb(enum nf_conntrack_msg_type type,
+		      struct nf_conntrack *ct, void *data)
+{
+	struct scratch_res *res = data;
+	int i = res->n++;
+
+	assert(i < SCRATCH_CTS);
+	assert(ntohs(nfct_get_attr_u16(ct, ATTR_PORT_DST)) == 1000 + i);
+	res->ct[i] = ct;
+
+	/* nothing is left of the previous message. */
+	assert(nfct_attr_is_set(ct, ATTR_MARK) == (i % 2 == 0));
+	if (i % 2 == 0)
+		assert(nfct_get_attr_u32(ct, ATTR_MARK) == (uint32_t)i);
+	if (i == 1) {
+		res->stolen = ct;
+		return NFCT_CB_STOLEN;
+	}
+	return NFCT_CB_CONTINUE;
+}
+
+/*
+ * One object is reused for every message until the callback keeps it,
+ * then a new one is used, and the kept one is not touched anymore.
+ */
+static void test_scratch(void)
+{
+	struct scratch_res res = {};
+	struct nf_conntrack *ct;
+	struct nfct_handle *h;
+	char buf[8192];
+	size_t len = 0;
+	int i, fd;
+
+	printf("== test NFCT_HF_SCRATCH ==\n");
+
+	h = nfct_open(CONNTRACK, 0);
+	assert(h);
+	assert(nfct_handle_set_flags(h, NFCT_HF_SCRATCH) == 0);
+	assert(nfct_handle_get_flags(h) == NFCT_HF_SCRATCH);
+	nfct_callback_register(h, NFCT_T_ALL, scratch_cb, &res);
+
+	for (i = 0; i < SCRATCH_CTS; i++) {
+		ct = ct_absent(i);
+		if (i % 2 == 0)
+			nfct_set_attr_u32(ct, ATTR_MARK, i);
+		len += ct_msg(buf + len, IPCTNL_MSG_CT_NEW,
+			      NLM_F_CREATE | NLM_F_EXCL, ct);
+		nfct_destroy(ct);
+	}
+	fd = feed_open(h);
+	assert(send(fd, buf, len, 0) == (ssize_t)len);
+	assert(nfct_catch_budget(h, 0, 0) == 0);
+	assert(res.n == SCRATCH_CTS);
+
+	assert(res.ct[0] == res.ct[1]);
+	assert(res.ct[2] != res.stolen && res.ct[2] == res.ct[3]);
+	assert(ntohs(nfct_get_attr_u16(res.stolen, ATTR_PORT_DST)) == 1001);
+	assert(!nfct_attr_is_set(res.stolen, ATTR_MARK));
+	nfct_destroy(res.stolen);
+
+	close(fd);
+	nfct_close(h);
+	printf("OK\n");
+}
+
+/* one event per datagram, the callback stops us twice. */
+#define RING_CTS	6
+
+struct ring_res {
+	int	n;
+	int	stop[RING_CTS];
+};
+
+static int ring_cb(enum nf_conntrack_msg_type type,
+		   struct nf_conntrack *ct, void *data)
+{
+	struct ring_res *res = data;
+	int i = res->n++;
+
+	assert(i < RING_CTS);
+	assert(ntohs(nfct_get_attr_u16(ct, ATTR_PORT_DST)) == 1000 + i);
+	return res->stop[i] ? NFCT_CB_STOP : NFCT_CB_CONTINUE;
+}
+
+static void ring_send(int fd, int n)
+{
+	struct nf_conntrack *ct;
+	char buf[8192];
+	size_t len;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		ct = ct_absent(i);
+		len = ct_msg(buf, IPCTNL_MSG_CT_NEW,
+			     NLM_F_CREATE | NLM_F_EXCL, ct);
+		assert(send(fd, buf, len, 0) == (ssize_t)len);
+		nfct_destroy(ct);
+	}
+}
+
+/*
+ * The ring takes four datagrams at once, what is left in it when the
+ * callback stops us comes first in the next call, nothing is lost.
+ */
+static void test_ring(void)
+{
+	struct ring_res res = {};
+	struct nfct_handle *h;
+	int fd;
+
+	printf("== test nfct_handle_set_rx_batch() ==\n");
+
+	h = nfct_open(CONNTRACK, 0);
+	assert(h);
+	assert(nfct_handle_set_rx_batch(h, 4, 0) == 0);
+	nfct_callback_register(h, NFCT_T_ALL, ring_cb, &res);
+
+	fd = feed_open(h);
+	ring_send(fd, RING_CTS);
+
+	res.stop[1] = res.stop[RING_CTS - 1] = 1;
+	assert(nfct_catch(h) == NFCT_CB_STOP);
+	assert(res.n == 2);
+
+	/* the ring cannot be replaced while it holds datagrams. */
+	assert(nfct_handle_set_rx_batch(h, 8, 0) == -1 && errno == EBUSY);
+
+	assert(nfct_catch(h) == NFCT_CB_STOP);
+	assert(res.n == RING_CTS);
+	assert(nfct_handle_set_rx_batch(h, 8, 0) == 0);
+
+	/* a datagram that does not fit in a buffer is not half processed. */
+	assert(nfct_handle_set_rx_batch(h, 4, 64) == 0);
+	ring_send(fd, 1);
+	assert(nfct_catch(h) == -1 && errno == ENOSPC);
+	assert(res.n == RING_CTS);
+
+	close(fd);
+	nfct_close(h);
+	printf("OK\n");
+}
+
+/* ten events in arrays of four, the callback keeps the second object. */
+#define BATCH_CTS	10
+#define BATCH_MAX	4
+
+struct batch_res {
+	int			calls;
+	int			n;
+	unsigned int		len[BATCH_CTS];
+	struct nf_conntrack	*objs[BATCH_MAX];
+	struct nf_conntrack	*kept;
+};
+
+static int batch_cb(struct nfct_cb_item *items, unsigned int nitems,
+		    void *data)
+{
+	struct batch_res *res = data;
+	unsigned int i;
+
+	res->len[res->calls++] = nitems;
+	for (i = 0; i < nitems; i++, res->n++) {
+		assert(items[i].type == (res->n % 3 ? NFCT_T_NEW :
+						      NFCT_T_DESTROY));
+		assert(ntohs(nfct_get_attr_u16(items[i].ct, ATTR_PORT_DST)) ==
+		       1000 + res->n);
+
+		/* recycled, but the one that we kept is replaced. */
+		assert(items[i].ct != res->kept);
+		if (res->objs[i] && res->objs[i] != res->kept)
+			assert(items[i].ct == res->objs[i]);
+		res->objs[i] = items[i].ct;
+	}
+	if (res->calls == 1) {
+		res->kept = items[1].ct;
+		items[1].ct = NULL;
+	}
+	return NFCT_CB_CONTINUE;
+}
+
+/*
+ * The events of one datagram are passed in arrays of at most four, and the
+ * rest once drained, the filtered types are not. The object whose entry
+ * was cleared is ours, it is not recycled.
+ */
+static void test_batch(void)
+{
+	struct batch_res res = {};
+	struct nf_conntrack *ct;
+	struct nfct_handle *h;
+	char buf[8192];
+	size_t len = 0;
+	int i, fd;
+
+	printf("== test nfct_callback_register_batch() ==\n");
+
+	h = nfct_open(CONNTRACK, 0);
+	assert(h);
+	assert(nfct_callback_register_batch(h, NFCT_T_NEW | NFCT_T_DESTROY,
+					    batch_cb, BATCH_MAX, &res) == 0);
+
+	for (i = 0; i < BATCH_CTS; i++) {
+		ct = ct_absent(i);
+		if (i % 3) {
+			len += ct_msg(buf + len, IPCTNL_MSG_CT_NEW,
+				      NLM_F_CREATE | NLM_F_EXCL, ct);
+		} else
+			len += ct_msg(buf + len, IPCTNL_MSG_CT_DELETE, 0, ct);
+		/* and an update that is filtered */
+		len += ct_msg(buf + len, IPCTNL_MSG_CT_NEW, 0, ct);
+		nfct_destroy(ct);
+	}
+	fd = feed_open(h);
+	assert(send(fd, buf, len, 0) == (ssize_t)len);
+	assert(nfct_catch_budget(h, 0, 0) == 0);
+
+	assert(res.n == BATCH_CTS && res.calls == 3);
+	assert(res.len[0] == 4 && res.len[1] == 4 && res.len[2] == 2);
+	assert(ntohs(nfct_get_attr_u16(res.kept, ATTR_PORT_DST)) == 1001);
+	nfct_destroy(res.kept);
+
+	close(fd);
+	nfct_close(h);
+	printf("OK\n");
+}
+
+/*
+ * What nfct_catch_budget() returns: 1 while there may be more to do, 0
+ * once drained, also if the callback stops us on the last datagram.
+ */
+static void test_budget(void)
+{
+	struct ring_res res = {};
+	struct nfct_handle *h;
+	int fd;
+
+	printf("== test nfct_catch_budget() ==\n");
+
+	h = nfct_open(CONNTRACK, 0);
+	assert(h);
+	assert(nfct_handle_set_rx_batch(h, 4, 0) == 0);
+	nfct_callback_register(h, NFCT_T_ALL, ring_cb, &res);
+
+	fd = feed_open(h);
+	assert(nfct_catch_budget(h, 0, 0) == 0);
+	ring_send(fd, RING_CTS);
+
+	/* out of budget, by number of datagrams and by time. */
+	assert(nfct_catch_budget(h, 2, 0) == 1);
+	assert(res.n == 2);
+	assert(nfct_catch_budget(h, 0, 1) == 1);
+	assert(res.n == 3);
+
+	/* stopped, with datagrams left in the ring and without. */
+	res.stop[3] = res.stop[RING_CTS - 1] = 1;
+	assert(nfct_catch_budget(h, 0, 0) == 1);
+	assert(res.n == 4);
+	assert(nfct_catch_budget(h, 0, 0) == 0);
+	assert(res.n == RING_CTS);
+	assert(nfct_catch_budget(h, 0, 0) == 0);
+
+	close(fd);
+	nfct_close(h);
+	printf("OK\n");
+}
+
+/* io_uring_setup() fails from now on, as if the kernel had no io_uring. */
+static void uring_deny(void)
+{
+	struct sock_filter filter[] = {
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+			 offsetof(struct seccomp_data, nr)),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_io_uring_setup, 0, 1),
+		BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | ENOSYS),
+		BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+	};
+	struct sock_fprog prog = {
+		.len	= sizeof(filter) / sizeof(filter[0]),
+		.filter	= filter,
+	};
+
+	assert(prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == 0);
+	assert(prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog) == 0);
+}
+
+/* the events are received, whatever the backend. */
+static void uring_events(struct nfct_handle *h)
+{
+	struct ring_res res = {};
+	int fd;
+
+	nfct_callback_register(h, NFCT_T_ALL, ring_cb, &res);
+	fd = feed_open(h);
+	ring_send(fd, RING_CTS);
+	assert(nfct_catch_budget(h, 0, 0) == 0);
+	assert(res.n == RING_CTS);
+	close(fd);
+}
+
+/*
+ * Without io_uring, enabling it fails with EOPNOTSUPP and the handle
+ * goes on without it. With it, the events go through it.
+ */
+static void test_uring(void)
+{
+	struct nfct_handle *h;
+	int status;
+
+	printf("== test nfct_handle_set_uring() ==\n");
+
+	if (fork() == 0) {
+		uring_deny();
+		h = nfct_open(CONNTRACK, 0);
+		assert(h);
+		assert(nfct_handle_set_uring(h, 8, 0) == -1 &&
+		       errno == EOPNOTSUPP);
+		uring_events(h);
+		nfct_close(h);
+		exit(EXIT_SUCCESS);
+	}
+	assert(wait(&status) > 0);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+
+	h = nfct_open(CONNTRACK, 0);
+	assert(h);
+	assert(nfct_handle_set_uring(h, 65536, 0) == -1 && errno == EINVAL);
+	if (nfct_handle_set_uring(h, 8, 0) == -1) {
+		assert(errno == EOPNOTSUPP);
+		printf("no io_uring, ");
+	}
+	uring_events(h);
+	nfct_close(h);
+	printf("OK\n");
+}
+
+static int stats_cb(enum nf_conntrack_msg_type type,
+		    struct nf_conntrack *ct, void *data)
+{
+	if (type == NFCT_T_DESTROY) {
+		nfct_destroy(ct);
+		return NFCT_CB_STOLEN;
+	}
+	/* the second conntrack */
+	if (ntohs(nfct_get_attr_u16(ct, ATTR_PORT_DST)) == 1001)
+		return NFCT_CB_STOP;
+	return NFCT_CB_CONTINUE;
+}
+
+/* two datagrams, one with a filtered update, the counters tell it all. */
+static void stats_feed(struct nfct_handle *h, int fd, size_t *bytes)
+{
+	struct nf_conntrack *ct;
+	char buf[8192];
+	size_t len;
+
+	ct = ct_absent(0);
+	len = ct_msg(buf, IPCTNL_MSG_CT_NEW, NLM_F_CREATE | NLM_F_EXCL, ct);
+	len += ct_msg(buf + len, IPCTNL_MSG_CT_NEW, 0, ct);
+	len += ct_msg(buf + len, IPCTNL_MSG_CT_DELETE, 0, ct);
+	assert(send(fd, buf, len, 0) == (ssize_t)len);
+	*bytes = len;
+	nfct_destroy(ct);
+
+	ct = ct_absent(1);
+	len = ct_msg(buf, IPCTNL_MSG_CT_NEW, NLM_F_CREATE | NLM_F_EXCL, ct);
+	assert(send(fd, buf, len, 0) == (ssize_t)len);
+	*bytes += len;
+	nfct_destroy(ct);
+
+	assert(nfct_catch(h) == NFCT_CB_STOP);
+}
+
+static void test_stats(void)
+{
+	struct nfct_handle_stats st, prev;
+	struct nfct_handle *h;
+	size_t bytes;
+	int fd;
+
+	printf("== test nfct_handle_stats() ==\n");
+
+	h = nfct_open(CONNTRACK, 0);
+	assert(h);
+	nfct_handle_stats(h, &st);
+	assert(st.datagrams == 0 && st.bytes == 0);
+	nfct_callback_register(h, NFCT_T_NEW | NFCT_T_DESTROY, stats_cb, NULL);
+
+	fd = feed_open(h);
+	assert(nfct_handle_set_flags(h, NFCT_HF_TIMING) == 0);
+	stats_feed(h, fd, &bytes);
+	nfct_handle_stats(h, &st);
+	assert(st.datagrams == 2 && st.bytes == bytes);
+	assert(st.enobufs == 0);
+	assert(st.msgs_new == 2 && st.msgs_update == 0);
+	assert(st.msgs_destroy == 1 && st.msgs_unknown == 0);
+	assert(st.filtered == 1);
+	assert(st.cb_stop == 1 && st.cb_stolen == 1);
+	assert(st.parse_ns > 0 && st.callback_ns > 0);
+
+	/* the counters add up, the time is only taken if asked for. */
+	assert(nfct_handle_set_flags(h, 0) == 0);
+	prev = st;
+	stats_feed(h, fd, &bytes);
+	nfct_handle_stats(h, &st);
+	assert(st.datagrams == 4 && st.bytes == prev.bytes + bytes);
+	assert(st.msgs_new == 4 && st.msgs_destroy == 2);
+	assert(st.filtered == 2);
+	assert(st.cb_stop == 2 && st.cb_stolen == 2);
+	assert(st.parse_ns == prev.parse_ns);
+	assert(st.callback_ns == prev.callback_ns);
+
+	close(fd);
+	nfct_close(h);
+	printf("OK\n");
+}
+
+int main(void)
+{
+	test_async();
+	test_async_datagram();
+	test_resync();
+	test_dispatch();
+	test_scratch();
+	test_ring();
+	test_batch();
+	test_budget();
+	test_uring();
+	test_stats();
+	return EXIT_SUCCESS;
+}
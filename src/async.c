@@ -0,0 +1,241 @@
+/*
+ * (C) 2026 by agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "internal/internal.h"
+#include "internal/linux_list.h"
+
+/*
+ * Asynchronous queries: every request that was sent and is not complete yet
+ * is looked up by the sequence number that libnfnetlink gave to it. Replies
+ * are told apart from events because the latter carry no sequence number.
+ * A request completes once its ACK or its error arrives, a GET request
+ * receives the conntrack before that. If the socket overruns, we cannot
+ * tell which replies were lost, so every request in flight fails with
+ * ENOBUFS and the replies that arrive late for them are dropped. Replies
+ * are queued in the order of the requests, so none of those is left once a
+ * reply to a later request shows up.
+ */
+#define ASYNC_BUCKETS	256
+
+struct async_req {
+	struct hlist_node	node;
+	uint32_t		seq;
+	enum nf_conntrack_query	qt;
+	/* reply to a GET request, until it completes */
+	struct nf_conntrack	*ct;
+	/* the reply could not be decoded, reported once the ACK arrives */
+	int			error;
+	int			(*cb)(int error, struct nf_conntrack *ct,
+				      void *data);
+	void			*data;
+};
+
+struct nfct_async {
+	unsigned int		count;
+	/* sequence numbers of the requests that failed with ENOBUFS */
+	uint32_t		lost_min;
+	uint32_t		lost_max;
+	struct hlist_head	buckets[ASYNC_BUCKETS];
+};
+
+struct nfct_async *__async_create(void)
+{
+	return calloc(1, sizeof(struct nfct_async));
+}
+
+static void async_del(struct nfct_async *a, struct async_req *req)
+{
+	hlist_del(&req->node);
+	if (req->ct)
+		nfct_destroy(req->ct);
+	free(req);
+	a->count--;
+}
+
+/* the callbacks of the requests that are left are not called. */
+void __async_destroy(struct nfct_async *a)
+{
+	struct async_req *req;
+	struct hlist_node *n, *tmp;
+	unsigned int i;
+
+	for (i = 0; i < ASYNC_BUCKETS; i++) {
+		hlist_for_each_entry_safe(req, n, tmp, &a->buckets[i], node)
+			async_del(a, req);
+	}
+	free(a);
+}
+
+unsigned int __async_pending(const struct nfct_async *a)
+{
+	return a->count;
+}
+
+static struct async_req *async_find(const struct nfct_async *a, uint32_t seq)
+{
+	struct async_req *req;
+	struct hlist_node *n;
+
+	for (n = a->buckets[seq % ASYNC_BUCKETS].first; n; n = n->next) {
+		req = hlist_entry(n, struct async_req, node);
+		if (req->seq == seq)
+			return req;
+	}
+	return NULL;
+}
+
+int __async_send(struct nfct_handle *h, struct nfnlhdr *req_msg,
+		 const enum nf_conntrack_query qt,
+		 int (*cb)(int error, struct nf_conntrack *ct, void *data),
+		 void *data)
+{
+	struct nfct_async *a = h->async;
+	uint32_t seq = req_msg->nlh.nlmsg_seq;
+	struct async_req *req;
+
+	/* the sequence number wrapped around onto a request in flight. */
+	if (async_find(a, seq)) {
+		errno = EBUSY;
+		return -1;
+	}
+
+	req = calloc(1, sizeof(struct async_req));
+	if (req == NULL)
+		return -1;
+
+	req->seq = seq;
+	req->qt = qt;
+	req->cb = cb;
+	req->data = data;
+
+	if (nfnl_send(h->nfnlh, &req_msg->nlh) == -1) {
+		free(req);
+		return -1;
+	}
+
+	hlist_add_head(&req->node, &a->buckets[seq % ASYNC_BUCKETS]);
+	a->count++;
+
+	return 0;
+}
+
+/* the datagram is a reply to a request in flight. */
+int __async_match(struct nfct_async *a, const void *buf, size_t len)
+{
+	const struct nlmsghdr *nlh = buf;
+
+	if (!NLMSG_OK(nlh, len) || nlh->nlmsg_seq == 0)
+		return 0;
+
+	if (a->lost_max) {
+		if (nlh->nlmsg_seq - a->lost_min <= a->lost_max - a->lost_min)
+			return 1;
+		/* the late replies would have been queued before this one. */
+		if ((int32_t)(nlh->nlmsg_seq - a->lost_max) > 0)
+			a->lost_min = a->lost_max = 0;
+	}
+
+	return a->count && async_find(a, nlh->nlmsg_seq) != NULL;
+}
+
+static int async_complete(struct nfct_handle *h, struct async_req *req,
+			  int error)
+{
+	int (*cb)(int error, struct nf_conntrack *ct, void *data) = req->cb;
+	struct nf_conntrack *ct = req->ct;
+	void *data = req->data;
+	int ret;
+
+	if (req->error)
+		error = req->error;
+
+	req->ct = NULL;
+	async_del(h->async, req);
+
+	ret = cb(error, error ? NULL : ct, data);
+	if (ct && (error || ret != NFCT_CB_STOLEN))
+		nfct_destroy(ct);
+
+	return ret == NFCT_CB_STOLEN ? NFCT_CB_CONTINUE : ret;
+}
+
+/*
+ * Pass the replies in the datagram to the requests they belong to. They are
+ * not received again, thus every one of them is matched even if a callback
+ * stops us, the worst verdict is returned.
+ */
+int __async_process(struct nfct_handle *h, const void *buf, size_t len)
+{
+	const struct nlmsghdr *nlh = buf;
+	const struct nlmsgerr *err;
+	struct async_req *req;
+	int ret = NFCT_CB_CONTINUE, verdict;
+
+	for (; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+		req = async_find(h->async, nlh->nlmsg_seq);
+		if (req == NULL)
+			continue;
+
+		if (nlh->nlmsg_type == NLMSG_ERROR) {
+			if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(*err)))
+				continue;
+			err = NLMSG_DATA(nlh);
+			verdict = async_complete(h, req, -err->error);
+			if (verdict < ret)
+				ret = verdict;
+		} else if (req->qt == NFCT_Q_GET && req->ct == NULL &&
+			   req->error == 0 &&
+			   NFNL_SUBSYS_ID(nlh->nlmsg_type) == NFNL_SUBSYS_CTNETLINK &&
+			   NFNL_MSG_TYPE(nlh->nlmsg_type) == IPCTNL_MSG_CT_NEW) {
+			req->ct = nfct_new();
+			if (req->ct == NULL)
+				req->error = errno;
+			else if (__parse_conntrack(nlh, req->ct, NULL) < 0)
+				req->error = errno;
+		}
+	}
+	return ret;
+}
+
+/*
+ * Replies were lost, fail the requests in flight. Their callbacks are
+ * called with ENOBUFS, the verdicts are ignored since the caller is told
+ * about the overrun anyway. Requests that the callbacks send are not in
+ * the range, thus they are left alone.
+ */
+void __async_lost(struct nfct_handle *h)
+{
+	struct nfct_async *a = h->async;
+	struct async_req *req;
+	struct hlist_node *n, *tmp;
+	unsigned int i;
+
+	if (a->count == 0)
+		return;
+
+	a->lost_min = a->lost_max = 0;
+	for (i = 0; i < ASYNC_BUCKETS; i++) {
+		for (n = a->buckets[i].first; n; n = n->next) {
+			req = hlist_entry(n, struct async_req, node);
+			if (a->lost_min == 0 ||
+			    (int32_t)(req->seq - a->lost_min) < 0)
+				a->lost_min = req->seq;
+			if (a->lost_max == 0 ||
+			    (int32_t)(req->seq - a->lost_max) > 0)
+				a->lost_max = req->seq;
+		}
+	}
+
+	for (i = 0; i < ASYNC_BUCKETS; i++) {
+		hlist_for_each_entry_safe(req, n, tmp, &a->buckets[i], node) {
+			if (req->seq - a->lost_min <= a->lost_max - a->lost_min)
+				async_complete(h, req, ENOBUFS);
+		}
+	}
+}
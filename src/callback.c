@@ -29,6 +29,175 @@ static int __parse_message(const struct nlmsghdr *nlh)
 	return ret;
 }
 
+/* timestamp for the performance counters, zero unless NFCT_HF_TIMING is set */
+uint64_t __stats_now(const struct nfct_handle *h)
+{
+	struct timespec ts;
+
+	if (!(h->flags & NFCT_HF_TIMING))
+		return 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void __stats_elapsed(const struct nfct_handle *h, uint64_t *ns,
+		     uint64_t start)
+{
+	uint64_t now;
+
+	/* the flag might have changed in between. */
+	if (start == 0)
+		return;
+
+	now = __stats_now(h);
+	if (now)
+		*ns += now - start;
+}
+
+void __stats_verdict(struct nfct_handle *h, int ret)
+{
+	if (ret == NFCT_CB_STOP)
+		h->stats.cb_stop++;
+	else if (ret == NFCT_CB_STOLEN)
+		h->stats.cb_stolen++;
+}
+
+static void __stats_type(struct nfct_handle *h, unsigned int type)
+{
+	switch(type) {
+	case NFCT_T_NEW:
+		h->stats.msgs_new++;
+		break;
+	case NFCT_T_UPDATE:
+		h->stats.msgs_update++;
+		break;
+	case NFCT_T_DESTROY:
+		h->stats.msgs_destroy++;
+		break;
+	default:
+		h->stats.msgs_unknown++;
+		break;
+	}
+}
+
+static struct nf_conntrack *__callback_ct_alloc(struct nfct_handle *h)
+{
+	if (h->pool)
+		return __pool_get(h->pool);
+
+	return nfct_new();
+}
+
+static struct nf_conntrack *__callback_scratch(struct nfct_handle *h)
+{
+	if (h->scratch == NULL) {
+		h->scratch = __callback_ct_alloc(h);
+		return h->scratch;
+	}
+	/* attributes are only visible if their bit is set, clearing the
+	 * bitset is enough to recycle the object. Buffers that are attached
+	 * to it are reused by the parsers. */
+	memset(h->scratch->head.set, 0, sizeof(h->scratch->head.set));
+
+	return h->scratch;
+}
+
+#define CB_BATCH_DEFAULT	64
+
+struct __cb_batch *__callback_batch_create(unsigned int max)
+{
+	struct __cb_batch *b;
+
+	b = calloc(1, sizeof(struct __cb_batch));
+	if (b == NULL)
+		return NULL;
+
+	b->max = max ? max : CB_BATCH_DEFAULT;
+	b->items = calloc(b->max, sizeof(struct nfct_cb_item));
+	b->objs = calloc(b->max, sizeof(struct nf_conntrack *));
+	if (b->items == NULL || b->objs == NULL) {
+		__callback_batch_destroy(b);
+		return NULL;
+	}
+	return b;
+}
+
+void __callback_batch_destroy(struct __cb_batch *b)
+{
+	unsigned int i;
+
+	if (b->objs) {
+		for (i = 0; i < b->max; i++) {
+			if (b->objs[i])
+				nfct_destroy(b->objs[i]);
+		}
+	}
+	free(b->objs);
+	free(b->items);
+	free(b);
+}
+
+/* pass the accumulated conntracks to the batch callback, if any. */
+int __callback_flush(struct nfct_handle *h)
+{
+	struct __data_container *container = h->nfnl_cb_ct.data;
+	struct __cb_batch *b = h->cb_batch;
+	unsigned int i, len = b->len;
+	uint64_t start;
+	int ret;
+
+	if (len == 0)
+		return NFNL_CB_CONTINUE;
+
+	b->len = 0;
+	start = __stats_now(h);
+	ret = h->batch_cb(b->items, len, container->data);
+	__stats_elapsed(h, &h->stats.callback_ns, start);
+	__stats_verdict(h, ret);
+
+	/* the callback keeps the objects whose entry it has cleared. */
+	for (i = 0; i < len; i++) {
+		if (b->items[i].ct == NULL)
+			b->objs[i] = NULL;
+	}
+	if (ret == NFCT_CB_STOLEN)
+		ret = NFCT_CB_CONTINUE;
+
+	return ret;
+}
+
+static int __callback_batch_add(struct nfct_handle *h, unsigned int type,
+				const struct nlmsghdr *nlh)
+{
+	struct __cb_batch *b = h->cb_batch;
+	struct nf_conntrack *ct = b->objs[b->len];
+	uint64_t start;
+	int err;
+
+	if (ct == NULL) {
+		ct = __callback_ct_alloc(h);
+		if (ct == NULL)
+			return NFNL_CB_FAILURE;
+		b->objs[b->len] = ct;
+	} else
+		memset(ct->head.set, 0, sizeof(ct->head.set));
+
+	start = __stats_now(h);
+	err = __parse_conntrack(nlh, ct, h->parse_mask);
+	__stats_elapsed(h, &h->stats.parse_ns, start);
+	/* the object stays in the batch, it is recycled by the next one. */
+	if (err < 0)
+		return NFNL_CB_FAILURE;
+
+	b->items[b->len].type = type;
+	b->items[b->len].ct = ct;
+	if (++b->len == b->max)
+		return __callback_flush(h);
+
+	return NFNL_CB_CONTINUE;
+}
+
 int __callback(struct nlmsghdr *nlh, struct nfattr *nfa[], void *data)
 {
 	int ret = NFNL_CB_STOP;
@@ -36,38 +205,92 @@ int __callback(struct nlmsghdr *nlh, struct nfattr *nfa[], void *data)
 	struct nf_conntrack *ct = NULL;
 	struct nf_expect *exp = NULL;
 	struct __data_container *container = data;
+	struct nfct_handle *h = container->h;
 	uint8_t subsys = NFNL_SUBSYS_ID(nlh->nlmsg_type);
+	uint64_t start;
+	int err;
 
 	if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct nfgenmsg))) {
 		errno = EINVAL;
 		return NFNL_CB_FAILURE;
 	}
 	type = __parse_message(nlh);
-	if (!(type & container->type))
+	if (!(type & container->type)) {
+		h->stats.filtered++;
 		return NFNL_CB_CONTINUE;
+	}
+	__stats_type(h, type);
 
 	switch(subsys) {
 	case NFNL_SUBSYS_CTNETLINK:
-		ct = nfct_new();
+		if (container->h->view_cb) {
+			struct nfct_view view;
+
+			__view_init(&view, nlh);
+			start = __stats_now(h);
+			ret = container->h->view_cb(nlh, type, &view,
+						    container->data);
+			__stats_elapsed(h, &h->stats.callback_ns, start);
+			__stats_verdict(h, ret);
+			/* the view refers to the receive buffer. */
+			if (ret == NFCT_CB_STOLEN)
+				ret = NFCT_CB_CONTINUE;
+			break;
+		}
+		if (container->h->batch_cb) {
+			ret = __callback_batch_add(container->h, type, nlh);
+			break;
+		}
+		if (container->h->flags & NFCT_HF_SCRATCH)
+			ct = __callback_scratch(container->h);
+		else
+			ct = __callback_ct_alloc(container->h);
 		if (ct == NULL)
 			return NFNL_CB_FAILURE;
 
-		__parse_conntrack(nlh, nfa, ct);
+		start = __stats_now(h);
+		err = __parse_conntrack(nlh, ct, h->parse_mask);
+		__stats_elapsed(h, &h->stats.parse_ns, start);
+		if (err < 0) {
+			ret = NFNL_CB_FAILURE;
+			break;
+		}
 
+		if (container->h->resync)
+			__resync_event(container->h->resync, type, ct);
+
+		/* only events, replies to queries go to the callback now. */
+		if (container->h->coalesce && nlh->nlmsg_seq == 0) {
+			/* the window keeps the object, get a new one later. */
+			if (ct == container->h->scratch)
+				container->h->scratch = NULL;
+			return __coalesce_add(container->h, type, ct);
+		}
+
+		start = __stats_now(h);
 		if (container->h->cb) {
 			ret = container->h->cb(type, ct, container->data);
 		} else if (container->h->cb2) {
 			ret = container->h->cb2(nlh, type, ct,
 						container->data);
 		}
+		__stats_elapsed(h, &h->stats.callback_ns, start);
+		__stats_verdict(h, ret);
 		break;
 	case NFNL_SUBSYS_CTNETLINK_EXP:
 		exp = nfexp_new();
 		if (exp == NULL)
 			return NFNL_CB_FAILURE;
 
-		__parse_expect(nlh, nfa, exp);
+		start = __stats_now(h);
+		err = __parse_expect(nlh, exp);
+		__stats_elapsed(h, &h->stats.parse_ns, start);
+		if (err < 0) {
+			ret = NFNL_CB_FAILURE;
+			break;
+		}
 
+		start = __stats_now(h);
 		if (container->h->expect_cb) {
 			ret = container->h->expect_cb(type, exp,
 						      container->data);
@@ -75,6 +298,8 @@ int __callback(struct nlmsghdr *nlh, struct nfattr *nfa[], void *data)
 			ret = container->h->expect_cb2(nlh, type, exp,
 						       container->data);
 		}
+		__stats_elapsed(h, &h->stats.callback_ns, start);
+		__stats_verdict(h, ret);
 		break;
 	default:
 		errno = ENOTSUP;
@@ -82,10 +307,14 @@ int __callback(struct nlmsghdr *nlh, struct nfattr *nfa[], void *data)
 		break;
 	}
 
-	if (ret == NFCT_CB_STOLEN)
+	if (ret == NFCT_CB_STOLEN) {
+		/* the caller keeps the scratch object, get a new one later. */
+		if (ct && ct == container->h->scratch)
+			container->h->scratch = NULL;
 		return NFNL_CB_CONTINUE;
+	}
 
-	if (ct)
+	if (ct && ct != container->h->scratch)
 		nfct_destroy(ct);
 	if (exp)
 		nfexp_destroy(exp);
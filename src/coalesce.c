@@ -0,0 +1,236 @@
+/*
+ * (C) 2026 by agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <time.h>
+
+#include "internal/internal.h"
+#include "internal/linux_list.h"
+
+/*
+ * Event coalescing: conntracks are held back for a window of time or a
+ * number of events, successive events for the same conntrack are merged
+ * into one entry that carries the latest state. Entries are passed to the
+ * callback in the order they were opened once the window closes.
+ */
+#define COALESCE_BUCKETS	1024
+
+struct coalesce_entry {
+	/* arrival order */
+	struct list_head	head;
+	/* lookup by original tuple, unhashed once the conntrack is gone */
+	struct hlist_node	node;
+	uint32_t		hash;
+	unsigned int		type;
+	struct nf_conntrack	*ct;
+};
+
+struct nfct_coalesce {
+	unsigned int		max_events;
+	uint64_t		window_ns;
+
+	/* events merged since the window was opened, and when it was */
+	unsigned int		events;
+	uint64_t		start;
+
+	struct list_head	list;
+	struct hlist_head	buckets[COALESCE_BUCKETS];
+};
+
+static uint64_t coalesce_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct nfct_coalesce *__coalesce_create(unsigned int max_events,
+					uint64_t window_ns)
+{
+	struct nfct_coalesce *c;
+
+	c = calloc(1, sizeof(struct nfct_coalesce));
+	if (c == NULL)
+		return NULL;
+
+	c->max_events = max_events;
+	c->window_ns = window_ns;
+	INIT_LIST_HEAD(&c->list);
+
+	return c;
+}
+
+static void coalesce_del(struct coalesce_entry *e)
+{
+	list_del(&e->head);
+	hlist_del_init(&e->node);
+	free(e);
+}
+
+void __coalesce_destroy(struct nfct_coalesce *c)
+{
+	struct coalesce_entry *e, *next;
+
+	list_for_each_entry_safe(e, next, &c->list, head) {
+		nfct_destroy(e->ct);
+		coalesce_del(e);
+	}
+	free(c);
+}
+
+int __coalesce_pending(const struct nfct_coalesce *c)
+{
+	return !list_empty(&c->list);
+}
+
+static struct coalesce_entry *
+coalesce_find(struct nfct_coalesce *c, const struct nf_conntrack *ct,
+	      uint32_t hash)
+{
+	struct coalesce_entry *e;
+	struct hlist_node *n;
+
+	for (n = c->buckets[hash % COALESCE_BUCKETS].first; n; n = n->next) {
+		e = hlist_entry(n, struct coalesce_entry, node);
+		if (e->hash == hash &&
+		    __cmp_orig(e->ct, ct, NFCT_CMP_STRICT))
+			return e;
+	}
+	return NULL;
+}
+
+/* a different conntrack with the same tuple, the old one is gone. */
+static int coalesce_reused(const struct coalesce_entry *e,
+			   const struct nf_conntrack *ct)
+{
+	if (e->type == NFCT_T_DESTROY)
+		return 1;
+
+	return test_bit(ATTR_ID, e->ct->head.set) &&
+	       test_bit(ATTR_ID, ct->head.set) &&
+	       e->ct->id != ct->id;
+}
+
+/* pass the entries to the callback in arrival order. */
+int __coalesce_flush(struct nfct_handle *h)
+{
+	struct __data_container *container = h->nfnl_cb_ct.data;
+	struct nfct_coalesce *c = h->coalesce;
+	struct coalesce_entry *e;
+	struct nf_conntrack *ct;
+	unsigned int type;
+	uint64_t start;
+	int ret = NFCT_CB_CONTINUE;
+
+	c->events = 0;
+
+	/* entries that are left if the callback stops us go first next time */
+	while (!list_empty(&c->list) && ret > NFCT_CB_STOP) {
+		e = list_entry(c->list.next, struct coalesce_entry, head);
+		type = e->type;
+		ct = e->ct;
+		coalesce_del(e);
+
+		ret = NFCT_CB_CONTINUE;
+		start = __stats_now(h);
+		if (h->cb)
+			ret = h->cb(type, ct, container->data);
+		else if (h->cb2)
+			ret = h->cb2(NULL, type, ct, container->data);
+		__stats_elapsed(h, &h->stats.callback_ns, start);
+		__stats_verdict(h, ret);
+
+		if (ret == NFCT_CB_STOLEN)
+			ret = NFCT_CB_CONTINUE;
+		else
+			nfct_destroy(ct);
+	}
+	return ret;
+}
+
+/* flush if the window is over, the receive path calls this once drained. */
+int __coalesce_expire(struct nfct_handle *h)
+{
+	struct nfct_coalesce *c = h->coalesce;
+
+	if (list_empty(&c->list))
+		return NFCT_CB_CONTINUE;
+
+	if ((c->max_events && c->events >= c->max_events) ||
+	    (c->window_ns && coalesce_now() - c->start >= c->window_ns))
+		return __coalesce_flush(h);
+
+	return NFCT_CB_CONTINUE;
+}
+
+/*
+ * Milliseconds until the window closes, rounded up, so that the receive
+ * path does not sleep beyond it. -1 if there is nothing to wait for.
+ */
+int __coalesce_timeout(const struct nfct_coalesce *c)
+{
+	uint64_t elapsed;
+
+	if (list_empty(&c->list) || c->window_ns == 0)
+		return -1;
+
+	elapsed = coalesce_now() - c->start;
+	if (elapsed >= c->window_ns)
+		return 0;
+
+	return (c->window_ns - elapsed + 999999) / 1000000;
+}
+
+/*
+ * Merge one event into the window, the window owns ct from now on. NEW and
+ * UPDATE events refresh the state of the entry, that keeps the type of the
+ * event that opened it. DESTROY turns the entry into a DESTROY, so that a
+ * conntrack that is created and destroyed in the same window is reported
+ * once.
+ */
+int __coalesce_add(struct nfct_handle *h, unsigned int type,
+		   struct nf_conntrack *ct)
+{
+	struct nfct_coalesce *c = h->coalesce;
+	struct coalesce_entry *e;
+	uint32_t hash;
+
+	hash = __hash_orig(ct);
+	e = coalesce_find(c, ct, hash);
+	if (e && coalesce_reused(e, ct)) {
+		hlist_del_init(&e->node);
+		e = NULL;
+	}
+
+	if (e == NULL) {
+		e = calloc(1, sizeof(struct coalesce_entry));
+		if (e == NULL) {
+			nfct_destroy(ct);
+			return NFCT_CB_FAILURE;
+		}
+		if (list_empty(&c->list))
+			c->start = c->window_ns ? coalesce_now() : 0;
+
+		e->hash = hash;
+		e->type = type;
+		e->ct = ct;
+		list_add_tail(&e->head, &c->list);
+		hlist_add_head(&e->node, &c->buckets[hash % COALESCE_BUCKETS]);
+	} else if (type == NFCT_T_DESTROY) {
+		nfct_destroy(e->ct);
+		e->type = NFCT_T_DESTROY;
+		e->ct = ct;
+	} else {
+		nfct_copy(e->ct, ct, NFCT_CP_ALL);
+		nfct_destroy(ct);
+	}
+
+	c->events++;
+
+	return __coalesce_expire(h);
+}
@@ -81,6 +81,7 @@ struct nf_conntrack *nfct_new(void)
 		return NULL;
 
 	memset(ct, 0, sizeof(struct nf_conntrack));
+	ct->heap = 1;
 
 	return ct;
 }
@@ -92,14 +93,11 @@ struct nf_conntrack *nfct_new(void)
 void nfct_destroy(struct nf_conntrack *ct)
 {
 	assert(ct != NULL);
-	if (ct->secctx)
-		free(ct->secctx);
-	if (ct->helper_info)
-		free(ct->helper_info);
-	if (ct->connlabels)
-		nfct_bitmask_destroy(ct->connlabels);
-	if (ct->connlabels_mask)
-		nfct_bitmask_destroy(ct->connlabels_mask);
+	if (ct->pool) {
+		__pool_put(ct->pool, ct);
+		return;
+	}
+	__cold_release(ct);
 	free(ct);
 	ct = NULL; /* bugtrap */
 }
@@ -108,11 +106,22 @@ void nfct_destroy(struct nf_conntrack *ct)
  * nf_sizeof - return the size in bytes of a certain conntrack object
  * \param ct pointer to the conntrack object
  *
+ * The object is made of a compact block that holds the attributes that are
+ * present in most events (tuples, status, timeout, mark, counters and
+ * protocol information) and an extension that is only allocated once a
+ * rarely used attribute (master tuple, NAT, sequence adjustment, helper,
+ * security context, timestamp or labels) is set. The size that is returned
+ * includes the extension only if the object has one.
+ *
  * This function is DEPRECATED, don't use it in your code.
  */
 size_t nfct_sizeof(const struct nf_conntrack *ct)
 {
 	assert(ct != NULL);
+
+	if (ct->cold)
+		return sizeof(*ct) + sizeof(*ct->cold);
+
 	return sizeof(*ct);
 }
 
@@ -126,15 +135,20 @@ size_t nfct_sizeof(const struct nf_conntrack *ct)
 	struct nf_conntrack *ct = (struct nf_conntrack *) buf;
 	memset(ct, 0, nfct_maxsize());
 \endverbatim
- * Note: As for now this function returns the same size that nfct_sizeof(ct)
- * does although _this could change in the future_. Therefore, do not assume
- * that nfct_sizeof(ct) == nfct_maxsize().
+ * Note: This function returns the size of an object that carries the
+ * extension for rarely used attributes, therefore nfct_sizeof(ct) is smaller
+ * than nfct_maxsize() for objects that do not have it. Objects allocated in
+ * the stack keep that extension in the buffer, so they need no release.
+ * However, the security context, the helper information and labels beyond
+ * the first 128 bits are always stored in the heap: objects that may carry
+ * them, for example because events are parsed into them, leak unless they
+ * are allocated with nfct_new() and released with nfct_destroy().
  *
  * This function is DEPRECATED, don't use it in your code.
  */
 size_t nfct_maxsize(void)
 {
-	return sizeof(struct nf_conntrack);
+	return sizeof(struct nf_conntrack) + sizeof(struct __nfct_cold);
 }
 
 /**
@@ -197,6 +211,91 @@ int nfct_getobjopt(const struct nf_conntrack *ct, unsigned int option)
 	return __getobjopt(ct, option);
 }
 
+/**
+ * @}
+ */
+
+/**
+ * \defgroup pool Conntrack object pool
+ * @{
+ */
+
+/**
+ * nfct_pool_create - create a pool of conntrack objects
+ * \param batch number of objects moved at once between the pool and the
+ * per-thread free lists, zero selects the default (64).
+ *
+ * Objects are allocated in slabs of batch entries and recycled through
+ * per-thread free lists, so that getting and releasing an object does not
+ * go through the general allocator. The secctx, helper info and label
+ * buffers are kept attached to recycled objects and reused when possible.
+ *
+ * On error, NULL is returned and errno is set appropiately. Otherwise,
+ * a valid pointer to the pool is returned.
+ */
+struct nfct_pool *nfct_pool_create(unsigned int batch)
+{
+	return __pool_create(batch);
+}
+
+/**
+ * nfct_pool_destroy - release a pool of conntrack objects
+ * \param pool pointer to the pool object
+ *
+ * All objects taken from this pool must have been released via
+ * nfct_pool_put() or nfct_destroy() before calling this function, and the
+ * pool must not be attached to any handle.
+ */
+void nfct_pool_destroy(struct nfct_pool *pool)
+{
+	assert(pool != NULL);
+	__pool_destroy(pool);
+}
+
+/**
+ * nfct_pool_new - get a conntrack object from the pool
+ * \param pool pointer to the pool object
+ *
+ * The object that is returned has no attributes set, like the ones returned
+ * by nfct_new(). Calling nfct_destroy() on it returns it to the pool.
+ *
+ * In case of success, this function returns a valid pointer to the object,
+ * otherwise NULL is returned and errno is set appropiately.
+ */
+struct nf_conntrack *nfct_pool_new(struct nfct_pool *pool)
+{
+	assert(pool != NULL);
+	return __pool_get(pool);
+}
+
+/**
+ * nfct_pool_put - return a conntrack object to the pool
+ * \param pool pointer to the pool object
+ * \param ct pointer to a conntrack object taken from this pool
+ */
+void nfct_pool_put(struct nfct_pool *pool, struct nf_conntrack *ct)
+{
+	assert(pool != NULL);
+	assert(ct != NULL);
+	__pool_put(pool, ct);
+}
+
+/**
+ * nfct_pool_attach - use a pool for the objects passed to the callbacks
+ * \param h library handler
+ * \param pool pointer to the pool object, NULL to stop using a pool
+ *
+ * Once attached, the conntrack objects that are passed to the callbacks are
+ * taken from this pool instead of being allocated via nfct_new(). Objects
+ * that are kept by means of NFCT_CB_STOLEN go back to the pool when they
+ * are released with nfct_destroy().
+ */
+void nfct_pool_attach(struct nfct_handle *h, struct nfct_pool *pool)
+{
+	assert(h != NULL);
+	h->pool = pool;
+}
+
 /**
  * @}
  */
@@ -349,6 +448,258 @@ void nfct_callback_unregister2(struct nfct_handle *h)
 	h->nfnl_cb_ct.attr_count = 0;
 }
 
+/**
+ * nfct_callback_register_view - register a callback that receives views
+ * \param h library handler
+ * \param type message type (see enum nf_conntrack_msg_type definition)
+ * \param cb callback used to process the messages received
+ * \param data data used by the callback, if any.
+ *
+ * This function registers a callback that receives a view over every
+ * conntrack message instead of a conntrack object. The message is indexed
+ * in one pass and the attributes are only decoded when they are requested
+ * via nfct_view_get_attr() and friends, so nothing is allocated or parsed
+ * for attributes that the callback does not look at.
+ *
+ * The view refers to the buffer that holds the message, so it is only
+ * valid until the callback returns. NFCT_CB_STOLEN is handled like
+ * NFCT_CB_CONTINUE. If you need to keep the information, use
+ * nfct_nlmsg_parse() on the Netlink header passed to the callback.
+ *
+ * In case of error -1 is returned and errno is set appropiately, otherwise
+ * 0 is returned.
+ *
+ * WARNING: Don't mix this function with nfct_callback_register() or
+ * nfct_callback_register2(), use only one at a time.
+ */
+int nfct_callback_register_view(struct nfct_handle *h,
+				enum nf_conntrack_msg_type type,
+				int (*cb)(const struct nlmsghdr *nlh,
+					  enum nf_conntrack_msg_type type,
+					  struct nfct_view *view,
+					  void *data),
+				void *data)
+{
+	struct __data_container *container;
+
+	assert(h != NULL);
+
+	container = calloc(sizeof(struct __data_container), 1);
+	if (container == NULL)
+		return -1;
+
+	h->view_cb = cb;
+	container->h = h;
+	container->type = type;
+	container->data = data;
+
+	h->nfnl_cb_ct.call = __callback;
+	h->nfnl_cb_ct.data = container;
+	h->nfnl_cb_ct.attr_count = CTA_MAX;
+
+	nfnl_callback_register(h->nfnlssh_ct,
+			       IPCTNL_MSG_CT_NEW,
+			       &h->nfnl_cb_ct);
+
+	nfnl_callback_register(h->nfnlssh_ct,
+			       IPCTNL_MSG_CT_DELETE,
+			       &h->nfnl_cb_ct);
+
+	return 0;
+}
+
+/**
+ * nfct_callback_unregister_view - unregister a view callback
+ * \param h library handler
+ */
+void nfct_callback_unregister_view(struct nfct_handle *h)
+{
+	assert(h != NULL);
+
+	nfnl_callback_unregister(h->nfnlssh_ct, IPCTNL_MSG_CT_NEW);
+	nfnl_callback_unregister(h->nfnlssh_ct, IPCTNL_MSG_CT_DELETE);
+
+	h->view_cb = NULL;
+	free(h->nfnl_cb_ct.data);
+
+	h->nfnl_cb_ct.call = NULL;
+	h->nfnl_cb_ct.data = NULL;
+	h->nfnl_cb_ct.attr_count = 0;
+}
+
+/**
+ * nfct_callback_register_batch - register a callback that receives arrays
+ * \param h library handler
+ * \param type message type (see enum nf_conntrack_msg_type definition)
+ * \param cb callback used to process the conntracks received
+ * \param max maximum number of conntracks per call, zero selects the
+ * default (64)
+ * \param data data used by the callback, if any.
+ *
+ * This function registers a callback that receives an array with the
+ * message type and the conntrack object of every conntrack received in a
+ * call to nfct_catch(), or in a dump issued via nfct_query(), instead of
+ * being called once per conntrack. The callback is called once the array
+ * holds max entries and once there are no more messages to process. This
+ * allows the consumer to take locks or to push to queues once per array.
+ *
+ * The objects are owned by the handle and recycled for the next call. To
+ * keep one, set the ct field of its entry to NULL, then it has to be
+ * released via nfct_destroy(). The callback verdict applies to the whole
+ * array, NFCT_CB_STOLEN is handled like NFCT_CB_CONTINUE.
+ *
+ * When this callback is registered, nfct_catch() uses the batched receive
+ * ring (see nfct_handle_set_rx_batch()), one buffer is set up if none was.
+ *
+ * In case of error -1 is returned and errno is set appropiately, otherwise
+ * 0 is returned.
+ */
+int nfct_callback_register_batch(struct nfct_handle *h,
+				 enum nf_conntrack_msg_type type,
+				 int (*cb)(struct nfct_cb_item *items,
+					   unsigned int nitems,
+					   void *data),
+				 unsigned int max,
+				 void *data)
+{
+	struct __data_container *container;
+	struct __cb_batch *batch;
+
+	assert(h != NULL);
+
+	container = calloc(sizeof(struct __data_container), 1);
+	if (container == NULL)
+		return -1;
+
+	batch = __callback_batch_create(max);
+	if (batch == NULL) {
+		free(container);
+		return -1;
+	}
+
+	/* registering again replaces the previous batch callback. */
+	if (h->cb_batch) {
+		__callback_batch_destroy(h->cb_batch);
+		free(h->nfnl_cb_ct.data);
+	}
+
+	h->batch_cb = cb;
+	h->cb_batch = batch;
+	container->h = h;
+	container->type = type;
+	container->data = data;
+
+	h->nfnl_cb_ct.call = __callback;
+	h->nfnl_cb_ct.data = container;
+	h->nfnl_cb_ct.attr_count = CTA_MAX;
+
+	nfnl_callback_register(h->nfnlssh_ct,
+			       IPCTNL_MSG_CT_NEW,
+			       &h->nfnl_cb_ct);
+
+	nfnl_callback_register(h->nfnlssh_ct,
+			       IPCTNL_MSG_CT_DELETE,
+			       &h->nfnl_cb_ct);
+
+	return 0;
+}
+
+/**
+ * nfct_callback_unregister_batch - unregister a batch callback
+ * \param h library handler
+ */
+void nfct_callback_unregister_batch(struct nfct_handle *h)
+{
+	assert(h != NULL);
+
+	nfnl_callback_unregister(h->nfnlssh_ct, IPCTNL_MSG_CT_NEW);
+	nfnl_callback_unregister(h->nfnlssh_ct, IPCTNL_MSG_CT_DELETE);
+
+	h->batch_cb = NULL;
+	if (h->cb_batch) {
+		__callback_batch_destroy(h->cb_batch);
+		h->cb_batch = NULL;
+	}
+	free(h->nfnl_cb_ct.data);
+
+	h->nfnl_cb_ct.call = NULL;
+	h->nfnl_cb_ct.data = NULL;
+	h->nfnl_cb_ct.attr_count = 0;
+}
+
+/**
+ * nfct_dispatch_create - run the callback in a pool of worker threads
+ * \param h library handler
+ * \param type message type (see enum nf_conntrack_msg_type definition)
+ * \param nworkers number of worker threads
+ * \param ring_size number of conntracks that can be queued per worker,
+ * rounded up to a power of two. Zero selects the default (1024)
+ * \param cb callback used to process the conntracks received
+ * \param data data used by the callback, if any.
+ *
+ * This function registers a callback in the handle that hands over the
+ * conntracks received via nfct_catch() or nfct_query() to nworkers worker
+ * threads, which call cb. The worker is selected by a hash of the original
+ * tuple, so the events of one flow are processed in order by the same
+ * worker. Conntracks are passed to the workers through single-producer,
+ * single-consumer rings without locks. When the ring of a worker is full,
+ * the thread calling nfct_catch() waits until there is room.
+ *
+ * The callback is called from the worker threads, it has to be thread-safe
+ * if it accesses shared data. Only NFCT_CB_STOLEN is meaningful: the object
+ * is released after the callback returns unless it returns NFCT_CB_STOLEN,
+ * then nfct_destroy() has to be called to release it. NFCT_CB_STOP is
+ * ignored, the worker goes on with the next conntrack and nfct_catch() does
+ * not return, use nfct_catch_budget() to get the control back.
+ *
+ * On error, NULL is returned and errno is appropriately set. Otherwise, a
+ * valid pointer is returned.
+ *
+ * WARNING: Don't mix this function with the other callback registration
+ * functions on the same handle.
+ */
+struct nfct_dispatch *
+nfct_dispatch_create(struct nfct_handle *h,
+		     enum nf_conntrack_msg_type type,
+		     unsigned int nworkers,
+		     unsigned int ring_size,
+		     int (*cb)(enum nf_conntrack_msg_type type,
+			       struct nf_conntrack *ct,
+			       void *data),
+		     void *data)
+{
+	struct nfct_dispatch *d;
+
+	assert(h != NULL);
+	assert(cb != NULL);
+
+	d = __dispatch_create(h, nworkers, ring_size, cb, data);
+	if (d == NULL)
+		return NULL;
+
+	if (nfct_callback_register(h, type, __dispatch_callback, d) == -1) {
+		__dispatch_destroy(d);
+		return NULL;
+	}
+	return d;
+}
+
+/**
+ * nfct_dispatch_destroy - stop the worker threads and release the dispatcher
+ * \param d dispatcher returned by nfct_dispatch_create()
+ *
+ * The conntracks that are still queued are processed before the workers
+ * exit. This function has to be called from the thread that calls
+ * nfct_catch(), once it has returned.
+ */
+void nfct_dispatch_destroy(struct nfct_dispatch *d)
+{
+	assert(d != NULL);
+
+	nfct_callback_unregister(__dispatch_handle(d));
+	__dispatch_destroy(d);
+}
+
 /**
  * @}
  */
@@ -376,6 +727,8 @@ nfct_set_attr_l(struct nf_conntrack *ct, const enum nf_conntrack_attr type,
 		return;
 
 	if (set_attr_array[type]) {
+		if (__cold_prepare(ct, type) < 0)
+			return;
 		set_attr_array[type](ct, value, len);
 		set_bit(type, ct->head.set);
 	}
@@ -636,6 +989,8 @@ void nfct_set_attr_grp(struct nf_conntrack *ct,
 		return;
 
 	if (set_attr_grp_array[type]) {
+		if (__cold_prepare_grp(ct, type) < 0)
+			return;
 		set_attr_grp_array[type](ct, data);
 		set_bitmask_u32(ct->head.set,
 				attr_grp_bitmask[type].bitmask, __NFCT_BITSET);
@@ -910,8 +1265,6 @@ int nfct_parse_conntrack(enum nf_conntrack_msg_type type,
 {
 	unsigned int flags;
 	int len = nlh->nlmsg_len;
-	struct nfgenmsg *nfhdr = NLMSG_DATA(nlh);
-	struct nfattr *cda[CTA_MAX];
 
 	assert(nlh != NULL);
 	assert(ct != NULL);
@@ -926,13 +1279,187 @@ int nfct_parse_conntrack(enum nf_conntrack_msg_type type,
 	if (!(flags & type))
 		return 0;
 
-	nfnl_parse_attr(cda, CTA_MAX, NFA_DATA(nfhdr), len);
-
-	__parse_conntrack(nlh, cda, ct);
+	if (__parse_conntrack(nlh, ct, NULL) < 0)
+		return NFCT_T_ERROR;
 
 	return flags;
 }
 
+/**
+ * @}
+ */
+
+/**
+ * \defgroup view Conntrack message views
+ * @{
+ */
+
+/**
+ * nfct_view_new - allocate a new conntrack message view
+ *
+ * In case of success, this function returns a valid pointer to a memory blob,
+ * otherwise NULL is returned and errno is set appropiately.
+ */
+struct nfct_view *nfct_view_new(void)
+{
+	struct nfct_view *view;
+
+	view = calloc(1, sizeof(struct nfct_view));
+	if (view == NULL)
+		return NULL;
+
+	return view;
+}
+
+/**
+ * nfct_view_destroy - release a conntrack message view
+ * \param view pointer to the view object
+ */
+void nfct_view_destroy(struct nfct_view *view)
+{
+	assert(view != NULL);
+	free(view);
+}
+
+/**
+ * nfct_view_parse - index a conntrack Netlink message
+ * \param view pointer to the view object
+ * \param nlh pointer to the Netlink message
+ *
+ * This function walks the message once and records where each attribute
+ * is, no attribute is decoded. The message must remain available and
+ * unmodified while the view is in use.
+ *
+ * On error, -1 is returned and errno is set appropiately. On success, 0 is
+ * returned.
+ */
+int nfct_view_parse(struct nfct_view *view, const struct nlmsghdr *nlh)
+{
+	assert(view != NULL);
+	assert(nlh != NULL);
+
+	if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct nfgenmsg)) ||
+	    NFNL_SUBSYS_ID(nlh->nlmsg_type) != NFNL_SUBSYS_CTNETLINK) {
+		errno = EINVAL;
+		return -1;
+	}
+	__view_init(view, nlh);
+
+	return 0;
+}
+
+/**
+ * nfct_view_get_attr - get a conntrack attribute from a view
+ * \param view pointer to a valid view
+ * \param type attribute type
+ *
+ * This function returns the same as nfct_get_attr() would for a conntrack
+ * object built out of the same message. Attributes that are stored in the
+ * message in the same format are returned in place, the remaining ones are
+ * converted into storage that belongs to the view, which remains valid
+ * until the same attribute is requested again.
+ *
+ * In case of success a valid pointer to the attribute requested is returned,
+ * on error NULL is returned and errno is set appropiately.
+ */
+const void *nfct_view_get_attr(struct nfct_view *view,
+			       const enum nf_conntrack_attr type)
+{
+	assert(view != NULL);
+
+	if (unlikely(type >= ATTR_MAX)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (!test_bit(type, view->set)) {
+		errno = ENODATA;
+		return NULL;
+	}
+
+	return __view_get_attr(view, type);
+}
+
+/**
+ * nfct_view_get_attr_u8 - get attribute of unsigned 8-bits long from a view
+ * \param view pointer to a valid view
+ * \param type attribute type
+ *
+ * Returns the value of the requested attribute, if the attribute is not
+ * set, 0 is returned.
+ */
+uint8_t nfct_view_get_attr_u8(struct nfct_view *view,
+			      const enum nf_conntrack_attr type)
+{
+	const uint8_t *ret = nfct_view_get_attr(view, type);
+	return ret == NULL ? 0 : *ret;
+}
+
+/**
+ * nfct_view_get_attr_u16 - get attribute of unsigned 16-bits long from a view
+ * \param view pointer to a valid view
+ * \param type attribute type
+ *
+ * Returns the value of the requested attribute, if the attribute is not
+ * set, 0 is returned.
+ */
+uint16_t nfct_view_get_attr_u16(struct nfct_view *view,
+				const enum nf_conntrack_attr type)
+{
+	const uint16_t *ret = nfct_view_get_attr(view, type);
+	return ret == NULL ? 0 : *ret;
+}
+
+/**
+ * nfct_view_get_attr_u32 - get attribute of unsigned 32-bits long from a view
+ * \param view pointer to a valid view
+ * \param type attribute type
+ *
+ * Returns the value of the requested attribute, if the attribute is not
+ * set, 0 is returned.
+ */
+uint32_t nfct_view_get_attr_u32(struct nfct_view *view,
+				const enum nf_conntrack_attr type)
+{
+	const uint32_t *ret = nfct_view_get_attr(view, type);
+	return ret == NULL ? 0 : *ret;
+}
+
+/**
+ * nfct_view_get_attr_u64 - get attribute of unsigned 64-bits long from a view
+ * \param view pointer to a valid view
+ * \param type attribute type
+ *
+ * Returns the value of the requested attribute, if the attribute is not
+ * set, 0 is returned.
+ */
+uint64_t nfct_view_get_attr_u64(struct nfct_view *view,
+				const enum nf_conntrack_attr type)
+{
+	const uint64_t *ret = nfct_view_get_attr(view, type);
+	return ret == NULL ? 0 : *ret;
+}
+
+/**
+ * nfct_view_attr_is_set - check if a certain attribute is in the message
+ * \param view pointer to a valid view
+ * \param type attribute type
+ *
+ * On error, -1 is returned and errno is set appropiately, otherwise
+ * the value of the attribute is returned.
+ */
+int nfct_view_attr_is_set(const struct nfct_view *view,
+			  const enum nf_conntrack_attr type)
+{
+	assert(view != NULL);
+
+	if (unlikely(type >= ATTR_MAX)) {
+		errno = EINVAL;
+		return -1;
+	}
+	return test_bit(type, view->set);
+}
+
 /**
  * @}
  */
@@ -960,6 +1487,7 @@ int nfct_query(struct nfct_handle *h,
 		char buffer[size];
 		struct nfnlhdr req;
 	} u;
+	int ret;
 
 	assert(h != NULL);
 	assert(data != NULL);
@@ -967,7 +1495,13 @@ int nfct_query(struct nfct_handle *h,
 	if (__build_query_ct(h->nfnlssh_ct, qt, data, &u.req, size) == -1)
 		return -1;
 
-	return nfnl_query(h->nfnlh, &u.req.nlh);
+	ret = nfnl_query(h->nfnlh, &u.req.nlh);
+
+	/* deliver what is left of a dump to the batch callback. */
+	if (h->batch_cb && __callback_flush(h) == NFNL_CB_FAILURE)
+		return -1;
+
+	return ret;
 }
 
 /**
@@ -1002,6 +1536,231 @@ int nfct_send(struct nfct_handle *h,
 	return nfnl_send(h->nfnlh, &u.req.nlh);
 }
 
+/**
+ * nfct_query_async - send a query and get its result through nfct_catch()
+ * \param h library handler
+ * \param qt query type
+ * \param data data required to send the query
+ * \param cb completion callback
+ * \param cb_data data that is passed to the completion callback
+ *
+ * Like nfct_send(), this function does not wait for the reply, but it
+ * remembers the sequence number of the request. Once nfct_catch() receives
+ * the ACK or the error for it, the completion callback is called with 0 or
+ * the errno value reported by the kernel. For NFCT_Q_GET, the conntrack
+ * that was received is passed too, it is released once the callback
+ * returns unless the verdict is NFCT_CB_STOLEN. The verdict is handled as
+ * the one of the callback registered to the handle.
+ *
+ * Any number of requests may be in flight, the replies are matched by
+ * their sequence number so that they can arrive in any order, mixed with
+ * events. Since nfct_catch() only returns once a callback tells it to stop,
+ * the completion callback usually returns NFCT_CB_STOP once
+ * nfct_query_async_pending() drops to zero. Do not use nfct_query() on the
+ * same handle while requests are in flight. Requests that are in flight
+ * when the handle is closed are dropped without calling their callback.
+ *
+ * The replies must fit into the receive buffer of the socket until
+ * nfct_catch() gets them, increase it with nfnl_rcvbufsiz() to keep many
+ * requests in flight. If replies are lost anyway, every request in flight
+ * completes with ENOBUFS, whatever its outcome was, the events that are
+ * queued in the socket are discarded and nfct_catch() fails with ENOBUFS.
+ *
+ * Dump queries are not supported, use nfct_query() for them.
+ *
+ * On error, -1 is returned and errno is explicitely set. On success, 0
+ * is returned.
+ */
+int nfct_query_async(struct nfct_handle *h,
+		     const enum nf_conntrack_query qt,
+		     const void *data,
+		     int (*cb)(int error, struct nf_conntrack *ct,
+			       void *cb_data),
+		     void *cb_data)
+{
+	const size_t size = 4096;	/* enough for now */
+	union {
+		char buffer[size];
+		struct nfnlhdr req;
+	} u;
+
+	assert(h != NULL);
+	assert(data != NULL);
+	assert(cb != NULL);
+
+	switch(qt) {
+	case NFCT_Q_DUMP:
+	case NFCT_Q_DUMP_RESET:
+	case NFCT_Q_DUMP_FILTER:
+	case NFCT_Q_DUMP_FILTER_RESET:
+		errno = ENOTSUP;
+		return -1;
+	default:
+		break;
+	}
+
+	if (h->async == NULL) {
+		h->async = __async_create();
+		if (h->async == NULL)
+			return -1;
+	}
+
+	if (__build_query_ct(h->nfnlssh_ct, qt, data, &u.req, size) == -1)
+		return -1;
+
+	return __async_send(h, &u.req, qt, cb, cb_data);
+}
+
+/**
+ * nfct_query_async_pending - number of asynchronous queries in flight
+ * \param h library handler
+ *
+ * See nfct_query_async().
+ */
+unsigned int nfct_query_async_pending(const struct nfct_handle *h)
+{
+	assert(h != NULL);
+
+	return h->async ? __async_pending(h->async) : 0;
+}
+
+/**
+ * nfct_flush_filter - delete the conntracks that match a template
+ * \param h library handler
+ * \param filter dump filter, NULL to dump the whole table
+ * \param tmpl conntrack template, NULL to delete whatever the filter matches
+ * \param flags flags that are passed to nfct_cmp()
+ *
+ * This function dumps the table through a second socket, the dump filter
+ * (see nfct_filter_dump_create()) lets the kernel skip what is clearly out,
+ * then every conntrack is compared with the template via nfct_cmp(). The
+ * matching ones are deleted through this handle while the dump goes on, up
+ * to 64 deletions are in flight at once, see nfct_query_async(). Conntracks
+ * that are gone before their deletion arrives are not an error. The
+ * deletion requests carry the original tuple and the zone, plus the reply
+ * tuple if the zone only applies to the reply direction.
+ *
+ * The callback that was registered to this handle still receives the events
+ * that arrive meanwhile, if any. The asynchronous queries that were in
+ * flight before are completed too.
+ *
+ * On error, -1 is returned and errno is set appropiately, the conntracks
+ * that were deleted so far stay deleted. On success, the number of
+ * conntracks that were deleted is returned.
+ */
+int nfct_flush_filter(struct nfct_handle *h,
+		      const struct nfct_filter_dump *filter,
+		      const struct nf_conntrack *tmpl,
+		      unsigned int flags)
+{
+	assert(h != NULL);
+
+	return __flush_filter(h, filter, tmpl, flags);
+}
+
+/**
+ * nfct_remark_filter - change the mark of the conntracks that match a template
+ * \param h library handler
+ * \param filter dump filter, NULL to dump the whole table
+ * \param tmpl conntrack template, NULL to update whatever the filter matches
+ * \param flags flags that are passed to nfct_cmp()
+ * \param mark new value of the bits of the mark in mask
+ * \param mask bits of the mark that are changed
+ *
+ * This function works like nfct_flush_filter(), but the matching conntracks
+ * are updated instead: the bits of their mark that are set in mask are
+ * replaced with those of mark, the rest are kept. The update requests carry
+ * the tuples and the zone, as the deletion requests of nfct_flush_filter()
+ * do, the new bits of the mark and the mask, so the kernel leaves the other
+ * bits as they are, even if they change meanwhile. Conntracks whose mark
+ * already has the right value are skipped.
+ *
+ * On error, -1 is returned and errno is set appropiately, the conntracks
+ * that were updated so far stay updated. On success, the number of
+ * conntracks that were updated is returned.
+ */
+int nfct_remark_filter(struct nfct_handle *h,
+		       const struct nfct_filter_dump *filter,
+		       const struct nf_conntrack *tmpl,
+		       unsigned int flags,
+		       uint32_t mark, uint32_t mask)
+{
+	assert(h != NULL);
+
+	if (mask == 0)
+		return 0;
+
+	return __rewrite_filter(h, filter, tmpl, flags, mark, mask,
+				NULL, NULL);
+}
+
+/**
+ * nfct_relabel_filter - change the labels of the conntracks that match a
+ * template
+ * \param h library handler
+ * \param filter dump filter, NULL to dump the whole table
+ * \param tmpl conntrack template, NULL to update whatever the filter matches
+ * \param flags flags that are passed to nfct_cmp()
+ * \param set labels to set, NULL for none
+ * \param clear labels to clear, NULL for none
+ *
+ * This function works like nfct_flush_filter(), but the labels of the
+ * matching conntracks are updated instead. The update requests carry the
+ * tuples and the zone, as the deletion requests of nfct_flush_filter() do,
+ * the labels and the mask of the labels that change, so the kernel leaves
+ * the other labels as they are. Conntracks that already have the right
+ * labels are skipped. The conntracks must have room for
+ * labels, which is only the case if labels were in use when they were
+ * created, otherwise the kernel reports ENOSPC.
+ *
+ * On error, -1 is returned and errno is set appropiately, the conntracks
+ * that were updated so far stay updated. On success, the number of
+ * conntracks that were updated is returned.
+ */
+int nfct_relabel_filter(struct nfct_handle *h,
+			const struct nfct_filter_dump *filter,
+			const struct nf_conntrack *tmpl,
+			unsigned int flags,
+			const struct nfct_bitmask *set,
+			const struct nfct_bitmask *clear)
+{
+	assert(h != NULL);
+
+	if (set == NULL && clear == NULL)
+		return 0;
+
+	return __rewrite_filter(h, filter, tmpl, flags, 0, 0, set, clear);
+}
+
+
+/*
+ * Replies to the asynchronous queries were lost. The kernel does not report
+ * further overruns until the socket is drained, so discard what is queued,
+ * events were lost anyway. This happens before the requests in flight fail,
+ * the replies to those that their callbacks send are not discarded.
+ */
+static void async_overrun(struct nfct_handle *h)
+{
+	__rx_drain(h);
+	__async_lost(h);
+	errno = ENOBUFS;
+}
+
+static int __catch(struct nfct_handle *h)
+{
+	if (h->uring)
+		return __uring_catch(h);
+
+	/* the batch callback and the coalescing window are flushed once the
+	 * receive ring is drained, and datagrams are accounted, so we do not
+	 * use nfnl_catch(). */
+	if (h->rx == NULL) {
+		h->rx = __rx_create(1, 0);
+		if (h->rx == NULL)
+			return -1;
+	}
+	return __rx_catch(h);
+}
 
 /**
  * nfct_catch - catch events
@@ -1016,12 +1775,286 @@ int nfct_send(struct nfct_handle *h,
  *
  * Beware that this function also handles expectation events, in case they are
  * received through this handle.
+ *
+ * See nfct_handle_set_rx_batch() to receive several events per system call
+ * and nfct_handle_set_uring() to receive them through io_uring. If the
+ * NFCT_HF_RESYNC flag is set, lost events are recovered via nfct_resync()
+ * instead of failing with ENOBUFS.
  */
 int nfct_catch(struct nfct_handle *h)
 {
+	int ret;
+
 	assert(h != NULL);
 
-	return nfnl_catch(h->nfnlh);
+	while (1) {
+		ret = __catch(h);
+		if (ret == -1 && errno == ENOBUFS) {
+			h->stats.enobufs++;
+			if (h->async)
+				async_overrun(h);
+		}
+		/* events were lost, recover and go on. */
+		if (ret == -1 && errno == ENOBUFS && h->resync) {
+			ret = __resync_run(h);
+			if (ret > NFCT_CB_STOP)
+				continue;
+		}
+		return ret;
+	}
+}
+
+/**
+ * nfct_catch_budget - catch events without blocking, bounded work
+ * \param h library handler
+ * \param max_msgs maximum number of datagrams to process, 0 means no limit
+ * \param max_ns maximum time to spend in nanoseconds, 0 means no limit
+ *
+ * This function processes the events that are already queued in the socket
+ * and invokes the callback that was registered to this handle, like
+ * nfct_catch() does. It never blocks: it returns once the socket has been
+ * drained, max_msgs datagrams have been processed or max_ns nanoseconds
+ * have elapsed, whatever happens first. The time limit is checked between
+ * datagrams, so one datagram may exceed it. This is intended to be called
+ * from an event loop when nfct_fd() is readable.
+ *
+ * Datagrams that were received but not processed yet are kept in the
+ * receive ring (see nfct_handle_set_rx_batch()) for the next call, one
+ * buffer is set up if none was.
+ *
+ * On error, -1 is returned and errno is set appropiately. On success, 1 is
+ * returned if the budget was exhausted and there may be more events to
+ * process, in that case this function should be called again soon, even
+ * if the file descriptor is not readable. Otherwise, 0 is returned: the
+ * socket was drained. If the callback returns NFCT_CB_STOP, this function
+ * returns 1 if received events are left in the ring, otherwise 0.
+ */
+int nfct_catch_budget(struct nfct_handle *h, unsigned int max_msgs,
+		      uint64_t max_ns)
+{
+	int ret;
+
+	assert(h != NULL);
+
+	if (h->uring)
+		ret = __uring_catch_budget(h, max_msgs, max_ns);
+	else {
+		if (h->rx == NULL) {
+			h->rx = __rx_create(1, 0);
+			if (h->rx == NULL)
+				return -1;
+		}
+		ret = __rx_catch_budget(h, max_msgs, max_ns);
+	}
+	if (ret == -1 && errno == ENOBUFS) {
+		h->stats.enobufs++;
+		if (h->async)
+			async_overrun(h);
+	}
+	/* events were lost, recover, there may be more events queued. */
+	if (ret == -1 && errno == ENOBUFS && h->resync) {
+		ret = __resync_run(h);
+		if (ret > NFCT_CB_STOP)
+			return 1;
+		return ret < 0 ? -1 : 0;
+	}
+	return ret;
+}
+
+/**
+ * nfct_resync - report the differences between the table and the events
+ * \param h library handler
+ *
+ * This function dumps the conntrack table through a second socket and
+ * compares it with the conntracks that were reported via events since
+ * NFCT_HF_RESYNC was set (see nfct_handle_set_flags()). The callback that
+ * was registered to this handle receives a synthetic NFCT_T_NEW event for
+ * every conntrack that was not reported yet and a synthetic NFCT_T_DESTROY
+ * event for every conntrack that is gone. nfct_catch() calls this function
+ * once events have been lost. Calling it right after setting the flag
+ * reports the existing conntracks as NFCT_T_NEW events. The filter that is
+ * attached to the socket of the handle, if any, applies to the dump too,
+ * so that conntracks that would not be reported via events are not
+ * reported via this function either. Kernels that cannot give the filter
+ * back (before Linux 3.8) report every conntrack of the dump.
+ *
+ * On error, -1 is returned and errno is set appropiately, EINVAL means that
+ * NFCT_HF_RESYNC is not set. Otherwise, the callback verdict is returned.
+ */
+int nfct_resync(struct nfct_handle *h)
+{
+	assert(h != NULL);
+
+	if (h->resync == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	return __resync_run(h);
+}
+
+/**
+ * nfct_coalesce_flush - pass the events that are held back to the callback
+ * \param h library handler
+ *
+ * This function closes the coalescing window that was set up via
+ * nfct_handle_set_coalesce() and passes the merged events to the callback
+ * that was registered to this handle. If the callback returns NFCT_CB_STOP,
+ * the events that are left are passed in the next flush.
+ *
+ * On error, -1 is returned and errno is set appropiately, EINVAL means that
+ * coalescing is not enabled. Otherwise, the callback verdict is returned.
+ */
+int nfct_coalesce_flush(struct nfct_handle *h)
+{
+	assert(h != NULL);
+
+	if (h->coalesce == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	return __coalesce_flush(h);
+}
+
+/**
+ * @}
+ */
+
+/**
+ * \defgroup table Columnar conntrack table
+ * @{
+ */
+
+/**
+ * nfct_table_new - allocate a new columnar conntrack table
+ *
+ * The table stores one array per column (see enum nfct_table_col) instead
+ * of one object per entry, so that aggregations over a column, such as
+ * adding up the bytes per mark or zone, run over contiguous memory.
+ *
+ * In case of success, this function returns a valid pointer to the table,
+ * otherwise NULL is returned and errno is set appropiately.
+ */
+struct nfct_table *nfct_table_new(void)
+{
+	return __table_new();
+}
+
+/**
+ * nfct_table_destroy - release a columnar conntrack table
+ * \param t pointer to the table
+ */
+void nfct_table_destroy(struct nfct_table *t)
+{
+	assert(t != NULL);
+	__table_destroy(t);
+}
+
+/**
+ * nfct_table_reset - remove all the entries from a table
+ * \param t pointer to the table
+ *
+ * The memory of the columns is kept, so that the table can be filled again
+ * without allocating.
+ */
+void nfct_table_reset(struct nfct_table *t)
+{
+	assert(t != NULL);
+	__table_reset(t);
+}
+
+/**
+ * nfct_table_len - return the number of entries in a table
+ * \param t pointer to the table
+ */
+unsigned int nfct_table_len(const struct nfct_table *t)
+{
+	assert(t != NULL);
+	return __table_len(t);
+}
+
+/**
+ * nfct_table_column - get the array that stores a column
+ * \param t pointer to the table
+ * \param col column (see enum nfct_table_col)
+ *
+ * The array has nfct_table_len() elements of the type that is documented
+ * in enum nfct_table_col. Entries that do not carry the attribute hold zero.
+ * The pointer is valid until the table is modified.
+ *
+ * On error, NULL is returned and errno is set appropiately.
+ */
+const void *nfct_table_column(const struct nfct_table *t,
+			      const enum nfct_table_col col)
+{
+	assert(t != NULL);
+
+	if (unlikely(col >= NFCT_COL_MAX)) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return __table_column(t, col);
+}
+
+/**
+ * nfct_table_add_nlmsg - append a conntrack Netlink message to a table
+ * \param t pointer to the table
+ * \param nlh pointer to the Netlink message
+ *
+ * Use this function to fill a table from your own Netlink socket.
+ *
+ * On error, -1 is returned and errno is set appropiately. On success, 0 is
+ * returned.
+ */
+int nfct_table_add_nlmsg(struct nfct_table *t, const struct nlmsghdr *nlh)
+{
+	assert(t != NULL);
+	assert(nlh != NULL);
+
+	if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct nfgenmsg)) ||
+	    NFNL_SUBSYS_ID(nlh->nlmsg_type) != NFNL_SUBSYS_CTNETLINK) {
+		errno = EINVAL;
+		return -1;
+	}
+	return __table_add(t, nlh);
+}
+
+/**
+ * nfct_table_dump - dump the conntrack table into a columnar table
+ * \param h library handler
+ * \param t pointer to the table
+ * \param family protocol family to dump (AF_INET, AF_INET6 or AF_UNSPEC)
+ *
+ * This function issues a NFCT_Q_DUMP query and appends every entry to the
+ * table, no conntrack object is allocated. The callback registered to the
+ * handle, if any, is not called for the entries of this dump.
+ *
+ * On error, -1 is returned and errno is set appropiately. On success, 0 is
+ * returned.
+ */
+int nfct_table_dump(struct nfct_handle *h, struct nfct_table *t,
+		    uint32_t family)
+{
+	struct nfnl_callback cb = {
+		.call		= __table_callback,
+		.data		= t,
+		.attr_count	= CTA_MAX,
+	};
+	int ret;
+
+	assert(h != NULL);
+	assert(t != NULL);
+
+	nfnl_callback_register(h->nfnlssh_ct, IPCTNL_MSG_CT_NEW, &cb);
+	ret = nfct_query(h, NFCT_Q_DUMP, &family);
+
+	/* restore the callback that was registered, if any. */
+	if (h->nfnl_cb_ct.call)
+		nfnl_callback_register(h->nfnlssh_ct, IPCTNL_MSG_CT_NEW,
+				       &h->nfnl_cb_ct);
+	else
+		nfnl_callback_unregister(h->nfnlssh_ct, IPCTNL_MSG_CT_NEW);
+
+	return ret;
 }
 
 /**
@@ -1224,6 +2257,8 @@ void nfct_copy(struct nf_conntrack *ct1,
 		for (i=0; i<ATTR_MAX; i++) {
 			if (test_bit(i, ct2->head.set)) {
 				assert(copy_attr_array[i]);
+				if (__cold_prepare(ct1, i) < 0)
+					continue;
 				copy_attr_array[i](ct1, ct2);
 				set_bit(i, ct1->head.set);
 			}
@@ -1281,7 +2316,9 @@ void nfct_copy(struct nf_conntrack *ct1,
 	if (flags & NFCT_CP_META) {
 		for (i=ATTR_TCP_STATE; i<ATTR_MAX; i++) {
 			if (test_bit(i, ct2->head.set)) {
-				assert(copy_attr_array[i]),
+				assert(copy_attr_array[i]);
+				if (__cold_prepare(ct1, i) < 0)
+					continue;
 				copy_attr_array[i](ct1, ct2);
 				set_bit(i, ct1->head.set);
 			}
@@ -1303,6 +2340,8 @@ void nfct_copy_attr(struct nf_conntrack *ct1,
 {
 	if (test_bit(type, ct2->head.set)) {
 		assert(copy_attr_array[type]);
+		if (__cold_prepare(ct1, type) < 0)
+			return;
 		copy_attr_array[type](ct1, ct2);
 		set_bit(type, ct1->head.set);
 	}
@@ -1339,7 +2378,14 @@ struct nfct_filter *nfct_filter_create(void)
  */
 void nfct_filter_destroy(struct nfct_filter *filter)
 {
+	int i;
+
 	assert(filter != NULL);
+
+	for (i = 0; i < 2; i++) {
+		free(filter->l3proto[i]);
+		free(filter->l3proto_ipv6[i]);
+	}
 	free(filter);
 	filter = NULL;
 }
@@ -1350,8 +2396,11 @@ void nfct_filter_destroy(struct nfct_filter *filter)
  * \param type filter attribute type
  * \param value pointer to the value of the filter attribute
  *
- * Limitations: You can add up to 127 IPv4 addresses and masks for 
- * NFCT_FILTER_SRC_IPV4 and, similarly, 127 for NFCT_FILTER_DST_IPV4.
+ * There is no limit on the number of IPv4 and IPv6 addresses and masks, but
+ * nfct_filter_attach() fails if the filter does not fit into a BSF program.
+ * That is some 2500 IPv4 addresses, or some 350 IPv6 addresses that share no
+ * prefix, in total. Masks that are prefixes count once merged: prefixes that
+ * others cover are dropped, and adjacent IPv4 prefixes become a single range.
  */
 void nfct_filter_add_attr(struct nfct_filter *filter,
 			  const enum nfct_filter_attr type, 
@@ -1423,9 +2472,10 @@ int nfct_filter_set_logic(struct nfct_filter *filter,
  * \param fd socket descriptor
  * \param filter filter that we want to attach to the socket
  *
- * This function returns -1 on error and set errno appropriately. If the
- * function returns EINVAL probably you have found a bug in it. Please,
- * report this.
+ * This function returns -1 on error and set errno appropriately. E2BIG
+ * means that the filter does not fit into a BSF program, see
+ * nfct_filter_add_attr(). If the function returns EINVAL probably you have
+ * found a bug in it. Please, report this.
  */
 int nfct_filter_attach(int fd, struct nfct_filter *filter)
 {
@@ -1742,6 +2792,27 @@ bool nfct_bitmask_equal(const struct nfct_bitmask *b1, const struct nfct_bitmask
 	return memcmp(b1->bits, b2->bits, b1->words * sizeof(b1->bits[0])) == 0;
 }
 
+/*
+ * nfct_bitmask_set_attr_grp - set the bits of the attributes of a group
+ *
+ * \param b pointer to the bitmask object
+ * \param type attribute group, see enum nf_conntrack_attr_grp
+ *
+ * Bits of enum nf_conntrack_attr values are set, e.g. to build the mask for
+ * nfct_handle_set_parse_mask(). Bits beyond the size of b are ignored.
+ */
+void nfct_bitmask_set_attr_grp(struct nfct_bitmask *b,
+			       enum nf_conntrack_attr_grp type)
+{
+	unsigned int i;
+
+	if (unlikely(type >= ATTR_GRP_MAX))
+		return;
+
+	for (i = 0; i < __NFCT_BITSET && i < b->words; i++)
+		b->bits[i] |= attr_grp_bitmask[type].bitmask[i];
+}
+
 /**
  * @}
  */
@@ -0,0 +1,442 @@
+/*
+ * (C) 2026 by agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "internal/internal.h"
+#include <assert.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <libmnl/libmnl.h>
+
+/*
+ * Batched queries: the messages are built back to back in one buffer and
+ * sent in as few datagrams as the size of the batch allows. The kernel
+ * processes every message of a datagram before sendmsg() returns. Only the
+ * last message of a datagram requests an ACK, the others are only answered
+ * if they fail, so that the replies are one datagram plus one per failure.
+ */
+#define BATCH_SIZE_DEFAULT	16384
+/* room for one message, see nfct_query() */
+#define BATCH_MSG_MAX		4096
+
+struct nfct_batch {
+	struct nfct_handle	*h;
+	size_t			size;
+	uint32_t		seq;
+
+	char			*buf;
+	size_t			len;
+	size_t			cap;
+
+	/* result of every message, see nfct_batch_error() */
+	unsigned int		nmsgs;
+	unsigned int		max;
+	int			*err;
+};
+
+/**
+ * \defgroup batch Batched queries
+ * @{
+ */
+
+/**
+ * nfct_batch_create - allocate a batch of queries
+ * \param h library handler
+ * \param size maximum size of one datagram in bytes, 0 for the default
+ *
+ * Messages that fail are answered with an error report that stays in the
+ * socket receive buffer until the whole datagram is processed. If the
+ * receive buffer cannot hold them, some results are lost, see
+ * nfct_batch_error(). The default size is small enough for the default
+ * receive buffer, increase the latter with nfnl_rcvbufsiz() before you
+ * use larger datagrams.
+ *
+ * The handle should not be subscribed to events, events that arrive while
+ * the batch waits for its replies are discarded.
+ *
+ * In case of success, this function returns a valid pointer to the batch,
+ * otherwise NULL is returned and errno is set appropiately.
+ */
+struct nfct_batch *nfct_batch_create(struct nfct_handle *h, size_t size)
+{
+	struct nfct_batch *b;
+
+	assert(h != NULL);
+
+	if (size == 0)
+		size = BATCH_SIZE_DEFAULT;
+	if (size < BATCH_MSG_MAX) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	b = calloc(1, sizeof(struct nfct_batch));
+	if (b == NULL)
+		return NULL;
+
+	b->h = h;
+	b->size = size;
+	b->seq = time(NULL);
+
+	return b;
+}
+
+/**
+ * nfct_batch_destroy - release a batch of queries
+ * \param b pointer to the batch
+ */
+void nfct_batch_destroy(struct nfct_batch *b)
+{
+	assert(b != NULL);
+
+	free(b->buf);
+	free(b->err);
+	free(b);
+}
+
+/**
+ * nfct_batch_reset - remove all the messages from a batch
+ * \param b pointer to the batch
+ *
+ * The memory is kept, so that the batch can be filled again without
+ * allocating.
+ */
+void nfct_batch_reset(struct nfct_batch *b)
+{
+	assert(b != NULL);
+
+	b->len = 0;
+	b->nmsgs = 0;
+}
+
+/**
+ * nfct_batch_len - return the number of messages in a batch
+ * \param b pointer to the batch
+ */
+unsigned int nfct_batch_len(const struct nfct_batch *b)
+{
+	assert(b != NULL);
+	return b->nmsgs;
+}
+
+static int batch_grow(struct nfct_batch *b)
+{
+	unsigned int max;
+	size_t cap;
+	void *p;
+
+	if (b->cap - b->len < BATCH_MSG_MAX) {
+		cap = b->cap ? b->cap * 2 : b->size;
+		p = realloc(b->buf, cap);
+		if (p == NULL)
+			return -1;
+		b->buf = p;
+		b->cap = cap;
+	}
+	if (b->nmsgs == b->max) {
+		max = b->max ? b->max * 2 : 64;
+		p = realloc(b->err, max * sizeof(int));
+		if (p == NULL)
+			return -1;
+		b->err = p;
+		b->max = max;
+	}
+	return 0;
+}
+
+/* put the headers of a new message at the tail of the batch. */
+static struct nlmsghdr *batch_put(struct nfct_batch *b,
+				  const enum nf_conntrack_query qt,
+				  uint8_t family)
+{
+	struct nlmsghdr *nlh;
+	struct nfgenmsg *nfh;
+	uint16_t type, flags = NLM_F_REQUEST;
+
+	switch(qt) {
+	case NFCT_Q_CREATE:
+		type = IPCTNL_MSG_CT_NEW;
+		flags |= NLM_F_CREATE|NLM_F_EXCL;
+		break;
+	case NFCT_Q_UPDATE:
+		type = IPCTNL_MSG_CT_NEW;
+		break;
+	case NFCT_Q_DESTROY:
+		type = IPCTNL_MSG_CT_DELETE;
+		break;
+	case NFCT_Q_CREATE_UPDATE:
+		type = IPCTNL_MSG_CT_NEW;
+		flags |= NLM_F_CREATE;
+		break;
+	default:
+		errno = ENOTSUP;
+		return NULL;
+	}
+
+	if (b->nmsgs == INT_MAX) {
+		errno = ENOSPC;
+		return NULL;
+	}
+	if (batch_grow(b) < 0)
+		return NULL;
+
+	nlh = mnl_nlmsg_put_header(b->buf + b->len);
+	nlh->nlmsg_type = (NFNL_SUBSYS_CTNETLINK << 8) | type;
+	nlh->nlmsg_flags = flags;
+
+	nfh = mnl_nlmsg_put_extra_header(nlh, sizeof(struct nfgenmsg));
+	nfh->nfgen_family = family;
+	nfh->version = NFNETLINK_V0;
+	nfh->res_id = 0;
+
+	return nlh;
+}
+
+/* the message at the tail is complete. */
+static int batch_commit(struct nfct_batch *b, const struct nlmsghdr *nlh)
+{
+	b->len += NLMSG_ALIGN(nlh->nlmsg_len);
+	b->err[b->nmsgs] = 0;
+
+	return b->nmsgs++;
+}
+
+/**
+ * nfct_batch_add - append a query to a batch
+ * \param b pointer to the batch
+ * \param qt query type
+ * \param ct conntrack object the query refers to
+ *
+ * The query types are NFCT_Q_CREATE, NFCT_Q_UPDATE, NFCT_Q_DESTROY and
+ * NFCT_Q_CREATE_UPDATE, see nfct_query(). The message is built with
+ * nfct_nlmsg_build(), the object can be modified or released afterwards.
+ *
+ * On error, -1 is returned and errno is set appropiately. On success, the
+ * index of the message in the batch is returned, see nfct_batch_error().
+ */
+int nfct_batch_add(struct nfct_batch *b, const enum nf_conntrack_query qt,
+		   const struct nf_conntrack *ct)
+{
+	struct nlmsghdr *nlh;
+
+	assert(b != NULL);
+	assert(ct != NULL);
+
+	nlh = batch_put(b, qt, ct->head.orig.l3protonum);
+	if (nlh == NULL)
+		return -1;
+
+	if (nfct_nlmsg_build(nlh, ct) < 0)
+		return -1;
+
+	return batch_commit(b, nlh);
+}
+
+/**
+ * nfct_batch_add_template - append a query built from a template to a batch
+ * \param b pointer to the batch
+ * \param qt query type
+ * \param t message template, see nfct_template_compile()
+ *
+ * Like nfct_batch_add(), but the message is a copy of the template in its
+ * current state, the template can be patched afterwards.
+ *
+ * On error, -1 is returned and errno is set appropiately. On success, the
+ * index of the message in the batch is returned, see nfct_batch_error().
+ */
+int nfct_batch_add_template(struct nfct_batch *b,
+			    const enum nf_conntrack_query qt,
+			    const struct nfct_template *t)
+{
+	struct nlmsghdr *nlh;
+
+	assert(b != NULL);
+	assert(t != NULL);
+
+	nlh = batch_put(b, qt, nfct_template_family(t));
+	if (nlh == NULL)
+		return -1;
+
+	nfct_template_build(t, nlh);
+
+	return batch_commit(b, nlh);
+}
+
+/*
+ * record the results of the replies to the messages [first, last]. The
+ * kernel processes the datagram before sendmsg() returns, so the replies
+ * are queued already. If the one to the last message is missing, the
+ * kernel gave up at the last failure that it reported, e.g. nfnetlink
+ * rejects a datagram as a whole with EPERM, the messages after it were
+ * not processed and report the same error.
+ */
+static int batch_recv(struct nfct_batch *b, unsigned int first,
+		      unsigned int last)
+{
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	int fd = nfnl_fd(b->h->nfnlh);
+	int lost = 0, done = 0, err;
+	const struct nlmsghdr *nlh;
+	const struct nlmsgerr *e;
+	unsigned int i;
+	int ret;
+
+	while (!done) {
+		ret = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == ENOBUFS) {
+				/* pick up whatever is left. */
+				lost = 1;
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -1;
+		}
+
+		nlh = (const struct nlmsghdr *)buf;
+		for (; mnl_nlmsg_ok(nlh, ret); nlh = mnl_nlmsg_next(nlh, &ret)) {
+			if (nlh->nlmsg_type != NLMSG_ERROR ||
+			    nlh->nlmsg_len < NLMSG_LENGTH(sizeof(*e)))
+				continue;
+
+			e = mnl_nlmsg_get_payload(nlh);
+			i = e->msg.nlmsg_seq - b->seq;
+			if (i < first || i > last)
+				continue;
+
+			b->err[i] = -e->error;
+			if (i == last)
+				done = 1;
+		}
+	}
+
+	/* failures whose report was dropped look like successes. */
+	if (lost) {
+		for (i = first; i <= last; i++) {
+			if (b->err[i] == 0 && !(i == last && done))
+				b->err[i] = ENOBUFS;
+		}
+	} else if (!done) {
+		for (i = last; i > first && b->err[i] == 0; i--)
+			;
+		err = b->err[i] ? b->err[i++] : EIO;
+		for (; i <= last; i++)
+			b->err[i] = err;
+	}
+	return 0;
+}
+
+/**
+ * nfct_batch_send - send a batch of queries and wait for the results
+ * \param b pointer to the batch
+ *
+ * Every datagram is sent with one sendmsg() call, then the replies to it
+ * are collected before the next one is sent. The messages stay in the
+ * batch, use nfct_batch_reset() to fill it again.
+ *
+ * On error, -1 is returned and errno is set appropiately, the messages
+ * that were not sent report the same error. Otherwise, the number of
+ * messages that failed is returned.
+ */
+int nfct_batch_send(struct nfct_batch *b)
+{
+	struct sockaddr_nl snl = {
+		.nl_family	= AF_NETLINK,
+	};
+	struct iovec iov;
+	struct msghdr msg = {
+		.msg_name	= &snl,
+		.msg_namelen	= sizeof(snl),
+		.msg_iov	= &iov,
+		.msg_iovlen	= 1,
+	};
+	struct nlmsghdr *nlh, *last;
+	unsigned int i, first, failed = 0;
+	size_t off = 0, len;
+	int fd;
+
+	assert(b != NULL);
+
+	fd = nfnl_fd(b->h->nfnlh);
+
+	/* a new sequence space, replies to earlier sends do not match. */
+	b->seq += b->nmsgs;
+
+	for (i = 0; i < b->nmsgs; ) {
+		first = i;
+		len = 0;
+		last = NULL;
+
+		/* as many messages as fit into one datagram. */
+		while (i < b->nmsgs) {
+			nlh = (struct nlmsghdr *)(b->buf + off + len);
+			if (len && len + nlh->nlmsg_len > b->size)
+				break;
+
+			nlh->nlmsg_seq = b->seq + i;
+			nlh->nlmsg_flags &= ~NLM_F_ACK;
+			b->err[i] = 0;
+			len += NLMSG_ALIGN(nlh->nlmsg_len);
+			last = nlh;
+			i++;
+		}
+		last->nlmsg_flags |= NLM_F_ACK;
+
+		iov.iov_base = b->buf + off;
+		iov.iov_len = len;
+		off += len;
+
+		while (sendmsg(fd, &msg, 0) == -1) {
+			if (errno == EINTR)
+				continue;
+			for (i = first; i < b->nmsgs; i++)
+				b->err[i] = errno;
+			return -1;
+		}
+
+		if (batch_recv(b, first, i - 1) < 0) {
+			for (; first < b->nmsgs; first++)
+				b->err[first] = errno;
+			return -1;
+		}
+	}
+
+	for (i = 0; i < b->nmsgs; i++) {
+		if (b->err[i])
+			failed++;
+	}
+	return failed;
+}
+
+/**
+ * nfct_batch_error - get the result of one message of a batch
+ * \param b pointer to the batch
+ * \param index index of the message, as returned by nfct_batch_add()
+ *
+ * This function returns 0 if the message succeeded, otherwise the errno
+ * value that the kernel reported for it. ENOBUFS means that the result was
+ * lost because the socket receive buffer was full. If the kernel stops
+ * processing a datagram at a failure, such as EPERM without privileges,
+ * the messages after it in the datagram report the same error.
+ */
+int nfct_batch_error(const struct nfct_batch *b, unsigned int index)
+{
+	assert(b != NULL);
+
+	if (index >= b->nmsgs)
+		return EINVAL;
+
+	return b->err[index];
+}
+
+/**
+ * @}
+ */
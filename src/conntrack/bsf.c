@@ -178,25 +178,6 @@ nfct_bsf_cmp_k_stack(struct sock_filter *this, int k,
 	return NEW_POS(__code);
 }
 
-/* like previous, but use jf instead of jt. We can merge both functions */
-static int
-nfct_bsf_cmp_k_stack_jf(struct sock_filter *this, int k,
-			int jump_false, int pos, struct stack *s)
-{
-	struct sock_filter __code = {
-		.code	= BPF_JMP|BPF_JEQ|BPF_K,
-		.k	= k,
-	};
-	struct jump jmp = {
-		.line	= pos,
-		.jt	= 0,
-		.jf	= jump_false - 1,
-	};
-	stack_push(s, &jmp);
-	memcpy(&this[pos], &__code, sizeof(__code));
-	return NEW_POS(__code);
-}
-
 static int
 nfct_bsf_alu_and(struct sock_filter *this, int k, int pos)
 {
@@ -253,19 +234,6 @@ nfct_bsf_load_attr(struct sock_filter *this, int word_size, int pos)
 	return NEW_POS(__code);
 }
 
-static int
-nfct_bsf_load_attr_offset(struct sock_filter *this, int word_size,
-			  int offset, int pos)
-{
-	struct sock_filter __code = {
-		/* A = skb->data[X + k:word_size] */
-		.code	= BPF_LD|word_size|BPF_IND,
-		.k	= sizeof(struct nfattr) + offset,
-	};
-	memcpy(&this[pos], &__code, sizeof(__code));
-	return NEW_POS(__code);
-}
-
 static int
 nfct_bsf_ret_verdict(struct sock_filter *this, int verdict, int pos)
 {
@@ -484,203 +452,676 @@ bsf_add_proto_filter(const struct nfct_filter *f, struct sock_filter *this)
 	return j;
 }
 
-static int
-bsf_add_addr_ipv4_filter(const struct nfct_filter *f,
-		         struct sock_filter *this,
-			 unsigned int type)
+/*
+ * Address filters are compiled into a decision tree. The addresses whose
+ * mask is a prefix are merged first, as a prefix trie would do: prefixes
+ * that others cover are dropped, two halves of a prefix become that prefix.
+ * IPv4 prefixes are then a sorted list of disjoint ranges, that a binary
+ * tree of BPF_JGT comparisons searches at once, whatever their masks. The
+ * rest of the addresses are grouped by mask and sorted, then every group is
+ * searched via a binary tree whose leaves are short chains of BPF_JEQ. IPv6
+ * addresses are searched one word after another. The comparisons can only
+ * jump 255 lines ahead, whatever may be further away is reached through a
+ * BPF_JA trampoline, which has a 32 bits offset.
+ */
+#define BSF_TREE_LEAF	8
+
+struct bsf_key {
+	uint32_t	mask[4];
+	uint32_t	addr[4];
+};
+
+struct bsf_range {
+	uint32_t	lo;
+	uint32_t	hi;
+};
+
+struct bsf_tree {
+	struct sock_filter	*code;
+	unsigned int		len;
+	unsigned int		size;
+	unsigned int		words;
+	/* trampolines to the match label, patched once it is known */
+	unsigned int		*match;
+	unsigned int		match_len;
+};
+
+/* lines beyond the size are counted but not written, see the caller. */
+static unsigned int tree_emit(struct bsf_tree *t, uint16_t code,
+			      uint8_t jt, uint8_t jf, uint32_t k)
 {
-	unsigned int i, j, dir, attr;
-	unsigned int label_continue, jt;
-	struct stack *s;
-	struct jump jmp;
+	if (t->len < t->size) {
+		t->code[t->len].code = code;
+		t->code[t->len].jt = jt;
+		t->code[t->len].jf = jf;
+		t->code[t->len].k = k;
+	}
+	return t->len++;
+}
+
+static unsigned int tree_ja(struct bsf_tree *t)
+{
+	return tree_emit(t, BPF_JMP|BPF_JA, 0, 0, 0);
+}
+
+static void tree_patch(struct bsf_tree *t, unsigned int line,
+		       unsigned int target)
+{
+	if (line < t->size)
+		t->code[line].k = target - line - 1;
+}
+
+static void tree_ja_match(struct bsf_tree *t)
+{
+	t->match[t->match_len++] = tree_ja(t);
+}
+
+/* next word of the address that the mask does not clear, if any. */
+static unsigned int
+tree_next_word(const struct bsf_tree *t, const struct bsf_key *key,
+	       unsigned int w)
+{
+	while (w < t->words && key->mask[w] == 0)
+		w++;
+	return w;
+}
+
+/* A = word w of the address, X holds the offset of the attribute. */
+static void tree_load(struct bsf_tree *t, const struct bsf_key *key,
+		      unsigned int w)
+{
+	tree_emit(t, BPF_LD|BPF_W|BPF_IND, 0, 0,
+		  sizeof(struct nfattr) + w * sizeof(uint32_t));
+	if (key->mask[w] != 0xffffffff)
+		tree_emit(t, BPF_ALU|BPF_AND|BPF_K, 0, 0, key->mask[w]);
+}
+
+/* the leaves are full but the last one, so that there are few nodes. */
+static unsigned int tree_half(unsigned int n)
+{
+	return ((n + BSF_TREE_LEAF - 1) / BSF_TREE_LEAF / 2) * BSF_TREE_LEAF;
+}
+
+/* number of lines that tree_search() emits. */
+static unsigned int tree_search_len(unsigned int n, int tramp)
+{
+	unsigned int half, left;
+
+	if (n <= BSF_TREE_LEAF)
+		return tramp ? 2 * n : n + 1;
+
+	half = tree_half(n);
+	left = tree_search_len(half, tramp);
+
+	return 1 + (left + 1 > 255) + left + 1 +
+	       tree_search_len(n - half, tramp);
+}
+
+/*
+ * Search A in the sorted values, the program goes on at the trampoline
+ * tramp[i] if A is v[i], or at the match label if there are no trampolines.
+ * Otherwise, it falls through.
+ */
+static void tree_search(struct bsf_tree *t, const uint32_t *v, unsigned int n,
+			unsigned int *tramp)
+{
+	unsigned int i, half, left, right = 0, end;
+
+	if (n <= BSF_TREE_LEAF) {
+		/* the last comparison falls through to its trampoline, the
+		 * others are n lines ahead, or all share the match one. */
+		for (i = 0; i < n - 1; i++)
+			tree_emit(t, BPF_JMP|BPF_JEQ|BPF_K,
+				  tramp ? n : n - i - 1, 0, v[i]);
+		tree_emit(t, BPF_JMP|BPF_JEQ|BPF_K, 0, tramp ? n : 1, v[i]);
+		if (tramp == NULL) {
+			tree_ja_match(t);
+			return;
+		}
+		tramp[n - 1] = tree_ja(t);
+		for (i = 0; i < n - 1; i++)
+			tramp[i] = tree_ja(t);
+		return;
+	}
+
+	half = tree_half(n);
+	left = tree_search_len(half, tramp != NULL);
+	if (left + 1 <= 255) {
+		tree_emit(t, BPF_JMP|BPF_JGT|BPF_K, left + 1, 0, v[half - 1]);
+	} else {
+		tree_emit(t, BPF_JMP|BPF_JGT|BPF_K, 0, 1, v[half - 1]);
+		right = tree_ja(t);
+	}
+	tree_search(t, v, half, tramp);
+	end = tree_ja(t);
+	if (right)
+		tree_patch(t, right, t->len);
+	tree_search(t, v + half, n - half, tramp ? tramp + half : NULL);
+	tree_patch(t, end, t->len);
+}
+
+/* number of lines that tree_range() emits. */
+static unsigned int tree_range_len(const struct bsf_range *r, unsigned int n)
+{
+	unsigned int i, half, left, len = 1;
+
+	if (n <= BSF_TREE_LEAF) {
+		for (i = 0; i < n; i++)
+			len += r[i].lo == r[i].hi ? 1 : 2;
+		return len;
+	}
+
+	half = tree_half(n);
+	left = tree_range_len(r, half);
+
+	return 1 + (left + 1 > 255) + left + 1 +
+	       tree_range_len(r + half, n - half);
+}
+
+/*
+ * Search A in the sorted and disjoint ranges, the program goes on at the
+ * match label if A is in any of them. Otherwise, it falls through.
+ */
+static void tree_range(struct bsf_tree *t, const struct bsf_range *r,
+		       unsigned int n)
+{
+	unsigned int i, half, left, right = 0, end, line, next, match = 0;
+
+	if (n <= BSF_TREE_LEAF) {
+		/* the match trampoline follows the comparisons. */
+		for (i = 0; i < n; i++)
+			match += r[i].lo == r[i].hi ? 1 : 2;
+
+		for (i = 0, line = 0; i < n; i++, line = next) {
+			next = line + (r[i].lo == r[i].hi ? 1 : 2);
+			if (i == n - 1)
+				next = match + 1;
+
+			if (r[i].lo == r[i].hi) {
+				tree_emit(t, BPF_JMP|BPF_JEQ|BPF_K,
+					  match - line - 1, next - line - 1,
+					  r[i].lo);
+				continue;
+			}
+			tree_emit(t, BPF_JMP|BPF_JGT|BPF_K,
+				  next - line - 1, 0, r[i].hi);
+			line++;
+			tree_emit(t, BPF_JMP|BPF_JGE|BPF_K,
+				  match - line - 1, next - line - 1, r[i].lo);
+		}
+		tree_ja_match(t);
+		return;
+	}
+
+	half = tree_half(n);
+	left = tree_range_len(r, half);
+	if (left + 1 <= 255) {
+		tree_emit(t, BPF_JMP|BPF_JGT|BPF_K, left + 1, 0, r[half - 1].hi);
+	} else {
+		tree_emit(t, BPF_JMP|BPF_JGT|BPF_K, 0, 1, r[half - 1].hi);
+		right = tree_ja(t);
+	}
+	tree_range(t, r, half);
+	end = tree_ja(t);
+	if (right)
+		tree_patch(t, right, t->len);
+	tree_range(t, r + half, n - half);
+	tree_patch(t, end, t->len);
+}
+
+/*
+ * Match the keys, which only differ from word w on, A holds that word. The
+ * program falls through if none matches.
+ */
+static int tree_word(struct bsf_tree *t, const struct bsf_key *keys,
+		     unsigned int n, unsigned int w)
+{
+	unsigned int i, r, next, *start, *tramp, jeq[4], njeq = 0;
+	uint32_t *v;
+	int ret = 0;
+
+	/* only one is left, compare what is left of it. */
+	if (n == 1) {
+		for (i = w; i < t->words; i = tree_next_word(t, keys, i + 1)) {
+			if (i > w)
+				tree_load(t, keys, i);
+			jeq[njeq++] = tree_emit(t, BPF_JMP|BPF_JEQ|BPF_K,
+						0, 0, keys->addr[i]);
+		}
+		tree_ja_match(t);
+		for (i = 0; i < njeq; i++) {
+			if (jeq[i] < t->size)
+				t->code[jeq[i]].jf = t->len - jeq[i] - 1;
+		}
+		return 0;
+	}
+
+	/* the keys are sorted, those that share word w are contiguous. */
+	v = malloc(n * sizeof(uint32_t));
+	start = malloc((n + 1) * sizeof(unsigned int));
+	tramp = malloc(n * sizeof(unsigned int));
+	if (v == NULL || start == NULL || tramp == NULL) {
+		errno = ENOMEM;
+		ret = -1;
+		goto out;
+	}
+	for (i = 0, r = 0; i < n; i++) {
+		if (i > 0 && keys[i].addr[w] == v[r - 1])
+			continue;
+		v[r] = keys[i].addr[w];
+		start[r++] = i;
+	}
+	start[r] = n;
+
+	next = tree_next_word(t, keys, w + 1);
+	if (next == t->words) {
+		/* this is the last word, the keys are distinct. */
+		tree_search(t, v, r, NULL);
+		goto out;
+	}
+
+	tree_search(t, v, r, tramp);
+	/* no match, skip what follows: reuse tramp[] for these jumps. */
+	for (i = 0; i < r; i++) {
+		unsigned int skip = tree_ja(t);
+
+		tree_patch(t, tramp[i], t->len);
+		tramp[i] = skip;
+		tree_load(t, &keys[start[i]], next);
+		ret = tree_word(t, keys + start[i], start[i + 1] - start[i],
+				next);
+		if (ret < 0)
+			goto out;
+	}
+	for (i = 0; i < r; i++)
+		tree_patch(t, tramp[i], t->len);
+out:
+	free(v);
+	free(start);
+	free(tramp);
+	return ret;
+}
+
+static int bsf_key_cmp(const void *a, const void *b)
+{
+	const struct bsf_key *ka = a, *kb = b;
+	unsigned int i;
+
+	for (i = 0; i < 4; i++) {
+		if (ka->mask[i] != kb->mask[i])
+			return ka->mask[i] < kb->mask[i] ? -1 : 1;
+	}
+	for (i = 0; i < 4; i++) {
+		if (ka->addr[i] != kb->addr[i])
+			return ka->addr[i] < kb->addr[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+/* word w of the mask of a prefix that is p bits long. */
+static uint32_t bsf_prefix_word(unsigned int p, unsigned int w)
+{
+	if (p >= (w + 1) * 32)
+		return 0xffffffff;
+	if (p <= w * 32)
+		return 0;
+	return 0xffffffff << ((w + 1) * 32 - p);
+}
+
+/* length of the prefix, or -1 if the mask is not a prefix. */
+static int bsf_prefix_len(const struct bsf_key *key, unsigned int words)
+{
+	unsigned int w, p = 0;
+
+	while (p < words * 32 && key->mask[p / 32] & (1U << (31 - p % 32)))
+		p++;
+
+	for (w = 0; w < words; w++) {
+		if (key->mask[w] != bsf_prefix_word(p, w))
+			return -1;
+	}
+	return p;
+}
+
+/* by address first, the shorter prefix first if the address is the same. */
+static int bsf_prefix_cmp(const void *a, const void *b)
+{
+	const struct bsf_key *ka = a, *kb = b;
+	unsigned int i;
+
+	for (i = 0; i < 4; i++) {
+		if (ka->addr[i] != kb->addr[i])
+			return ka->addr[i] < kb->addr[i] ? -1 : 1;
+	}
+	for (i = 0; i < 4; i++) {
+		if (ka->mask[i] != kb->mask[i])
+			return ka->mask[i] < kb->mask[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+/* the prefix a covers the prefix b. */
+static int bsf_prefix_covers(const struct bsf_key *a, const struct bsf_key *b,
+			     unsigned int words)
+{
+	unsigned int w;
+
+	for (w = 0; w < words; w++) {
+		if ((a->mask[w] & b->mask[w]) != a->mask[w] ||
+		    (b->addr[w] & a->mask[w]) != a->addr[w])
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * The keys are prefixes. Those that others cover are dropped, two halves of
+ * a prefix become that prefix, as in a trie whose nodes are merged once both
+ * children are full. The sorted keys visit that trie in order, thus the
+ * prefixes that are left after them are kept in a stack. They are disjoint
+ * and sorted by address, their number is returned.
+ */
+static unsigned int bsf_prefix_merge(struct bsf_key *key, unsigned int n,
+				     unsigned int words)
+{
+	unsigned int i, w, top = 0;
+	struct bsf_key *a, *b;
+	int p;
+
+	qsort(key, n, sizeof(struct bsf_key), bsf_prefix_cmp);
+
+	for (i = 0; i < n; i++) {
+		if (top > 0 && bsf_prefix_covers(&key[top - 1], &key[i], words))
+			continue;
+		key[top++] = key[i];
+
+		while (top > 1) {
+			a = &key[top - 2];
+			b = &key[top - 1];
+			p = bsf_prefix_len(b, words);
+			if (p == 0 || memcmp(a->mask, b->mask, sizeof(a->mask)))
+				break;
+			for (w = 0; w < words; w++) {
+				if ((a->addr[w] ^ b->addr[w]) &
+				    bsf_prefix_word(p - 1, w))
+					break;
+			}
+			if (w < words)
+				break;
+			/* a is the lower half, thus it is the parent. */
+			for (w = 0; w < words; w++)
+				a->mask[w] = bsf_prefix_word(p - 1, w);
+			top--;
+		}
+	}
+	return top;
+}
+
+/*
+ * Masked keys: the merged prefixes come first, nprefix of them, then the
+ * rest sorted and unique. The number of keys is returned.
+ */
+static int bsf_addr_keys(const struct nfct_filter *f, unsigned int type,
+			 struct bsf_key **keys, unsigned int *nprefix)
+{
+	unsigned int i, k, n, p, dir, words;
+	struct bsf_key *key, tmp;
 
 	switch(type) {
 	case CTA_IP_V4_SRC:
-		dir = __FILTER_ADDR_SRC;
-		attr = NFCT_FILTER_SRC_IPV4;
-		break;
 	case CTA_IP_V4_DST:
-		dir = __FILTER_ADDR_DST;
-		attr = NFCT_FILTER_DST_IPV4;
+		dir = type == CTA_IP_V4_SRC ? __FILTER_ADDR_SRC :
+					      __FILTER_ADDR_DST;
+		n = f->l3proto_elems[dir];
+		words = 1;
 		break;
 	default:
-		return 0;
+		dir = type == CTA_IP_V6_SRC ? __FILTER_ADDR_SRC :
+					      __FILTER_ADDR_DST;
+		n = f->l3proto_elems_ipv6[dir];
+		words = 4;
+		break;
 	}
-
-	/* nothing to filter, skip */
-	if (f->l3proto_elems[dir] == 0)
+	if (n == 0)
 		return 0;
 
-	/* XXX: 127 maximum IPs + 3 jumps in the three-level iteration */
-	s = stack_create(sizeof(struct jump), 3 + 127);
-	if (s == NULL) {
+	key = calloc(n, sizeof(struct bsf_key));
+	if (key == NULL) {
 		errno = ENOMEM;
 		return -1;
 	}
 
-	jt = 1;
-	if (f->logic[attr] == NFCT_FILTER_LOGIC_POSITIVE)
-		label_continue = 1;
-	else
-		label_continue = 2;
-
-	j = 0;
-	j += nfct_bsf_load_payload_offset(this, j);
-	j += nfct_bsf_find_attr(this, CTA_TUPLE_ORIG, j);
-	j += nfct_bsf_cmp_k_stack(this, 0, label_continue - j, j, s);
-	j += nfct_bsf_add_attr_data_offset(this, j);
-	j += nfct_bsf_find_attr(this, CTA_TUPLE_IP, j);
-	j += nfct_bsf_cmp_k_stack(this, 0, label_continue - j, j, s);
-	j += nfct_bsf_add_attr_data_offset(this, j);
-	j += nfct_bsf_find_attr(this, type, j);
-	j += nfct_bsf_cmp_k_stack(this, 0, label_continue - j, j, s);
-	j += nfct_bsf_x_equal_a(this, j);
-
-	for (i = 0; i < f->l3proto_elems[dir]; i++) {
-		int ip = f->l3proto[dir][i].addr & f->l3proto[dir][i].mask;
-
-		j += nfct_bsf_load_attr(this, BPF_W, j);
-		j += nfct_bsf_alu_and(this, f->l3proto[dir][i].mask, j);
-		j += nfct_bsf_cmp_k_stack(this, ip, jt - j, j, s);
+	for (i = 0; i < n; i++) {
+		if (type == CTA_IP_V4_SRC || type == CTA_IP_V4_DST) {
+			key[i].mask[0] = f->l3proto[dir][i].mask;
+			key[i].addr[0] = f->l3proto[dir][i].addr &
+					 f->l3proto[dir][i].mask;
+			continue;
+		}
+		for (k = 0; k < 4; k++) {
+			key[i].mask[k] = f->l3proto_ipv6[dir][i].mask[k];
+			key[i].addr[k] = f->l3proto_ipv6[dir][i].addr[k] &
+					 f->l3proto_ipv6[dir][i].mask[k];
+		}
 	}
 
-	while (stack_pop(s, &jmp) != -1)
-		this[jmp.line].jt += jmp.jt + j;
-
-	if (f->logic[attr] == NFCT_FILTER_LOGIC_NEGATIVE)
-		j += nfct_bsf_jump_to(this, 1, j);
+	for (i = 0, p = 0; i < n; i++) {
+		if (bsf_prefix_len(&key[i], words) < 0)
+			continue;
+		tmp = key[p];
+		key[p++] = key[i];
+		key[i] = tmp;
+	}
+	*nprefix = bsf_prefix_merge(key, p, words);
 
-	j += nfct_bsf_ret_verdict(this, NFCT_FILTER_REJECT, j);
+	memmove(key + *nprefix, key + p, (n - p) * sizeof(struct bsf_key));
+	n -= p - *nprefix;
 
-	stack_destroy(s);
+	qsort(key + *nprefix, n - *nprefix, sizeof(struct bsf_key),
+	      bsf_key_cmp);
+	for (i = *nprefix, k = i; i < n; i++) {
+		if (k == *nprefix || bsf_key_cmp(&key[k - 1], &key[i]) != 0)
+			key[k++] = key[i];
+	}
 
-	return j;
+	*keys = key;
+	return k;
 }
 
-static int
-bsf_add_saddr_ipv4_filter(const struct nfct_filter *f, struct sock_filter *this)
+/* the IPv4 prefixes as ranges, those that are adjacent are merged. */
+static unsigned int bsf_addr_ranges(const struct bsf_key *key, unsigned int n,
+				    struct bsf_range *r)
 {
-	return bsf_add_addr_ipv4_filter(f, this, CTA_IP_V4_SRC);
+	unsigned int i, len = 0;
+
+	for (i = 0; i < n; i++) {
+		if (len > 0 && r[len - 1].hi != 0xffffffff &&
+		    r[len - 1].hi + 1 == key[i].addr[0]) {
+			r[len - 1].hi = key[i].addr[0] | ~key[i].mask[0];
+			continue;
+		}
+		r[len].lo = key[i].addr[0];
+		r[len].hi = key[i].addr[0] | ~key[i].mask[0];
+		len++;
+	}
+	return len;
 }
 
-static int 
-bsf_add_daddr_ipv4_filter(const struct nfct_filter *f, struct sock_filter *this)
+/* if A == 0, the attribute is not there: jump to the trampoline. */
+static unsigned int tree_missing(struct bsf_tree *t)
 {
-	return bsf_add_addr_ipv4_filter(f, this, CTA_IP_V4_DST);
+	tree_emit(t, BPF_JMP|BPF_JEQ|BPF_K, 0, 1, 0);
+	return tree_ja(t);
 }
 
 static int
-bsf_add_addr_ipv6_filter(const struct nfct_filter *f,
-		         struct sock_filter *this,
-			 unsigned int type)
+bsf_add_addr_filter(const struct nfct_filter *f,
+		    struct sock_filter *this,
+		    unsigned int size,
+		    unsigned int type)
 {
-	unsigned int i, j, dir, attr;
-	unsigned int label_continue, jf;
-	struct stack *s;
-	struct jump jmp;
+	struct bsf_tree t = {
+		.code	= this,
+		.size	= size,
+	};
+	unsigned int i, g, w, attr, label_continue, missing[3], nprefix;
+	unsigned int nrange = 0;
+	struct bsf_range *range = NULL;
+	struct bsf_key *keys;
+	int n, ret = 0;
 
 	switch(type) {
+	case CTA_IP_V4_SRC:
+		attr = NFCT_FILTER_SRC_IPV4;
+		t.words = 1;
+		break;
+	case CTA_IP_V4_DST:
+		attr = NFCT_FILTER_DST_IPV4;
+		t.words = 1;
+		break;
 	case CTA_IP_V6_SRC:
-		dir = __FILTER_ADDR_SRC;
 		attr = NFCT_FILTER_SRC_IPV6;
+		t.words = 4;
 		break;
 	case CTA_IP_V6_DST:
-		dir = __FILTER_ADDR_DST;
 		attr = NFCT_FILTER_DST_IPV6;
+		t.words = 4;
 		break;
 	default:
 		return 0;
 	}
 
-	/* nothing to filter, skip */
-	if (f->l3proto_elems_ipv6[dir] == 0)
-		return 0;
+	n = bsf_addr_keys(f, type, &keys, &nprefix);
+	if (n <= 0)
+		return n;
 
-	/* XXX: 80 jumps (4*20) + 3 jumps in the three-level iteration */
-	s = stack_create(sizeof(struct jump), 3 + 80);
-	if (s == NULL) {
+	if (t.words == 1) {
+		range = calloc(nprefix + 1, sizeof(struct bsf_range));
+		if (range == NULL) {
+			free(keys);
+			errno = ENOMEM;
+			return -1;
+		}
+		nrange = bsf_addr_ranges(keys, nprefix, range);
+	} else {
+		/* the prefixes go along with the rest. */
+		qsort(keys, n, sizeof(struct bsf_key), bsf_key_cmp);
+		nprefix = 0;
+	}
+
+	/* at most one trampoline to the match label per key. */
+	t.match = calloc(n, sizeof(unsigned int));
+	if (t.match == NULL) {
+		free(range);
+		free(keys);
 		errno = ENOMEM;
 		return -1;
 	}
 
-	jf = 1;
-	if (f->logic[attr] == NFCT_FILTER_LOGIC_POSITIVE) {
+	if (f->logic[attr] == NFCT_FILTER_LOGIC_POSITIVE)
 		label_continue = 1;
-	} else {
+	else
 		label_continue = 2;
-	}
-
-	j = 0;
-	j += nfct_bsf_load_payload_offset(this, j);
-	j += nfct_bsf_find_attr(this, CTA_TUPLE_ORIG, j);
-	j += nfct_bsf_cmp_k_stack(this, 0, label_continue - j, j, s);
-	/* no need to access attribute payload, we are using nest-based finder
-	 * j += nfct_bsf_add_attr_data_offset(this, j); */
-	j += nfct_bsf_find_attr_nest(this, CTA_TUPLE_IP, j);
-	j += nfct_bsf_cmp_k_stack(this, 0, label_continue - j, j, s);
-	j += nfct_bsf_find_attr_nest(this, type, j);
-	j += nfct_bsf_cmp_k_stack(this, 0, label_continue - j, j, s);
-	j += nfct_bsf_x_equal_a(this, j);
 
-	for (i = 0; i < f->l3proto_elems_ipv6[dir]; i++) {
-		int k, offset;
-
-		for (k = 0, offset = 0; k < 4; k++, offset += 4) {
-			int ip = f->l3proto_ipv6[dir][i].addr[k] &
-				 f->l3proto_ipv6[dir][i].mask[k];
-
-			j += nfct_bsf_load_attr_offset(this, BPF_W, offset, j);
-			j += nfct_bsf_alu_and(this,
-					      f->l3proto_ipv6[dir][i].mask[k],
-					      j);
-			if (k < 3) {
-				j += nfct_bsf_cmp_k_stack_jf(this, ip,
-						jf - j - 1,
-						j, s);
-			} else {
-				/* last word: jump if true */
-				j += nfct_bsf_cmp_k_stack(this, ip, jf - j,
-							  j, s);
-			}
-		}
+	/* the lookup of the attribute, tree_emit() would do as well. */
+	t.len += nfct_bsf_load_payload_offset(this, t.len);
+	t.len += nfct_bsf_find_attr(this, CTA_TUPLE_ORIG, t.len);
+	missing[0] = tree_missing(&t);
+	if (t.words == 1) {
+		t.len += nfct_bsf_add_attr_data_offset(this, t.len);
+		t.len += nfct_bsf_find_attr(this, CTA_TUPLE_IP, t.len);
+		missing[1] = tree_missing(&t);
+		t.len += nfct_bsf_add_attr_data_offset(this, t.len);
+		t.len += nfct_bsf_find_attr(this, type, t.len);
+	} else {
+		/* no need to access attribute payload, we are using
+		 * nest-based finder */
+		t.len += nfct_bsf_find_attr_nest(this, CTA_TUPLE_IP, t.len);
+		missing[1] = tree_missing(&t);
+		t.len += nfct_bsf_find_attr_nest(this, type, t.len);
 	}
-
-	while (stack_pop(s, &jmp) != -1) {
-		if (jmp.jt) {
-			this[jmp.line].jt += jmp.jt + j;
+	missing[2] = tree_missing(&t);
+	t.len += nfct_bsf_x_equal_a(this, t.len);
+
+	/* one tree for the ranges, then one per mask, each falls through to
+	 * the next one. */
+	if (nrange > 0) {
+		tree_emit(&t, BPF_LD|BPF_W|BPF_IND, 0, 0, sizeof(struct nfattr));
+		tree_range(&t, range, nrange);
+	}
+	for (i = nprefix; i < (unsigned int)n; i = g) {
+		for (g = i + 1; g < (unsigned int)n; g++) {
+			if (memcmp(keys[g].mask, keys[i].mask,
+				   sizeof(keys[i].mask)) != 0)
+				break;
 		}
-		if (jmp.jf) {
-			this[jmp.line].jf += jmp.jf + j;
+		w = tree_next_word(&t, &keys[i], 0);
+		if (w == t.words) {
+			/* the mask is zero, anything matches. */
+			tree_ja_match(&t);
+			continue;
 		}
+		tree_load(&t, &keys[i], w);
+		ret = tree_word(&t, keys + i, g - i, w);
+		if (ret < 0)
+			goto out;
 	}
 
+	for (i = 0; i < t.match_len; i++)
+		tree_patch(&t, t.match[i], t.len + 1);
+	for (i = 0; i < 3; i++)
+		tree_patch(&t, missing[i], t.len + label_continue);
+
 	if (f->logic[attr] == NFCT_FILTER_LOGIC_NEGATIVE)
-		j += nfct_bsf_jump_to(this, 1, j);
+		tree_emit(&t, BPF_JMP|BPF_JA, 0, 0, 1);
 
-	j += nfct_bsf_ret_verdict(this, NFCT_FILTER_REJECT, j);
+	tree_emit(&t, BPF_RET|BPF_K, 0, 0, NFCT_FILTER_REJECT);
 
-	stack_destroy(s);
+	if (t.len > t.size) {
+		errno = E2BIG;
+		ret = -1;
+		goto out;
+	}
+	ret = t.len;
+out:
+	free(t.match);
+	free(range);
+	free(keys);
+	return ret;
+}
 
-	return j;
+static int
+bsf_add_saddr_ipv4_filter(const struct nfct_filter *f, struct sock_filter *this,
+			  unsigned int size)
+{
+	return bsf_add_addr_filter(f, this, size, CTA_IP_V4_SRC);
+}
+
+static int 
+bsf_add_daddr_ipv4_filter(const struct nfct_filter *f, struct sock_filter *this,
+			  unsigned int size)
+{
+	return bsf_add_addr_filter(f, this, size, CTA_IP_V4_DST);
 }
 
 static int
-bsf_add_saddr_ipv6_filter(const struct nfct_filter *f, struct sock_filter *this)
+bsf_add_saddr_ipv6_filter(const struct nfct_filter *f, struct sock_filter *this,
+			  unsigned int size)
 {
-	return bsf_add_addr_ipv6_filter(f, this, CTA_IP_V6_SRC);
+	return bsf_add_addr_filter(f, this, size, CTA_IP_V6_SRC);
 }
 
 static int 
-bsf_add_daddr_ipv6_filter(const struct nfct_filter *f, struct sock_filter *this)
+bsf_add_daddr_ipv6_filter(const struct nfct_filter *f, struct sock_filter *this,
+			  unsigned int size)
 {
-	return bsf_add_addr_ipv6_filter(f, this, CTA_IP_V6_DST);
+	return bsf_add_addr_filter(f, this, size, CTA_IP_V6_DST);
 }
 
 static int
 bsf_add_mark_filter(const struct nfct_filter *f, struct sock_filter *this)
 {
 	unsigned int i, j;
-	unsigned int jt;
 	struct stack *s;
 	struct jump jmp;
 	struct sock_filter __code = {
@@ -695,14 +1136,18 @@ bsf_add_mark_filter(const struct nfct_filter *f, struct sock_filter *this)
 	if (f->mark_elems == 0)
 		return 0;
 
-	/* XXX: see bsf_add_addr_ipv4_filter() */
-	s = stack_create(sizeof(struct jump), 3 + 127);
+	/*
+	 * The jt/jf offsets of BPF_JEQ are only 8 bits wide, a match of the
+	 * first marks could not jump past the lines of up to __FILTER_MARK_MAX
+	 * others. It skips to a BPF_JA instead, whose offset has 32 bits and
+	 * is patched once the end is known.
+	 */
+	s = stack_create(sizeof(struct jump), __FILTER_MARK_MAX);
 	if (s == NULL) {
 		errno = ENOMEM;
 		return -1;
 	}
 
-	jt = 1;
 	j = 0;
 	j += nfct_bsf_load_payload_offset(this, j);	/* A = nla header offset 		*/
 	j += nfct_bsf_find_attr(this, CTA_MARK, j);	/* A = CTA_MARK offset, started from A	*/
@@ -714,14 +1159,26 @@ bsf_add_mark_filter(const struct nfct_filter *f, struct sock_filter *this)
 
 	for (i = 0; i < f->mark_elems; i++) {
 		int mark = f->mark[i].val & f->mark[i].mask;
+		struct sock_filter __cmp = {
+			/* if (A != mark) skip next one */
+			.code = BPF_JMP|BPF_JEQ|BPF_K,
+			.k = mark,
+			.jt = 0,
+			.jf = 1,
+		};
 
 		j += nfct_bsf_alu_and(this, f->mark[i].mask, j);
-		j += nfct_bsf_cmp_k_stack(this, mark, jt - j, j, s);
+		memcpy(&this[j], &__cmp, sizeof(__cmp));
+		j += NEW_POS(__cmp);
+		jmp.line = j;
+		stack_push(s, &jmp);
+		j += nfct_bsf_jump_to(this, 0, j);
 		j += nfct_bsf_a_equal_x(this, j);
 	}
 
+	/* a match skips the verdict that follows. */
 	while (stack_pop(s, &jmp) != -1)
-		this[jmp.line].jt += jmp.jt + j;
+		this[jmp.line].k = j - jmp.line;
 
 	if (f->logic[NFCT_FILTER_MARK] == NFCT_FILTER_LOGIC_NEGATIVE)
 		j += nfct_bsf_jump_to(this, 1, j);
@@ -733,16 +1190,36 @@ bsf_add_mark_filter(const struct nfct_filter *f, struct sock_filter *this)
 	return j;
 }
 
-/* this buffer must be big enough to store all the autogenerated lines */
-#define BSF_BUFFER_SIZE 	2048
+/*
+ * The address filters are only limited by the size of the program, the
+ * rest of the filters take less lines than the slack.
+ */
+#define BSF_BUFFER_SIZE 	(BPF_MAXINSNS + 1024)
 
 int __setup_netlink_socket_filter(int fd, struct nfct_filter *f)
 {
-	struct sock_filter bsf[BSF_BUFFER_SIZE];
+	static int (*const addr_filter[])(const struct nfct_filter *f,
+					  struct sock_filter *this,
+					  unsigned int size) = {
+		bsf_add_saddr_ipv4_filter,
+		bsf_add_daddr_ipv4_filter,
+		bsf_add_saddr_ipv6_filter,
+		bsf_add_daddr_ipv6_filter,
+	};
+	static const char *addr_filter_str[] = {
+		"---- check src IPv4 ----",
+		"---- check dst IPv4 ----",
+		"---- check src IPv6 ----",
+		"---- check dst IPv6 ----",
+	};
+	struct sock_filter *bsf;
 	struct sock_fprog sf;
-	unsigned int j = 0, from = 0;
+	unsigned int i, j = 0, from = 0;
+	int ret;
 
-	memset(bsf, 0, sizeof(bsf));
+	bsf = calloc(BSF_BUFFER_SIZE, sizeof(struct sock_filter));
+	if (bsf == NULL)
+		return -1;
 
 	j += bsf_cmp_subsys(&bsf[j], j, NFNL_SUBSYS_CTNETLINK);
 	j += nfct_bsf_ret_verdict(bsf, NFCT_FILTER_ACCEPT, j);
@@ -751,18 +1228,16 @@ int __setup_netlink_socket_filter(int fd, struct nfct_filter *f)
 	j += bsf_add_proto_filter(f, &bsf[j]);
 	show_filter(bsf, from, j, "---- check proto ----");
 	from = j;
-	j += bsf_add_saddr_ipv4_filter(f, &bsf[j]);
-	show_filter(bsf, from, j, "---- check src IPv4 ----");
-	from = j;
-	j += bsf_add_daddr_ipv4_filter(f, &bsf[j]);
-	show_filter(bsf, from, j, "---- check dst IPv4 ----");
-	from = j;
-	j += bsf_add_saddr_ipv6_filter(f, &bsf[j]);
-	show_filter(bsf, from, j, "---- check src IPv6 ----");
-	from = j;
-	j += bsf_add_daddr_ipv6_filter(f, &bsf[j]);
-	show_filter(bsf, from, j, "---- check dst IPv6 ----");
-	from = j;
+	for (i = 0; i < sizeof(addr_filter) / sizeof(addr_filter[0]); i++) {
+		ret = addr_filter[i](f, &bsf[j], BPF_MAXINSNS - j);
+		if (ret < 0) {
+			free(bsf);
+			return -1;
+		}
+		j += ret;
+		show_filter(bsf, from, j, (char *)addr_filter_str[i]);
+		from = j;
+	}
 	j += bsf_add_state_filter(f, &bsf[j]);
 	show_filter(bsf, from, j, "---- check state ----");
 	from = j;
@@ -771,15 +1246,291 @@ int __setup_netlink_socket_filter(int fd, struct nfct_filter *f)
 	from = j;
 
 	/* nothing to filter, skip */
-	if (j == 0)
+	if (j == 0) {
+		free(bsf);
 		return 0;
+	}
 
 	j += nfct_bsf_ret_verdict(bsf, NFCT_FILTER_ACCEPT, j);
 	show_filter(bsf, from, j, "---- final verdict ----");
 	from = j;
 
+	if (j > BPF_MAXINSNS) {
+		free(bsf);
+		errno = E2BIG;
+		return -1;
+	}
+
 	sf.len = (sizeof(struct sock_filter) * j) / sizeof(bsf[0]);
 	sf.filter = bsf;
 
-	return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &sf, sizeof(sf));
+	ret = setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &sf, sizeof(sf));
+	free(bsf);
+
+	return ret;
+}
+
+/*
+ * Userspace counterpart of the socket filter: the program that is attached
+ * to a socket is run over messages that did not go through it, such as the
+ * results of a dump. This follows the kernel interpreter, out of bounds
+ * loads drop the message. Programs that use ancillary data other than the
+ * Netlink attribute lookups accept everything, we cannot tell.
+ */
+#ifndef SO_GET_FILTER
+#define SO_GET_FILTER	SO_ATTACH_FILTER
+#endif
+
+/* the program attached to fd, 0 if none or -1 on error. */
+int __bsf_get(int fd, struct sock_filter **code)
+{
+	socklen_t len = 0;
+	struct sock_filter *bsf;
+
+	*code = NULL;
+
+	/* the length is asked first, it is in instructions. */
+	if (getsockopt(fd, SOL_SOCKET, SO_GET_FILTER, NULL, &len) == -1)
+		return -1;
+	if (len == 0)
+		return 0;
+
+	bsf = calloc(len, sizeof(struct sock_filter));
+	if (bsf == NULL)
+		return -1;
+
+	if (getsockopt(fd, SOL_SOCKET, SO_GET_FILTER, bsf, &len) == -1) {
+		free(bsf);
+		return -1;
+	}
+	*code = bsf;
+	return len;
+}
+
+/* offset of the attribute of type `type' in [off, off + len), 0 if none. */
+static uint32_t bsf_nla_find(const uint8_t *data, uint32_t off, uint32_t len,
+			     uint32_t type)
+{
+	const struct nlattr *nla;
+
+	while (len >= sizeof(struct nlattr)) {
+		nla = (const struct nlattr *)(data + off);
+		if (nla->nla_len < sizeof(struct nlattr) || nla->nla_len > len)
+			break;
+		if ((nla->nla_type & NLA_TYPE_MASK) == type)
+			return off;
+		if (NLA_ALIGN(nla->nla_len) >= len)
+			break;
+		len -= NLA_ALIGN(nla->nla_len);
+		off += NLA_ALIGN(nla->nla_len);
+	}
+	return 0;
+}
+
+static int bsf_load(const uint8_t *data, size_t size, uint32_t off,
+		    unsigned int bytes, uint32_t *value)
+{
+	if (off > size || bytes > size - off)
+		return -1;
+
+	switch(bytes) {
+	case 4:
+		*value = (uint32_t)data[off] << 24 | data[off + 1] << 16 |
+			 data[off + 2] << 8 | data[off + 3];
+		break;
+	case 2:
+		*value = data[off] << 8 | data[off + 1];
+		break;
+	default:
+		*value = data[off];
+		break;
+	}
+	return 0;
+}
+
+/* ancillary data, -1 if we do not know about it. */
+static int bsf_ancillary(const uint8_t *data, size_t size, uint32_t k,
+			 uint32_t *a, uint32_t x)
+{
+	const struct nlattr *nla;
+
+	if (size < sizeof(struct nlattr) || *a > size - sizeof(struct nlattr)) {
+		*a = 0;
+		return 0;
+	}
+
+	switch(k - SKF_AD_OFF) {
+	case SKF_AD_NLATTR:
+		*a = bsf_nla_find(data, *a, size - *a, x);
+		return 0;
+	case SKF_AD_NLATTR_NEST:
+		nla = (const struct nlattr *)(data + *a);
+		if (nla->nla_len < sizeof(struct nlattr) ||
+		    nla->nla_len > size - *a) {
+			*a = 0;
+			return 0;
+		}
+		*a = bsf_nla_find(data, *a + NLA_HDRLEN,
+				  nla->nla_len - NLA_HDRLEN, x);
+		return 0;
+	}
+	return -1;
+}
+
+/* the verdict of the program on the message, 0 means that it is dropped. */
+uint32_t __bsf_run(const struct sock_filter *code, unsigned int len,
+		   const void *msg, size_t size)
+{
+	uint32_t a = 0, x = 0, mem[BPF_MEMWORDS] = { 0 }, v;
+	const uint8_t *data = msg;
+	const struct sock_filter *f;
+	unsigned int pc, bytes;
+
+	for (pc = 0; pc < len; pc++) {
+		f = &code[pc];
+
+		switch(BPF_CLASS(f->code)) {
+		case BPF_LD:
+			bytes = BPF_SIZE(f->code) == BPF_W ? 4 :
+				BPF_SIZE(f->code) == BPF_H ? 2 : 1;
+
+			switch(BPF_MODE(f->code)) {
+			case BPF_ABS:
+			case BPF_IND:
+				v = f->k;
+				if (v >= (uint32_t)SKF_AD_OFF &&
+				    BPF_MODE(f->code) == BPF_ABS) {
+					if (bsf_ancillary(data, size, v,
+							  &a, x) < 0)
+						return NFCT_FILTER_ACCEPT;
+					break;
+				}
+				if (BPF_MODE(f->code) == BPF_IND)
+					v += x;
+				if (v >= (uint32_t)SKF_LL_OFF)
+					return NFCT_FILTER_ACCEPT;
+				if (bsf_load(data, size, v, bytes, &a) < 0)
+					return NFCT_FILTER_REJECT;
+				break;
+			case BPF_IMM:
+				a = f->k;
+				break;
+			case BPF_MEM:
+				a = mem[f->k % BPF_MEMWORDS];
+				break;
+			case BPF_LEN:
+				a = size;
+				break;
+			default:
+				return NFCT_FILTER_ACCEPT;
+			}
+			break;
+		case BPF_LDX:
+			switch(BPF_MODE(f->code)) {
+			case BPF_IMM:
+				x = f->k;
+				break;
+			case BPF_MEM:
+				x = mem[f->k % BPF_MEMWORDS];
+				break;
+			case BPF_LEN:
+				x = size;
+				break;
+			case BPF_MSH:
+				if (bsf_load(data, size, f->k, 1, &v) < 0)
+					return NFCT_FILTER_REJECT;
+				x = (v & 0xf) << 2;
+				break;
+			default:
+				return NFCT_FILTER_ACCEPT;
+			}
+			break;
+		case BPF_ST:
+			mem[f->k % BPF_MEMWORDS] = a;
+			break;
+		case BPF_STX:
+			mem[f->k % BPF_MEMWORDS] = x;
+			break;
+		case BPF_ALU:
+			v = BPF_SRC(f->code) == BPF_X ? x : f->k;
+			switch(BPF_OP(f->code)) {
+			case BPF_ADD:
+				a += v;
+				break;
+			case BPF_SUB:
+				a -= v;
+				break;
+			case BPF_MUL:
+				a *= v;
+				break;
+			case BPF_DIV:
+				if (v == 0)
+					return NFCT_FILTER_REJECT;
+				a /= v;
+				break;
+#ifdef BPF_MOD
+			case BPF_MOD:
+				if (v == 0)
+					return NFCT_FILTER_REJECT;
+				a %= v;
+				break;
+#endif
+			case BPF_AND:
+				a &= v;
+				break;
+			case BPF_OR:
+				a |= v;
+				break;
+#ifdef BPF_XOR
+			case BPF_XOR:
+				a ^= v;
+				break;
+#endif
+			case BPF_LSH:
+				a = v < 32 ? a << v : 0;
+				break;
+			case BPF_RSH:
+				a = v < 32 ? a >> v : 0;
+				break;
+			case BPF_NEG:
+				a = -a;
+				break;
+			default:
+				return NFCT_FILTER_ACCEPT;
+			}
+			break;
+		case BPF_JMP:
+			v = BPF_SRC(f->code) == BPF_X ? x : f->k;
+			switch(BPF_OP(f->code)) {
+			case BPF_JA:
+				pc += f->k;
+				break;
+			case BPF_JEQ:
+				pc += a == v ? f->jt : f->jf;
+				break;
+			case BPF_JGT:
+				pc += a > v ? f->jt : f->jf;
+				break;
+			case BPF_JGE:
+				pc += a >= v ? f->jt : f->jf;
+				break;
+			case BPF_JSET:
+				pc += a & v ? f->jt : f->jf;
+				break;
+			default:
+				return NFCT_FILTER_ACCEPT;
+			}
+			break;
+		case BPF_RET:
+			return BPF_RVAL(f->code) == BPF_A ? a : f->k;
+		case BPF_MISC:
+			if (BPF_MISCOP(f->code) == BPF_TAX)
+				x = a;
+			else
+				a = x;
+			break;
+		}
+	}
+	/* the kernel does not let such a program in. */
+	return NFCT_FILTER_REJECT;
 }
@@ -224,15 +224,15 @@ __nat_seq_adj(struct nfnlhdr *req,
 	nfnl_addattr32(&req->nlh, 
 		       size, 
 		       CTA_NAT_SEQ_CORRECTION_POS,
-		       htonl(ct->natseq[dir].correction_pos));
+		       htonl(ct->cold->natseq[dir].correction_pos));
 	nfnl_addattr32(&req->nlh, 
 		       size, 
 		       CTA_NAT_SEQ_OFFSET_BEFORE,
-		       htonl(ct->natseq[dir].offset_before));
+		       htonl(ct->cold->natseq[dir].offset_before));
 	nfnl_addattr32(&req->nlh, 
 		       size, 
 		       CTA_NAT_SEQ_OFFSET_AFTER,
-		       htonl(ct->natseq[dir].offset_after));
+		       htonl(ct->cold->natseq[dir].offset_after));
 }
 
 static void 
@@ -298,8 +298,8 @@ static void __build_snat(struct nfnlhdr *req,
 	struct nfattr *nest;
 
 	nest = nfnl_nest(&req->nlh, size, CTA_NAT_SRC);
-	__build_nat(req, size, &ct->snat, l3protonum);
-	__build_protonat(req, size, ct, &ct->snat);
+	__build_nat(req, size, &ct->cold->snat, l3protonum);
+	__build_protonat(req, size, ct, &ct->cold->snat);
 	nfnl_nest_end(&req->nlh, nest);
 }
 
@@ -310,7 +310,7 @@ static void __build_snat_ipv4(struct nfnlhdr *req,
 	struct nfattr *nest;
 
 	nest = nfnl_nest(&req->nlh, size, CTA_NAT_SRC);
-	__build_nat(req, size, &ct->snat, AF_INET);
+	__build_nat(req, size, &ct->cold->snat, AF_INET);
 	nfnl_nest_end(&req->nlh, nest);
 }
 
@@ -321,7 +321,7 @@ static void __build_snat_ipv6(struct nfnlhdr *req,
 	struct nfattr *nest;
 
 	nest = nfnl_nest(&req->nlh, size, CTA_NAT_SRC);
-	__build_nat(req, size, &ct->snat, AF_INET6);
+	__build_nat(req, size, &ct->cold->snat, AF_INET6);
 	nfnl_nest_end(&req->nlh, nest);
 }
 
@@ -332,7 +332,7 @@ static void __build_snat_port(struct nfnlhdr *req,
 	struct nfattr *nest;
 
 	nest = nfnl_nest(&req->nlh, size, CTA_NAT_SRC);
-	__build_protonat(req, size, ct, &ct->snat);
+	__build_protonat(req, size, ct, &ct->cold->snat);
 	nfnl_nest_end(&req->nlh, nest);
 }
 
@@ -344,8 +344,8 @@ static void __build_dnat(struct nfnlhdr *req,
 	struct nfattr *nest;
 
 	nest = nfnl_nest(&req->nlh, size, CTA_NAT_DST);
-	__build_nat(req, size, &ct->dnat, l3protonum);
-	__build_protonat(req, size, ct, &ct->dnat);
+	__build_nat(req, size, &ct->cold->dnat, l3protonum);
+	__build_protonat(req, size, ct, &ct->cold->dnat);
 	nfnl_nest_end(&req->nlh, nest);
 }
 
@@ -356,7 +356,7 @@ static void __build_dnat_ipv4(struct nfnlhdr *req,
 	struct nfattr *nest;
 
 	nest = nfnl_nest(&req->nlh, size, CTA_NAT_DST);
-	__build_nat(req, size, &ct->dnat, AF_INET);
+	__build_nat(req, size, &ct->cold->dnat, AF_INET);
 	nfnl_nest_end(&req->nlh, nest);
 }
 
@@ -367,7 +367,7 @@ static void __build_dnat_ipv6(struct nfnlhdr *req,
 	struct nfattr *nest;
 
 	nest = nfnl_nest(&req->nlh, size, CTA_NAT_DST);
-	__build_nat(req, size, &ct->dnat, AF_INET6);
+	__build_nat(req, size, &ct->cold->dnat, AF_INET6);
 	nfnl_nest_end(&req->nlh, nest);
 }
 
@@ -378,7 +378,7 @@ static void __build_dnat_port(struct nfnlhdr *req,
 	struct nfattr *nest;
 
 	nest = nfnl_nest(&req->nlh, size, CTA_NAT_DST);
-        __build_protonat(req, size, ct, &ct->dnat);
+        __build_protonat(req, size, ct, &ct->cold->dnat);
 	nfnl_nest_end(&req->nlh, nest);
 }
 
@@ -402,13 +402,18 @@ static void __build_mark(struct nfnlhdr *req,
 			 const struct nf_conntrack *ct)
 {
 	nfnl_addattr32(&req->nlh, size, CTA_MARK, htonl(ct->mark));
+
+	/* the kernel only replaces these bits of the mark. */
+	if (test_bit(ATTR_MARK_MASK, ct->head.set))
+		nfnl_addattr32(&req->nlh, size, CTA_MARK_MASK,
+			       htonl(ct->cold->mark_mask));
 }
 
 static void __build_secmark(struct nfnlhdr *req,
 			    size_t size,
 			    const struct nf_conntrack *ct)
 {
-	nfnl_addattr32(&req->nlh, size, CTA_SECMARK, htonl(ct->secmark));
+	nfnl_addattr32(&req->nlh, size, CTA_SECMARK, htonl(ct->cold->secmark));
 }
 
 static void __build_helper_name(struct nfnlhdr *req,
@@ -421,8 +426,8 @@ static void __build_helper_name(struct nfnlhdr *req,
 	nfnl_addattr_l(&req->nlh,
 		       size, 
 		       CTA_HELP_NAME,
-		       ct->helper_name,
-		       strlen(ct->helper_name)+1);
+		       ct->cold->helper_name,
+		       strlen(ct->cold->helper_name)+1);
 	nfnl_nest_end(&req->nlh, nest);
 }
 
@@ -437,7 +442,7 @@ static void __build_labels(struct nfnlhdr *req,
 			   size_t size,
 			   const struct nf_conntrack *ct)
 {
-	struct nfct_bitmask *b = ct->connlabels;
+	struct nfct_bitmask *b = ct->cold->connlabels;
 	unsigned int b_size = b->words * sizeof(b->bits[0]);
 
 	nfnl_addattr_l(&req->nlh,
@@ -447,7 +452,7 @@ static void __build_labels(struct nfnlhdr *req,
 		       b_size);
 
 	if (test_bit(ATTR_CONNLABELS_MASK, ct->head.set)) {
-		b = ct->connlabels_mask;
+		b = ct->cold->connlabels_mask;
 		if (b_size == (b->words * sizeof(b->bits[0])))
 			nfnl_addattr_l(&req->nlh,
 				       size,
@@ -526,7 +531,7 @@ int __build_conntrack(struct nfnl_subsys_handle *ssh,
 	    test_bit(ATTR_MASTER_PORT_DST, ct->head.set) ||
 	    test_bit(ATTR_MASTER_L3PROTO, ct->head.set) ||
 	    test_bit(ATTR_MASTER_L4PROTO, ct->head.set))
-	    	__build_tuple(req, size, &ct->master, CTA_TUPLE_MASTER);
+	    	__build_tuple(req, size, &ct->cold->master, CTA_TUPLE_MASTER);
 
 	if (test_bit(ATTR_STATUS, ct->head.set))
 		__build_status(req, size, ct);
@@ -219,11 +219,11 @@ static int
 nfct_nat_seq_adj(struct nlmsghdr *nlh, const struct nf_conntrack *ct, int dir)
 {
 	mnl_attr_put_u32(nlh, CTA_NAT_SEQ_CORRECTION_POS,
-			 htonl(ct->natseq[dir].correction_pos));
+			 htonl(ct->cold->natseq[dir].correction_pos));
 	mnl_attr_put_u32(nlh, CTA_NAT_SEQ_OFFSET_BEFORE,
-			 htonl(ct->natseq[dir].offset_before));
+			 htonl(ct->cold->natseq[dir].offset_before));
 	mnl_attr_put_u32(nlh, CTA_NAT_SEQ_OFFSET_AFTER,
-			 htonl(ct->natseq[dir].offset_after));
+			 htonl(ct->cold->natseq[dir].offset_after));
 	return 0;
 }
 
@@ -288,8 +288,8 @@ nfct_build_snat(struct nlmsghdr *nlh, const struct nf_conntrack *ct,
 	struct nlattr *nest;
 
 	nest = mnl_attr_nest_start(nlh, CTA_NAT_SRC);
-	nfct_build_nat(nlh, &ct->snat, l3protonum);
-	nfct_build_protonat(nlh, ct, &ct->snat);
+	nfct_build_nat(nlh, &ct->cold->snat, l3protonum);
+	nfct_build_protonat(nlh, ct, &ct->cold->snat);
 	mnl_attr_nest_end(nlh, nest);
 	return 0;
 }
@@ -300,7 +300,7 @@ nfct_build_snat_ipv4(struct nlmsghdr *nlh, const struct nf_conntrack *ct)
 	struct nlattr *nest;
 
 	nest = mnl_attr_nest_start(nlh, CTA_NAT_SRC);
-	nfct_build_nat(nlh, &ct->snat, AF_INET);
+	nfct_build_nat(nlh, &ct->cold->snat, AF_INET);
 	mnl_attr_nest_end(nlh, nest);
 	return 0;
 }
@@ -311,7 +311,7 @@ nfct_build_snat_ipv6(struct nlmsghdr *nlh, const struct nf_conntrack *ct)
 	struct nlattr *nest;
 
 	nest = mnl_attr_nest_start(nlh, CTA_NAT_SRC);
-	nfct_build_nat(nlh, &ct->snat, AF_INET6);
+	nfct_build_nat(nlh, &ct->cold->snat, AF_INET6);
 	mnl_attr_nest_end(nlh, nest);
 	return 0;
 }
@@ -322,7 +322,7 @@ nfct_build_snat_port(struct nlmsghdr *nlh, const struct nf_conntrack *ct)
 	struct nlattr *nest;
 
 	nest = mnl_attr_nest_start(nlh, CTA_NAT_SRC);
-	nfct_build_protonat(nlh, ct, &ct->snat);
+	nfct_build_protonat(nlh, ct, &ct->cold->snat);
 	mnl_attr_nest_end(nlh, nest);
 	return 0;
 }
@@ -334,8 +334,8 @@ nfct_build_dnat(struct nlmsghdr *nlh, const struct nf_conntrack *ct,
 	struct nlattr *nest;
 
 	nest = mnl_attr_nest_start(nlh, CTA_NAT_DST);
-	nfct_build_nat(nlh, &ct->dnat, l3protonum);
-	nfct_build_protonat(nlh, ct, &ct->dnat);
+	nfct_build_nat(nlh, &ct->cold->dnat, l3protonum);
+	nfct_build_protonat(nlh, ct, &ct->cold->dnat);
 	mnl_attr_nest_end(nlh, nest);
 	return 0;
 }
@@ -346,7 +346,7 @@ nfct_build_dnat_ipv4(struct nlmsghdr *nlh, const struct nf_conntrack *ct)
 	struct nlattr *nest;
 
 	nest = mnl_attr_nest_start(nlh, CTA_NAT_DST);
-	nfct_build_nat(nlh, &ct->dnat, AF_INET);
+	nfct_build_nat(nlh, &ct->cold->dnat, AF_INET);
 	mnl_attr_nest_end(nlh, nest);
 	return 0;
 }
@@ -357,7 +357,7 @@ nfct_build_dnat_ipv6(struct nlmsghdr *nlh, const struct nf_conntrack *ct)
 	struct nlattr *nest;
 
 	nest = mnl_attr_nest_start(nlh, CTA_NAT_DST);
-	nfct_build_nat(nlh, &ct->dnat, AF_INET6);
+	nfct_build_nat(nlh, &ct->cold->dnat, AF_INET6);
 	mnl_attr_nest_end(nlh, nest);
 	return 0;
 }
@@ -368,7 +368,7 @@ nfct_build_dnat_port(struct nlmsghdr *nlh, const struct nf_conntrack *ct)
 	struct nlattr *nest;
 
 	nest = mnl_attr_nest_start(nlh, CTA_NAT_DST);
-	nfct_build_protonat(nlh, ct, &ct->dnat);
+	nfct_build_protonat(nlh, ct, &ct->cold->dnat);
 	mnl_attr_nest_end(nlh, nest);
 	return 0;
 }
@@ -391,13 +391,18 @@ static int
 nfct_build_mark(struct nlmsghdr *nlh, const struct nf_conntrack *ct)
 {
 	mnl_attr_put_u32(nlh, CTA_MARK, htonl(ct->mark));
+
+	/* the kernel only replaces these bits of the mark. */
+	if (test_bit(ATTR_MARK_MASK, ct->head.set))
+		mnl_attr_put_u32(nlh, CTA_MARK_MASK,
+				 htonl(ct->cold->mark_mask));
 	return 0;
 }
 
 static int
 nfct_build_secmark(struct nlmsghdr *nlh, const struct nf_conntrack *ct)
 {
-	mnl_attr_put_u32(nlh, CTA_SECMARK, htonl(ct->secmark));
+	mnl_attr_put_u32(nlh, CTA_SECMARK, htonl(ct->cold->secmark));
 	return 0;
 }
 
@@ -407,11 +412,11 @@ nfct_build_helper_name(struct nlmsghdr *nlh, const struct nf_conntrack *ct)
 	struct nlattr *nest;
 
 	nest = mnl_attr_nest_start(nlh, CTA_HELP);
-	mnl_attr_put_strz(nlh, CTA_HELP_NAME, ct->helper_name);
+	mnl_attr_put_strz(nlh, CTA_HELP_NAME, ct->cold->helper_name);
 
-	if (ct->helper_info != NULL) {
-		mnl_attr_put(nlh, CTA_HELP_INFO, ct->helper_info_len,
-				ct->helper_info);
+	if (test_bit(ATTR_HELPER_INFO, ct->head.set)) {
+		mnl_attr_put(nlh, CTA_HELP_INFO, ct->cold->helper_info_len,
+				ct->cold->helper_info);
 	}
 	mnl_attr_nest_end(nlh, nest);
 	return 0;
@@ -427,12 +432,12 @@ nfct_build_zone(struct nlmsghdr *nlh, const struct nf_conntrack *ct)
 static void
 nfct_build_labels(struct nlmsghdr *nlh, const struct nf_conntrack *ct)
 {
-	struct nfct_bitmask *b = ct->connlabels;
+	struct nfct_bitmask *b = ct->cold->connlabels;
 	unsigned int size = b->words * sizeof(b->bits[0]);
 	mnl_attr_put(nlh, CTA_LABELS, size, b->bits);
 
 	if (test_bit(ATTR_CONNLABELS_MASK, ct->head.set)) {
-		b = ct->connlabels_mask;
+		b = ct->cold->connlabels_mask;
 		if (size == (b->words * sizeof(b->bits[0])))
 			mnl_attr_put(nlh, CTA_LABELS_MASK, size, b->bits);
 	}
@@ -514,7 +519,7 @@ nfct_nlmsg_build(struct nlmsghdr *nlh, const struct nf_conntrack *ct)
 	    test_bit(ATTR_MASTER_PORT_DST, ct->head.set) ||
 	    test_bit(ATTR_MASTER_L3PROTO, ct->head.set) ||
 	    test_bit(ATTR_MASTER_L4PROTO, ct->head.set)) {
-		nfct_build_tuple(nlh, &ct->master, CTA_TUPLE_MASTER);
+		nfct_build_tuple(nlh, &ct->cold->master, CTA_TUPLE_MASTER);
 	}
 
 	if (test_bit(ATTR_STATUS, ct->head.set))
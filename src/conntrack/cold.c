@@ -0,0 +1,145 @@
+/*
+ * (C) 2026 by agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "internal/internal.h"
+
+/*
+ * Attributes that are stored in the cold extension of the conntrack object.
+ * They are seldom present in events and dumps, so the object only carries
+ * them once one of them is set.
+ */
+static const uint8_t cold_attr[ATTR_MAX] = {
+	[ATTR_MASTER_IPV4_SRC]			= 1,
+	[ATTR_MASTER_IPV4_DST]			= 1,
+	[ATTR_MASTER_IPV6_SRC]			= 1,
+	[ATTR_MASTER_IPV6_DST]			= 1,
+	[ATTR_MASTER_PORT_SRC]			= 1,
+	[ATTR_MASTER_PORT_DST]			= 1,
+	[ATTR_MASTER_L3PROTO]			= 1,
+	[ATTR_MASTER_L4PROTO]			= 1,
+	[ATTR_SECMARK]				= 1,
+	[ATTR_SNAT_IPV4]			= 1,
+	[ATTR_DNAT_IPV4]			= 1,
+	[ATTR_SNAT_IPV6]			= 1,
+	[ATTR_DNAT_IPV6]			= 1,
+	[ATTR_SNAT_PORT]			= 1,
+	[ATTR_DNAT_PORT]			= 1,
+	[ATTR_ORIG_NAT_SEQ_CORRECTION_POS]	= 1,
+	[ATTR_ORIG_NAT_SEQ_OFFSET_BEFORE]	= 1,
+	[ATTR_ORIG_NAT_SEQ_OFFSET_AFTER]	= 1,
+	[ATTR_REPL_NAT_SEQ_CORRECTION_POS]	= 1,
+	[ATTR_REPL_NAT_SEQ_OFFSET_BEFORE]	= 1,
+	[ATTR_REPL_NAT_SEQ_OFFSET_AFTER]	= 1,
+	[ATTR_HELPER_NAME]			= 1,
+	[ATTR_SECCTX]				= 1,
+	[ATTR_TIMESTAMP_START]			= 1,
+	[ATTR_TIMESTAMP_STOP]			= 1,
+	[ATTR_HELPER_INFO]			= 1,
+	[ATTR_CONNLABELS]			= 1,
+	[ATTR_CONNLABELS_MASK]			= 1,
+	[ATTR_MARK_MASK]			= 1,
+};
+
+/* returns the cold extension, it is allocated on first use. */
+struct __nfct_cold *__cold_get(struct nf_conntrack *ct)
+{
+	if (ct->cold)
+		return ct->cold;
+
+	if (ct->heap || ct->pool) {
+		ct->cold = calloc(1, sizeof(struct __nfct_cold));
+	} else {
+		/* the buffer was sized by nfct_maxsize(). */
+		ct->cold = (struct __nfct_cold *)(ct + 1);
+		memset(ct->cold, 0, sizeof(struct __nfct_cold));
+	}
+	return ct->cold;
+}
+
+/* make sure that attribute `type' can be stored in this object. */
+int __cold_prepare(struct nf_conntrack *ct, const int type)
+{
+	if (!cold_attr[type] || ct->cold)
+		return 0;
+
+	return __cold_get(ct) ? 0 : -1;
+}
+
+int __cold_prepare_grp(struct nf_conntrack *ct, const int type)
+{
+	switch(type) {
+	case ATTR_GRP_MASTER_IPV4:
+	case ATTR_GRP_MASTER_IPV6:
+	case ATTR_GRP_MASTER_PORT:
+		return __cold_get(ct) ? 0 : -1;
+	}
+	return 0;
+}
+
+/* unset all the attributes that live in the cold extension. */
+void __cold_unset(struct nf_conntrack *ct)
+{
+	int i;
+
+	for (i = 0; i < ATTR_MAX; i++) {
+		if (cold_attr[i])
+			unset_bit(i, ct->head.set);
+	}
+}
+
+void __cold_release(struct nf_conntrack *ct)
+{
+	struct __nfct_cold *cold = ct->cold;
+
+	if (cold == NULL)
+		return;
+
+	if (cold->secctx)
+		free(cold->secctx);
+	if (cold->helper_info)
+		free(cold->helper_info);
+	__labels_free(cold->connlabels, &cold->connlabels_buf);
+	__labels_free(cold->connlabels_mask, &cold->connlabels_mask_buf);
+	if (cold != (struct __nfct_cold *)(ct + 1))
+		free(cold);
+	ct->cold = NULL;
+}
+
+/*
+ * Label bitmasks that fit in `buf' are stored there, larger ones go to the
+ * heap. The current bitmask in `slot' is reused if it has the same size.
+ */
+struct nfct_bitmask *__labels_alloc(struct nfct_bitmask **slot,
+				    struct __nfct_labels *buf,
+				    unsigned int words)
+{
+	struct nfct_bitmask *b = *slot;
+
+	if (b && b->words == words)
+		return b;
+
+	if (words <= __NFCT_LABELS_WORDS) {
+		b = (struct nfct_bitmask *)buf;
+		b->words = words;
+	} else {
+		b = nfct_bitmask_new(words * 32 - 1);
+		if (b == NULL)
+			return NULL;
+	}
+	__labels_free(*slot, buf);
+	*slot = b;
+
+	return b;
+}
+
+void __labels_free(struct nfct_bitmask *b, struct __nfct_labels *buf)
+{
+	if (b && b != (struct nfct_bitmask *)buf)
+		nfct_bitmask_destroy(b);
+}
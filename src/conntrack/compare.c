@@ -180,6 +180,53 @@ int __cmp_orig(const struct nf_conntrack *ct1,
 	return 1;
 }
 
+static inline uint32_t hash_mix(uint32_t h, uint32_t v)
+{
+	h ^= v;
+	h *= 0x9e3779b1;
+	return h ^ (h >> 15);
+}
+
+/*
+ * Hash of the original tuple, objects that are equal for __cmp_orig() with
+ * the same attributes set have the same hash. Only attributes that are set
+ * are used, an unset zone is zone 0 like for the comparison.
+ */
+uint32_t __hash_orig(const struct nf_conntrack *ct)
+{
+	const struct __nfct_tuple *t = &ct->head.orig;
+	const uint32_t *set = ct->head.set;
+	uint32_t h = 0;
+	int i;
+
+	if (test_bit(ATTR_ORIG_L3PROTO, set))
+		h = hash_mix(h, t->l3protonum);
+	if (test_bit(ATTR_ORIG_L4PROTO, set))
+		h = hash_mix(h, t->protonum);
+	h = hash_mix(h, test_bit(ATTR_ORIG_ZONE, set) ? t->zone : 0);
+
+	if (test_bit(ATTR_ORIG_IPV4_SRC, set))
+		h = hash_mix(h, t->src.v4);
+	if (test_bit(ATTR_ORIG_IPV4_DST, set))
+		h = hash_mix(h, t->dst.v4);
+	if (test_bit(ATTR_ORIG_IPV6_SRC, set)) {
+		for (i = 0; i < 4; i++)
+			h = hash_mix(h, t->src.v6.s6_addr32[i]);
+	}
+	if (test_bit(ATTR_ORIG_IPV6_DST, set)) {
+		for (i = 0; i < 4; i++)
+			h = hash_mix(h, t->dst.v6.s6_addr32[i]);
+	}
+
+	if (test_bit(ATTR_ORIG_PORT_SRC, set) || test_bit(ATTR_ICMP_ID, set))
+		h = hash_mix(h, t->l4src.all);
+	if (test_bit(ATTR_ORIG_PORT_DST, set) ||
+	    test_bit(ATTR_ICMP_TYPE, set) || test_bit(ATTR_ICMP_CODE, set))
+		h = hash_mix(h, t->l4dst.all);
+
+	return h;
+}
+
 static int
 cmp_repl_l3proto(const struct nf_conntrack *ct1,
 		 const struct nf_conntrack *ct2,
@@ -318,6 +365,15 @@ cmp_mark(const struct nf_conntrack *ct1,
 	       nfct_get_attr_u32(ct2, ATTR_MARK);
 }
 
+static int
+cmp_mark_mask(const struct nf_conntrack *ct1,
+	      const struct nf_conntrack *ct2,
+	      unsigned int flags)
+{
+	return nfct_get_attr_u32(ct1, ATTR_MARK_MASK) ==
+	       nfct_get_attr_u32(ct2, ATTR_MARK_MASK);
+}
+
 static int 
 cmp_timeout(const struct nf_conntrack *ct1,
 	    const struct nf_conntrack *ct2,
@@ -390,20 +446,26 @@ cmp_secctx(const struct nf_conntrack *ct1,
 	   const struct nf_conntrack *ct2,
 	   unsigned int flags)
 {
-	if (ct1->secctx == NULL || ct2->secctx == NULL)
-		return ct1->secctx == ct2->secctx;
-	return strcmp(ct1->secctx, ct2->secctx) == 0;
+	if (ct1->cold->secctx == NULL || ct2->cold->secctx == NULL)
+		return ct1->cold->secctx == ct2->cold->secctx;
+	return strcmp(ct1->cold->secctx, ct2->cold->secctx) == 0;
 }
 
 static int __cmp_clabel(const struct nfct_bitmask *a,
 			const struct nfct_bitmask *b)
 {
-	unsigned int len, max;
+	unsigned int i, len, max;
 	const uint32_t *bits;
 
 	if (a == NULL || b == NULL)
 		return a == b;
 
+	/* the kernel always uses 128 bits labels, compare them at once. */
+	if (a->words == __NFCT_LABELS_WORDS &&
+	    b->words == __NFCT_LABELS_WORDS)
+		return ((a->bits[0] ^ b->bits[0]) | (a->bits[1] ^ b->bits[1]) |
+			(a->bits[2] ^ b->bits[2]) | (a->bits[3] ^ b->bits[3])) == 0;
+
 	if (a->words < b->words) {
 		bits = b->bits;
 		max = b->words;
@@ -414,12 +476,16 @@ static int __cmp_clabel(const struct nfct_bitmask *a,
 		len = b->words;
 	}
 
-	while (max > len) {
-		if (bits[--max])
+	for (i = 0; i < len; i++) {
+		if (a->bits[i] != b->bits[i])
 			return 0;
 	}
 	/* bitmask sizes are equal or extra bits are not set */
-	return memcmp(a->bits, b->bits, len * sizeof(a->bits[0])) == 0;
+	for (; i < max; i++) {
+		if (bits[i])
+			return 0;
+	}
+	return 1;
 }
 
 static int cmp_clabel(const struct nf_conntrack *ct1,
@@ -448,6 +514,8 @@ static int cmp_meta(const struct nf_conntrack *ct1,
 		return 0;
 	if (!__cmp(ATTR_MARK, ct1, ct2, flags, cmp_mark, false))
 		return 0;
+	if (!__cmp(ATTR_MARK_MASK, ct1, ct2, flags, cmp_mark_mask, true))
+		return 0;
 	if (!__cmp(ATTR_TIMEOUT, ct1, ct2, flags, cmp_timeout, true))
 		return 0;
 	if (!__cmp(ATTR_STATUS, ct1, ct2, flags, cmp_status, true))
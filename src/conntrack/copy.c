@@ -151,51 +151,51 @@ static void copy_attr_repl_l4proto(struct nf_conntrack *dest,
 static void copy_attr_master_ipv4_src(struct nf_conntrack *dest,
 				      const struct nf_conntrack *orig)
 {
-	dest->master.src.v4 = orig->master.src.v4;
+	dest->cold->master.src.v4 = orig->cold->master.src.v4;
 }
 
 static void copy_attr_master_ipv4_dst(struct nf_conntrack *dest,
 				      const struct nf_conntrack *orig)
 {
-	dest->master.dst.v4 = orig->master.dst.v4;
+	dest->cold->master.dst.v4 = orig->cold->master.dst.v4;
 }
 
 static void copy_attr_master_ipv6_src(struct nf_conntrack *dest,
 				      const struct nf_conntrack *orig)
 {
-	memcpy(&dest->master.src, &orig->master.src,
+	memcpy(&dest->cold->master.src, &orig->cold->master.src,
 	       sizeof(union __nfct_address));
 }
 
 static void copy_attr_master_ipv6_dst(struct nf_conntrack *dest,
 				      const struct nf_conntrack *orig)
 {
-	memcpy(&dest->master.dst, &orig->master.dst,
+	memcpy(&dest->cold->master.dst, &orig->cold->master.dst,
 	       sizeof(union __nfct_address));
 }
 
 static void copy_attr_master_port_src(struct nf_conntrack *dest,
 				      const struct nf_conntrack *orig)
 {
-	dest->master.l4src.all = orig->master.l4src.all;
+	dest->cold->master.l4src.all = orig->cold->master.l4src.all;
 }
 
 static void copy_attr_master_port_dst(struct nf_conntrack *dest,
 				      const struct nf_conntrack *orig)
 {
-	dest->master.l4dst.all = orig->master.l4dst.all;
+	dest->cold->master.l4dst.all = orig->cold->master.l4dst.all;
 }
 
 static void copy_attr_master_l3proto(struct nf_conntrack *dest,
 				     const struct nf_conntrack *orig)
 {
-	dest->master.l3protonum = orig->master.l3protonum;
+	dest->cold->master.l3protonum = orig->cold->master.l3protonum;
 }
 
 static void copy_attr_master_l4proto(struct nf_conntrack *dest,
 				     const struct nf_conntrack *orig)
 {
-	dest->master.protonum = orig->master.protonum;
+	dest->cold->master.protonum = orig->cold->master.protonum;
 }
 
 static void copy_attr_tcp_state(struct nf_conntrack *dest,
@@ -287,39 +287,39 @@ static void copy_attr_dccp_handshake_seq(struct nf_conntrack *dest,
 static void copy_attr_snat_ipv4(struct nf_conntrack *dest,
 				const struct nf_conntrack *orig)
 {
-	dest->snat.min_ip.v4 = orig->snat.min_ip.v4;
+	dest->cold->snat.min_ip.v4 = orig->cold->snat.min_ip.v4;
 }
 
 static void copy_attr_dnat_ipv4(struct nf_conntrack *dest,
 				const struct nf_conntrack *orig)
 {
-	dest->dnat.min_ip.v4 = orig->dnat.min_ip.v4;
+	dest->cold->dnat.min_ip.v4 = orig->cold->dnat.min_ip.v4;
 }
 
 static void copy_attr_snat_ipv6(struct nf_conntrack *dest,
 				const struct nf_conntrack *orig)
 {
-	memcpy(&dest->snat.min_ip.v6, &orig->snat.min_ip.v6,
+	memcpy(&dest->cold->snat.min_ip.v6, &orig->cold->snat.min_ip.v6,
 	       sizeof(struct in6_addr));
 }
 
 static void copy_attr_dnat_ipv6(struct nf_conntrack *dest,
 				const struct nf_conntrack *orig)
 {
-	memcpy(&dest->dnat.min_ip.v6, &orig->dnat.min_ip.v6,
+	memcpy(&dest->cold->dnat.min_ip.v6, &orig->cold->dnat.min_ip.v6,
 	       sizeof(struct in6_addr));
 }
 
 static void copy_attr_snat_port(struct nf_conntrack *dest,
 				const struct nf_conntrack *orig)
 {
-	dest->snat.l4min.all = orig->snat.l4min.all;
+	dest->cold->snat.l4min.all = orig->cold->snat.l4min.all;
 }
 
 static void copy_attr_dnat_port(struct nf_conntrack *dest,
 				const struct nf_conntrack *orig)
 {
-	dest->dnat.l4min.all = orig->dnat.l4min.all;
+	dest->cold->dnat.l4min.all = orig->cold->dnat.l4min.all;
 }
 
 static void copy_attr_timeout(struct nf_conntrack *dest,
@@ -334,10 +334,16 @@ static void copy_attr_mark(struct nf_conntrack *dest,
 	dest->mark = orig->mark;
 }
 
+static void copy_attr_mark_mask(struct nf_conntrack *dest,
+				const struct nf_conntrack *orig)
+{
+	dest->cold->mark_mask = orig->cold->mark_mask;
+}
+
 static void copy_attr_secmark(struct nf_conntrack *dest,
 			      const struct nf_conntrack *orig)
 {
-	dest->secmark = orig->secmark;
+	dest->cold->secmark = orig->cold->secmark;
 }
 
 static void copy_attr_orig_counter_packets(struct nf_conntrack *dest,
@@ -385,50 +391,50 @@ static void copy_attr_id(struct nf_conntrack *dest,
 static void copy_attr_orig_cor_pos(struct nf_conntrack *dest,
 				   const struct nf_conntrack *orig)
 {
-	dest->natseq[__DIR_ORIG].correction_pos =
-		orig->natseq[__DIR_ORIG].correction_pos;
+	dest->cold->natseq[__DIR_ORIG].correction_pos =
+		orig->cold->natseq[__DIR_ORIG].correction_pos;
 }
 
 static void copy_attr_orig_off_bfr(struct nf_conntrack *dest,
 				   const struct nf_conntrack *orig)
 {
-	dest->natseq[__DIR_ORIG].offset_before =
-		orig->natseq[__DIR_ORIG].offset_before;
+	dest->cold->natseq[__DIR_ORIG].offset_before =
+		orig->cold->natseq[__DIR_ORIG].offset_before;
 }
 
 static void copy_attr_orig_off_aft(struct nf_conntrack *dest,
 				   const struct nf_conntrack *orig)
 {
-	dest->natseq[__DIR_ORIG].offset_after =
-		orig->natseq[__DIR_ORIG].offset_after;
+	dest->cold->natseq[__DIR_ORIG].offset_after =
+		orig->cold->natseq[__DIR_ORIG].offset_after;
 }
 
 static void copy_attr_repl_cor_pos(struct nf_conntrack *dest,
 				   const struct nf_conntrack *orig)
 {
-	dest->natseq[__DIR_REPL].correction_pos =
-		orig->natseq[__DIR_REPL].correction_pos;
+	dest->cold->natseq[__DIR_REPL].correction_pos =
+		orig->cold->natseq[__DIR_REPL].correction_pos;
 }
 
 static void copy_attr_repl_off_bfr(struct nf_conntrack *dest,
 				   const struct nf_conntrack *orig)
 {
-	dest->natseq[__DIR_REPL].offset_before =
-		orig->natseq[__DIR_REPL].offset_before;
+	dest->cold->natseq[__DIR_REPL].offset_before =
+		orig->cold->natseq[__DIR_REPL].offset_before;
 }
 
 static void copy_attr_repl_off_aft(struct nf_conntrack *dest,
 				   const struct nf_conntrack *orig)
 {
-	dest->natseq[__DIR_REPL].offset_after =
-		orig->natseq[__DIR_REPL].offset_after;
+	dest->cold->natseq[__DIR_REPL].offset_after =
+		orig->cold->natseq[__DIR_REPL].offset_after;
 }
 
 static void copy_attr_helper_name(struct nf_conntrack *dest,
 				  const struct nf_conntrack *orig)
 {
-	strncpy(dest->helper_name, orig->helper_name, NFCT_HELPER_NAME_MAX);
-	dest->helper_name[NFCT_HELPER_NAME_MAX-1] = '\0';
+	strncpy(dest->cold->helper_name, orig->cold->helper_name, NFCT_HELPER_NAME_MAX);
+	dest->cold->helper_name[NFCT_HELPER_NAME_MAX-1] = '\0';
 }
 
 static void copy_attr_zone(struct nf_conntrack *dest,
@@ -440,62 +446,77 @@ static void copy_attr_zone(struct nf_conntrack *dest,
 static void copy_attr_secctx(struct nf_conntrack *dest,
 			     const struct nf_conntrack *orig)
 {
-	if (dest->secctx) {
-		free(dest->secctx);
-		dest->secctx = NULL;
+	if (dest->cold->secctx) {
+		free(dest->cold->secctx);
+		dest->cold->secctx = NULL;
+		dest->cold->secctx_size = 0;
+	}
+	if (orig->cold->secctx) {
+		dest->cold->secctx = strdup(orig->cold->secctx);
+		if (dest->cold->secctx)
+			dest->cold->secctx_size = strlen(dest->cold->secctx) + 1;
 	}
-	if (orig->secctx)
-		dest->secctx = strdup(orig->secctx);
 }
 
 static void copy_attr_timestamp_start(struct nf_conntrack *dest,
 				      const struct nf_conntrack *orig)
 {
-	dest->timestamp.start = orig->timestamp.start;
+	dest->cold->timestamp.start = orig->cold->timestamp.start;
 }
 
 static void copy_attr_timestamp_stop(struct nf_conntrack *dest,
 				     const struct nf_conntrack *orig)
 {
-	dest->timestamp.stop = orig->timestamp.stop;
+	dest->cold->timestamp.stop = orig->cold->timestamp.stop;
 }
 
 static void copy_attr_help_info(struct nf_conntrack *dest,
 				const struct nf_conntrack *orig)
 {
-	if (orig->helper_info == NULL)
+	if (orig->cold->helper_info == NULL)
 		return;
 
-	if (dest->helper_info != NULL)
-		free(dest->helper_info);
+	if (dest->cold->helper_info != NULL)
+		free(dest->cold->helper_info);
 
-	dest->helper_info = calloc(1, orig->helper_info_len);
-	if (dest->helper_info == NULL)
+	dest->cold->helper_info = calloc(1, orig->cold->helper_info_len);
+	if (dest->cold->helper_info == NULL)
 		return;
 
-	memcpy(dest->helper_info, orig->helper_info, orig->helper_info_len);
+	memcpy(dest->cold->helper_info, orig->cold->helper_info, orig->cold->helper_info_len);
+	dest->cold->helper_info_len = orig->cold->helper_info_len;
 }
 
-static void* do_copy_attr_connlabels(struct nfct_bitmask *dest,
-				     const struct nfct_bitmask *orig)
+static void do_copy_attr_connlabels(struct nfct_bitmask **dest,
+				    struct __nfct_labels *buf,
+				    const struct nfct_bitmask *orig)
 {
+	struct nfct_bitmask *b;
+
 	if (orig == NULL)
-		return dest;
-	if (dest)
-		nfct_bitmask_destroy(dest);
-	return nfct_bitmask_clone(orig);
+		return;
+
+	b = __labels_alloc(dest, buf, orig->words);
+	if (b == NULL)
+		return;
+
+	memcpy(b->bits, orig->bits, orig->words * sizeof(orig->bits[0]));
 }
 
 static void copy_attr_connlabels(struct nf_conntrack *dest,
 				 const struct nf_conntrack *orig)
 {
-	dest->connlabels = do_copy_attr_connlabels(dest->connlabels, orig->connlabels);
+	do_copy_attr_connlabels(&dest->cold->connlabels,
+				&dest->cold->connlabels_buf,
+				orig->cold->connlabels);
 }
 
 static void copy_attr_connlabels_mask(struct nf_conntrack *dest,
 				 const struct nf_conntrack *orig)
 {
-	dest->connlabels_mask = do_copy_attr_connlabels(dest->connlabels_mask, orig->connlabels_mask);
+	do_copy_attr_connlabels(&dest->cold->connlabels_mask,
+				&dest->cold->connlabels_mask_buf,
+				orig->cold->connlabels_mask);
 }
 
 const copy_attr copy_attr_array[ATTR_MAX] = {
@@ -571,20 +592,47 @@ const copy_attr copy_attr_array[ATTR_MAX] = {
 	[ATTR_CONNLABELS_MASK]		= copy_attr_connlabels_mask,
 	[ATTR_SNAT_IPV6]		= copy_attr_snat_ipv6,
 	[ATTR_DNAT_IPV6]		= copy_attr_dnat_ipv6,
+	[ATTR_MARK_MASK]		= copy_attr_mark_mask,
 };
 
 /* this is used by nfct_copy() with the NFCT_CP_OVERRIDE flag set. */
 void __copy_fast(struct nf_conntrack *ct1, const struct nf_conntrack *ct2)
 {
+	struct nfct_pool *pool = ct1->pool;
+	struct __nfct_cold *cold = ct1->cold, saved;
+	uint8_t heap = ct1->heap;
+
 	memcpy(ct1, ct2, sizeof(*ct1));
-	/* malloc'd attributes: don't free, do copy */
-	ct1->secctx = NULL;
-	ct1->helper_info = NULL;
-	ct1->connlabels = NULL;
-	ct1->connlabels_mask = NULL;
-
-	copy_attr_secctx(ct1, ct2);
-	copy_attr_help_info(ct1, ct2);
-	copy_attr_connlabels(ct1, ct2);
-	copy_attr_connlabels_mask(ct1, ct2);
+	ct1->pool = pool;
+	ct1->cold = cold;
+	ct1->heap = heap;
+
+	if (ct2->cold == NULL)
+		return;
+
+	cold = __cold_get(ct1);
+	if (cold == NULL) {
+		__cold_unset(ct1);
+		return;
+	}
+
+	/* malloc'd attributes: don't share, do copy */
+	memcpy(&saved, cold, sizeof(saved));
+	memcpy(cold, ct2->cold, sizeof(*cold));
+	cold->secctx = saved.secctx;
+	cold->secctx_size = saved.secctx_size;
+	cold->helper_info = saved.helper_info;
+	cold->helper_info_len = saved.helper_info_len;
+	cold->connlabels = saved.connlabels;
+	cold->connlabels_mask = saved.connlabels_mask;
+
+	/* buffers of unset attributes may be kept around for reuse. */
+	if (test_bit(ATTR_SECCTX, ct2->head.set))
+		copy_attr_secctx(ct1, ct2);
+	if (test_bit(ATTR_HELPER_INFO, ct2->head.set))
+		copy_attr_help_info(ct1, ct2);
+	if (test_bit(ATTR_CONNLABELS, ct2->head.set))
+		copy_attr_connlabels(ct1, ct2);
+	if (test_bit(ATTR_CONNLABELS_MASK, ct2->head.set))
+		copy_attr_connlabels_mask(ct1, ct2);
 }
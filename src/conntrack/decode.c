@@ -0,0 +1,852 @@
+/*
+ * (C) 2005-2012 by Pablo Neira Ayuso <pablo@netfilter.org>
+ * (C) 2026 by agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "internal/internal.h"
+#include <linux/netlink.h>
+#include <limits.h>
+#include <endian.h>
+#include <stddef.h>
+
+/*
+ * This is the decoder behind both the libnfnetlink and the libmnl parsing
+ * paths, conntracks, expectations and flow keys alike. Both hand over the
+ * attributes that follow the nfgenmsg header as they are in the message,
+ * struct nfattr and struct nlattr share the same layout.
+ *
+ * The message is decoded in one single pass: every attribute is looked up in
+ * the descriptor table of the nest that contains it, which tells how long
+ * its payload must be, where it goes and which attribute bit it sets. Nests
+ * are descended into as they are found. Fields are at an offset from the
+ * base of the enclosing nest, that is the object itself at the top level,
+ * its cold extension for the nests flagged as such, or the tuple, counters
+ * and sequence adjustment of the direction a nest refers to.
+ */
+enum {
+	CT_DEC_SKIP = 0,	/* not decoded */
+	CT_DEC_COPY,		/* same representation in the message */
+	CT_DEC_BE16,
+	CT_DEC_BE32,
+	CT_DEC_BE32_64,		/* 32 bits in the message, 64 in the object */
+	CT_DEC_BE64,
+	CT_DEC_STR,		/* string, truncated to the size of the field */
+	CT_DEC_FUNC,		/* decoded by a handler */
+	/* nests go last, see ct_desc_valid() */
+	CT_DEC_NEST,
+	CT_DEC_TUPLE,		/* nest that also sets the layer 3 protocol */
+	CT_DEC_HEAD,		/* tuple with its own attribute bits */
+};
+
+/* the field lives in the cold extension, allocated on demand. */
+#define CT_DESC_COLD		(1 << 0)
+/* the payload is a nest, even though a handler decodes it. */
+#define CT_DESC_NESTED		(1 << 1)
+/* 64 bits counter, the 32 bits one that follows does not overwrite it. */
+#define CT_DESC_WIDE		(1 << 2)
+
+/* the counter of a direction that the 64 bits attribute was decoded for. */
+#define CT_WIDE_BIT(d, dir)	(1 << ((dir) * 2 + (d)->off / sizeof(uint64_t)))
+
+/* the direction of a nest, nests without one inherit it. */
+#define CT_DIR(dir)		((dir) + 1)
+
+struct ct_decoder {
+	struct nf_conntrack	*ct;
+	uint32_t		*set;
+	const uint32_t		*want;
+	uint8_t			l3num;
+	/* see CT_DESC_WIDE */
+	uint8_t			wide;
+};
+
+struct ct_desc;
+
+struct ct_nest {
+	unsigned int		max;
+	const struct ct_desc	*desc;
+};
+
+struct ct_desc {
+	uint8_t			kind;
+	uint8_t			len;	/* expected payload length, 0 if any */
+	uint8_t			size;	/* size of the field for strings */
+	uint8_t			flags;
+	uint8_t			dir;	/* see CT_DIR() */
+	uint8_t			want;	/* __PARSE_* plus one, 0 if always */
+	/* attribute bit per direction, ATTR_MAX if none */
+	uint8_t			attr[__DIR_MASTER + 1];
+	uint16_t		off;
+	const struct ct_nest	*nest;
+	int			(*parse)(const struct ct_desc *d,
+					 const void *data, int len,
+					 struct ct_decoder *dec);
+};
+
+#define CT_LEAF(_kind, _len, _off, ...)					\
+	{ .kind = _kind, .len = _len, .off = _off, .attr = { __VA_ARGS__ } }
+
+#define CT_STRING(_size, _off, ...)					\
+	{ .kind = CT_DEC_STR, .size = _size, .off = _off,		\
+	  .attr = { __VA_ARGS__ } }
+
+#define CT_TUPLE(f)	offsetof(struct __nfct_tuple, f)
+#define CT_OBJ(f)	offsetof(struct nf_conntrack, f)
+#define CT_COLD(f)	offsetof(struct __nfct_cold, f)
+#define CT_COUNTER(f)	offsetof(struct __nfct_counters, f)
+#define CT_NATSEQ(f)	(CT_COLD(natseq[0].f) - CT_COLD(natseq[0]))
+#define CT_EXP(f)	offsetof(struct nf_expect, f)
+
+#define CT_ATTR_OK(a, rem)					\
+	((rem) >= (int)sizeof(struct nlattr) &&			\
+	 (a)->nla_len >= sizeof(struct nlattr) &&		\
+	 (a)->nla_len <= (rem))
+
+#define CT_ATTR_NEXT(a, rem)					\
+	((rem) -= NLA_ALIGN((a)->nla_len),			\
+	 (const struct nlattr *)((const char *)(a) + NLA_ALIGN((a)->nla_len)))
+
+#define CT_ATTR_TYPE(a)		((a)->nla_type & NLA_TYPE_MASK)
+#define CT_ATTR_DATA(a)		((const char *)(a) + NLA_HDRLEN)
+#define CT_ATTR_LEN(a)		((int)(a)->nla_len - NLA_HDRLEN)
+
+static const struct ct_desc ct_ip_desc[CTA_IP_MAX + 1] = {
+	[CTA_IP_V4_SRC]	= CT_LEAF(CT_DEC_COPY, sizeof(uint32_t),
+				  CT_TUPLE(src.v4), ATTR_ORIG_IPV4_SRC,
+				  ATTR_REPL_IPV4_SRC, ATTR_MASTER_IPV4_SRC),
+	[CTA_IP_V4_DST]	= CT_LEAF(CT_DEC_COPY, sizeof(uint32_t),
+				  CT_TUPLE(dst.v4), ATTR_ORIG_IPV4_DST,
+				  ATTR_REPL_IPV4_DST, ATTR_MASTER_IPV4_DST),
+	[CTA_IP_V6_SRC]	= CT_LEAF(CT_DEC_COPY, sizeof(struct in6_addr),
+				  CT_TUPLE(src.v6), ATTR_ORIG_IPV6_SRC,
+				  ATTR_REPL_IPV6_SRC, ATTR_MASTER_IPV6_SRC),
+	[CTA_IP_V6_DST]	= CT_LEAF(CT_DEC_COPY, sizeof(struct in6_addr),
+				  CT_TUPLE(dst.v6), ATTR_ORIG_IPV6_DST,
+				  ATTR_REPL_IPV6_DST, ATTR_MASTER_IPV6_DST),
+};
+
+static const struct ct_nest ct_ip_nest = { CTA_IP_MAX, ct_ip_desc };
+
+static const struct ct_desc ct_proto_desc[CTA_PROTO_MAX + 1] = {
+	[CTA_PROTO_NUM]		= CT_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+					  CT_TUPLE(protonum),
+					  ATTR_ORIG_L4PROTO, ATTR_REPL_L4PROTO,
+					  ATTR_MASTER_L4PROTO),
+	[CTA_PROTO_SRC_PORT]	= CT_LEAF(CT_DEC_COPY, sizeof(uint16_t),
+					  CT_TUPLE(l4src.tcp.port),
+					  ATTR_ORIG_PORT_SRC, ATTR_REPL_PORT_SRC,
+					  ATTR_MASTER_PORT_SRC),
+	[CTA_PROTO_DST_PORT]	= CT_LEAF(CT_DEC_COPY, sizeof(uint16_t),
+					  CT_TUPLE(l4dst.tcp.port),
+					  ATTR_ORIG_PORT_DST, ATTR_REPL_PORT_DST,
+					  ATTR_MASTER_PORT_DST),
+	[CTA_PROTO_ICMP_ID]	= CT_LEAF(CT_DEC_COPY, sizeof(uint16_t),
+					  CT_TUPLE(l4src.icmp.id),
+					  ATTR_ICMP_ID, ATTR_ICMP_ID,
+					  ATTR_ICMP_ID),
+	[CTA_PROTO_ICMP_TYPE]	= CT_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+					  CT_TUPLE(l4dst.icmp.type),
+					  ATTR_ICMP_TYPE, ATTR_ICMP_TYPE,
+					  ATTR_ICMP_TYPE),
+	[CTA_PROTO_ICMP_CODE]	= CT_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+					  CT_TUPLE(l4dst.icmp.code),
+					  ATTR_ICMP_CODE, ATTR_ICMP_CODE,
+					  ATTR_ICMP_CODE),
+	[CTA_PROTO_ICMPV6_ID]	= CT_LEAF(CT_DEC_COPY, sizeof(uint16_t),
+					  CT_TUPLE(l4src.icmp.id),
+					  ATTR_ICMP_ID, ATTR_ICMP_ID,
+					  ATTR_ICMP_ID),
+	[CTA_PROTO_ICMPV6_TYPE]	= CT_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+					  CT_TUPLE(l4dst.icmp.type),
+					  ATTR_ICMP_TYPE, ATTR_ICMP_TYPE,
+					  ATTR_ICMP_TYPE),
+	[CTA_PROTO_ICMPV6_CODE]	= CT_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+					  CT_TUPLE(l4dst.icmp.code),
+					  ATTR_ICMP_CODE, ATTR_ICMP_CODE,
+					  ATTR_ICMP_CODE),
+};
+
+static const struct ct_nest ct_proto_nest = { CTA_PROTO_MAX, ct_proto_desc };
+
+static const struct ct_desc ct_tuple_desc[CTA_TUPLE_MAX + 1] = {
+	[CTA_TUPLE_IP]		= {
+		.kind	= CT_DEC_NEST,
+		.nest	= &ct_ip_nest,
+	},
+	[CTA_TUPLE_PROTO]	= {
+		.kind	= CT_DEC_NEST,
+		.nest	= &ct_proto_nest,
+	},
+	[CTA_TUPLE_ZONE]	= CT_LEAF(CT_DEC_BE16, sizeof(uint16_t),
+					  CT_TUPLE(zone), ATTR_ORIG_ZONE,
+					  ATTR_REPL_ZONE, ATTR_MAX),
+};
+
+static const struct ct_nest ct_tuple_nest = { CTA_TUPLE_MAX, ct_tuple_desc };
+
+static int ct_decode_tcp_flags(const struct ct_desc *d, const void *data,
+			       int len, struct ct_decoder *dec)
+{
+	int dir = d->dir - 1;
+
+	memcpy(&dec->ct->protoinfo.tcp.flags[dir], data,
+	       sizeof(struct nf_ct_tcp_flags));
+
+	if (dir == __DIR_ORIG) {
+		set_bit(ATTR_TCP_FLAGS_ORIG, dec->set);
+		set_bit(ATTR_TCP_MASK_ORIG, dec->set);
+	} else {
+		set_bit(ATTR_TCP_FLAGS_REPL, dec->set);
+		set_bit(ATTR_TCP_MASK_REPL, dec->set);
+	}
+	return 0;
+}
+
+static const struct ct_desc ct_tcp_desc[CTA_PROTOINFO_TCP_MAX + 1] = {
+	[CTA_PROTOINFO_TCP_STATE]		=
+		CT_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+			CT_OBJ(protoinfo.tcp.state), ATTR_TCP_STATE),
+	[CTA_PROTOINFO_TCP_WSCALE_ORIGINAL]	=
+		CT_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+			CT_OBJ(protoinfo.tcp.wscale[__DIR_ORIG]),
+			ATTR_TCP_WSCALE_ORIG),
+	[CTA_PROTOINFO_TCP_WSCALE_REPLY]	=
+		CT_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+			CT_OBJ(protoinfo.tcp.wscale[__DIR_REPL]),
+			ATTR_TCP_WSCALE_REPL),
+	[CTA_PROTOINFO_TCP_FLAGS_ORIGINAL]	= {
+		.kind	= CT_DEC_FUNC,
+		.len	= sizeof(struct nf_ct_tcp_flags),
+		.dir	= CT_DIR(__DIR_ORIG),
+		.parse	= ct_decode_tcp_flags,
+	},
+	[CTA_PROTOINFO_TCP_FLAGS_REPLY]		= {
+		.kind	= CT_DEC_FUNC,
+		.len	= sizeof(struct nf_ct_tcp_flags),
+		.dir	= CT_DIR(__DIR_REPL),
+		.parse	= ct_decode_tcp_flags,
+	},
+};
+
+static const struct ct_desc ct_sctp_desc[CTA_PROTOINFO_SCTP_MAX + 1] = {
+	[CTA_PROTOINFO_SCTP_STATE]		=
+		CT_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+			CT_OBJ(protoinfo.sctp.state), ATTR_SCTP_STATE),
+	[CTA_PROTOINFO_SCTP_VTAG_ORIGINAL]	=
+		CT_LEAF(CT_DEC_BE32, sizeof(uint32_t),
+			CT_OBJ(protoinfo.sctp.vtag[__DIR_ORIG]),
+			ATTR_SCTP_VTAG_ORIG),
+	[CTA_PROTOINFO_SCTP_VTAG_REPLY]		=
+		CT_LEAF(CT_DEC_BE32, sizeof(uint32_t),
+			CT_OBJ(protoinfo.sctp.vtag[__DIR_REPL]),
+			ATTR_SCTP_VTAG_REPL),
+};
+
+static const struct ct_desc ct_dccp_desc[CTA_PROTOINFO_DCCP_MAX + 1] = {
+	[CTA_PROTOINFO_DCCP_STATE]		=
+		CT_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+			CT_OBJ(protoinfo.dccp.state), ATTR_DCCP_STATE),
+	[CTA_PROTOINFO_DCCP_ROLE]		=
+		CT_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+			CT_OBJ(protoinfo.dccp.role), ATTR_DCCP_ROLE),
+	[CTA_PROTOINFO_DCCP_HANDSHAKE_SEQ]	=
+		CT_LEAF(CT_DEC_BE64, sizeof(uint64_t),
+			CT_OBJ(protoinfo.dccp.handshake_seq),
+			ATTR_DCCP_HANDSHAKE_SEQ),
+};
+
+static const struct ct_nest ct_tcp_nest =
+	{ CTA_PROTOINFO_TCP_MAX, ct_tcp_desc };
+static const struct ct_nest ct_sctp_nest =
+	{ CTA_PROTOINFO_SCTP_MAX, ct_sctp_desc };
+static const struct ct_nest ct_dccp_nest =
+	{ CTA_PROTOINFO_DCCP_MAX, ct_dccp_desc };
+
+static const struct ct_desc ct_protoinfo_desc[CTA_PROTOINFO_MAX + 1] = {
+	[CTA_PROTOINFO_TCP]	= {
+		.kind	= CT_DEC_NEST,
+		.nest	= &ct_tcp_nest,
+	},
+	[CTA_PROTOINFO_SCTP]	= {
+		.kind	= CT_DEC_NEST,
+		.nest	= &ct_sctp_nest,
+	},
+	[CTA_PROTOINFO_DCCP]	= {
+		.kind	= CT_DEC_NEST,
+		.nest	= &ct_dccp_nest,
+	},
+};
+
+static const struct ct_nest ct_protoinfo_nest =
+	{ CTA_PROTOINFO_MAX, ct_protoinfo_desc };
+
+/*
+ * The 64 bits counters win if both are present, whatever the order. The
+ * kernel only sends one.
+ */
+static const struct ct_desc ct_counters_desc[CTA_COUNTERS_MAX + 1] = {
+	[CTA_COUNTERS_PACKETS]		= {
+		.kind	= CT_DEC_BE64,
+		.len	= sizeof(uint64_t),
+		.flags	= CT_DESC_WIDE,
+		.off	= CT_COUNTER(packets),
+		.attr	= { ATTR_ORIG_COUNTER_PACKETS,
+			    ATTR_REPL_COUNTER_PACKETS },
+	},
+	[CTA_COUNTERS_BYTES]		= {
+		.kind	= CT_DEC_BE64,
+		.len	= sizeof(uint64_t),
+		.flags	= CT_DESC_WIDE,
+		.off	= CT_COUNTER(bytes),
+		.attr	= { ATTR_ORIG_COUNTER_BYTES,
+			    ATTR_REPL_COUNTER_BYTES },
+	},
+	[CTA_COUNTERS32_PACKETS]	=
+		CT_LEAF(CT_DEC_BE32_64, sizeof(uint32_t), CT_COUNTER(packets),
+			ATTR_ORIG_COUNTER_PACKETS, ATTR_REPL_COUNTER_PACKETS),
+	[CTA_COUNTERS32_BYTES]		=
+		CT_LEAF(CT_DEC_BE32_64, sizeof(uint32_t), CT_COUNTER(bytes),
+			ATTR_ORIG_COUNTER_BYTES, ATTR_REPL_COUNTER_BYTES),
+};
+
+static const struct ct_nest ct_counters_nest =
+	{ CTA_COUNTERS_MAX, ct_counters_desc };
+
+static const struct ct_desc ct_nat_seq_desc[CTA_NAT_SEQ_MAX + 1] = {
+	[CTA_NAT_SEQ_CORRECTION_POS]	=
+		CT_LEAF(CT_DEC_BE32, sizeof(uint32_t),
+			CT_NATSEQ(correction_pos),
+			ATTR_ORIG_NAT_SEQ_CORRECTION_POS,
+			ATTR_REPL_NAT_SEQ_CORRECTION_POS),
+	[CTA_NAT_SEQ_OFFSET_BEFORE]	=
+		CT_LEAF(CT_DEC_BE32, sizeof(uint32_t),
+			CT_NATSEQ(offset_before),
+			ATTR_ORIG_NAT_SEQ_OFFSET_BEFORE,
+			ATTR_REPL_NAT_SEQ_OFFSET_BEFORE),
+	[CTA_NAT_SEQ_OFFSET_AFTER]	=
+		CT_LEAF(CT_DEC_BE32, sizeof(uint32_t),
+			CT_NATSEQ(offset_after),
+			ATTR_ORIG_NAT_SEQ_OFFSET_AFTER,
+			ATTR_REPL_NAT_SEQ_OFFSET_AFTER),
+};
+
+static const struct ct_nest ct_nat_seq_nest =
+	{ CTA_NAT_SEQ_MAX, ct_nat_seq_desc };
+
+static const struct ct_desc ct_timestamp_desc[CTA_TIMESTAMP_MAX + 1] = {
+	[CTA_TIMESTAMP_START]	=
+		CT_LEAF(CT_DEC_BE64, sizeof(uint64_t),
+			CT_COLD(timestamp.start), ATTR_TIMESTAMP_START),
+	[CTA_TIMESTAMP_STOP]	=
+		CT_LEAF(CT_DEC_BE64, sizeof(uint64_t),
+			CT_COLD(timestamp.stop), ATTR_TIMESTAMP_STOP),
+};
+
+static const struct ct_nest ct_timestamp_nest =
+	{ CTA_TIMESTAMP_MAX, ct_timestamp_desc };
+
+static int ct_decode_helper_info(const struct ct_desc *d, const void *data,
+				 int len, struct ct_decoder *dec)
+{
+	return __pool_set_helper_info(dec->ct, data, len);
+}
+
+static const struct ct_desc ct_helper_desc[CTA_HELP_MAX + 1] = {
+	[CTA_HELP_NAME]	= CT_STRING(NFCT_HELPER_NAME_MAX,
+				    CT_COLD(helper_name), ATTR_HELPER_NAME),
+	[CTA_HELP_INFO]	= {
+		.kind	= CT_DEC_FUNC,
+		.parse	= ct_decode_helper_info,
+	},
+};
+
+static const struct ct_nest ct_helper_nest = { CTA_HELP_MAX, ct_helper_desc };
+
+static int ct_decode_secctx(const struct ct_desc *d, const void *data,
+			    int len, struct ct_decoder *dec)
+{
+	const struct nlattr *a, *name = NULL;
+
+	for (a = data; CT_ATTR_OK(a, len); a = CT_ATTR_NEXT(a, len)) {
+		if (CT_ATTR_TYPE(a) != CTA_SECCTX_NAME)
+			continue;
+		/* __pool_set_secctx() copies it with strlen(). */
+		if (CT_ATTR_LEN(a) == 0 ||
+		    CT_ATTR_DATA(a)[CT_ATTR_LEN(a) - 1] != '\0') {
+			errno = ERANGE;
+			return -1;
+		}
+		name = a;
+	}
+
+	if (name == NULL)
+		return 0;
+
+	__pool_set_secctx(dec->ct, CT_ATTR_DATA(name));
+
+	return 0;
+}
+
+static int ct_decode_labels(const struct ct_desc *d, const void *data,
+			    int len, struct ct_decoder *dec)
+{
+	if (len == 0)
+		return 0;
+
+	return __pool_set_labels(dec->ct, data, len);
+}
+
+static const struct ct_desc ct_desc[CTA_MAX + 1] = {
+	[CTA_TUPLE_ORIG]	= {
+		.kind	= CT_DEC_TUPLE,
+		.dir	= CT_DIR(__DIR_ORIG),
+		.off	= CT_OBJ(head.orig),
+		.attr	= { [__DIR_ORIG] = ATTR_ORIG_L3PROTO },
+		.nest	= &ct_tuple_nest,
+	},
+	[CTA_TUPLE_REPLY]	= {
+		.kind	= CT_DEC_TUPLE,
+		.dir	= CT_DIR(__DIR_REPL),
+		.off	= CT_OBJ(repl),
+		.attr	= { [__DIR_REPL] = ATTR_REPL_L3PROTO },
+		.nest	= &ct_tuple_nest,
+	},
+	[CTA_TUPLE_MASTER]	= {
+		.kind	= CT_DEC_TUPLE,
+		.flags	= CT_DESC_COLD,
+		.dir	= CT_DIR(__DIR_MASTER),
+		.off	= CT_COLD(master),
+		.attr	= { [__DIR_MASTER] = ATTR_MASTER_L3PROTO },
+		.nest	= &ct_tuple_nest,
+	},
+	[CTA_STATUS]		= CT_LEAF(CT_DEC_BE32, sizeof(uint32_t),
+					  CT_OBJ(status), ATTR_STATUS),
+	[CTA_PROTOINFO]		= {
+		.kind	= CT_DEC_NEST,
+		.want	= __PARSE_PROTOINFO + 1,
+		.nest	= &ct_protoinfo_nest,
+	},
+	[CTA_HELP]		= {
+		.kind	= CT_DEC_NEST,
+		.flags	= CT_DESC_COLD,
+		.want	= __PARSE_HELPER + 1,
+		.nest	= &ct_helper_nest,
+	},
+	[CTA_TIMEOUT]		= CT_LEAF(CT_DEC_BE32, sizeof(uint32_t),
+					  CT_OBJ(timeout), ATTR_TIMEOUT),
+	[CTA_MARK]		= CT_LEAF(CT_DEC_BE32, sizeof(uint32_t),
+					  CT_OBJ(mark), ATTR_MARK),
+	[CTA_COUNTERS_ORIG]	= {
+		.kind	= CT_DEC_NEST,
+		.dir	= CT_DIR(__DIR_ORIG),
+		.want	= __PARSE_COUNTERS_ORIG + 1,
+		.off	= CT_OBJ(counters[__DIR_ORIG]),
+		.nest	= &ct_counters_nest,
+	},
+	[CTA_COUNTERS_REPLY]	= {
+		.kind	= CT_DEC_NEST,
+		.dir	= CT_DIR(__DIR_REPL),
+		.want	= __PARSE_COUNTERS_REPL + 1,
+		.off	= CT_OBJ(counters[__DIR_REPL]),
+		.nest	= &ct_counters_nest,
+	},
+	[CTA_USE]		= CT_LEAF(CT_DEC_BE32, sizeof(uint32_t),
+					  CT_OBJ(use), ATTR_USE),
+	[CTA_ID]		= CT_LEAF(CT_DEC_BE32, sizeof(uint32_t),
+					  CT_OBJ(id), ATTR_ID),
+	/* CTA_NAT_SRC and CTA_NAT_DST are deprecated. */
+	[CTA_NAT_SEQ_ADJ_ORIG]	= {
+		.kind	= CT_DEC_NEST,
+		.flags	= CT_DESC_COLD,
+		.dir	= CT_DIR(__DIR_ORIG),
+		.want	= __PARSE_NAT_SEQ_ORIG + 1,
+		.off	= CT_COLD(natseq[__DIR_ORIG]),
+		.nest	= &ct_nat_seq_nest,
+	},
+	[CTA_NAT_SEQ_ADJ_REPLY]	= {
+		.kind	= CT_DEC_NEST,
+		.flags	= CT_DESC_COLD,
+		.dir	= CT_DIR(__DIR_REPL),
+		.want	= __PARSE_NAT_SEQ_REPL + 1,
+		.off	= CT_COLD(natseq[__DIR_REPL]),
+		.nest	= &ct_nat_seq_nest,
+	},
+	[CTA_SECMARK]		= {
+		.kind	= CT_DEC_BE32,
+		.len	= sizeof(uint32_t),
+		.flags	= CT_DESC_COLD,
+		.off	= CT_COLD(secmark),
+		.attr	= { ATTR_SECMARK },
+	},
+	[CTA_ZONE]		= CT_LEAF(CT_DEC_BE16, sizeof(uint16_t),
+					  CT_OBJ(zone), ATTR_ZONE),
+	[CTA_SECCTX]		= {
+		.kind	= CT_DEC_FUNC,
+		.flags	= CT_DESC_COLD | CT_DESC_NESTED,
+		.want	= __PARSE_SECCTX + 1,
+		.parse	= ct_decode_secctx,
+	},
+	[CTA_TIMESTAMP]		= {
+		.kind	= CT_DEC_NEST,
+		.flags	= CT_DESC_COLD,
+		.want	= __PARSE_TIMESTAMP + 1,
+		.nest	= &ct_timestamp_nest,
+	},
+	/* CTA_LABELS_MASK is never sent by the kernel. */
+	[CTA_LABELS]		= {
+		.kind	= CT_DEC_FUNC,
+		.flags	= CT_DESC_COLD,
+		.want	= __PARSE_LABELS + 1,
+		.parse	= ct_decode_labels,
+	},
+};
+
+static const struct ct_nest ct_nest = { CTA_MAX, ct_desc };
+
+
+static const struct ct_desc exp_nat_desc[CTA_EXPECT_NAT_MAX + 1] = {
+	[CTA_EXPECT_NAT_DIR]	= CT_LEAF(CT_DEC_BE32, sizeof(uint32_t),
+					  CT_EXP(nat_dir), ATTR_EXP_NAT_DIR),
+	[CTA_EXPECT_NAT_TUPLE]	= {
+		.kind	= CT_DEC_HEAD,
+		.off	= CT_EXP(nat),
+		.attr	= { ATTR_EXP_NAT_TUPLE },
+		.nest	= &ct_tuple_nest,
+	},
+};
+
+static const struct ct_nest exp_nat_nest =
+	{ CTA_EXPECT_NAT_MAX, exp_nat_desc };
+
+static const struct ct_desc exp_desc[CTA_EXPECT_MAX + 1] = {
+	[CTA_EXPECT_MASTER]	= {
+		.kind	= CT_DEC_HEAD,
+		.off	= CT_EXP(master),
+		.attr	= { ATTR_EXP_MASTER },
+		.nest	= &ct_tuple_nest,
+	},
+	[CTA_EXPECT_TUPLE]	= {
+		.kind	= CT_DEC_HEAD,
+		.off	= CT_EXP(expected),
+		.attr	= { ATTR_EXP_EXPECTED },
+		.nest	= &ct_tuple_nest,
+	},
+	[CTA_EXPECT_MASK]	= {
+		.kind	= CT_DEC_HEAD,
+		.off	= CT_EXP(mask),
+		.attr	= { ATTR_EXP_MASK },
+		.nest	= &ct_tuple_nest,
+	},
+	[CTA_EXPECT_TIMEOUT]	= CT_LEAF(CT_DEC_BE32, sizeof(uint32_t),
+					  CT_EXP(timeout), ATTR_EXP_TIMEOUT),
+	[CTA_EXPECT_HELP_NAME]	= CT_STRING(NFCT_HELPER_NAME_MAX,
+					    CT_EXP(helper_name),
+					    ATTR_EXP_HELPER_NAME),
+	[CTA_EXPECT_ZONE]	= CT_LEAF(CT_DEC_BE16, sizeof(uint16_t),
+					  CT_EXP(zone), ATTR_EXP_ZONE),
+	[CTA_EXPECT_FLAGS]	= CT_LEAF(CT_DEC_BE32, sizeof(uint32_t),
+					  CT_EXP(flags), ATTR_EXP_FLAGS),
+	[CTA_EXPECT_CLASS]	= CT_LEAF(CT_DEC_BE32, sizeof(uint32_t),
+					  CT_EXP(class), ATTR_EXP_CLASS),
+	[CTA_EXPECT_NAT]	= {
+		.kind	= CT_DEC_NEST,
+		.nest	= &exp_nat_nest,
+	},
+	[CTA_EXPECT_FN]		= CT_STRING(__NFCT_EXPECTFN_MAX,
+					    CT_EXP(expectfn), ATTR_EXP_FN),
+};
+
+static const struct ct_nest exp_nest = { CTA_EXPECT_MAX, exp_desc };
+
+/* flow keys: no object and no attribute bits, see nfct_nlmsg_extract_key(). */
+#define CT_KEY(f)	offsetof(struct nfct_flow_tuple, f)
+#define CT_KEY_LEAF(_kind, _len, _off)					\
+	CT_LEAF(_kind, _len, _off, ATTR_MAX, ATTR_MAX, ATTR_MAX)
+
+static const struct ct_desc key_ip_desc[CTA_IP_MAX + 1] = {
+	[CTA_IP_V4_SRC]	= CT_KEY_LEAF(CT_DEC_COPY, sizeof(uint32_t),
+				      CT_KEY(src)),
+	[CTA_IP_V4_DST]	= CT_KEY_LEAF(CT_DEC_COPY, sizeof(uint32_t),
+				      CT_KEY(dst)),
+	[CTA_IP_V6_SRC]	= CT_KEY_LEAF(CT_DEC_COPY, sizeof(struct in6_addr),
+				      CT_KEY(src)),
+	[CTA_IP_V6_DST]	= CT_KEY_LEAF(CT_DEC_COPY, sizeof(struct in6_addr),
+				      CT_KEY(dst)),
+};
+
+static const struct ct_nest key_ip_nest = { CTA_IP_MAX, key_ip_desc };
+
+static const struct ct_desc key_proto_desc[CTA_PROTO_MAX + 1] = {
+	[CTA_PROTO_NUM]		= CT_KEY_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+					      CT_KEY(l4proto)),
+	[CTA_PROTO_SRC_PORT]	= CT_KEY_LEAF(CT_DEC_COPY, sizeof(uint16_t),
+					      CT_KEY(sport)),
+	[CTA_PROTO_DST_PORT]	= CT_KEY_LEAF(CT_DEC_COPY, sizeof(uint16_t),
+					      CT_KEY(dport)),
+	[CTA_PROTO_ICMP_ID]	= CT_KEY_LEAF(CT_DEC_COPY, sizeof(uint16_t),
+					      CT_KEY(sport)),
+	[CTA_PROTO_ICMP_TYPE]	= CT_KEY_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+					      CT_KEY(icmp_type)),
+	[CTA_PROTO_ICMP_CODE]	= CT_KEY_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+					      CT_KEY(icmp_code)),
+	[CTA_PROTO_ICMPV6_ID]	= CT_KEY_LEAF(CT_DEC_COPY, sizeof(uint16_t),
+					      CT_KEY(sport)),
+	[CTA_PROTO_ICMPV6_TYPE]	= CT_KEY_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+					      CT_KEY(icmp_type)),
+	[CTA_PROTO_ICMPV6_CODE]	= CT_KEY_LEAF(CT_DEC_COPY, sizeof(uint8_t),
+					      CT_KEY(icmp_code)),
+};
+
+static const struct ct_nest key_proto_nest = { CTA_PROTO_MAX, key_proto_desc };
+
+static const struct ct_desc key_tuple_desc[CTA_TUPLE_MAX + 1] = {
+	[CTA_TUPLE_IP]		= {
+		.kind	= CT_DEC_NEST,
+		.nest	= &key_ip_nest,
+	},
+	[CTA_TUPLE_PROTO]	= {
+		.kind	= CT_DEC_NEST,
+		.nest	= &key_proto_nest,
+	},
+};
+
+static const struct ct_nest key_tuple_nest = { CTA_TUPLE_MAX, key_tuple_desc };
+
+static const struct ct_desc key_desc[CTA_MAX + 1] = {
+	[CTA_TUPLE_ORIG]	= {
+		.kind	= CT_DEC_NEST,
+		.off	= offsetof(struct nfct_flow_key, orig),
+		.nest	= &key_tuple_nest,
+	},
+	[CTA_TUPLE_REPLY]	= {
+		.kind	= CT_DEC_NEST,
+		.off	= offsetof(struct nfct_flow_key, reply),
+		.nest	= &key_tuple_nest,
+	},
+	[CTA_ZONE]		= CT_KEY_LEAF(CT_DEC_BE16, sizeof(uint16_t),
+					      offsetof(struct nfct_flow_key, zone)),
+	[CTA_ID]		= CT_KEY_LEAF(CT_DEC_BE32, sizeof(uint32_t),
+					      offsetof(struct nfct_flow_key, id)),
+};
+
+static const struct ct_nest key_nest = { CTA_MAX, key_desc };
+
+static inline int ct_desc_valid(const struct ct_desc *d, int len)
+{
+	if (d->len)
+		return len == d->len;
+
+	/* nests may be empty, otherwise they carry at least one header. */
+	if (d->kind >= CT_DEC_NEST || (d->flags & CT_DESC_NESTED))
+		return len == 0 || len >= NLA_HDRLEN;
+
+	if (d->kind == CT_DEC_STR)
+		return len > 0;
+
+	return 1;
+}
+
+static int
+ct_decode(const struct ct_nest *nest, const void *data, int len,
+	  char *base, int dir, struct ct_decoder *dec);
+
+/* this is the hot path, once per attribute. */
+static inline int
+ct_decode_attr(const struct ct_nest *nest, unsigned int type,
+	       const struct nlattr *a, char *base, int dir,
+	       struct ct_decoder *dec)
+{
+	const struct ct_desc *d;
+	const char *payload;
+	uint32_t *set;
+	uint64_t u64;
+	char *field;
+	size_t n;
+	int plen, ret;
+
+	/* skip unsupported attribute in user-space */
+	if (type > nest->max)
+		return 0;
+
+	d = &nest->desc[type];
+	if (d->kind == CT_DEC_SKIP)
+		return 0;
+
+	payload = CT_ATTR_DATA(a);
+	plen = CT_ATTR_LEN(a);
+	if (!ct_desc_valid(d, plen)) {
+		errno = ERANGE;
+		return -1;
+	}
+
+	if (d->want && !__parse_want(dec->want, d->want - 1))
+		return 0;
+
+	if (d->flags & CT_DESC_COLD) {
+		if (__cold_get(dec->ct) == NULL)
+			return -1;
+		field = (char *)dec->ct->cold + d->off;
+	} else
+		field = base + d->off;
+
+	switch(d->kind) {
+	case CT_DEC_COPY:
+		/* let the compiler inline the common sizes. */
+		switch(d->len) {
+		case sizeof(uint8_t):
+			*(uint8_t *)field = *(const uint8_t *)payload;
+			break;
+		case sizeof(uint16_t):
+			memcpy(field, payload, sizeof(uint16_t));
+			break;
+		case sizeof(uint32_t):
+			memcpy(field, payload, sizeof(uint32_t));
+			break;
+		default:
+			memcpy(field, payload, d->len);
+			break;
+		}
+		break;
+	case CT_DEC_BE16:
+		*(uint16_t *)field = ntohs(*(const uint16_t *)payload);
+		break;
+	case CT_DEC_BE32:
+		*(uint32_t *)field = ntohl(*(const uint32_t *)payload);
+		break;
+	case CT_DEC_BE32_64:
+		if (dec->wide & CT_WIDE_BIT(d, dir))
+			return 0;
+		*(uint64_t *)field = ntohl(*(const uint32_t *)payload);
+		break;
+	case CT_DEC_BE64:
+		/* the payload is only aligned to 32 bits. */
+		memcpy(&u64, payload, sizeof(u64));
+		*(uint64_t *)field = be64toh(u64);
+		if (d->flags & CT_DESC_WIDE)
+			dec->wide |= CT_WIDE_BIT(d, dir);
+		break;
+	case CT_DEC_STR:
+		n = strnlen(payload, plen);
+		if (n > d->size - 1)
+			n = d->size - 1;
+		memcpy(field, payload, n);
+		field[n] = '\0';
+		break;
+	case CT_DEC_TUPLE:
+		((struct __nfct_tuple *)field)->l3protonum = dec->l3num;
+		set_bit(d->attr[d->dir - 1], dec->set);
+		/* fall through */
+	case CT_DEC_NEST:
+		return ct_decode(d->nest, payload, plen, field,
+				 d->dir ? d->dir - 1 : dir, dec);
+	case CT_DEC_HEAD:
+		/* the tuple bits go to the head, the attribute bit to us. */
+		set = dec->set;
+		dec->set = ((struct nfct_tuple_head *)field)->set;
+		((struct nfct_tuple_head *)field)->orig.l3protonum = dec->l3num;
+		set_bit(ATTR_ORIG_L3PROTO, dec->set);
+		ret = ct_decode(d->nest, payload, plen,
+				(char *)&((struct nfct_tuple_head *)field)->orig,
+				__DIR_ORIG, dec);
+		dec->set = set;
+		if (ret < 0)
+			return -1;
+		break;
+	case CT_DEC_FUNC:
+		return d->parse(d, payload, plen, dec);
+	}
+
+	if (d->attr[dir] != ATTR_MAX)
+		set_bit(d->attr[dir], dec->set);
+
+	return 0;
+}
+
+static int
+ct_decode(const struct ct_nest *nest, const void *data, int len,
+	  char *base, int dir, struct ct_decoder *dec)
+{
+	const struct nlattr *a;
+
+	for (a = data; CT_ATTR_OK(a, len); a = CT_ATTR_NEXT(a, len)) {
+		if (ct_decode_attr(nest, CT_ATTR_TYPE(a), a, base, dir,
+				   dec) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+int __decode_conntrack(const void *payload, size_t len, uint16_t l3num,
+		       struct nf_conntrack *ct, const uint32_t *want)
+{
+	struct ct_decoder dec = {
+		.ct	= ct,
+		.set	= ct->head.set,
+		.want	= want,
+		.l3num	= l3num,
+	};
+
+	if (len > INT_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return ct_decode(&ct_nest, payload, len, (char *)ct, __DIR_ORIG, &dec);
+}
+
+int __decode_tuple(const void *payload, size_t len,
+		   struct __nfct_tuple *tuple, int dir, uint32_t *set)
+{
+	struct ct_decoder dec = {
+		.set	= set,
+	};
+
+	if (len > INT_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return ct_decode(&ct_tuple_nest, payload, len, (char *)tuple, dir,
+			 &dec);
+}
+
+int __decode_flow_key(const void *payload, size_t len, uint8_t l3num,
+		      struct nfct_flow_key *key)
+{
+	struct ct_decoder dec = {
+		.l3num	= l3num,
+	};
+
+	if (len > INT_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(key, 0, sizeof(*key));
+	key->l3proto = l3num;
+
+	return ct_decode(&key_nest, payload, len, (char *)key, __DIR_ORIG,
+			 &dec);
+}
+
+int __decode_expect(const void *payload, size_t len, uint16_t l3num,
+		    struct nf_expect *exp)
+{
+	struct ct_decoder dec = {
+		.set	= exp->set,
+		.l3num	= l3num,
+	};
+
+	if (len > INT_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return ct_decode(&exp_nest, payload, len, (char *)exp, __DIR_ORIG,
+			 &dec);
+}
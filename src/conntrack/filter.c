@@ -27,56 +27,80 @@ filter_attr_l4proto_state(struct nfct_filter *filter, const void *value)
 	filter->l4proto_state[this->proto].len++;
 }
 
-static void filter_attr_src_ipv4(struct nfct_filter *filter, const void *value)
+/* room for more addresses, a failure leaves the array as is. */
+static void *filter_grow(void *array, uint32_t *size, size_t elem_size)
 {
-	const struct nfct_filter_ipv4 *this = value;
+	uint32_t n = *size ? *size * 2 : __FILTER_ADDR_MIN;
+	void *tmp;
 
-	if (filter->l3proto_elems[0] >= __FILTER_ADDR_MAX)
-		return;
+	tmp = realloc(array, n * elem_size);
+	if (tmp == NULL)
+		return NULL;
 
-	filter->l3proto[0][filter->l3proto_elems[0]].addr = this->addr;
-	filter->l3proto[0][filter->l3proto_elems[0]].mask = this->mask;
-	filter->l3proto_elems[0]++;
+	*size = n;
+	return tmp;
 }
 
-static void filter_attr_dst_ipv4(struct nfct_filter *filter, const void *value)
+static void filter_add_ipv4(struct nfct_filter *filter, int dir,
+			    const struct nfct_filter_ipv4 *this)
 {
-	const struct nfct_filter_ipv4 *this = value;
-
-	if (filter->l3proto_elems[1] >= __FILTER_ADDR_MAX)
-		return;
-
-	filter->l3proto[1][filter->l3proto_elems[1]].addr = this->addr;
-	filter->l3proto[1][filter->l3proto_elems[1]].mask = this->mask;
-	filter->l3proto_elems[1]++;
+	uint32_t n = filter->l3proto_elems[dir];
+	void *tmp;
+
+	if (n == filter->l3proto_size[dir]) {
+		tmp = filter_grow(filter->l3proto[dir],
+				  &filter->l3proto_size[dir],
+				  sizeof(*filter->l3proto[dir]));
+		if (tmp == NULL)
+			return;
+		filter->l3proto[dir] = tmp;
+	}
+
+	filter->l3proto[dir][n].addr = this->addr;
+	filter->l3proto[dir][n].mask = this->mask;
+	filter->l3proto_elems[dir]++;
 }
 
-static void filter_attr_src_ipv6(struct nfct_filter *filter, const void *value)
+static void filter_attr_src_ipv4(struct nfct_filter *filter, const void *value)
 {
-	const struct nfct_filter_ipv6 *this = value;
+	filter_add_ipv4(filter, __FILTER_ADDR_SRC, value);
+}
 
-	if (filter->l3proto_elems_ipv6[0] >= __FILTER_IPV6_MAX)
-		return;
+static void filter_attr_dst_ipv4(struct nfct_filter *filter, const void *value)
+{
+	filter_add_ipv4(filter, __FILTER_ADDR_DST, value);
+}
 
-	memcpy(filter->l3proto_ipv6[0][filter->l3proto_elems_ipv6[0]].addr,
+static void filter_add_ipv6(struct nfct_filter *filter, int dir,
+			    const struct nfct_filter_ipv6 *this)
+{
+	uint32_t n = filter->l3proto_elems_ipv6[dir];
+	void *tmp;
+
+	if (n == filter->l3proto_size_ipv6[dir]) {
+		tmp = filter_grow(filter->l3proto_ipv6[dir],
+				  &filter->l3proto_size_ipv6[dir],
+				  sizeof(*filter->l3proto_ipv6[dir]));
+		if (tmp == NULL)
+			return;
+		filter->l3proto_ipv6[dir] = tmp;
+	}
+
+	memcpy(filter->l3proto_ipv6[dir][n].addr,
 	       this->addr, sizeof(uint32_t)*4);
-	memcpy(filter->l3proto_ipv6[0][filter->l3proto_elems_ipv6[0]].mask,
+	memcpy(filter->l3proto_ipv6[dir][n].mask,
 	       this->mask, sizeof(uint32_t)*4);
-	filter->l3proto_elems_ipv6[0]++;
+	filter->l3proto_elems_ipv6[dir]++;
 }
 
-static void filter_attr_dst_ipv6(struct nfct_filter *filter, const void *value)
+static void filter_attr_src_ipv6(struct nfct_filter *filter, const void *value)
 {
-	const struct nfct_filter_ipv6 *this = value;
-
-	if (filter->l3proto_elems_ipv6[1] >= __FILTER_IPV6_MAX)
-		return;
+	filter_add_ipv6(filter, __FILTER_ADDR_SRC, value);
+}
 
-	memcpy(filter->l3proto_ipv6[1][filter->l3proto_elems_ipv6[1]].addr,
-	       this->addr, sizeof(uint32_t)*4);
-	memcpy(filter->l3proto_ipv6[1][filter->l3proto_elems_ipv6[1]].mask,
-	       this->mask, sizeof(uint32_t)*4);
-	filter->l3proto_elems_ipv6[1]++;
+static void filter_attr_dst_ipv6(struct nfct_filter *filter, const void *value)
+{
+	filter_add_ipv6(filter, __FILTER_ADDR_DST, value);
 }
 
 static void filter_attr_mark(struct nfct_filter *filter, const void *value)
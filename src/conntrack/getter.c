@@ -116,42 +116,42 @@ static const void *get_attr_repl_l4proto(const struct nf_conntrack *ct)
 
 static const void *get_attr_master_ipv4_src(const struct nf_conntrack *ct)
 {
-	return &ct->master.src.v4;
+	return &ct->cold->master.src.v4;
 }
 
 static const void *get_attr_master_ipv4_dst(const struct nf_conntrack *ct)
 {
-	return &ct->master.dst.v4;
+	return &ct->cold->master.dst.v4;
 }
 
 static const void *get_attr_master_ipv6_src(const struct nf_conntrack *ct)
 {
-	return &ct->master.src.v6;
+	return &ct->cold->master.src.v6;
 }
 
 static const void *get_attr_master_ipv6_dst(const struct nf_conntrack *ct)
 {
-	return &ct->master.dst.v6;
+	return &ct->cold->master.dst.v6;
 }
 
 static const void *get_attr_master_port_src(const struct nf_conntrack *ct)
 {
-	return &ct->master.l4src.all;
+	return &ct->cold->master.l4src.all;
 }
 
 static const void *get_attr_master_port_dst(const struct nf_conntrack *ct)
 {
-	return &ct->master.l4dst.all;
+	return &ct->cold->master.l4dst.all;
 }
 
 static const void *get_attr_master_l3proto(const struct nf_conntrack *ct)
 {
-	return &ct->master.l3protonum;
+	return &ct->cold->master.l3protonum;
 }
 
 static const void *get_attr_master_l4proto(const struct nf_conntrack *ct)
 {
-	return &ct->master.protonum;
+	return &ct->cold->master.protonum;
 }
 
 static const void *get_attr_tcp_state(const struct nf_conntrack *ct)
@@ -206,32 +206,32 @@ static const void *get_attr_sctp_vtag_repl(const struct nf_conntrack *ct)
 
 static const void *get_attr_snat_ipv4(const struct nf_conntrack *ct)
 {
-	return &ct->snat.min_ip.v4;
+	return &ct->cold->snat.min_ip.v4;
 }
 
 static const void *get_attr_dnat_ipv4(const struct nf_conntrack *ct)
 {
-	return &ct->dnat.min_ip.v4;
+	return &ct->cold->dnat.min_ip.v4;
 }
 
 static const void *get_attr_snat_ipv6(const struct nf_conntrack *ct)
 {
-	return &ct->snat.min_ip.v6;
+	return &ct->cold->snat.min_ip.v6;
 }
 
 static const void *get_attr_dnat_ipv6(const struct nf_conntrack *ct)
 {
-	return &ct->dnat.min_ip.v6;
+	return &ct->cold->dnat.min_ip.v6;
 }
 
 static const void *get_attr_snat_port(const struct nf_conntrack *ct)
 {
-	return &ct->snat.l4min.all;
+	return &ct->cold->snat.l4min.all;
 }
 
 static const void *get_attr_dnat_port(const struct nf_conntrack *ct)
 {
-	return &ct->dnat.l4min.all;
+	return &ct->cold->dnat.l4min.all;
 }
 
 static const void *get_attr_timeout(const struct nf_conntrack *ct)
@@ -244,9 +244,14 @@ static const void *get_attr_mark(const struct nf_conntrack *ct)
 	return &ct->mark;
 }
 
+static const void *get_attr_mark_mask(const struct nf_conntrack *ct)
+{
+	return &ct->cold->mark_mask;
+}
+
 static const void *get_attr_secmark(const struct nf_conntrack *ct)
 {
-	return &ct->secmark;
+	return &ct->cold->secmark;
 }
 
 static const void *get_attr_orig_counter_packets(const struct nf_conntrack *ct)
@@ -286,37 +291,37 @@ static const void *get_attr_id(const struct nf_conntrack *ct)
 
 static const void *get_attr_orig_cor_pos(const struct nf_conntrack *ct)
 {
-	return &ct->natseq[__DIR_ORIG].correction_pos;
+	return &ct->cold->natseq[__DIR_ORIG].correction_pos;
 }
 
 static const void *get_attr_orig_off_bfr(const struct nf_conntrack *ct)
 {
-	return &ct->natseq[__DIR_ORIG].offset_before;
+	return &ct->cold->natseq[__DIR_ORIG].offset_before;
 }
 
 static const void *get_attr_orig_off_aft(const struct nf_conntrack *ct)
 {
-	return &ct->natseq[__DIR_ORIG].offset_after;
+	return &ct->cold->natseq[__DIR_ORIG].offset_after;
 }
 
 static const void *get_attr_repl_cor_pos(const struct nf_conntrack *ct)
 {
-	return &ct->natseq[__DIR_REPL].correction_pos;
+	return &ct->cold->natseq[__DIR_REPL].correction_pos;
 }
 
 static const void *get_attr_repl_off_bfr(const struct nf_conntrack *ct)
 {
-	return &ct->natseq[__DIR_REPL].offset_before;
+	return &ct->cold->natseq[__DIR_REPL].offset_before;
 }
 
 static const void *get_attr_repl_off_aft(const struct nf_conntrack *ct)
 {
-	return &ct->natseq[__DIR_REPL].offset_after;
+	return &ct->cold->natseq[__DIR_REPL].offset_after;
 }
 
 static const void *get_attr_helper_name(const struct nf_conntrack *ct)
 {
-	return ct->helper_name;
+	return ct->cold->helper_name;
 }
 
 static const void *get_attr_dccp_state(const struct nf_conntrack *ct)
@@ -341,32 +346,32 @@ static const void *get_attr_zone(const struct nf_conntrack *ct)
 
 static const void *get_attr_secctx(const struct nf_conntrack *ct)
 {
-	return ct->secctx;
+	return ct->cold->secctx;
 }
 
 static const void *get_attr_timestamp_start(const struct nf_conntrack *ct)
 {
-	return &ct->timestamp.start;
+	return &ct->cold->timestamp.start;
 }
 
 static const void *get_attr_timestamp_stop(const struct nf_conntrack *ct)
 {
-	return &ct->timestamp.stop;
+	return &ct->cold->timestamp.stop;
 }
 
 static const void *get_attr_helper_info(const struct nf_conntrack *ct)
 {
-	return ct->helper_info;
+	return ct->cold->helper_info;
 }
 
 static const void *get_attr_connlabels(const struct nf_conntrack *ct)
 {
-	return ct->connlabels;
+	return ct->cold->connlabels;
 }
 
 static const void *get_attr_connlabels_mask(const struct nf_conntrack *ct)
 {
-	return ct->connlabels_mask;
+	return ct->cold->connlabels_mask;
 }
 
 const get_attr get_attr_array[ATTR_MAX] = {
@@ -442,4 +447,5 @@ const get_attr get_attr_array[ATTR_MAX] = {
 	[ATTR_CONNLABELS_MASK]		= get_attr_connlabels_mask,
 	[ATTR_SNAT_IPV6]		= get_attr_snat_ipv6,
 	[ATTR_DNAT_IPV6]		= get_attr_dnat_ipv6,
+	[ATTR_MARK_MASK]		= get_attr_mark_mask,
 };
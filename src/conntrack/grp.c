@@ -102,3 +102,63 @@ const struct attr_grp_bitmask attr_grp_bitmask[ATTR_GRP_MAX]= {
 		.type = NFCT_BITMASK_OR,
 	},
 };
+
+/* attributes stored by every nested attribute that the parsers may skip */
+const uint32_t parse_bitmask[__PARSE_MAX][__NFCT_BITSET] = {
+	[__PARSE_NAT_SEQ_ORIG] = {
+		[1] = (1U << (ATTR_ORIG_NAT_SEQ_CORRECTION_POS & 31)) |
+		      (1U << (ATTR_ORIG_NAT_SEQ_OFFSET_BEFORE & 31)) |
+		      (1U << (ATTR_ORIG_NAT_SEQ_OFFSET_AFTER & 31)),
+	},
+	[__PARSE_NAT_SEQ_REPL] = {
+		[1] = (1U << (ATTR_REPL_NAT_SEQ_CORRECTION_POS & 31)) |
+		      (1U << (ATTR_REPL_NAT_SEQ_OFFSET_BEFORE & 31)) |
+		      (1U << (ATTR_REPL_NAT_SEQ_OFFSET_AFTER & 31)),
+	},
+	[__PARSE_PROTOINFO] = {
+		[0] = (1U << ATTR_TCP_STATE),
+		[1] = (1U << (ATTR_TCP_FLAGS_ORIG & 31)) |
+		      (1U << (ATTR_TCP_FLAGS_REPL & 31)) |
+		      (1U << (ATTR_TCP_MASK_ORIG & 31)) |
+		      (1U << (ATTR_TCP_MASK_REPL & 31)) |
+		      (1U << (ATTR_SCTP_STATE & 31)) |
+		      (1U << (ATTR_SCTP_VTAG_ORIG & 31)) |
+		      (1U << (ATTR_SCTP_VTAG_REPL & 31)) |
+		      (1U << (ATTR_DCCP_STATE & 31)) |
+		      (1U << (ATTR_DCCP_ROLE & 31)) |
+		      (1U << (ATTR_DCCP_HANDSHAKE_SEQ & 31)) |
+		      (1U << (ATTR_TCP_WSCALE_ORIG & 31)) |
+		      (1U << (ATTR_TCP_WSCALE_REPL & 31)),
+	},
+	[__PARSE_COUNTERS_ORIG] = {
+		[0] = (1U << ATTR_ORIG_COUNTER_PACKETS) |
+		      (1U << ATTR_ORIG_COUNTER_BYTES),
+	},
+	[__PARSE_COUNTERS_REPL] = {
+		[0] = (1U << ATTR_REPL_COUNTER_PACKETS) |
+		      (1U << ATTR_REPL_COUNTER_BYTES),
+	},
+	[__PARSE_HELPER] = {
+		[1] = (1U << (ATTR_HELPER_NAME & 31)),
+		[2] = (1U << (ATTR_HELPER_INFO & 31)),
+	},
+	[__PARSE_SECCTX] = {
+		[1] = (1U << (ATTR_SECCTX & 31)),
+	},
+	[__PARSE_TIMESTAMP] = {
+		[1] = (1U << (ATTR_TIMESTAMP_START & 31)),
+		[2] = (1U << (ATTR_TIMESTAMP_STOP & 31)),
+	},
+	[__PARSE_LABELS] = {
+		[2] = (1U << (ATTR_CONNLABELS & 31)),
+	},
+};
+
+/* attributes set in `attrs' are wanted, the others are not. */
+void __parse_mask(uint32_t *want, const struct nfct_bitmask *attrs)
+{
+	unsigned int i;
+
+	for (i = 0; i < __NFCT_BITSET; i++)
+		want[i] = i < attrs->words ? attrs->bits[i] : 0;
+}
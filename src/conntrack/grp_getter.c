@@ -62,22 +62,22 @@ static void get_attr_grp_icmp(const struct nf_conntrack *ct, void *data)
 static void get_attr_grp_master_ipv4(const struct nf_conntrack *ct, void *data)
 {
 	struct nfct_attr_grp_ipv4 *this = data;
-	this->src = ct->master.src.v4;
-	this->dst = ct->master.dst.v4;
+	this->src = ct->cold->master.src.v4;
+	this->dst = ct->cold->master.dst.v4;
 }
 
 static void get_attr_grp_master_ipv6(const struct nf_conntrack *ct, void *data)
 {
 	struct nfct_attr_grp_ipv6 *this = data;
-	memcpy(this->src, &ct->master.src.v6, sizeof(uint32_t)*4);
-	memcpy(this->dst, &ct->master.dst.v6, sizeof(uint32_t)*4);
+	memcpy(this->src, &ct->cold->master.src.v6, sizeof(uint32_t)*4);
+	memcpy(this->dst, &ct->cold->master.dst.v6, sizeof(uint32_t)*4);
 }
 
 static void get_attr_grp_master_port(const struct nf_conntrack *ct, void *data)
 {
 	struct nfct_attr_grp_port *this = data;
-	this->sport = ct->master.l4src.all;
-	this->dport = ct->master.l4dst.all;
+	this->sport = ct->cold->master.l4src.all;
+	this->dport = ct->cold->master.l4dst.all;
 }
 
 static void get_attr_grp_orig_ctrs(const struct nf_conntrack *ct, void *data)
@@ -118,24 +118,24 @@ static void set_attr_grp_icmp(struct nf_conntrack *ct, const void *value)
 static void set_attr_grp_master_ipv4(struct nf_conntrack *ct, const void *value)
 {
 	const struct nfct_attr_grp_ipv4 *this = value;
-	ct->master.src.v4 = this->src;
-	ct->master.dst.v4 = this->dst;
-	ct->master.l3protonum = AF_INET;
+	ct->cold->master.src.v4 = this->src;
+	ct->cold->master.dst.v4 = this->dst;
+	ct->cold->master.l3protonum = AF_INET;
 }
 
 static void set_attr_grp_master_ipv6(struct nf_conntrack *ct, const void *value)
 {
 	const struct nfct_attr_grp_ipv6 *this = value;
-	memcpy(&ct->master.src.v6, this->src, sizeof(uint32_t)*4);
-	memcpy(&ct->master.dst.v6, this->dst, sizeof(uint32_t)*4);
-	ct->master.l3protonum = AF_INET6;
+	memcpy(&ct->cold->master.src.v6, this->src, sizeof(uint32_t)*4);
+	memcpy(&ct->cold->master.dst.v6, this->dst, sizeof(uint32_t)*4);
+	ct->cold->master.l3protonum = AF_INET6;
 }
 
 static void set_attr_grp_master_port(struct nf_conntrack *ct, const void *value)
 {
 	const struct nfct_attr_grp_port *this = value;
-	ct->master.l4src.all = this->sport;
-	ct->master.l4dst.all = this->dport;
+	ct->cold->master.l4src.all = this->sport;
+	ct->cold->master.l4dst.all = this->dport;
 }
 
 static void set_attr_grp_do_nothing(struct nf_conntrack *ct, const void *value)
@@ -54,15 +54,15 @@ static void setobjopt_undo_snat(struct nf_conntrack *ct)
 {
 	switch (ct->head.orig.l3protonum) {
 	case AF_INET:
-		ct->snat.min_ip.v4 = ct->repl.dst.v4;
-		ct->snat.max_ip.v4 = ct->snat.min_ip.v4;
+		ct->cold->snat.min_ip.v4 = ct->repl.dst.v4;
+		ct->cold->snat.max_ip.v4 = ct->cold->snat.min_ip.v4;
 		ct->repl.dst.v4 = ct->head.orig.src.v4;
 		set_bit(ATTR_SNAT_IPV4, ct->head.set);
 		break;
 	case AF_INET6:
-		memcpy(&ct->snat.min_ip.v6, &ct->repl.dst.v6,
+		memcpy(&ct->cold->snat.min_ip.v6, &ct->repl.dst.v6,
 		       sizeof(struct in6_addr));
-		memcpy(&ct->snat.max_ip.v6, &ct->snat.min_ip.v6,
+		memcpy(&ct->cold->snat.max_ip.v6, &ct->cold->snat.min_ip.v6,
 		       sizeof(struct in6_addr));
 		memcpy(&ct->repl.dst.v6, &ct->head.orig.src.v6,
 		       sizeof(struct in6_addr));
@@ -77,14 +77,14 @@ static void setobjopt_undo_dnat(struct nf_conntrack *ct)
 {
 	switch (ct->head.orig.l3protonum) {
 	case AF_INET:
-		ct->dnat.min_ip.v4 = ct->repl.src.v4;
-		ct->dnat.max_ip.v4 = ct->dnat.min_ip.v4;
+		ct->cold->dnat.min_ip.v4 = ct->repl.src.v4;
+		ct->cold->dnat.max_ip.v4 = ct->cold->dnat.min_ip.v4;
 		ct->repl.src.v4 = ct->head.orig.dst.v4;
 		set_bit(ATTR_DNAT_IPV4, ct->head.set);
 	case AF_INET6:
-		memcpy(&ct->dnat.min_ip.v6, &ct->repl.src.v6,
+		memcpy(&ct->cold->dnat.min_ip.v6, &ct->repl.src.v6,
 		       sizeof(struct in6_addr));
-		memcpy(&ct->dnat.max_ip.v6, &ct->dnat.min_ip.v6,
+		memcpy(&ct->cold->dnat.max_ip.v6, &ct->cold->dnat.min_ip.v6,
 		       sizeof(struct in6_addr));
 		memcpy(&ct->repl.src.v6, &ct->head.orig.dst.v6,
 		       sizeof(struct in6_addr));
@@ -97,8 +97,8 @@ static void setobjopt_undo_dnat(struct nf_conntrack *ct)
 
 static void setobjopt_undo_spat(struct nf_conntrack *ct)
 {
-	ct->snat.l4min.all = ct->repl.l4dst.tcp.port;
-	ct->snat.l4max.all = ct->snat.l4min.all;
+	ct->cold->snat.l4min.all = ct->repl.l4dst.tcp.port;
+	ct->cold->snat.l4max.all = ct->cold->snat.l4min.all;
 	ct->repl.l4dst.tcp.port =
 			ct->head.orig.l4src.tcp.port;
 	set_bit(ATTR_SNAT_PORT, ct->head.set);
@@ -106,8 +106,8 @@ static void setobjopt_undo_spat(struct nf_conntrack *ct)
 
 static void setobjopt_undo_dpat(struct nf_conntrack *ct)
 {
-	ct->dnat.l4min.all = ct->repl.l4src.tcp.port;
-	ct->dnat.l4max.all = ct->dnat.l4min.all;
+	ct->cold->dnat.l4min.all = ct->repl.l4src.tcp.port;
+	ct->cold->dnat.l4max.all = ct->cold->dnat.l4min.all;
 	ct->repl.l4src.tcp.port =
 			ct->head.orig.l4dst.tcp.port;
 	set_bit(ATTR_DNAT_PORT, ct->head.set);
@@ -137,6 +137,17 @@ int __setobjopt(struct nf_conntrack *ct, unsigned int option)
 	if (unlikely(option > NFCT_SOPT_MAX))
 		return -1;
 
+	switch(option) {
+	case NFCT_SOPT_UNDO_SNAT:
+	case NFCT_SOPT_UNDO_DNAT:
+	case NFCT_SOPT_UNDO_SPAT:
+	case NFCT_SOPT_UNDO_DPAT:
+		/* the NAT attributes live in the cold extension. */
+		if (__cold_get(ct) == NULL)
+			return -1;
+		break;
+	}
+
 	setobjopt_array[option](ct);
 	return 0;
 }
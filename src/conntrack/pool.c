@@ -0,0 +1,325 @@
+/*
+ * (C) 2026 by agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <pthread.h>
+#include <assert.h>
+#include <limits.h>
+
+#include "internal/internal.h"
+#include "internal/linux_list.h"
+
+#define POOL_BATCH_DEFAULT	64
+
+/*
+ * Objects are carved out of slabs of `batch' entries. Free objects are
+ * chained through their first bytes, the cold extension and its secctx,
+ * helper_info and connlabels buffers are kept attached so that they can be
+ * recycled by the parsers.
+ */
+struct pool_slab {
+	struct pool_slab	*next;
+	unsigned int		nobjs;
+	struct nf_conntrack	objs[];
+};
+
+/* per-thread free list, it is only touched by its owner thread. */
+struct pool_cache {
+	struct list_head	head;
+	struct nfct_pool	*pool;
+	struct nf_conntrack	*free;
+	unsigned int		nfree;
+};
+
+struct nfct_pool {
+	pthread_mutex_t		lock;
+	pthread_key_t		key;
+	unsigned int		batch;
+
+	/* objects returned by the per-thread caches, protected by lock */
+	struct nf_conntrack	*free;
+	unsigned int		nfree;
+
+	struct list_head	caches;
+	struct pool_slab	*slabs;
+};
+
+#define POOL_NEXT(ct)	(*(struct nf_conntrack **)(ct))
+
+static void pool_cache_release(void *data)
+{
+	struct pool_cache *cache = data;
+	struct nfct_pool *pool = cache->pool;
+	struct nf_conntrack *ct;
+
+	pthread_mutex_lock(&pool->lock);
+	while (cache->free) {
+		ct = cache->free;
+		cache->free = POOL_NEXT(ct);
+		POOL_NEXT(ct) = pool->free;
+		pool->free = ct;
+		pool->nfree++;
+	}
+	list_del(&cache->head);
+	pthread_mutex_unlock(&pool->lock);
+	free(cache);
+}
+
+static struct pool_cache *pool_cache_get(struct nfct_pool *pool)
+{
+	struct pool_cache *cache;
+
+	cache = pthread_getspecific(pool->key);
+	if (cache)
+		return cache;
+
+	cache = calloc(1, sizeof(struct pool_cache));
+	if (cache == NULL)
+		return NULL;
+
+	cache->pool = pool;
+	if (pthread_setspecific(pool->key, cache) != 0) {
+		free(cache);
+		return NULL;
+	}
+	pthread_mutex_lock(&pool->lock);
+	list_add(&cache->head, &pool->caches);
+	pthread_mutex_unlock(&pool->lock);
+
+	return cache;
+}
+
+static int pool_slab_alloc(struct nfct_pool *pool, struct pool_cache *cache)
+{
+	struct pool_slab *slab;
+	unsigned int i;
+
+	slab = calloc(1, sizeof(struct pool_slab) +
+			 pool->batch * sizeof(struct nf_conntrack));
+	if (slab == NULL)
+		return -1;
+
+	slab->nobjs = pool->batch;
+	for (i = 0; i < slab->nobjs; i++) {
+		slab->objs[i].pool = pool;
+		POOL_NEXT(&slab->objs[i]) = cache->free;
+		cache->free = &slab->objs[i];
+	}
+	cache->nfree += slab->nobjs;
+
+	pthread_mutex_lock(&pool->lock);
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+	pthread_mutex_unlock(&pool->lock);
+
+	return 0;
+}
+
+/* move up to `batch' objects from the shared list to this thread's cache. */
+static int pool_refill(struct nfct_pool *pool, struct pool_cache *cache)
+{
+	struct nf_conntrack *ct;
+	unsigned int i;
+
+	pthread_mutex_lock(&pool->lock);
+	for (i = 0; i < pool->batch && pool->free; i++) {
+		ct = pool->free;
+		pool->free = POOL_NEXT(ct);
+		pool->nfree--;
+		POOL_NEXT(ct) = cache->free;
+		cache->free = ct;
+	}
+	pthread_mutex_unlock(&pool->lock);
+	cache->nfree += i;
+
+	if (cache->nfree > 0)
+		return 0;
+
+	return pool_slab_alloc(pool, cache);
+}
+
+/* give `batch' objects back to the shared list so other threads see them. */
+static void pool_flush(struct nfct_pool *pool, struct pool_cache *cache)
+{
+	struct nf_conntrack *first = cache->free, *last = cache->free;
+	unsigned int i;
+
+	for (i = 1; i < pool->batch; i++)
+		last = POOL_NEXT(last);
+
+	cache->free = POOL_NEXT(last);
+	cache->nfree -= pool->batch;
+
+	pthread_mutex_lock(&pool->lock);
+	POOL_NEXT(last) = pool->free;
+	pool->free = first;
+	pool->nfree += pool->batch;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+struct nfct_pool *__pool_create(unsigned int batch)
+{
+	struct nfct_pool *pool;
+
+	pool = calloc(1, sizeof(struct nfct_pool));
+	if (pool == NULL)
+		return NULL;
+
+	pool->batch = batch ? batch : POOL_BATCH_DEFAULT;
+	INIT_LIST_HEAD(&pool->caches);
+
+	errno = pthread_key_create(&pool->key, pool_cache_release);
+	if (errno != 0) {
+		free(pool);
+		return NULL;
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+
+	return pool;
+}
+
+void __pool_destroy(struct nfct_pool *pool)
+{
+	struct pool_cache *cache, *next;
+	struct pool_slab *slab;
+	unsigned int i;
+
+	pthread_key_delete(pool->key);
+
+	list_for_each_entry_safe(cache, next, &pool->caches, head)
+		free(cache);
+
+	while (pool->slabs) {
+		slab = pool->slabs;
+		pool->slabs = slab->next;
+		for (i = 0; i < slab->nobjs; i++)
+			__cold_release(&slab->objs[i]);
+		free(slab);
+	}
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+}
+
+struct nf_conntrack *__pool_get(struct nfct_pool *pool)
+{
+	struct pool_cache *cache;
+	struct nf_conntrack *ct;
+	struct __nfct_cold *cold;
+
+	cache = pool_cache_get(pool);
+	if (cache == NULL)
+		return NULL;
+
+	if (cache->nfree == 0 && pool_refill(pool, cache) < 0)
+		return NULL;
+
+	ct = cache->free;
+	cache->free = POOL_NEXT(ct);
+	cache->nfree--;
+
+	/*
+	 * keep the cold extension around, parsers recycle it together with
+	 * the side buffers that hang from it.
+	 */
+	cold = ct->cold;
+	memset(ct, 0, sizeof(struct nf_conntrack));
+	ct->pool = pool;
+	ct->cold = cold;
+
+	return ct;
+}
+
+void __pool_put(struct nfct_pool *pool, struct nf_conntrack *ct)
+{
+	struct pool_cache *cache;
+
+	assert(ct->pool == pool);
+
+	cache = pool_cache_get(pool);
+	if (cache == NULL) {
+		pthread_mutex_lock(&pool->lock);
+		POOL_NEXT(ct) = pool->free;
+		pool->free = ct;
+		pool->nfree++;
+		pthread_mutex_unlock(&pool->lock);
+		return;
+	}
+	POOL_NEXT(ct) = cache->free;
+	cache->free = ct;
+	cache->nfree++;
+
+	if (cache->nfree >= 2 * pool->batch)
+		pool_flush(pool, cache);
+}
+
+/*
+ * Side allocations: objects coming from a pool (or with an attribute that
+ * was unset) may still own a buffer, reuse it if it is large enough.
+ */
+int __pool_set_secctx(struct nf_conntrack *ct, const char *name)
+{
+	size_t len = strlen(name);
+
+	if (__cold_get(ct) == NULL)
+		return -1;
+
+	if (ct->cold->secctx && ct->cold->secctx_size > len) {
+		memcpy(ct->cold->secctx, name, len + 1);
+	} else {
+		char *secctx = strdup(name);
+
+		if (secctx == NULL)
+			return -1;
+		if (ct->cold->secctx)
+			free(ct->cold->secctx);
+		ct->cold->secctx = secctx;
+		ct->cold->secctx_size = len + 1;
+	}
+	set_bit(ATTR_SECCTX, ct->head.set);
+	return 0;
+}
+
+int __pool_set_helper_info(struct nf_conntrack *ct,
+			   const void *data, size_t len)
+{
+	if (__cold_get(ct) == NULL)
+		return -1;
+
+	if (ct->cold->helper_info == NULL || ct->cold->helper_info_len < len) {
+		void *helper_info = calloc(1, len);
+
+		if (helper_info == NULL)
+			return -1;
+		if (ct->cold->helper_info)
+			free(ct->cold->helper_info);
+		ct->cold->helper_info = helper_info;
+	}
+	memcpy(ct->cold->helper_info, data, len);
+	ct->cold->helper_info_len = len;
+	set_bit(ATTR_HELPER_INFO, ct->head.set);
+	return 0;
+}
+
+int __pool_set_labels(struct nf_conntrack *ct, const void *data, size_t len)
+{
+	unsigned int words = DIV_ROUND_UP(len, sizeof(uint32_t));
+	struct nfct_bitmask *b;
+
+	if (__cold_get(ct) == NULL)
+		return -1;
+
+	b = __labels_alloc(&ct->cold->connlabels, &ct->cold->connlabels_buf,
+			   words);
+	if (b == NULL)
+		return -1;
+
+	b->bits[words - 1] = 0;
+	memcpy(b->bits, data, len);
+	set_bit(ATTR_CONNLABELS, ct->head.set);
+	return 0;
+}
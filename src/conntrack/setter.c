@@ -237,39 +237,39 @@ set_attr_sctp_vtag_repl(struct nf_conntrack *ct, const void *value, size_t len)
 static void
 set_attr_snat_ipv4(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->snat.min_ip.v4 = ct->snat.max_ip.v4 = *((uint32_t *) value);
+	ct->cold->snat.min_ip.v4 = ct->cold->snat.max_ip.v4 = *((uint32_t *) value);
 }
 
 static void
 set_attr_dnat_ipv4(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->dnat.min_ip.v4 = ct->dnat.max_ip.v4 = *((uint32_t *) value);
+	ct->cold->dnat.min_ip.v4 = ct->cold->dnat.max_ip.v4 = *((uint32_t *) value);
 }
 
 static void
 set_attr_snat_ipv6(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	memcpy(&ct->snat.min_ip.v6, value, sizeof(struct in6_addr));
-	memcpy(&ct->snat.max_ip.v6, value, sizeof(struct in6_addr));
+	memcpy(&ct->cold->snat.min_ip.v6, value, sizeof(struct in6_addr));
+	memcpy(&ct->cold->snat.max_ip.v6, value, sizeof(struct in6_addr));
 }
 
 static void
 set_attr_dnat_ipv6(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	memcpy(&ct->dnat.min_ip.v6, value, sizeof(struct in6_addr));
-	memcpy(&ct->dnat.max_ip.v6, value, sizeof(struct in6_addr));
+	memcpy(&ct->cold->dnat.min_ip.v6, value, sizeof(struct in6_addr));
+	memcpy(&ct->cold->dnat.max_ip.v6, value, sizeof(struct in6_addr));
 }
 
 static void
 set_attr_snat_port(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->snat.l4min.all = ct->snat.l4max.all = *((uint16_t *) value);
+	ct->cold->snat.l4min.all = ct->cold->snat.l4max.all = *((uint16_t *) value);
 }
 
 static void
 set_attr_dnat_port(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->dnat.l4min.all = ct->dnat.l4max.all = *((uint16_t *) value);
+	ct->cold->dnat.l4min.all = ct->cold->dnat.l4max.all = *((uint16_t *) value);
 }
 
 static void
@@ -284,10 +284,16 @@ set_attr_mark(struct nf_conntrack *ct, const void *value, size_t len)
 	ct->mark = *((uint32_t *) value);
 }
 
+static void
+set_attr_mark_mask(struct nf_conntrack *ct, const void *value, size_t len)
+{
+	ct->cold->mark_mask = *((uint32_t *) value);
+}
+
 static void
 set_attr_secmark(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->secmark = *((uint32_t *) value);
+	ct->cold->secmark = *((uint32_t *) value);
 }
 
 static void
@@ -305,92 +311,92 @@ set_attr_id(struct nf_conntrack *ct, const void *value, size_t len)
 static void
 set_attr_master_ipv4_src(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->master.src.v4 = *((uint32_t *) value);
+	ct->cold->master.src.v4 = *((uint32_t *) value);
 }
 
 static void
 set_attr_master_ipv4_dst(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->master.dst.v4 = *((uint32_t *) value);
+	ct->cold->master.dst.v4 = *((uint32_t *) value);
 }
 
 static void
 set_attr_master_ipv6_src(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	memcpy(&ct->master.src.v6, value, sizeof(uint32_t)*4);
+	memcpy(&ct->cold->master.src.v6, value, sizeof(uint32_t)*4);
 }
 
 static void
 set_attr_master_ipv6_dst(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	memcpy(&ct->master.dst.v6, value, sizeof(uint32_t)*4);
+	memcpy(&ct->cold->master.dst.v6, value, sizeof(uint32_t)*4);
 }
 
 static void
 set_attr_master_port_src(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->master.l4src.all = *((uint16_t *) value);
+	ct->cold->master.l4src.all = *((uint16_t *) value);
 }
 
 static void
 set_attr_master_port_dst(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->master.l4dst.all = *((uint16_t *) value);
+	ct->cold->master.l4dst.all = *((uint16_t *) value);
 }
 
 static void
 set_attr_master_l3proto(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->master.l3protonum = *((uint8_t *) value);
+	ct->cold->master.l3protonum = *((uint8_t *) value);
 }
 
 static void
 set_attr_master_l4proto(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->master.protonum = *((uint8_t *) value);
+	ct->cold->master.protonum = *((uint8_t *) value);
 }
 
 static void
 set_attr_orig_cor_pos(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->natseq[__DIR_ORIG].correction_pos = *((uint32_t *) value);
+	ct->cold->natseq[__DIR_ORIG].correction_pos = *((uint32_t *) value);
 }
 
 static void
 set_attr_orig_off_bfr(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->natseq[__DIR_ORIG].offset_before = *((uint32_t *) value);
+	ct->cold->natseq[__DIR_ORIG].offset_before = *((uint32_t *) value);
 }
 
 static void
 set_attr_orig_off_aft(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->natseq[__DIR_ORIG].offset_after = *((uint32_t *) value);
+	ct->cold->natseq[__DIR_ORIG].offset_after = *((uint32_t *) value);
 }
 
 static void
 set_attr_repl_cor_pos(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->natseq[__DIR_REPL].correction_pos = *((uint32_t *) value);
+	ct->cold->natseq[__DIR_REPL].correction_pos = *((uint32_t *) value);
 }
 
 static void
 set_attr_repl_off_bfr(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->natseq[__DIR_REPL].offset_before = *((uint32_t *) value);
+	ct->cold->natseq[__DIR_REPL].offset_before = *((uint32_t *) value);
 }
 
 static void
 set_attr_repl_off_aft(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	ct->natseq[__DIR_REPL].offset_after = *((uint32_t *) value);
+	ct->cold->natseq[__DIR_REPL].offset_after = *((uint32_t *) value);
 }
 
 static void
 set_attr_helper_name(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	strncpy(ct->helper_name, value, NFCT_HELPER_NAME_MAX);
-	ct->helper_name[NFCT_HELPER_NAME_MAX-1] = '\0';
+	strncpy(ct->cold->helper_name, value, NFCT_HELPER_NAME_MAX);
+	ct->cold->helper_name[NFCT_HELPER_NAME_MAX-1] = '\0';
 }
 
 static void
@@ -433,38 +439,31 @@ set_attr_zone(struct nf_conntrack *ct, const void *value, size_t len)
 static void
 set_attr_helper_info(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	if (ct->helper_info == NULL) {
-retry:
-		ct->helper_info = calloc(1, len);
-		if (ct->helper_info == NULL)
-			return;
-
-		memcpy(ct->helper_info, value, len);
-	} else {
-		free(ct->helper_info);
-		goto retry;
-	}
+	__pool_set_helper_info(ct, value, len);
 }
 
 static void
-do_set_attr_connlabels(struct nfct_bitmask *current, const void *value)
+do_set_attr_connlabels(struct nfct_bitmask *current, struct __nfct_labels *buf,
+		       const void *value)
 {
-	if (current && current != value)
-		nfct_bitmask_destroy(current);
+	if (current != value)
+		__labels_free(current, buf);
 }
 
 static void
 set_attr_connlabels(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	do_set_attr_connlabels(ct->connlabels, value);
-	ct->connlabels = (void *) value;
+	do_set_attr_connlabels(ct->cold->connlabels, &ct->cold->connlabels_buf,
+			       value);
+	ct->cold->connlabels = (void *) value;
 }
 
 static void
 set_attr_connlabels_mask(struct nf_conntrack *ct, const void *value, size_t len)
 {
-	do_set_attr_connlabels(ct->connlabels_mask, value);
-	ct->connlabels_mask = (void *) value;
+	do_set_attr_connlabels(ct->cold->connlabels_mask,
+			       &ct->cold->connlabels_mask_buf, value);
+	ct->cold->connlabels_mask = (void *) value;
 }
 
 static void
@@ -543,4 +542,5 @@ const set_attr set_attr_array[ATTR_MAX] = {
 	[ATTR_CONNLABELS_MASK]	= set_attr_connlabels_mask,
 	[ATTR_SNAT_IPV6]	= set_attr_snat_ipv6,
 	[ATTR_DNAT_IPV6]	= set_attr_dnat_ipv6,
+	[ATTR_MARK_MASK]	= set_attr_mark_mask,
 };
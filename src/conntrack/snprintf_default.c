@@ -221,7 +221,7 @@ __snprintf_mark(char *buf, unsigned int len, const struct nf_conntrack *ct)
 static int
 __snprintf_secmark(char *buf, unsigned int len, const struct nf_conntrack *ct)
 {
-	return (snprintf(buf, len, "secmark=%u ", ct->secmark));
+	return (snprintf(buf, len, "secmark=%u ", ct->cold->secmark));
 }
 
 static int
@@ -245,14 +245,14 @@ __snprintf_zone(char *buf, unsigned int len, const struct nf_conntrack *ct)
 static int
 __snprintf_secctx(char *buf, unsigned int len, const struct nf_conntrack *ct)
 {
-	return (snprintf(buf, len, "secctx=%s ", ct->secctx));
+	return (snprintf(buf, len, "secctx=%s ", ct->cold->secctx));
 }
 
 static int
 __snprintf_timestamp_start(char *buf, unsigned int len,
 			   const struct nf_conntrack *ct)
 {
-	time_t start = (time_t)(ct->timestamp.start / NSEC_PER_SEC);
+	time_t start = (time_t)(ct->cold->timestamp.start / NSEC_PER_SEC);
 	char *tmp = ctime(&start);
 
 	/* overwrite \n in the ctime() output. */
@@ -264,7 +264,7 @@ static int
 __snprintf_timestamp_stop(char *buf, unsigned int len,
 			  const struct nf_conntrack *ct)
 {
-	time_t stop = (time_t)(ct->timestamp.stop / NSEC_PER_SEC);
+	time_t stop = (time_t)(ct->cold->timestamp.stop / NSEC_PER_SEC);
 	char *tmp = ctime(&stop);
 
 	/* overwrite \n in the ctime() output. */
@@ -278,12 +278,12 @@ __snprintf_timestamp_delta(char *buf, unsigned int len,
 {
 	time_t delta_time, stop;
 
-	if (ct->timestamp.stop == 0)
+	if (ct->cold->timestamp.stop == 0)
 		time(&stop);
 	else
-		stop = (time_t)(ct->timestamp.stop / NSEC_PER_SEC);
+		stop = (time_t)(ct->cold->timestamp.stop / NSEC_PER_SEC);
 
-	delta_time = stop - (time_t)(ct->timestamp.start / NSEC_PER_SEC);
+	delta_time = stop - (time_t)(ct->cold->timestamp.start / NSEC_PER_SEC);
 
 	return (snprintf(buf, len, "delta-time=%llu ",
 			(unsigned long long)delta_time));
@@ -292,7 +292,7 @@ __snprintf_timestamp_delta(char *buf, unsigned int len,
 static int
 __snprintf_helper_name(char *buf, unsigned int len, const struct nf_conntrack *ct)
 {
-	return (snprintf(buf, len, "helper=%s ", ct->helper_name));
+	return (snprintf(buf, len, "helper=%s ", ct->cold->helper_name));
 }
 
 int
@@ -186,7 +186,7 @@ __snprintf_timestamp_start(char *buf, unsigned int len,
 	unsigned int size = 0, offset = 0;
 
 	ret = snprintf(buf, len, "<start>%llu</start>",
-		       (unsigned long long)ct->timestamp.start);
+		       (unsigned long long)ct->cold->timestamp.start);
 	BUFFER_SIZE(ret, size, len, offset);
 
 	return size;
@@ -200,7 +200,7 @@ __snprintf_timestamp_stop(char *buf, unsigned int len,
 	unsigned int size = 0, offset = 0;
 
 	ret = snprintf(buf, len, "<stop>%llu</stop>",
-		       (unsigned long long)ct->timestamp.stop);
+		       (unsigned long long)ct->cold->timestamp.stop);
 	BUFFER_SIZE(ret, size, len, offset);
 
 	return size;
@@ -215,7 +215,7 @@ __snprintf_deltatime_now(char *buf, unsigned int len,
 	time_t now, delta_time;
 
 	time(&now);
-        delta_time = now - (time_t)(ct->timestamp.start / NSEC_PER_SEC);
+        delta_time = now - (time_t)(ct->cold->timestamp.start / NSEC_PER_SEC);
 
 	ret = snprintf(buf+offset, len, "<deltatime>%llu</deltatime>",
 		(unsigned long long)delta_time);
@@ -229,8 +229,8 @@ __snprintf_deltatime(char *buf, unsigned int len, const struct nf_conntrack *ct)
 {
 	int ret;
 	unsigned int size = 0, offset = 0;
-	time_t delta_time = (time_t)((ct->timestamp.stop -
-				ct->timestamp.start) / NSEC_PER_SEC);
+	time_t delta_time = (time_t)((ct->cold->timestamp.stop -
+				ct->cold->timestamp.start) / NSEC_PER_SEC);
 
 	ret = snprintf(buf+offset, len, "<deltatime>%llu</deltatime>",
 		(unsigned long long)delta_time);
@@ -245,7 +245,7 @@ __snprintf_helper_name(char *buf, unsigned int len, const struct nf_conntrack *c
 	int ret;
 	unsigned int size = 0, offset = 0;
 
-	ret = snprintf(buf+offset, len, "<helper>%s</helper>", ct->helper_name);
+	ret = snprintf(buf+offset, len, "<helper>%s</helper>", ct->cold->helper_name);
 	BUFFER_SIZE(ret, size, len, offset);
 
 	return size;
@@ -471,13 +471,13 @@ int __snprintf_conntrack_xml(char *buf,
 
 	if (test_bit(ATTR_SECMARK, ct->head.set)) {
 		ret = snprintf(buf+offset, len, 
-				"<secmark>%u</secmark>", ct->secmark);
+				"<secmark>%u</secmark>", ct->cold->secmark);
 		BUFFER_SIZE(ret, size, len, offset);
 	}
 
 	if (test_bit(ATTR_SECCTX, ct->head.set)) {
 		ret = snprintf(buf+offset, len,
-				"<secctx>%s</secctx>", ct->secctx);
+				"<secctx>%s</secctx>", ct->cold->secctx);
 		BUFFER_SIZE(ret, size, len, offset);
 	}
 
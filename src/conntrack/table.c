@@ -0,0 +1,147 @@
+/*
+ * (C) 2026 by agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "internal/internal.h"
+
+#define TABLE_SIZE_MIN	256
+
+/* one array per column, row i of the table is element i of every array. */
+struct nfct_table {
+	unsigned int	len;
+	unsigned int	size;
+	void		*col[NFCT_COL_MAX];
+};
+
+/*
+ * Source attributes of every column: the IPv4 attribute is tried first,
+ * then the IPv6 one. Shorter values are zero-padded up to the column size.
+ */
+static const struct {
+	uint8_t		size;
+	uint8_t		attr[2];
+	uint8_t		len[2];
+} table_col[NFCT_COL_MAX] = {
+	[NFCT_COL_L3PROTO]	= { 1, { ATTR_ORIG_L3PROTO, ATTR_ORIG_L3PROTO },
+				       { 1, 1 } },
+	[NFCT_COL_L4PROTO]	= { 1, { ATTR_ORIG_L4PROTO, ATTR_ORIG_L4PROTO },
+				       { 1, 1 } },
+	[NFCT_COL_ORIG_SRC]	= { 16, { ATTR_ORIG_IPV4_SRC, ATTR_ORIG_IPV6_SRC },
+					{ 4, 16 } },
+	[NFCT_COL_ORIG_DST]	= { 16, { ATTR_ORIG_IPV4_DST, ATTR_ORIG_IPV6_DST },
+					{ 4, 16 } },
+	[NFCT_COL_REPL_SRC]	= { 16, { ATTR_REPL_IPV4_SRC, ATTR_REPL_IPV6_SRC },
+					{ 4, 16 } },
+	[NFCT_COL_REPL_DST]	= { 16, { ATTR_REPL_IPV4_DST, ATTR_REPL_IPV6_DST },
+					{ 4, 16 } },
+	[NFCT_COL_ORIG_PORT_SRC] = { 2, { ATTR_ORIG_PORT_SRC, ATTR_ORIG_PORT_SRC },
+					{ 2, 2 } },
+	[NFCT_COL_ORIG_PORT_DST] = { 2, { ATTR_ORIG_PORT_DST, ATTR_ORIG_PORT_DST },
+					{ 2, 2 } },
+	[NFCT_COL_REPL_PORT_SRC] = { 2, { ATTR_REPL_PORT_SRC, ATTR_REPL_PORT_SRC },
+					{ 2, 2 } },
+	[NFCT_COL_REPL_PORT_DST] = { 2, { ATTR_REPL_PORT_DST, ATTR_REPL_PORT_DST },
+					{ 2, 2 } },
+	[NFCT_COL_STATUS]	= { 4, { ATTR_STATUS, ATTR_STATUS }, { 4, 4 } },
+	[NFCT_COL_MARK]		= { 4, { ATTR_MARK, ATTR_MARK }, { 4, 4 } },
+	[NFCT_COL_ZONE]		= { 2, { ATTR_ZONE, ATTR_ZONE }, { 2, 2 } },
+	[NFCT_COL_TIMEOUT]	= { 4, { ATTR_TIMEOUT, ATTR_TIMEOUT }, { 4, 4 } },
+	[NFCT_COL_ID]		= { 4, { ATTR_ID, ATTR_ID }, { 4, 4 } },
+	[NFCT_COL_ORIG_PACKETS]	= { 8, { ATTR_ORIG_COUNTER_PACKETS,
+					 ATTR_ORIG_COUNTER_PACKETS }, { 8, 8 } },
+	[NFCT_COL_ORIG_BYTES]	= { 8, { ATTR_ORIG_COUNTER_BYTES,
+					 ATTR_ORIG_COUNTER_BYTES }, { 8, 8 } },
+	[NFCT_COL_REPL_PACKETS]	= { 8, { ATTR_REPL_COUNTER_PACKETS,
+					 ATTR_REPL_COUNTER_PACKETS }, { 8, 8 } },
+	[NFCT_COL_REPL_BYTES]	= { 8, { ATTR_REPL_COUNTER_BYTES,
+					 ATTR_REPL_COUNTER_BYTES }, { 8, 8 } },
+};
+
+struct nfct_table *__table_new(void)
+{
+	return calloc(1, sizeof(struct nfct_table));
+}
+
+void __table_destroy(struct nfct_table *t)
+{
+	int i;
+
+	for (i = 0; i < NFCT_COL_MAX; i++)
+		free(t->col[i]);
+	free(t);
+}
+
+void __table_reset(struct nfct_table *t)
+{
+	t->len = 0;
+}
+
+unsigned int __table_len(const struct nfct_table *t)
+{
+	return t->len;
+}
+
+const void *__table_column(const struct nfct_table *t, int col)
+{
+	return t->col[col];
+}
+
+static int table_grow(struct nfct_table *t)
+{
+	unsigned int size = t->size ? t->size * 2 : TABLE_SIZE_MIN;
+	void *col;
+	int i;
+
+	/* columns that were already grown keep their new size on failure. */
+	for (i = 0; i < NFCT_COL_MAX; i++) {
+		col = realloc(t->col[i], (size_t)size * table_col[i].size);
+		if (col == NULL)
+			return -1;
+		t->col[i] = col;
+	}
+	t->size = size;
+
+	return 0;
+}
+
+int __table_add(struct nfct_table *t, const struct nlmsghdr *nlh)
+{
+	struct nfct_view v;
+	unsigned int row;
+	int i, j;
+
+	if (t->len == t->size && table_grow(t) < 0)
+		return -1;
+
+	__view_init(&v, nlh);
+
+	row = t->len++;
+	for (i = 0; i < NFCT_COL_MAX; i++) {
+		char *cell = (char *)t->col[i] + row * table_col[i].size;
+
+		memset(cell, 0, table_col[i].size);
+		for (j = 0; j < 2; j++) {
+			int type = table_col[i].attr[j];
+
+			if (test_bit(type, v.set)) {
+				memcpy(cell, __view_get_attr(&v, type),
+				       table_col[i].len[j]);
+				break;
+			}
+		}
+	}
+	return 0;
+}
+
+int __table_callback(struct nlmsghdr *nlh, struct nfattr *nfa[], void *data)
+{
+	if (__table_add(data, nlh) < 0)
+		return NFNL_CB_FAILURE;
+
+	return NFNL_CB_CONTINUE;
+}
@@ -0,0 +1,293 @@
+/*
+ * (C) 2026 by agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "internal/internal.h"
+#include <assert.h>
+#include <libmnl/libmnl.h>
+
+/*
+ * Message templates: the attributes of a conntrack are serialized once, the
+ * offset of the payload of the attributes that can be patched is recorded.
+ * Building a message out of a template is a copy.
+ */
+struct nfct_template {
+	uint8_t		family;
+	size_t		len;
+	char		*data;
+	/* offset of the payload in data, 0 if the attribute is not there */
+	uint16_t	off[ATTR_MAX];
+};
+
+/* attributes of the tuple nests, per direction */
+static const struct {
+	uint8_t		ipv4[2];
+	uint8_t		ipv6[2];
+	uint8_t		port[2];
+} template_tuple[2] = {
+	[__DIR_ORIG] = {
+		.ipv4	= { ATTR_ORIG_IPV4_SRC, ATTR_ORIG_IPV4_DST },
+		.ipv6	= { ATTR_ORIG_IPV6_SRC, ATTR_ORIG_IPV6_DST },
+		.port	= { ATTR_ORIG_PORT_SRC, ATTR_ORIG_PORT_DST },
+	},
+	[__DIR_REPL] = {
+		.ipv4	= { ATTR_REPL_IPV4_SRC, ATTR_REPL_IPV4_DST },
+		.ipv6	= { ATTR_REPL_IPV6_SRC, ATTR_REPL_IPV6_DST },
+		.port	= { ATTR_REPL_PORT_SRC, ATTR_REPL_PORT_DST },
+	},
+};
+
+/* payload length of the attributes that can be patched, 0 if not */
+static size_t template_attr_len(unsigned int type)
+{
+	switch(type) {
+	case ATTR_ORIG_IPV4_SRC:
+	case ATTR_ORIG_IPV4_DST:
+	case ATTR_REPL_IPV4_SRC:
+	case ATTR_REPL_IPV4_DST:
+	case ATTR_MARK:
+	case ATTR_TIMEOUT:
+		return sizeof(uint32_t);
+	case ATTR_ORIG_IPV6_SRC:
+	case ATTR_ORIG_IPV6_DST:
+	case ATTR_REPL_IPV6_SRC:
+	case ATTR_REPL_IPV6_DST:
+		return sizeof(struct in6_addr);
+	case ATTR_ORIG_PORT_SRC:
+	case ATTR_ORIG_PORT_DST:
+	case ATTR_REPL_PORT_SRC:
+	case ATTR_REPL_PORT_DST:
+		return sizeof(uint16_t);
+	}
+	return 0;
+}
+
+static void template_record(struct nfct_template *t, unsigned int type,
+			    const struct nlattr *attr)
+{
+	if (mnl_attr_get_payload_len(attr) != template_attr_len(type))
+		return;
+
+	t->off[type] = (const char *)mnl_attr_get_payload(attr) - t->data;
+}
+
+static void template_tuple_record(struct nfct_template *t,
+				  const struct nlattr *nest, int dir)
+{
+	const uint8_t *ipv4 = template_tuple[dir].ipv4;
+	const uint8_t *ipv6 = template_tuple[dir].ipv6;
+	const uint8_t *port = template_tuple[dir].port;
+	const struct nlattr *attr, *a;
+	unsigned int type;
+
+	mnl_attr_for_each_nested(attr, nest) {
+		if (mnl_attr_get_type(attr) == CTA_TUPLE_IP) {
+			mnl_attr_for_each_nested(a, attr) {
+				type = mnl_attr_get_type(a);
+				if (type == CTA_IP_V4_SRC || type == CTA_IP_V4_DST)
+					template_record(t, ipv4[type - CTA_IP_V4_SRC],
+							a);
+				else if (type == CTA_IP_V6_SRC || type == CTA_IP_V6_DST)
+					template_record(t, ipv6[type - CTA_IP_V6_SRC],
+							a);
+			}
+		} else if (mnl_attr_get_type(attr) == CTA_TUPLE_PROTO) {
+			mnl_attr_for_each_nested(a, attr) {
+				type = mnl_attr_get_type(a);
+				if (type == CTA_PROTO_SRC_PORT ||
+				    type == CTA_PROTO_DST_PORT)
+					template_record(t,
+							port[type - CTA_PROTO_SRC_PORT],
+							a);
+			}
+		}
+	}
+}
+
+/**
+ * \defgroup template Message templates
+ * @{
+ */
+
+/**
+ * nfct_template_compile - serialize a conntrack into a message template
+ * \param ct pointer to a valid conntrack object
+ *
+ * The conntrack is built with nfct_nlmsg_build() once. The addresses and
+ * ports of both tuples, the mark and the timeout can then be changed with
+ * nfct_template_set_attr(), which patches the bytes of the message in place,
+ * as long as they are set in the conntrack. Use it to create many similar
+ * conntracks.
+ *
+ * In case of success, this function returns a valid pointer to the template,
+ * otherwise NULL is returned and errno is set appropiately.
+ */
+struct nfct_template *nfct_template_compile(const struct nf_conntrack *ct)
+{
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	struct nfct_template *t;
+	struct nlmsghdr *nlh;
+	const struct nlattr *attr;
+	void *payload;
+
+	assert(ct != NULL);
+
+	nlh = mnl_nlmsg_put_header(buf);
+	payload = mnl_nlmsg_put_extra_header(nlh, sizeof(struct nfgenmsg));
+	if (nfct_nlmsg_build(nlh, ct) < 0)
+		return NULL;
+
+	t = calloc(1, sizeof(struct nfct_template));
+	if (t == NULL)
+		return NULL;
+
+	t->family = ct->head.orig.l3protonum;
+	t->len = nlh->nlmsg_len - ((char *)payload - buf) -
+		 sizeof(struct nfgenmsg);
+	t->data = malloc(t->len);
+	if (t->data == NULL) {
+		free(t);
+		return NULL;
+	}
+	memcpy(t->data, (char *)payload + sizeof(struct nfgenmsg), t->len);
+
+	mnl_attr_for_each_payload((const void *)t->data, t->len) {
+		switch(mnl_attr_get_type(attr)) {
+		case CTA_TUPLE_ORIG:
+			template_tuple_record(t, attr, __DIR_ORIG);
+			break;
+		case CTA_TUPLE_REPLY:
+			template_tuple_record(t, attr, __DIR_REPL);
+			break;
+		case CTA_MARK:
+			template_record(t, ATTR_MARK, attr);
+			break;
+		case CTA_TIMEOUT:
+			template_record(t, ATTR_TIMEOUT, attr);
+			break;
+		}
+	}
+	return t;
+}
+
+/**
+ * nfct_template_destroy - release a message template
+ * \param t pointer to the template
+ */
+void nfct_template_destroy(struct nfct_template *t)
+{
+	assert(t != NULL);
+
+	free(t->data);
+	free(t);
+}
+
+/**
+ * nfct_template_set_attr - patch an attribute of a message template
+ * \param t pointer to the template
+ * \param type attribute type
+ * \param value pointer to the attribute value
+ *
+ * The value has the same format as in nfct_set_attr(): addresses and ports
+ * in network byte order, the mark and the timeout in host byte order.
+ *
+ * On error, -1 is returned and errno is set appropiately: ENOENT if the
+ * attribute was not set in the conntrack the template was compiled from,
+ * EINVAL if it cannot be patched. On success, 0 is returned.
+ */
+int nfct_template_set_attr(struct nfct_template *t,
+			   const enum nf_conntrack_attr type,
+			   const void *value)
+{
+	size_t len;
+	uint32_t v;
+
+	assert(t != NULL);
+	assert(value != NULL);
+
+	len = template_attr_len(type);
+	if (unlikely(len == 0)) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (unlikely(t->off[type] == 0)) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	if (type == ATTR_MARK || type == ATTR_TIMEOUT) {
+		v = htonl(*((const uint32_t *)value));
+		value = &v;
+	}
+	memcpy(t->data + t->off[type], value, len);
+
+	return 0;
+}
+
+/**
+ * nfct_template_set_attr_u16 - patch an attribute of a message template
+ * \param t pointer to the template
+ * \param type attribute type
+ * \param value unsigned 16 bits attribute value
+ */
+int nfct_template_set_attr_u16(struct nfct_template *t,
+			       const enum nf_conntrack_attr type,
+			       uint16_t value)
+{
+	return nfct_template_set_attr(t, type, &value);
+}
+
+/**
+ * nfct_template_set_attr_u32 - patch an attribute of a message template
+ * \param t pointer to the template
+ * \param type attribute type
+ * \param value unsigned 32 bits attribute value
+ */
+int nfct_template_set_attr_u32(struct nfct_template *t,
+			       const enum nf_conntrack_attr type,
+			       uint32_t value)
+{
+	return nfct_template_set_attr(t, type, &value);
+}
+
+/**
+ * nfct_template_build - build a message out of a template
+ * \param t pointer to the template
+ * \param nlh pointer to the Netlink message
+ *
+ * This is the counterpart of nfct_nlmsg_build(): the attributes of the
+ * template are appended to the message, which must have room for them.
+ * The family of the nfgenmsg header is left to the caller, see
+ * nfct_template_family().
+ *
+ * This function returns 0.
+ */
+int nfct_template_build(const struct nfct_template *t, struct nlmsghdr *nlh)
+{
+	assert(t != NULL);
+	assert(nlh != NULL);
+
+	memcpy(mnl_nlmsg_get_payload_tail(nlh), t->data, t->len);
+	nlh->nlmsg_len += MNL_ALIGN(t->len);
+
+	return 0;
+}
+
+/**
+ * nfct_template_family - get the layer 3 protocol of a template
+ * \param t pointer to the template
+ */
+uint8_t nfct_template_family(const struct nfct_template *t)
+{
+	assert(t != NULL);
+	return t->family;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,548 @@
+/*
+ * (C) 2026 by agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "internal/internal.h"
+#include <linux/netlink.h>
+#include <endian.h>
+#include <stddef.h>
+
+/*
+ * A view indexes a ctnetlink message in one single pass: for every attribute
+ * found, it records the offset of its payload from the beginning of the
+ * message. Values are only decoded when requested. Those whose in-object
+ * representation is the same as the one in the message (addresses, ports,
+ * protocol numbers, strings, ...) are returned in place.
+ */
+
+enum {
+	VIEW_RAW = 0,		/* returned in place */
+	VIEW_BE16,
+	VIEW_BE32,
+	VIEW_BE64,
+	VIEW_COUNTER,		/* 64 or 32 bits, in big endian */
+	VIEW_LABELS,
+};
+
+static const uint8_t view_kind[ATTR_MAX] = {
+	[ATTR_TIMEOUT]				= VIEW_BE32,
+	[ATTR_MARK]				= VIEW_BE32,
+	[ATTR_ORIG_COUNTER_PACKETS]		= VIEW_COUNTER,
+	[ATTR_REPL_COUNTER_PACKETS]		= VIEW_COUNTER,
+	[ATTR_ORIG_COUNTER_BYTES]		= VIEW_COUNTER,
+	[ATTR_REPL_COUNTER_BYTES]		= VIEW_COUNTER,
+	[ATTR_USE]				= VIEW_BE32,
+	[ATTR_ID]				= VIEW_BE32,
+	[ATTR_STATUS]				= VIEW_BE32,
+	[ATTR_SECMARK]				= VIEW_BE32,
+	[ATTR_ORIG_NAT_SEQ_CORRECTION_POS]	= VIEW_BE32,
+	[ATTR_ORIG_NAT_SEQ_OFFSET_BEFORE]	= VIEW_BE32,
+	[ATTR_ORIG_NAT_SEQ_OFFSET_AFTER]	= VIEW_BE32,
+	[ATTR_REPL_NAT_SEQ_CORRECTION_POS]	= VIEW_BE32,
+	[ATTR_REPL_NAT_SEQ_OFFSET_BEFORE]	= VIEW_BE32,
+	[ATTR_REPL_NAT_SEQ_OFFSET_AFTER]	= VIEW_BE32,
+	[ATTR_SCTP_VTAG_ORIG]			= VIEW_BE32,
+	[ATTR_SCTP_VTAG_REPL]			= VIEW_BE32,
+	[ATTR_DCCP_HANDSHAKE_SEQ]		= VIEW_BE64,
+	[ATTR_ZONE]				= VIEW_BE16,
+	[ATTR_ORIG_ZONE]			= VIEW_BE16,
+	[ATTR_REPL_ZONE]			= VIEW_BE16,
+	[ATTR_TIMESTAMP_START]			= VIEW_BE64,
+	[ATTR_TIMESTAMP_STOP]			= VIEW_BE64,
+	[ATTR_CONNLABELS]			= VIEW_LABELS,
+};
+
+#define VIEW_ATTR_OK(a, rem)					\
+	((rem) >= (int)sizeof(struct nlattr) &&			\
+	 (a)->nla_len >= sizeof(struct nlattr) &&		\
+	 (a)->nla_len <= (rem))
+
+#define VIEW_ATTR_NEXT(a, rem)					\
+	((rem) -= NLA_ALIGN((a)->nla_len),			\
+	 (const struct nlattr *)((const char *)(a) + NLA_ALIGN((a)->nla_len)))
+
+#define VIEW_ATTR_TYPE(a)	((a)->nla_type & NLA_TYPE_MASK)
+#define VIEW_ATTR_DATA(a)	((const char *)(a) + NLA_HDRLEN)
+#define VIEW_ATTR_LEN(a)	((int)(a)->nla_len - NLA_HDRLEN)
+
+#define view_for_each_nested(pos, nest, rem)			\
+	for (pos = (const struct nlattr *)VIEW_ATTR_DATA(nest),	\
+	     rem = VIEW_ATTR_LEN(nest);				\
+	     VIEW_ATTR_OK(pos, rem);				\
+	     pos = VIEW_ATTR_NEXT(pos, rem))
+
+static inline void
+view_index(struct nfct_view *v, int type, const char *data, int len, int min)
+{
+	size_t off = data - (const char *)v->nlh;
+
+	if (len < min || off > UINT16_MAX)
+		return;
+
+	v->off[type] = off;
+	set_bit(type, v->set);
+}
+
+#define VIEW_INDEX(v, type, a, min) \
+	view_index(v, type, VIEW_ATTR_DATA(a), VIEW_ATTR_LEN(a), min)
+
+static const int view_ipv4_src[] = {
+	[__DIR_ORIG]	= ATTR_ORIG_IPV4_SRC,
+	[__DIR_REPL]	= ATTR_REPL_IPV4_SRC,
+	[__DIR_MASTER]	= ATTR_MASTER_IPV4_SRC,
+};
+static const int view_ipv4_dst[] = {
+	[__DIR_ORIG]	= ATTR_ORIG_IPV4_DST,
+	[__DIR_REPL]	= ATTR_REPL_IPV4_DST,
+	[__DIR_MASTER]	= ATTR_MASTER_IPV4_DST,
+};
+static const int view_ipv6_src[] = {
+	[__DIR_ORIG]	= ATTR_ORIG_IPV6_SRC,
+	[__DIR_REPL]	= ATTR_REPL_IPV6_SRC,
+	[__DIR_MASTER]	= ATTR_MASTER_IPV6_SRC,
+};
+static const int view_ipv6_dst[] = {
+	[__DIR_ORIG]	= ATTR_ORIG_IPV6_DST,
+	[__DIR_REPL]	= ATTR_REPL_IPV6_DST,
+	[__DIR_MASTER]	= ATTR_MASTER_IPV6_DST,
+};
+static const int view_l3proto[] = {
+	[__DIR_ORIG]	= ATTR_ORIG_L3PROTO,
+	[__DIR_REPL]	= ATTR_REPL_L3PROTO,
+	[__DIR_MASTER]	= ATTR_MASTER_L3PROTO,
+};
+static const int view_l4proto[] = {
+	[__DIR_ORIG]	= ATTR_ORIG_L4PROTO,
+	[__DIR_REPL]	= ATTR_REPL_L4PROTO,
+	[__DIR_MASTER]	= ATTR_MASTER_L4PROTO,
+};
+static const int view_port_src[] = {
+	[__DIR_ORIG]	= ATTR_ORIG_PORT_SRC,
+	[__DIR_REPL]	= ATTR_REPL_PORT_SRC,
+	[__DIR_MASTER]	= ATTR_MASTER_PORT_SRC,
+};
+static const int view_port_dst[] = {
+	[__DIR_ORIG]	= ATTR_ORIG_PORT_DST,
+	[__DIR_REPL]	= ATTR_REPL_PORT_DST,
+	[__DIR_MASTER]	= ATTR_MASTER_PORT_DST,
+};
+
+static void view_ip(struct nfct_view *v, const struct nlattr *nest, int dir)
+{
+	const struct nlattr *a;
+	int rem;
+
+	view_for_each_nested(a, nest, rem) {
+		switch(VIEW_ATTR_TYPE(a)) {
+		case CTA_IP_V4_SRC:
+			VIEW_INDEX(v, view_ipv4_src[dir], a, sizeof(uint32_t));
+			break;
+		case CTA_IP_V4_DST:
+			VIEW_INDEX(v, view_ipv4_dst[dir], a, sizeof(uint32_t));
+			break;
+		case CTA_IP_V6_SRC:
+			VIEW_INDEX(v, view_ipv6_src[dir], a,
+				   sizeof(struct in6_addr));
+			break;
+		case CTA_IP_V6_DST:
+			VIEW_INDEX(v, view_ipv6_dst[dir], a,
+				   sizeof(struct in6_addr));
+			break;
+		}
+	}
+}
+
+static void view_proto(struct nfct_view *v, const struct nlattr *nest, int dir)
+{
+	const struct nlattr *a;
+	int rem;
+
+	view_for_each_nested(a, nest, rem) {
+		switch(VIEW_ATTR_TYPE(a)) {
+		case CTA_PROTO_NUM:
+			VIEW_INDEX(v, view_l4proto[dir], a, sizeof(uint8_t));
+			break;
+		case CTA_PROTO_SRC_PORT:
+			VIEW_INDEX(v, view_port_src[dir], a, sizeof(uint16_t));
+			break;
+		case CTA_PROTO_DST_PORT:
+			VIEW_INDEX(v, view_port_dst[dir], a, sizeof(uint16_t));
+			break;
+		/* ICMP attributes are only exposed for the original tuple */
+		case CTA_PROTO_ICMP_TYPE:
+		case CTA_PROTO_ICMPV6_TYPE:
+			if (dir == __DIR_ORIG)
+				VIEW_INDEX(v, ATTR_ICMP_TYPE, a, sizeof(uint8_t));
+			break;
+		case CTA_PROTO_ICMP_CODE:
+		case CTA_PROTO_ICMPV6_CODE:
+			if (dir == __DIR_ORIG)
+				VIEW_INDEX(v, ATTR_ICMP_CODE, a, sizeof(uint8_t));
+			break;
+		case CTA_PROTO_ICMP_ID:
+		case CTA_PROTO_ICMPV6_ID:
+			if (dir == __DIR_ORIG)
+				VIEW_INDEX(v, ATTR_ICMP_ID, a, sizeof(uint16_t));
+			break;
+		}
+	}
+}
+
+static void view_tuple(struct nfct_view *v, const struct nlattr *nest, int dir)
+{
+	const struct nlattr *a;
+	int rem;
+
+	/* the layer 3 protocol comes from the nfgenmsg header */
+	view_index(v, view_l3proto[dir],
+		   (const char *)NLMSG_DATA(v->nlh) +
+		   offsetof(struct nfgenmsg, nfgen_family),
+		   sizeof(uint8_t), sizeof(uint8_t));
+
+	view_for_each_nested(a, nest, rem) {
+		switch(VIEW_ATTR_TYPE(a)) {
+		case CTA_TUPLE_IP:
+			view_ip(v, a, dir);
+			break;
+		case CTA_TUPLE_PROTO:
+			view_proto(v, a, dir);
+			break;
+		case CTA_TUPLE_ZONE:
+			if (dir == __DIR_ORIG)
+				VIEW_INDEX(v, ATTR_ORIG_ZONE, a,
+					   sizeof(uint16_t));
+			else if (dir == __DIR_REPL)
+				VIEW_INDEX(v, ATTR_REPL_ZONE, a,
+					   sizeof(uint16_t));
+			break;
+		}
+	}
+}
+
+static void view_protoinfo_tcp(struct nfct_view *v, const struct nlattr *nest)
+{
+	const struct nlattr *a;
+	int rem;
+
+	view_for_each_nested(a, nest, rem) {
+		switch(VIEW_ATTR_TYPE(a)) {
+		case CTA_PROTOINFO_TCP_STATE:
+			VIEW_INDEX(v, ATTR_TCP_STATE, a, sizeof(uint8_t));
+			break;
+		case CTA_PROTOINFO_TCP_WSCALE_ORIGINAL:
+			VIEW_INDEX(v, ATTR_TCP_WSCALE_ORIG, a, sizeof(uint8_t));
+			break;
+		case CTA_PROTOINFO_TCP_WSCALE_REPLY:
+			VIEW_INDEX(v, ATTR_TCP_WSCALE_REPL, a, sizeof(uint8_t));
+			break;
+		/* struct nf_ct_tcp_flags: the mask follows the flags */
+		case CTA_PROTOINFO_TCP_FLAGS_ORIGINAL:
+			VIEW_INDEX(v, ATTR_TCP_FLAGS_ORIG, a,
+				   sizeof(struct nf_ct_tcp_flags));
+			view_index(v, ATTR_TCP_MASK_ORIG, VIEW_ATTR_DATA(a) + 1,
+				   VIEW_ATTR_LEN(a) - 1, sizeof(uint8_t));
+			break;
+		case CTA_PROTOINFO_TCP_FLAGS_REPLY:
+			VIEW_INDEX(v, ATTR_TCP_FLAGS_REPL, a,
+				   sizeof(struct nf_ct_tcp_flags));
+			view_index(v, ATTR_TCP_MASK_REPL, VIEW_ATTR_DATA(a) + 1,
+				   VIEW_ATTR_LEN(a) - 1, sizeof(uint8_t));
+			break;
+		}
+	}
+}
+
+static void view_protoinfo_sctp(struct nfct_view *v, const struct nlattr *nest)
+{
+	const struct nlattr *a;
+	int rem;
+
+	view_for_each_nested(a, nest, rem) {
+		switch(VIEW_ATTR_TYPE(a)) {
+		case CTA_PROTOINFO_SCTP_STATE:
+			VIEW_INDEX(v, ATTR_SCTP_STATE, a, sizeof(uint8_t));
+			break;
+		case CTA_PROTOINFO_SCTP_VTAG_ORIGINAL:
+			VIEW_INDEX(v, ATTR_SCTP_VTAG_ORIG, a, sizeof(uint32_t));
+			break;
+		case CTA_PROTOINFO_SCTP_VTAG_REPLY:
+			VIEW_INDEX(v, ATTR_SCTP_VTAG_REPL, a, sizeof(uint32_t));
+			break;
+		}
+	}
+}
+
+static void view_protoinfo_dccp(struct nfct_view *v, const struct nlattr *nest)
+{
+	const struct nlattr *a;
+	int rem;
+
+	view_for_each_nested(a, nest, rem) {
+		switch(VIEW_ATTR_TYPE(a)) {
+		case CTA_PROTOINFO_DCCP_STATE:
+			VIEW_INDEX(v, ATTR_DCCP_STATE, a, sizeof(uint8_t));
+			break;
+		case CTA_PROTOINFO_DCCP_ROLE:
+			VIEW_INDEX(v, ATTR_DCCP_ROLE, a, sizeof(uint8_t));
+			break;
+		case CTA_PROTOINFO_DCCP_HANDSHAKE_SEQ:
+			VIEW_INDEX(v, ATTR_DCCP_HANDSHAKE_SEQ, a,
+				   sizeof(uint64_t));
+			break;
+		}
+	}
+}
+
+static void view_protoinfo(struct nfct_view *v, const struct nlattr *nest)
+{
+	const struct nlattr *a;
+	int rem;
+
+	view_for_each_nested(a, nest, rem) {
+		switch(VIEW_ATTR_TYPE(a)) {
+		case CTA_PROTOINFO_TCP:
+			view_protoinfo_tcp(v, a);
+			break;
+		case CTA_PROTOINFO_SCTP:
+			view_protoinfo_sctp(v, a);
+			break;
+		case CTA_PROTOINFO_DCCP:
+			view_protoinfo_dccp(v, a);
+			break;
+		}
+	}
+}
+
+static void view_counters(struct nfct_view *v, const struct nlattr *nest,
+			  int dir)
+{
+	int packets = dir == __DIR_ORIG ? ATTR_ORIG_COUNTER_PACKETS :
+					  ATTR_REPL_COUNTER_PACKETS;
+	int bytes = dir == __DIR_ORIG ? ATTR_ORIG_COUNTER_BYTES :
+					ATTR_REPL_COUNTER_BYTES;
+	const struct nlattr *a;
+	int rem;
+
+	view_for_each_nested(a, nest, rem) {
+		switch(VIEW_ATTR_TYPE(a)) {
+		case CTA_COUNTERS_PACKETS:
+			VIEW_INDEX(v, packets, a, sizeof(uint64_t));
+			break;
+		case CTA_COUNTERS_BYTES:
+			VIEW_INDEX(v, bytes, a, sizeof(uint64_t));
+			break;
+		/* 64 bits counters take precedence over the 32 bits ones */
+		case CTA_COUNTERS32_PACKETS:
+			if (!test_bit(packets, v->set))
+				VIEW_INDEX(v, packets, a, sizeof(uint32_t));
+			break;
+		case CTA_COUNTERS32_BYTES:
+			if (!test_bit(bytes, v->set))
+				VIEW_INDEX(v, bytes, a, sizeof(uint32_t));
+			break;
+		}
+	}
+}
+
+static void view_nat_seq(struct nfct_view *v, const struct nlattr *nest,
+			 int dir)
+{
+	const struct nlattr *a;
+	int rem;
+
+	view_for_each_nested(a, nest, rem) {
+		switch(VIEW_ATTR_TYPE(a)) {
+		case CTA_NAT_SEQ_CORRECTION_POS:
+			VIEW_INDEX(v, dir == __DIR_ORIG ?
+				   ATTR_ORIG_NAT_SEQ_CORRECTION_POS :
+				   ATTR_REPL_NAT_SEQ_CORRECTION_POS,
+				   a, sizeof(uint32_t));
+			break;
+		case CTA_NAT_SEQ_OFFSET_BEFORE:
+			VIEW_INDEX(v, dir == __DIR_ORIG ?
+				   ATTR_ORIG_NAT_SEQ_OFFSET_BEFORE :
+				   ATTR_REPL_NAT_SEQ_OFFSET_BEFORE,
+				   a, sizeof(uint32_t));
+			break;
+		case CTA_NAT_SEQ_OFFSET_AFTER:
+			VIEW_INDEX(v, dir == __DIR_ORIG ?
+				   ATTR_ORIG_NAT_SEQ_OFFSET_AFTER :
+				   ATTR_REPL_NAT_SEQ_OFFSET_AFTER,
+				   a, sizeof(uint32_t));
+			break;
+		}
+	}
+}
+
+static void view_helper(struct nfct_view *v, const struct nlattr *nest)
+{
+	const struct nlattr *a;
+	int rem;
+
+	view_for_each_nested(a, nest, rem) {
+		switch(VIEW_ATTR_TYPE(a)) {
+		case CTA_HELP_NAME:
+			VIEW_INDEX(v, ATTR_HELPER_NAME, a, sizeof(char));
+			break;
+		case CTA_HELP_INFO:
+			VIEW_INDEX(v, ATTR_HELPER_INFO, a, sizeof(char));
+			break;
+		}
+	}
+}
+
+static void view_secctx(struct nfct_view *v, const struct nlattr *nest)
+{
+	const struct nlattr *a;
+	int rem;
+
+	view_for_each_nested(a, nest, rem) {
+		if (VIEW_ATTR_TYPE(a) == CTA_SECCTX_NAME)
+			VIEW_INDEX(v, ATTR_SECCTX, a, sizeof(char));
+	}
+}
+
+static void view_timestamp(struct nfct_view *v, const struct nlattr *nest)
+{
+	const struct nlattr *a;
+	int rem;
+
+	view_for_each_nested(a, nest, rem) {
+		switch(VIEW_ATTR_TYPE(a)) {
+		case CTA_TIMESTAMP_START:
+			VIEW_INDEX(v, ATTR_TIMESTAMP_START, a,
+				   sizeof(uint64_t));
+			break;
+		case CTA_TIMESTAMP_STOP:
+			VIEW_INDEX(v, ATTR_TIMESTAMP_STOP, a, sizeof(uint64_t));
+			break;
+		}
+	}
+}
+
+void __view_init(struct nfct_view *v, const struct nlmsghdr *nlh)
+{
+	const struct nlattr *a;
+	int rem;
+
+	v->nlh = nlh;
+	memset(v->set, 0, sizeof(v->set));
+
+	a = (const struct nlattr *)((const char *)NLMSG_DATA(nlh) +
+				    NLMSG_ALIGN(sizeof(struct nfgenmsg)));
+	rem = (int)nlh->nlmsg_len - NLMSG_SPACE(sizeof(struct nfgenmsg));
+
+	for (; VIEW_ATTR_OK(a, rem); a = VIEW_ATTR_NEXT(a, rem)) {
+		switch(VIEW_ATTR_TYPE(a)) {
+		case CTA_TUPLE_ORIG:
+			view_tuple(v, a, __DIR_ORIG);
+			break;
+		case CTA_TUPLE_REPLY:
+			view_tuple(v, a, __DIR_REPL);
+			break;
+		case CTA_TUPLE_MASTER:
+			view_tuple(v, a, __DIR_MASTER);
+			break;
+		case CTA_NAT_SEQ_ADJ_ORIG:
+			view_nat_seq(v, a, __DIR_ORIG);
+			break;
+		case CTA_NAT_SEQ_ADJ_REPLY:
+			view_nat_seq(v, a, __DIR_REPL);
+			break;
+		case CTA_STATUS:
+			VIEW_INDEX(v, ATTR_STATUS, a, sizeof(uint32_t));
+			break;
+		case CTA_PROTOINFO:
+			view_protoinfo(v, a);
+			break;
+		case CTA_TIMEOUT:
+			VIEW_INDEX(v, ATTR_TIMEOUT, a, sizeof(uint32_t));
+			break;
+		case CTA_MARK:
+			VIEW_INDEX(v, ATTR_MARK, a, sizeof(uint32_t));
+			break;
+		case CTA_SECMARK:
+			VIEW_INDEX(v, ATTR_SECMARK, a, sizeof(uint32_t));
+			break;
+		case CTA_COUNTERS_ORIG:
+			view_counters(v, a, __DIR_ORIG);
+			break;
+		case CTA_COUNTERS_REPLY:
+			view_counters(v, a, __DIR_REPL);
+			break;
+		case CTA_USE:
+			VIEW_INDEX(v, ATTR_USE, a, sizeof(uint32_t));
+			break;
+		case CTA_ID:
+			VIEW_INDEX(v, ATTR_ID, a, sizeof(uint32_t));
+			break;
+		case CTA_HELP:
+			view_helper(v, a);
+			break;
+		case CTA_ZONE:
+			VIEW_INDEX(v, ATTR_ZONE, a, sizeof(uint16_t));
+			break;
+		case CTA_SECCTX:
+			view_secctx(v, a);
+			break;
+		case CTA_TIMESTAMP:
+			view_timestamp(v, a);
+			break;
+		case CTA_LABELS:
+			/* it has to fit in the inline storage of the view */
+			if (VIEW_ATTR_LEN(a) <= (int)sizeof(v->labels.bits))
+				VIEW_INDEX(v, ATTR_CONNLABELS, a,
+					   sizeof(uint32_t));
+			break;
+		}
+	}
+}
+
+const void *__view_get_attr(struct nfct_view *v, int type)
+{
+	const char *data = (const char *)v->nlh + v->off[type];
+	const struct nlattr *attr;
+	uint16_t u16;
+	uint32_t u32;
+	uint64_t u64;
+
+	switch(view_kind[type]) {
+	case VIEW_RAW:
+		return data;
+	case VIEW_BE16:
+		memcpy(&u16, data, sizeof(u16));
+		v->val[type].u16 = ntohs(u16);
+		break;
+	case VIEW_BE32:
+		memcpy(&u32, data, sizeof(u32));
+		v->val[type].u32 = ntohl(u32);
+		break;
+	case VIEW_BE64:
+		memcpy(&u64, data, sizeof(u64));
+		v->val[type].u64 = be64toh(u64);
+		break;
+	case VIEW_COUNTER:
+		attr = (const struct nlattr *)(data - NLA_HDRLEN);
+		if (VIEW_ATTR_LEN(attr) >= (int)sizeof(uint64_t)) {
+			memcpy(&u64, data, sizeof(u64));
+			v->val[type].u64 = be64toh(u64);
+		} else {
+			memcpy(&u32, data, sizeof(u32));
+			v->val[type].u64 = ntohl(u32);
+		}
+		break;
+	case VIEW_LABELS:
+		attr = (const struct nlattr *)(data - NLA_HDRLEN);
+		v->labels.words = DIV_ROUND_UP(VIEW_ATTR_LEN(attr),
+					       sizeof(uint32_t));
+		memset(v->labels.bits, 0, sizeof(v->labels.bits));
+		memcpy(v->labels.bits, data, VIEW_ATTR_LEN(attr));
+		return &v->labels;
+	}
+	return &v->val[type];
+}
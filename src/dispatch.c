@@ -0,0 +1,272 @@
+/*
+ * (C) 2026 by agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <pthread.h>
+
+#include "internal/internal.h"
+
+/*
+ * Sharded event dispatcher: the thread that calls nfct_catch() parses the
+ * messages and pushes every conntrack to the ring of one worker, which is
+ * selected by hashing the original tuple. Each ring has one producer and
+ * one consumer, so head and tail are only written by one side and no lock
+ * is needed to pass objects. The mutex and condition of a worker are only
+ * used to sleep when its ring is empty, or the producer when it is full.
+ */
+#define DISPATCH_RING_DEFAULT	1024
+#define DISPATCH_SPIN		256
+#define DISPATCH_CACHELINE	64
+
+enum {
+	DISPATCH_WORKER = 0,
+	DISPATCH_PRODUCER,
+};
+
+struct dispatch_slot {
+	enum nf_conntrack_msg_type	type;
+	struct nf_conntrack		*ct;
+};
+
+struct dispatch_worker {
+	/* next slot to fill, only written by the producer */
+	unsigned int		tail
+				__attribute__((aligned(DISPATCH_CACHELINE)));
+	/* next slot to consume, only written by the worker */
+	unsigned int		head
+				__attribute__((aligned(DISPATCH_CACHELINE)));
+
+	/* set while the worker or the producer sleeps on `cond' */
+	int			waiting[2]
+				__attribute__((aligned(DISPATCH_CACHELINE)));
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+
+	struct nfct_dispatch	*d;
+	struct dispatch_slot	*slots;
+	pthread_t		thread;
+	int			running;
+};
+
+struct nfct_dispatch {
+	struct nfct_handle	*h;
+	unsigned int		nworkers;
+	/* workers whose lock and cond are initialized */
+	unsigned int		nready;
+	unsigned int		mask;
+	int			stop;
+
+	int			(*cb)(enum nf_conntrack_msg_type type,
+				      struct nf_conntrack *ct,
+				      void *data);
+	void			*data;
+
+	struct dispatch_worker	*workers;
+};
+
+static inline unsigned int load_acquire(const unsigned int *p)
+{
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void store_release(unsigned int *p, unsigned int v)
+{
+	__atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static int ring_empty(struct dispatch_worker *w)
+{
+	return __atomic_load_n(&w->tail, __ATOMIC_SEQ_CST) == w->head;
+}
+
+static int ring_full(struct dispatch_worker *w)
+{
+	return w->tail - __atomic_load_n(&w->head, __ATOMIC_SEQ_CST) >
+	       w->d->mask;
+}
+
+static int ring_stopped(struct dispatch_worker *w)
+{
+	return __atomic_load_n(&w->d->stop, __ATOMIC_SEQ_CST);
+}
+
+static int worker_blocked(struct dispatch_worker *w)
+{
+	return ring_empty(w) && !ring_stopped(w);
+}
+
+/*
+ * Sleep while `blocked' holds, the other side wakes us up via ring_wake().
+ * Each side has its own flag, both never sleep at the same time since the
+ * ring cannot be empty and full at once.
+ */
+static void ring_wait(struct dispatch_worker *w, int who,
+		      int (*blocked)(struct dispatch_worker *w))
+{
+	pthread_mutex_lock(&w->lock);
+	__atomic_store_n(&w->waiting[who], 1, __ATOMIC_SEQ_CST);
+	while (blocked(w))
+		pthread_cond_wait(&w->cond, &w->lock);
+	__atomic_store_n(&w->waiting[who], 0, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&w->lock);
+}
+
+static void ring_wake(struct dispatch_worker *w, int who)
+{
+	/* order the update of head/tail before reading the flag. */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&w->waiting[who], __ATOMIC_RELAXED)) {
+		pthread_mutex_lock(&w->lock);
+		pthread_cond_signal(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+	}
+}
+
+static void *worker_main(void *arg)
+{
+	struct dispatch_worker *w = arg;
+	struct nfct_dispatch *d = w->d;
+	struct dispatch_slot *slot;
+	unsigned int head, spin = 0;
+
+	while (1) {
+		head = w->head;
+		if (load_acquire(&w->tail) == head) {
+			if (spin++ < DISPATCH_SPIN)
+				continue;
+			spin = 0;
+			/* the ring is drained before we leave. */
+			if (ring_stopped(w) && ring_empty(w))
+				break;
+			ring_wait(w, DISPATCH_WORKER, worker_blocked);
+			continue;
+		}
+		slot = &w->slots[head & d->mask];
+		/* NFCT_CB_STOP is ignored, nfct_catch() cannot be stopped. */
+		if (d->cb(slot->type, slot->ct, d->data) != NFCT_CB_STOLEN)
+			nfct_destroy(slot->ct);
+
+		store_release(&w->head, head + 1);
+		ring_wake(w, DISPATCH_PRODUCER);
+	}
+	return NULL;
+}
+
+int __dispatch_callback(enum nf_conntrack_msg_type type,
+			struct nf_conntrack *ct, void *data)
+{
+	struct nfct_dispatch *d = data;
+	struct dispatch_worker *w;
+	unsigned int tail;
+
+	w = &d->workers[__hash_orig(ct) % d->nworkers];
+
+	/* back-pressure: wait for the worker to make room. */
+	if (ring_full(w))
+		ring_wait(w, DISPATCH_PRODUCER, ring_full);
+
+	tail = w->tail;
+	w->slots[tail & d->mask].type = type;
+	w->slots[tail & d->mask].ct = ct;
+	store_release(&w->tail, tail + 1);
+	ring_wake(w, DISPATCH_WORKER);
+
+	/* the worker releases the object. */
+	return NFCT_CB_STOLEN;
+}
+
+struct nfct_dispatch *
+__dispatch_create(struct nfct_handle *h, unsigned int nworkers,
+		  unsigned int ring_size,
+		  int (*cb)(enum nf_conntrack_msg_type type,
+			    struct nf_conntrack *ct, void *data),
+		  void *data)
+{
+	struct nfct_dispatch *d;
+	unsigned int i, size = 1;
+
+	if (nworkers == 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if (ring_size == 0)
+		ring_size = DISPATCH_RING_DEFAULT;
+	while (size < ring_size)
+		size <<= 1;
+
+	d = calloc(1, sizeof(struct nfct_dispatch));
+	if (d == NULL)
+		return NULL;
+
+	d->h = h;
+	d->nworkers = nworkers;
+	d->mask = size - 1;
+	d->cb = cb;
+	d->data = data;
+	/* calloc() does not honour the alignment of the ring indexes. */
+	if (posix_memalign((void **)&d->workers, DISPATCH_CACHELINE,
+			   nworkers * sizeof(struct dispatch_worker)) != 0) {
+		free(d);
+		errno = ENOMEM;
+		return NULL;
+	}
+	memset(d->workers, 0, nworkers * sizeof(struct dispatch_worker));
+
+	for (i = 0; i < nworkers; i++) {
+		struct dispatch_worker *w = &d->workers[i];
+
+		w->d = d;
+		pthread_mutex_init(&w->lock, NULL);
+		pthread_cond_init(&w->cond, NULL);
+		d->nready = i + 1;
+		w->slots = calloc(size, sizeof(struct dispatch_slot));
+		if (w->slots == NULL)
+			goto err;
+		if (pthread_create(&w->thread, NULL, worker_main, w) != 0) {
+			errno = EAGAIN;
+			goto err;
+		}
+		w->running = 1;
+	}
+	return d;
+err:
+	__dispatch_destroy(d);
+	return NULL;
+}
+
+struct nfct_handle *__dispatch_handle(const struct nfct_dispatch *d)
+{
+	return d->h;
+}
+
+void __dispatch_destroy(struct nfct_dispatch *d)
+{
+	unsigned int i;
+
+	__atomic_store_n(&d->stop, 1, __ATOMIC_SEQ_CST);
+
+	for (i = 0; i < d->nready; i++) {
+		struct dispatch_worker *w = &d->workers[i];
+
+		if (!w->running)
+			continue;
+
+		pthread_mutex_lock(&w->lock);
+		pthread_cond_signal(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+		pthread_join(w->thread, NULL);
+	}
+	for (i = 0; i < d->nready; i++) {
+		struct dispatch_worker *w = &d->workers[i];
+
+		pthread_mutex_destroy(&w->lock);
+		pthread_cond_destroy(&w->cond);
+		free(w->slots);
+	}
+	free(d->workers);
+	free(d);
+}
@@ -624,8 +624,6 @@ int nfexp_parse_expect(enum nf_conntrack_msg_type type,
 {
 	unsigned int flags;
 	int len = nlh->nlmsg_len;
-	struct nfgenmsg *nfhdr = NLMSG_DATA(nlh);
-	struct nfattr *cda[CTA_EXPECT_MAX];
 
 	assert(nlh != NULL);
 	assert(exp != NULL);
@@ -640,9 +638,8 @@ int nfexp_parse_expect(enum nf_conntrack_msg_type type,
 	if (!(flags & type))
 		return 0;
 
-	nfnl_parse_attr(cda, CTA_EXPECT_MAX, NFA_DATA(nfhdr), len);
-
-	__parse_expect(nlh, cda, exp);
+	if (__parse_expect(nlh, exp) < 0)
+		return NFCT_T_ERROR;
 
 	return flags;
 }
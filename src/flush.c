@@ -0,0 +1,349 @@
+/*
+ * (C) 2026 by agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "internal/internal.h"
+
+/*
+ * Flush and rewrite by filter: the table is dumped through a second socket,
+ * and every conntrack that matches the template is deleted or updated
+ * through the handle as soon as the dump reports it. The requests are
+ * asynchronous queries, up to FLUSH_WINDOW of them are in flight, so that
+ * their replies fit into the default receive buffer of the socket.
+ */
+#define FLUSH_WINDOW	64
+
+struct flush_dump {
+	struct nfct_handle		*h;
+	const struct nf_conntrack	*tmpl;
+	unsigned int			flags;
+	/* NFCT_Q_DESTROY or NFCT_Q_UPDATE */
+	enum nf_conntrack_query		qt;
+	/* the bits of the mark in mark_mask are replaced, if any */
+	uint32_t			mark;
+	uint32_t			mark_mask;
+	/* labels to set and to clear, NULL if untouched */
+	const struct nfct_bitmask	*set;
+	const struct nfct_bitmask	*clear;
+	/* what identifies the conntrack, and the update to it */
+	struct nf_conntrack		*req;
+	/* stop catching once no more requests than this are in flight */
+	unsigned int			wait;
+	int				count;
+	int				error;
+};
+
+static int flush_done(int error, struct nf_conntrack *ct, void *data)
+{
+	struct flush_dump *f = data;
+
+	if (error == 0)
+		f->count++;
+	/* it expired or someone else deleted it meanwhile. */
+	else if (error != ENOENT && f->error == 0)
+		f->error = error;
+
+	if (nfct_query_async_pending(f->h) > f->wait)
+		return NFCT_CB_CONTINUE;
+
+	return NFCT_CB_STOP;
+}
+
+/*
+ * Catch the replies until no more than `wait' requests are in flight. If
+ * that fails, we give up on them, so that none refers to us later on.
+ */
+static int flush_wait(struct flush_dump *f, unsigned int wait)
+{
+	f->wait = wait;
+
+	while (nfct_query_async_pending(f->h) > wait) {
+		if (nfct_catch(f->h) == -1 &&
+		    nfct_query_async_pending(f->h) > wait) {
+			if (f->error == 0)
+				f->error = errno;
+			__async_lost(f->h);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* the labels would not change, the conntrack has no labels means zero. */
+static int flush_labels_same(const struct nfct_bitmask *set,
+			     const struct nfct_bitmask *clear,
+			     const struct nf_conntrack *ct)
+{
+	const struct nfct_bitmask *cur = nfct_get_attr(ct, ATTR_CONNLABELS);
+	unsigned int i, max;
+
+	if (set) {
+		max = nfct_bitmask_maxbit(set);
+		for (i = 0; i <= max; i++) {
+			if (nfct_bitmask_test_bit(set, i) &&
+			    (cur == NULL || i > nfct_bitmask_maxbit(cur) ||
+			     !nfct_bitmask_test_bit(cur, i)))
+				return 0;
+		}
+	}
+	if (clear && cur) {
+		max = nfct_bitmask_maxbit(clear);
+		for (i = 0; i <= max; i++) {
+			if (nfct_bitmask_test_bit(clear, i) &&
+			    i <= nfct_bitmask_maxbit(cur) &&
+			    nfct_bitmask_test_bit(cur, i))
+				return 0;
+		}
+	}
+	return 1;
+}
+
+/* point the request at ct, the update that it carries is unset. */
+static void flush_tuple(struct nf_conntrack *req, const struct nf_conntrack *ct)
+{
+	memset(req->head.set, 0, sizeof(req->head.set));
+	nfct_copy(req, ct, NFCT_CP_ORIG);
+	/* the same tuple may be in several zones. */
+	nfct_copy_attr(req, ct, ATTR_ORIG_ZONE);
+	nfct_copy_attr(req, ct, ATTR_ZONE);
+	/* a zone in the reply direction goes in the reply tuple. */
+	if (nfct_attr_is_set(ct, ATTR_REPL_ZONE) > 0) {
+		nfct_copy(req, ct, NFCT_CP_REPL);
+		nfct_copy_attr(req, ct, ATTR_REPL_ZONE);
+	}
+}
+
+/*
+ * Prepare the update of ct in the request that __rewrite_request() made,
+ * returns 0 if there is nothing to do. The mark and the labels come along
+ * with their masks, which the request carries already: the kernel applies
+ * them, so changes that happen meanwhile to the other bits are kept.
+ */
+int __rewrite_prepare(struct nf_conntrack *req, const struct nf_conntrack *ct,
+		      uint32_t mark, uint32_t mark_mask,
+		      const struct nfct_bitmask *set,
+		      const struct nfct_bitmask *clear)
+{
+	uint32_t cur = 0;
+	int same = 1;
+
+	flush_tuple(req, ct);
+
+	if (mark_mask) {
+		if (nfct_attr_is_set(ct, ATTR_MARK) > 0)
+			cur = nfct_get_attr_u32(ct, ATTR_MARK);
+		if ((cur & mark_mask) != (mark & mark_mask)) {
+			set_bit(ATTR_MARK, req->head.set);
+			set_bit(ATTR_MARK_MASK, req->head.set);
+			same = 0;
+		}
+	}
+	if ((set || clear) && !flush_labels_same(set, clear, ct)) {
+		set_bit(ATTR_CONNLABELS, req->head.set);
+		set_bit(ATTR_CONNLABELS_MASK, req->head.set);
+		same = 0;
+	}
+	return !same;
+}
+
+/* prepare the request for ct, returns 0 if there is nothing to do. */
+static int flush_prepare(struct flush_dump *f, const struct nf_conntrack *ct)
+{
+	if (f->qt == NFCT_Q_DESTROY) {
+		flush_tuple(f->req, ct);
+		return 1;
+	}
+	return __rewrite_prepare(f->req, ct, f->mark, f->mark_mask,
+				 f->set, f->clear);
+}
+
+static int flush_dump_cb(enum nf_conntrack_msg_type type,
+			 struct nf_conntrack *ct, void *data)
+{
+	struct flush_dump *f = data;
+
+	if (f->tmpl && !nfct_cmp(f->tmpl, ct, f->flags))
+		return NFCT_CB_CONTINUE;
+
+	if (!flush_prepare(f, ct))
+		return NFCT_CB_CONTINUE;
+
+	if (flush_wait(f, FLUSH_WINDOW - 1) == -1)
+		return NFCT_CB_FAILURE;
+
+	if (nfct_query_async(f->h, f->qt, f->req, flush_done, f) == -1) {
+		f->error = errno;
+		return NFCT_CB_FAILURE;
+	}
+	return NFCT_CB_CONTINUE;
+}
+
+static int flush_run(struct flush_dump *f,
+		     const struct nfct_filter_dump *filter)
+{
+	struct nfct_handle *dh;
+	uint32_t family = AF_UNSPEC;
+	int ret;
+
+	dh = nfct_open(CONNTRACK, 0);
+	if (dh == NULL)
+		return -1;
+
+	nfct_callback_register(dh, NFCT_T_ALL, flush_dump_cb, f);
+	if (filter)
+		ret = nfct_query(dh, NFCT_Q_DUMP_FILTER, filter);
+	else
+		ret = nfct_query(dh, NFCT_Q_DUMP, &family);
+	if (ret == -1 && f->error == 0)
+		f->error = errno;
+
+	nfct_close(dh);
+
+	/* the requests in flight refer to us, collect them in any case. */
+	flush_wait(f, 0);
+
+	if (f->error) {
+		errno = f->error;
+		return -1;
+	}
+	return f->count;
+}
+
+/*
+ * Delete the conntracks that the dump filter lets through and that match
+ * the template. Returns the number of conntracks that were deleted.
+ */
+int __flush_filter(struct nfct_handle *h,
+		   const struct nfct_filter_dump *filter,
+		   const struct nf_conntrack *tmpl, unsigned int flags)
+{
+	struct flush_dump f = {
+		.h	= h,
+		.tmpl	= tmpl,
+		.flags	= flags,
+		.qt	= NFCT_Q_DESTROY,
+	};
+	int ret;
+
+	f.req = nfct_new();
+	if (f.req == NULL)
+		return -1;
+
+	ret = flush_run(&f, filter);
+	nfct_destroy(f.req);
+
+	return ret;
+}
+
+/* copy of `bits' that is `max' bits long, empty if there are no bits. */
+static struct nfct_bitmask *
+flush_labels(const struct nfct_bitmask *bits, unsigned int max)
+{
+	struct nfct_bitmask *b;
+	unsigned int i;
+
+	b = nfct_bitmask_new(max);
+	if (b == NULL || bits == NULL)
+		return b;
+
+	for (i = 0; i <= nfct_bitmask_maxbit(bits); i++) {
+		if (nfct_bitmask_test_bit(bits, i))
+			nfct_bitmask_set_bit(b, i);
+	}
+	return b;
+}
+
+/*
+ * The request that __rewrite_prepare() points at every conntrack: the bits
+ * of the mark and the labels to change, along with their masks.
+ */
+struct nf_conntrack *__rewrite_request(uint32_t mark, uint32_t mark_mask,
+				       const struct nfct_bitmask *set,
+				       const struct nfct_bitmask *clear)
+{
+	struct nfct_bitmask *labels, *mask;
+	struct nf_conntrack *req;
+	unsigned int i, max = 0;
+
+	req = nfct_new();
+	if (req == NULL)
+		return NULL;
+
+	if (mark_mask) {
+		/* the kernel xors the mark into the bits that are kept. */
+		nfct_set_attr_u32(req, ATTR_MARK, mark & mark_mask);
+		/* without the mask, the whole mark would be replaced. */
+		nfct_set_attr_u32(req, ATTR_MARK_MASK, mark_mask);
+		if (nfct_attr_is_set(req, ATTR_MARK_MASK) <= 0) {
+			nfct_destroy(req);
+			errno = ENOMEM;
+			return NULL;
+		}
+	}
+
+	if (set || clear) {
+		if (set)
+			max = nfct_bitmask_maxbit(set);
+		if (clear && nfct_bitmask_maxbit(clear) > max)
+			max = nfct_bitmask_maxbit(clear);
+
+		/* both must have the same size, the kernel wants them so. */
+		labels = flush_labels(set, max);
+		mask = flush_labels(clear, max);
+		if (labels == NULL || mask == NULL) {
+			if (labels)
+				nfct_bitmask_destroy(labels);
+			if (mask)
+				nfct_bitmask_destroy(mask);
+			nfct_destroy(req);
+			return NULL;
+		}
+		for (i = 0; i <= max; i++) {
+			if (nfct_bitmask_test_bit(labels, i))
+				nfct_bitmask_set_bit(mask, i);
+		}
+		/* the request owns them from now on. */
+		nfct_set_attr(req, ATTR_CONNLABELS, labels);
+		nfct_set_attr(req, ATTR_CONNLABELS_MASK, mask);
+	}
+	return req;
+}
+
+/*
+ * Update the mark and the labels of the conntracks that the dump filter
+ * lets through and that match the template. Returns the number of
+ * conntracks that were updated, those that need no change are skipped.
+ */
+int __rewrite_filter(struct nfct_handle *h,
+		     const struct nfct_filter_dump *filter,
+		     const struct nf_conntrack *tmpl, unsigned int flags,
+		     uint32_t mark, uint32_t mark_mask,
+		     const struct nfct_bitmask *set,
+		     const struct nfct_bitmask *clear)
+{
+	struct flush_dump f = {
+		.h		= h,
+		.tmpl		= tmpl,
+		.flags		= flags,
+		.qt		= NFCT_Q_UPDATE,
+		.mark		= mark,
+		.mark_mask	= mark_mask,
+		.set		= set,
+		.clear		= clear,
+	};
+	int ret;
+
+	f.req = __rewrite_request(mark, mark_mask, set, clear);
+	if (f.req == NULL)
+		return -1;
+
+	ret = flush_run(&f, filter);
+	nfct_destroy(f.req);
+
+	return ret;
+}
@@ -170,6 +170,8 @@ int nfct_close2(struct nfct_handle *cth, bool keep_fd)
 	/* required by the new API */
 	cth->cb = NULL;
 	cth->cb2 = NULL;
+	cth->view_cb = NULL;
+	cth->batch_cb = NULL;
 	cth->expect_cb = NULL;
 	cth->expect_cb2 = NULL;
 	free(cth->nfnl_cb_ct.data);
@@ -183,6 +185,21 @@ int nfct_close2(struct nfct_handle *cth, bool keep_fd)
 	cth->nfnl_cb_exp.data = NULL;
 	cth->nfnl_cb_exp.attr_count = 0;
 
+	if (cth->scratch)
+		nfct_destroy(cth->scratch);
+	if (cth->rx)
+		__rx_destroy(cth->rx);
+	if (cth->uring)
+		__uring_destroy(cth->uring);
+	if (cth->resync)
+		__resync_destroy(cth->resync);
+	if (cth->coalesce)
+		__coalesce_destroy(cth->coalesce);
+	if (cth->async)
+		__async_destroy(cth->async);
+	if (cth->cb_batch)
+		__callback_batch_destroy(cth->cb_batch);
+
 	if (keep_fd)
 		err = nfnl_close2(cth->nfnlh);
 	else
@@ -206,6 +223,256 @@ const struct nfnl_handle *nfct_nfnlh(struct nfct_handle *cth)
 	return cth->nfnlh;
 }
 
+/**
+ * nfct_handle_set_flags - set the flags of one existing ctnetlink handler
+ * \param cth handler obtained via nfct_open()
+ * \param flags bitmask of handle flags
+ *
+ * The following flags are supported:
+ *
+ * - NFCT_HF_SCRATCH: parse every message into one conntrack object that is
+ * owned by the handler instead of allocating and releasing one object per
+ * message. The object passed to the callback is only valid until it
+ * returns. If the callback returns NFCT_CB_STOLEN, the object is handed
+ * over to the caller, that has to release it via nfct_destroy(), and a new
+ * one is allocated for the next message.
+ *
+ * - NFCT_HF_RESYNC: recover from lost events. The handler keeps a copy of
+ * every conntrack reported via events. If nfct_catch() hits ENOBUFS, the
+ * table is dumped through a second socket and the callback receives a
+ * synthetic NFCT_T_NEW event for every conntrack that is missing in the
+ * copy and a synthetic NFCT_T_DESTROY event for every conntrack that is
+ * gone, then nfct_catch() goes on. See nfct_resync(). This only works
+ * with callbacks registered via nfct_callback_register() and
+ * nfct_callback_register2(), the latter gets a NULL netlink header for
+ * synthetic NFCT_T_DESTROY events.
+ *
+ * - NFCT_HF_TIMING: account the time spent in the parsers and in the
+ * callbacks, see nfct_handle_stats(). This takes two clock readings per
+ * parser and callback invocation.
+ *
+ * On error, -1 is returned and errno is set appropiately.
+ */
+int nfct_handle_set_flags(struct nfct_handle *cth, unsigned int flags)
+{
+	if (flags & ~(NFCT_HF_SCRATCH | NFCT_HF_RESYNC | NFCT_HF_TIMING)) {
+		errno = EINVAL;
+		return -1;
+	}
+	if ((flags & NFCT_HF_RESYNC) && cth->resync == NULL) {
+		cth->resync = __resync_create();
+		if (cth->resync == NULL)
+			return -1;
+	}
+	if (!(flags & NFCT_HF_RESYNC) && cth->resync) {
+		__resync_destroy(cth->resync);
+		cth->resync = NULL;
+	}
+	if (!(flags & NFCT_HF_SCRATCH) && cth->scratch) {
+		nfct_destroy(cth->scratch);
+		cth->scratch = NULL;
+	}
+	cth->flags = flags;
+
+	return 0;
+}
+
+/**
+ * nfct_handle_get_flags - get the flags of one existing ctnetlink handler
+ * \param cth handler obtained via nfct_open()
+ */
+unsigned int nfct_handle_get_flags(const struct nfct_handle *cth)
+{
+	return cth->flags;
+}
+
+/**
+ * nfct_handle_set_parse_mask - only parse the attributes that are needed
+ * \param cth handler obtained via nfct_open()
+ * \param attrs bitmask of enum nf_conntrack_attr values, NULL to parse all
+ *
+ * The objects passed to the callbacks of this handler, for events and for
+ * dumps, are parsed from the netlink messages. Nested attributes whose
+ * attributes are all left unset in attrs are not decoded, that is:
+ * counters, protocol information, NAT sequence adjustments, helper,
+ * security context, timestamps and labels. This saves the time to decode
+ * them and the memory that secctx and labels take. Other attributes are
+ * always decoded since they are cheap. See nfct_bitmask_set_attr_grp() to
+ * set the attributes of a group.
+ *
+ * The bitmask is copied, the caller can release it.
+ */
+void nfct_handle_set_parse_mask(struct nfct_handle *cth,
+				const struct nfct_bitmask *attrs)
+{
+	if (attrs == NULL) {
+		cth->parse_mask = NULL;
+		return;
+	}
+	__parse_mask(cth->parse_want, attrs);
+	cth->parse_mask = cth->parse_want;
+}
+
+/**
+ * nfct_handle_stats - get the performance counters of one handler
+ * \param cth handler obtained via nfct_open()
+ * \param stats where the counters are copied to
+ *
+ * The counters are updated as messages flow through the handler:
+ *
+ * - datagrams and bytes: received by nfct_catch() and nfct_catch_budget().
+ * - enobufs: times that nfct_catch() and nfct_catch_budget() hit ENOBUFS,
+ * i.e. events were lost.
+ * - msgs_new, msgs_update, msgs_destroy and msgs_unknown: messages that
+ * were passed to the parsers, per type.
+ * - filtered: messages that were skipped since their type is not in the
+ * mask that was passed to nfct_callback_register().
+ * - cb_stop and cb_stolen: NFCT_CB_STOP and NFCT_CB_STOLEN verdicts of the
+ * callbacks.
+ * - parse_ns and callback_ns: time spent in the parsers and in the
+ * callbacks, in nanoseconds, only if NFCT_HF_TIMING is set.
+ *
+ * Counters are never reset, compare two snapshots to get rates.
+ */
+void nfct_handle_stats(const struct nfct_handle *cth,
+		       struct nfct_handle_stats *stats)
+{
+	*stats = cth->stats;
+}
+
+/**
+ * nfct_handle_set_rx_batch - receive several datagrams per system call
+ * \param cth handler obtained via nfct_open()
+ * \param nbufs number of datagrams received at once, zero to disable
+ * \param bufsiz size of every receive buffer, zero selects the default
+ * size that nfnl_catch() uses
+ *
+ * Once enabled, nfct_catch() drains up to nbufs datagrams per recvmmsg()
+ * call into a ring of buffers and then runs the registered callbacks over
+ * them. This reduces the system call overhead under event storms. If a
+ * callback stops nfct_catch(), the datagrams that were left in the ring
+ * are processed in the next call.
+ *
+ * On error, -1 is returned and errno is set appropiately. EBUSY means that
+ * there are datagrams left in the ring, call nfct_catch() first.
+ */
+int nfct_handle_set_rx_batch(struct nfct_handle *cth,
+			     unsigned int nbufs, size_t bufsiz)
+{
+	struct nfct_rx *rx = NULL;
+
+	if (cth->rx && __rx_pending(cth->rx)) {
+		errno = EBUSY;
+		return -1;
+	}
+	if (nbufs > 0) {
+		rx = __rx_create(nbufs, bufsiz);
+		if (rx == NULL)
+			return -1;
+	}
+	if (cth->rx)
+		__rx_destroy(cth->rx);
+	cth->rx = rx;
+
+	return 0;
+}
+
+/**
+ * nfct_handle_set_uring - receive events through io_uring
+ * \param cth handler obtained via nfct_open()
+ * \param nbufs number of receive buffers, rounded up to a power of two,
+ * zero to disable
+ * \param bufsiz size of every receive buffer, zero selects the default
+ * size that nfnl_catch() uses
+ *
+ * Once enabled, nfct_catch() and nfct_catch_budget() keep one multishot
+ * recvmsg request posted on the netlink socket through io_uring. The kernel
+ * places every datagram in one of nbufs buffers that are registered as a
+ * provided buffer ring, then completions are processed by the registered
+ * callbacks without a system call per datagram. This takes precedence over
+ * nfct_handle_set_rx_batch().
+ *
+ * If the application does not keep up and the kernel runs out of buffers,
+ * nfct_catch() fails with ENOBUFS, like it does when the socket overruns,
+ * and the request is posted again in the next call. If NETLINK_NO_ENOBUFS
+ * is set on the socket, the request is posted again without failing.
+ *
+ * On error, -1 is returned and errno is set appropiately. EOPNOTSUPP means
+ * that the library was built without io_uring support or that the kernel
+ * does not provide it, the handle keeps receiving events as it did before.
+ * EBUSY means that there are completions left to process, call nfct_catch()
+ * first.
+ */
+int nfct_handle_set_uring(struct nfct_handle *cth,
+			  unsigned int nbufs, size_t bufsiz)
+{
+	struct nfct_uring *uring = NULL;
+
+	if (cth->uring && __uring_pending(cth->uring)) {
+		errno = EBUSY;
+		return -1;
+	}
+	if (nbufs > 0) {
+		uring = __uring_create(nbufs, bufsiz);
+		if (uring == NULL)
+			return -1;
+	}
+	if (cth->uring)
+		__uring_destroy(cth->uring);
+	cth->uring = uring;
+
+	return 0;
+}
+
+/**
+ * nfct_handle_set_coalesce - merge bursts of events for the same conntrack
+ * \param cth handler obtained via nfct_open()
+ * \param max_events close the window after this many events, zero means
+ * no limit
+ * \param window_ns close the window after this many nanoseconds, zero
+ * means no limit
+ *
+ * Once enabled, the conntracks that are parsed from events are held back
+ * instead of being passed to the callback right away. Successive events for
+ * the same conntrack, identified by its original tuple and its ID, are
+ * merged into one entry that carries the latest state and the type of the
+ * first event, except that a DESTROY event turns the entry into a DESTROY.
+ * A conntrack that is created and destroyed within the window is reported
+ * once as NFCT_T_DESTROY. When the window closes, the entries are passed to
+ * the callback in the order they were first seen. The callback registered
+ * via nfct_callback_register2() gets a NULL netlink header. Replies to the
+ * requests sent through this handle, such as nfct_query() GET and dump
+ * requests, are not events: they are passed to the callback right away.
+ *
+ * The window is checked for every event and when nfct_catch() has drained
+ * the socket, nfct_catch() does not sleep beyond it. Applications that call
+ * nfct_catch_budget() should call it or nfct_coalesce_flush() periodically
+ * even if no events arrive. Set both limits to zero to disable coalescing.
+ *
+ * On error, -1 is returned and errno is set appropiately. EBUSY means that
+ * there are events held back, call nfct_coalesce_flush() first.
+ */
+int nfct_handle_set_coalesce(struct nfct_handle *cth,
+			     unsigned int max_events, uint64_t window_ns)
+{
+	struct nfct_coalesce *coalesce = NULL;
+
+	if (cth->coalesce && __coalesce_pending(cth->coalesce)) {
+		errno = EBUSY;
+		return -1;
+	}
+	if (max_events > 0 || window_ns > 0) {
+		coalesce = __coalesce_create(max_events, window_ns);
+		if (coalesce == NULL)
+			return -1;
+	}
+	if (cth->coalesce)
+		__coalesce_destroy(cth->coalesce);
+	cth->coalesce = coalesce;
+
+	return 0;
+}
+
 /**
  * @}
  */
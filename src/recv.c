@@ -0,0 +1,278 @@
+/*
+ * (C) 2026 by agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#define _GNU_SOURCE
+#include <sys/socket.h>
+#include <poll.h>
+#include <time.h>
+#include <linux/netlink.h>
+
+#include "internal/internal.h"
+
+/*
+ * Batched receive: one recvmmsg() call fills up to `nbufs' buffers, then the
+ * datagrams are passed to nfnl_process() one by one. Datagrams that are
+ * still in the ring when a callback stops the loop are processed first in
+ * the next call, so that nothing that was received is lost.
+ */
+struct nfct_rx {
+	unsigned int		nbufs;
+	size_t			bufsiz;
+
+	/* datagrams received in the last call and next one to process */
+	unsigned int		count;
+	unsigned int		next;
+
+	struct mmsghdr		*msgs;
+	struct iovec		*iov;
+	struct sockaddr_nl	*peer;
+	unsigned char		*bufs;
+};
+
+struct nfct_rx *__rx_create(unsigned int nbufs, size_t bufsiz)
+{
+	struct nfct_rx *rx;
+	unsigned int i;
+
+	rx = calloc(1, sizeof(struct nfct_rx));
+	if (rx == NULL)
+		return NULL;
+
+	rx->nbufs = nbufs;
+	rx->bufsiz = bufsiz ? bufsiz : NFNL_BUFFSIZE;
+	rx->msgs = calloc(nbufs, sizeof(struct mmsghdr));
+	rx->iov = calloc(nbufs, sizeof(struct iovec));
+	rx->peer = calloc(nbufs, sizeof(struct sockaddr_nl));
+	rx->bufs = malloc(nbufs * rx->bufsiz);
+	if (rx->msgs == NULL || rx->iov == NULL || rx->peer == NULL ||
+	    rx->bufs == NULL) {
+		__rx_destroy(rx);
+		return NULL;
+	}
+
+	for (i = 0; i < nbufs; i++) {
+		rx->iov[i].iov_base = rx->bufs + i * rx->bufsiz;
+		rx->iov[i].iov_len = rx->bufsiz;
+		rx->msgs[i].msg_hdr.msg_iov = &rx->iov[i];
+		rx->msgs[i].msg_hdr.msg_iovlen = 1;
+		rx->msgs[i].msg_hdr.msg_name = &rx->peer[i];
+	}
+	return rx;
+}
+
+void __rx_destroy(struct nfct_rx *rx)
+{
+	free(rx->msgs);
+	free(rx->iov);
+	free(rx->peer);
+	free(rx->bufs);
+	free(rx);
+}
+
+int __rx_pending(const struct nfct_rx *rx)
+{
+	return rx->next < rx->count;
+}
+
+static int rx_process(struct nfct_handle *h, const struct mmsghdr *m)
+{
+	const struct msghdr *msg = &m->msg_hdr;
+	const struct sockaddr_nl *peer = msg->msg_name;
+
+	h->stats.datagrams++;
+	h->stats.bytes += m->msg_len;
+
+	if (msg->msg_flags & MSG_TRUNC) {
+		errno = ENOSPC;
+		return -1;
+	}
+	/* only the kernel is allowed to talk to us. */
+	if (msg->msg_namelen != sizeof(struct sockaddr_nl) || peer->nl_pid != 0)
+		return NFNL_CB_CONTINUE;
+
+	if (h->async &&
+	    __async_match(h->async, msg->msg_iov->iov_base, m->msg_len))
+		return __async_process(h, msg->msg_iov->iov_base, m->msg_len);
+
+	return nfnl_process(h->nfnlh, msg->msg_iov->iov_base, m->msg_len);
+}
+
+/* refill up to `vlen' slots of the ring, returns the datagrams received. */
+static int rx_fill(struct nfct_handle *h, struct nfct_rx *rx,
+		   unsigned int vlen, int flags)
+{
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < vlen; i++) {
+		rx->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_nl);
+		rx->msgs[i].msg_hdr.msg_flags = 0;
+	}
+
+	ret = recvmmsg(nfnl_fd(h->nfnlh), rx->msgs, vlen, flags, NULL);
+	if (ret < 0)
+		return -1;
+
+	rx->count = ret;
+	rx->next = 0;
+	return ret;
+}
+
+/* hand over what the batch callback or the coalescing window holds, keep
+ * the worst verdict */
+static int rx_flush(struct nfct_handle *h, int ret)
+{
+	int err;
+
+	if (h->batch_cb) {
+		err = __callback_flush(h);
+		if (err < ret)
+			ret = err;
+	}
+	if (h->coalesce) {
+		err = __coalesce_expire(h);
+		if (err < ret)
+			ret = err;
+	}
+	return ret;
+}
+
+/* wait for datagrams, but not beyond the coalescing window. */
+static int rx_wait(struct nfct_handle *h)
+{
+	struct pollfd pfd = {
+		.fd	= nfnl_fd(h->nfnlh),
+		.events	= POLLIN,
+	};
+	int timeout;
+
+	if (h->coalesce == NULL)
+		return 1;
+
+	timeout = __coalesce_timeout(h->coalesce);
+	if (timeout < 0)
+		return 1;
+
+	return poll(&pfd, 1, timeout);
+}
+
+int __rx_catch(struct nfct_handle *h)
+{
+	struct nfct_rx *rx = h->rx;
+	int ret;
+
+	while (1) {
+		while (rx->next < rx->count) {
+			ret = rx_process(h, &rx->msgs[rx->next++]);
+			if (ret <= NFNL_CB_STOP)
+				return rx_flush(h, ret);
+		}
+		ret = rx_flush(h, NFNL_CB_CONTINUE);
+		if (ret <= NFNL_CB_STOP)
+			return ret;
+
+		ret = rx_wait(h);
+		if (ret == 0) {
+			ret = __coalesce_flush(h);
+			if (ret <= NFNL_CB_STOP)
+				return ret;
+			continue;
+		} else if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		/* block until one datagram is there, then take what we can. */
+		if (rx_fill(h, rx, rx->nbufs, MSG_WAITFORONE) < 0) {
+			/* interrupted syscall must retry */
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+	}
+}
+
+/*
+ * Discard what is queued in the socket without waiting for more. Every
+ * datagram takes more than its header from the receive buffer, so there are
+ * no more of them than that, those that arrive meanwhile are not our
+ * business: we do not loop forever under load.
+ */
+void __rx_drain(struct nfct_handle *h)
+{
+	int fd = nfnl_fd(h->nfnlh), rcvbuf = 0;
+	socklen_t len = sizeof(rcvbuf);
+	unsigned int max;
+
+	getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, &len);
+	for (max = rcvbuf / NLMSG_HDRLEN + 1; max > 0; max--) {
+		if (recv(fd, NULL, 0, MSG_DONTWAIT | MSG_TRUNC) < 0 &&
+		    errno != EINTR)
+			break;
+	}
+}
+
+static uint64_t rx_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Like __rx_catch() but it never blocks and it stops after `max_msgs'
+ * datagrams or once `max_ns' nanoseconds have elapsed, zero means no limit.
+ * Returns 1 if there may be more to process, 0 if the socket was drained or
+ * the callback stopped us, -1 on error.
+ */
+int __rx_catch_budget(struct nfct_handle *h, unsigned int max_msgs,
+		      uint64_t max_ns)
+{
+	struct nfct_rx *rx = h->rx;
+	uint64_t deadline = max_ns ? rx_now() + max_ns : 0;
+	unsigned int n = 0, vlen;
+	int ret;
+
+	while (1) {
+		while (rx->next < rx->count) {
+			/* at least one datagram per call, so that we progress. */
+			if (n > 0 && ((max_msgs && n == max_msgs) ||
+				      (deadline && rx_now() >= deadline))) {
+				if (rx_flush(h, NFNL_CB_CONTINUE) < 0)
+					return -1;
+				return 1;
+			}
+			ret = rx_process(h, &rx->msgs[rx->next++]);
+			n++;
+			if (ret <= NFNL_CB_STOP)
+				return rx_flush(h, ret) < 0 ? -1 : __rx_pending(rx);
+		}
+		ret = rx_flush(h, NFNL_CB_CONTINUE);
+		if (ret <= NFNL_CB_STOP)
+			return ret < 0 ? -1 : 0;
+
+		if (n > 0 && ((max_msgs && n == max_msgs) ||
+			      (deadline && rx_now() >= deadline)))
+			return 1;
+
+		/* do not take more from the socket than we may process. */
+		vlen = rx->nbufs;
+		if (max_msgs && max_msgs - n < vlen)
+			vlen = max_msgs - n;
+
+		if (rx_fill(h, rx, vlen, MSG_DONTWAIT) < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+	}
+}
@@ -0,0 +1,316 @@
+/*
+ * (C) 2026 by agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "internal/internal.h"
+#include "internal/linux_list.h"
+
+/*
+ * Event-loss recovery: a cache of the conntracks that were reported via
+ * events is kept up to date. Once events have been lost, the table is
+ * dumped through a second socket and compared with the cache, the
+ * differences are reported to the callback as synthetic NEW and DESTROY
+ * events. Every dump bumps the generation, cache entries that were not
+ * refreshed by the dump are gone. Conntracks that the filter attached to
+ * the event socket would drop are not reported, unless they are cached.
+ */
+#define RESYNC_BUCKETS_MIN	1024
+
+struct resync_entry {
+	struct hlist_node	node;
+	uint32_t		hash;
+	unsigned int		gen;
+	struct nf_conntrack	*ct;
+};
+
+struct nfct_resync {
+	unsigned int		gen;
+	unsigned int		count;
+	unsigned int		size;
+	struct hlist_head	*buckets;
+};
+
+struct nfct_resync *__resync_create(void)
+{
+	struct nfct_resync *r;
+
+	r = calloc(1, sizeof(struct nfct_resync));
+	if (r == NULL)
+		return NULL;
+
+	r->size = RESYNC_BUCKETS_MIN;
+	r->buckets = calloc(r->size, sizeof(struct hlist_head));
+	if (r->buckets == NULL) {
+		free(r);
+		return NULL;
+	}
+	return r;
+}
+
+static void resync_del(struct nfct_resync *r, struct resync_entry *e)
+{
+	hlist_del(&e->node);
+	if (e->ct)
+		nfct_destroy(e->ct);
+	free(e);
+	r->count--;
+}
+
+void __resync_destroy(struct nfct_resync *r)
+{
+	struct resync_entry *e;
+	struct hlist_node *n, *tmp;
+	unsigned int i;
+
+	for (i = 0; i < r->size; i++) {
+		hlist_for_each_entry_safe(e, n, tmp, &r->buckets[i], node)
+			resync_del(r, e);
+	}
+	free(r->buckets);
+	free(r);
+}
+
+static struct resync_entry *
+resync_find(struct nfct_resync *r, const struct nf_conntrack *ct,
+	    uint32_t hash)
+{
+	struct resync_entry *e;
+	struct hlist_node *n;
+
+	for (n = r->buckets[hash & (r->size - 1)].first; n; n = n->next) {
+		e = hlist_entry(n, struct resync_entry, node);
+		if (e->hash == hash &&
+		    __cmp_orig(e->ct, ct, NFCT_CMP_STRICT))
+			return e;
+	}
+	return NULL;
+}
+
+/* double the buckets, a failure only makes the chains longer. */
+static void resync_grow(struct nfct_resync *r)
+{
+	unsigned int i, size = r->size * 2;
+	struct hlist_head *buckets;
+	struct resync_entry *e;
+	struct hlist_node *n, *tmp;
+
+	buckets = calloc(size, sizeof(struct hlist_head));
+	if (buckets == NULL)
+		return;
+
+	for (i = 0; i < r->size; i++) {
+		hlist_for_each_entry_safe(e, n, tmp, &r->buckets[i], node) {
+			hlist_del(&e->node);
+			hlist_add_head(&e->node, &buckets[e->hash & (size - 1)]);
+		}
+	}
+	free(r->buckets);
+	r->buckets = buckets;
+	r->size = size;
+}
+
+/* add a copy of ct to the cache. */
+static struct resync_entry *
+resync_add(struct nfct_resync *r, const struct nf_conntrack *ct,
+	   uint32_t hash)
+{
+	struct resync_entry *e;
+
+	e = calloc(1, sizeof(struct resync_entry));
+	if (e == NULL)
+		return NULL;
+
+	e->ct = nfct_clone(ct);
+	if (e->ct == NULL) {
+		free(e);
+		return NULL;
+	}
+	e->hash = hash;
+	e->gen = r->gen;
+
+	if (r->count >= r->size)
+		resync_grow(r);
+
+	hlist_add_head(&e->node, &r->buckets[hash & (r->size - 1)]);
+	r->count++;
+
+	return e;
+}
+
+/* update the cache with one event, a failure leaves it stale. */
+void __resync_event(struct nfct_resync *r, unsigned int type,
+		    const struct nf_conntrack *ct)
+{
+	struct resync_entry *e;
+	uint32_t hash;
+
+	hash = __hash_orig(ct);
+	e = resync_find(r, ct, hash);
+
+	switch(type) {
+	case NFCT_T_NEW:
+		if (e == NULL) {
+			resync_add(r, ct, hash);
+			break;
+		}
+		nfct_copy(e->ct, ct, NFCT_CP_OVERRIDE);
+		break;
+	case NFCT_T_UPDATE:
+		/* updates only carry what has changed. */
+		if (e == NULL) {
+			resync_add(r, ct, hash);
+			break;
+		}
+		nfct_copy(e->ct, ct, NFCT_CP_ALL);
+		break;
+	case NFCT_T_DESTROY:
+		if (e)
+			resync_del(r, e);
+		break;
+	}
+}
+
+struct resync_dump {
+	struct nfct_handle	*h;
+	struct nfct_resync	*r;
+	/* the filter of the event socket, if any */
+	struct sock_filter	*filter;
+	unsigned int		filter_len;
+	int			ret;
+};
+
+/* pass one synthetic event to the callback, ct is released unless kept */
+static int resync_report(struct nfct_handle *h, const struct nlmsghdr *nlh,
+			 enum nf_conntrack_msg_type type,
+			 struct nf_conntrack *ct)
+{
+	struct __data_container *container = h->nfnl_cb_ct.data;
+	int ret = NFCT_CB_CONTINUE;
+
+	/* merge with the events that are held back, if any. */
+	if (h->coalesce && container && (type & container->type))
+		return __coalesce_add(h, type, ct);
+
+	if (container && (type & container->type)) {
+		if (h->cb)
+			ret = h->cb(type, ct, container->data);
+		else if (h->cb2)
+			ret = h->cb2(nlh, type, ct, container->data);
+	}
+	if (ret != NFCT_CB_STOLEN)
+		nfct_destroy(ct);
+
+	return ret == NFCT_CB_STOLEN ? NFCT_CB_CONTINUE : ret;
+}
+
+static int resync_dump_cb(const struct nlmsghdr *nlh,
+			  enum nf_conntrack_msg_type type,
+			  struct nf_conntrack *ct, void *data)
+{
+	struct resync_dump *dump = data;
+	struct nfct_resync *r = dump->r;
+	struct resync_entry *e;
+	struct nf_conntrack *new;
+	uint32_t hash;
+
+	hash = __hash_orig(ct);
+	e = resync_find(r, ct, hash);
+	if (e) {
+		nfct_copy(e->ct, ct, NFCT_CP_OVERRIDE);
+		e->gen = r->gen;
+		return NFCT_CB_CONTINUE;
+	}
+
+	/* the event socket would not have reported this one. */
+	if (dump->filter &&
+	    !__bsf_run(dump->filter, dump->filter_len, nlh, nlh->nlmsg_len))
+		return NFCT_CB_CONTINUE;
+
+	e = resync_add(r, ct, hash);
+	if (e == NULL) {
+		dump->ret = -1;
+		return NFCT_CB_FAILURE;
+	}
+
+	/* we missed the creation of this one. */
+	new = nfct_clone(ct);
+	if (new && dump->ret > NFCT_CB_STOP)
+		dump->ret = resync_report(dump->h, nlh, NFCT_T_NEW, new);
+	else if (new)
+		nfct_destroy(new);
+
+	return NFCT_CB_CONTINUE;
+}
+
+/*
+ * Dump the table through a second socket and report what has changed since
+ * the last event that was received. The verdict of the callback is returned.
+ */
+int __resync_run(struct nfct_handle *h)
+{
+	struct nfct_resync *r = h->resync;
+	struct resync_dump dump = {
+		.h	= h,
+		.r	= r,
+		.ret	= NFCT_CB_CONTINUE,
+	};
+	struct nfct_handle *dh;
+	struct resync_entry *e;
+	struct hlist_node *n, *tmp;
+	struct nf_conntrack *ct;
+	uint32_t family = AF_UNSPEC;
+	unsigned int i;
+	int ret;
+
+	/* the dump supersedes what is left in the socket queue. Until the
+	 * queue is empty the kernel drops new events without reporting
+	 * ENOBUFS again, so this must happen before the dump starts. */
+	__rx_drain(h);
+
+	ret = __bsf_get(nfnl_fd(h->nfnlh), &dump.filter);
+	/* the kernel cannot give the filter back, dump without it. */
+	if (ret == -1 && errno == ENOPROTOOPT)
+		ret = 0;
+	else if (ret == -1)
+		return -1;
+	dump.filter_len = ret;
+
+	dh = nfct_open(CONNTRACK, 0);
+	if (dh == NULL) {
+		free(dump.filter);
+		return -1;
+	}
+
+	r->gen++;
+	nfct_callback_register2(dh, NFCT_T_ALL, resync_dump_cb, &dump);
+	ret = nfct_query(dh, NFCT_Q_DUMP, &family);
+	nfct_close(dh);
+	free(dump.filter);
+
+	/* entries that were not refreshed might still exist, keep them. */
+	if (ret == -1 || dump.ret == -1)
+		return -1;
+
+	for (i = 0; i < r->size; i++) {
+		hlist_for_each_entry_safe(e, n, tmp, &r->buckets[i], node) {
+			if (e->gen == r->gen)
+				continue;
+
+			/* we missed the destruction of this one. */
+			ct = e->ct;
+			e->ct = NULL;
+			resync_del(r, e);
+			if (dump.ret > NFCT_CB_STOP)
+				dump.ret = resync_report(h, NULL,
+							 NFCT_T_DESTROY, ct);
+			else
+				nfct_destroy(ct);
+		}
+	}
+	return dump.ret;
+}
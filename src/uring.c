@@ -0,0 +1,518 @@
+/*
+ * (C) 2026 by agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#define _GNU_SOURCE
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/netlink.h>
+
+#include "internal/internal.h"
+
+#if defined(__NR_io_uring_setup) && defined(__linux__)
+#include <linux/io_uring.h>
+#endif
+
+#if defined(__NR_io_uring_setup) && defined(IORING_RECV_MULTISHOT)
+
+/*
+ * io_uring receive backend: one multishot recvmsg request stays posted on
+ * the netlink socket, the kernel picks a buffer from a provided buffer ring
+ * for every datagram and posts a completion for it. Completions are read
+ * from the shared completion ring without entering the kernel, the buffer
+ * is handed back to the kernel once the datagram has been processed. The
+ * request only needs to be posted again if the kernel terminates it.
+ */
+#define URING_BGID		0x6e66	/* buffer group id, any value works */
+#define URING_SQ_ENTRIES	2
+
+struct nfct_uring {
+	int			fd;
+
+	/* submission ring, only one request is ever posted */
+	void			*sq_ptr;
+	size_t			sq_size;
+	unsigned int		*sq_tail;
+	unsigned int		*sq_mask;
+	unsigned int		*sq_flags;
+	unsigned int		*sq_array;
+	struct io_uring_sqe	*sqes;
+	size_t			sqes_size;
+
+	/* completion ring */
+	void			*cq_ptr;
+	size_t			cq_size;
+	unsigned int		*cq_head;
+	unsigned int		*cq_tail;
+	unsigned int		*cq_mask;
+	struct io_uring_cqe	*cqes;
+
+	/* provided buffer ring */
+	struct io_uring_buf_ring *br;
+	size_t			br_size;
+	unsigned int		nbufs;
+	uint16_t		br_tail;
+	size_t			bufsiz;
+	unsigned char		*bufs;
+
+	/* the multishot request is written to the ring / live in the kernel */
+	int			queued;
+	int			armed;
+	struct msghdr		msg;
+};
+
+static int uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned int to_submit,
+		       unsigned int min_complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned int opcode, void *arg,
+			  unsigned int nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void uring_buf_add(struct nfct_uring *u, unsigned int bid)
+{
+	struct io_uring_buf *buf;
+
+	buf = &u->br->bufs[u->br_tail & (u->nbufs - 1)];
+	buf->addr = (uintptr_t)(u->bufs + bid * u->bufsiz);
+	buf->len = u->bufsiz;
+	buf->bid = bid;
+	u->br_tail++;
+}
+
+/* make the buffers that were added visible to the kernel. */
+static void uring_buf_commit(struct nfct_uring *u)
+{
+	__atomic_store_n(&u->br->tail, u->br_tail, __ATOMIC_RELEASE);
+}
+
+static int uring_map(struct nfct_uring *u, struct io_uring_params *p)
+{
+	char *sq, *cq;
+
+	u->sq_size = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+	u->cq_size = p->cq_off.cqes + p->cq_entries *
+					sizeof(struct io_uring_cqe);
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (u->cq_size > u->sq_size)
+			u->sq_size = u->cq_size;
+		u->cq_size = 0;
+	}
+
+	u->sq_ptr = mmap(NULL, u->sq_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+	if (u->sq_ptr == MAP_FAILED) {
+		u->sq_ptr = NULL;
+		return -1;
+	}
+	if (u->cq_size) {
+		u->cq_ptr = mmap(NULL, u->cq_size, PROT_READ | PROT_WRITE,
+				 MAP_SHARED | MAP_POPULATE, u->fd,
+				 IORING_OFF_CQ_RING);
+		if (u->cq_ptr == MAP_FAILED) {
+			u->cq_ptr = NULL;
+			return -1;
+		}
+	}
+
+	u->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+	u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+	if (u->sqes == MAP_FAILED) {
+		u->sqes = NULL;
+		return -1;
+	}
+
+	sq = u->sq_ptr;
+	cq = u->cq_ptr ? u->cq_ptr : u->sq_ptr;
+	u->sq_tail = (unsigned int *)(sq + p->sq_off.tail);
+	u->sq_mask = (unsigned int *)(sq + p->sq_off.ring_mask);
+	u->sq_flags = (unsigned int *)(sq + p->sq_off.flags);
+	u->sq_array = (unsigned int *)(sq + p->sq_off.array);
+	u->cq_head = (unsigned int *)(cq + p->cq_off.head);
+	u->cq_tail = (unsigned int *)(cq + p->cq_off.tail);
+	u->cq_mask = (unsigned int *)(cq + p->cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe *)(cq + p->cq_off.cqes);
+
+	return 0;
+}
+
+static int uring_bufs_init(struct nfct_uring *u)
+{
+	struct io_uring_buf_reg reg;
+	unsigned int i;
+
+	u->br_size = u->nbufs * sizeof(struct io_uring_buf);
+	u->br = mmap(NULL, u->br_size, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (u->br == MAP_FAILED) {
+		u->br = NULL;
+		return -1;
+	}
+	u->bufs = malloc(u->nbufs * u->bufsiz);
+	if (u->bufs == NULL)
+		return -1;
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uintptr_t)u->br;
+	reg.ring_entries = u->nbufs;
+	reg.bgid = URING_BGID;
+	if (uring_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		/* buffer rings came with Linux 5.19. */
+		if (errno == EINVAL)
+			errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	for (i = 0; i < u->nbufs; i++)
+		uring_buf_add(u, i);
+	uring_buf_commit(u);
+
+	return 0;
+}
+
+struct nfct_uring *__uring_create(unsigned int nbufs, size_t bufsiz)
+{
+	struct io_uring_params p;
+	struct nfct_uring *u;
+	unsigned int n = 1;
+
+	/* the buffer ring size has to be a power of two. */
+	while (n < nbufs)
+		n <<= 1;
+	if (n > 32768) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	u = calloc(1, sizeof(struct nfct_uring));
+	if (u == NULL)
+		return NULL;
+
+	u->nbufs = n;
+	/* every buffer starts with the recvmsg header and the peer address */
+	u->bufsiz = sizeof(struct io_uring_recvmsg_out) +
+		    sizeof(struct sockaddr_nl) +
+		    (bufsiz ? bufsiz : NFNL_BUFFSIZE);
+	u->msg.msg_namelen = sizeof(struct sockaddr_nl);
+
+	/* one completion per buffer plus room for the one that ends it. */
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = 2 * n;
+	u->fd = uring_setup(URING_SQ_ENTRIES, &p);
+	if (u->fd < 0) {
+		/* not built into the kernel, disabled or too old. */
+		if (errno == ENOSYS || errno == EPERM || errno == EINVAL)
+			errno = EOPNOTSUPP;
+		free(u);
+		return NULL;
+	}
+
+	if (uring_map(u, &p) < 0 || uring_bufs_init(u) < 0) {
+		__uring_destroy(u);
+		return NULL;
+	}
+	return u;
+}
+
+void __uring_destroy(struct nfct_uring *u)
+{
+	/* this also cancels the request and unregisters the buffers. */
+	close(u->fd);
+
+	if (u->sqes)
+		munmap(u->sqes, u->sqes_size);
+	if (u->cq_ptr)
+		munmap(u->cq_ptr, u->cq_size);
+	if (u->sq_ptr)
+		munmap(u->sq_ptr, u->sq_size);
+	if (u->br)
+		munmap(u->br, u->br_size);
+	free(u->bufs);
+	free(u);
+}
+
+int __uring_pending(const struct nfct_uring *u)
+{
+	return __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE) != *u->cq_head;
+}
+
+/* post the multishot recvmsg request. */
+static void uring_arm(struct nfct_handle *h, struct nfct_uring *u)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int tail = *u->sq_tail;
+	unsigned int idx = tail & *u->sq_mask;
+
+	sqe = &u->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->fd = nfnl_fd(h->nfnlh);
+	sqe->addr = (uintptr_t)&u->msg;
+	sqe->len = 1;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BGID;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+
+	u->sq_array[idx] = idx;
+	__atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	u->queued = 1;
+}
+
+static int uring_no_enobufs(struct nfct_handle *h)
+{
+	socklen_t len = sizeof(int);
+	int on = 0;
+
+	if (getsockopt(nfnl_fd(h->nfnlh), SOL_NETLINK, NETLINK_NO_ENOBUFS,
+		       &on, &len) < 0)
+		return 0;
+
+	return on;
+}
+
+/* process one completion, the buffer is given back to the kernel. */
+static int uring_process(struct nfct_handle *h, struct nfct_uring *u,
+			 const struct io_uring_cqe *cqe)
+{
+	const struct io_uring_recvmsg_out *out;
+	const struct sockaddr_nl *peer;
+	unsigned int bid;
+	int ret = NFNL_CB_CONTINUE;
+
+	if (!(cqe->flags & IORING_CQE_F_MORE))
+		u->armed = 0;
+
+	/*
+	 * Errors terminate the request. ENOBUFS is reported either if the
+	 * socket overran or if we ran out of buffers, both mean that the
+	 * application could not keep up, report it like nfnl_catch() does.
+	 * If the socket does not report overruns, we ran out of buffers and
+	 * the datagrams are still queued, the request is just posted again.
+	 */
+	if (cqe->res < 0) {
+		if (cqe->res == -ENOBUFS && uring_no_enobufs(h))
+			return NFNL_CB_CONTINUE;
+		errno = -cqe->res;
+		return -1;
+	}
+	if (!(cqe->flags & IORING_CQE_F_BUFFER))
+		return NFNL_CB_CONTINUE;
+
+	bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+	out = (const struct io_uring_recvmsg_out *)(u->bufs + bid * u->bufsiz);
+	peer = (const struct sockaddr_nl *)(out + 1);
+
+	h->stats.datagrams++;
+	h->stats.bytes += out->payloadlen;
+
+	if (out->flags & MSG_TRUNC) {
+		errno = ENOSPC;
+		ret = -1;
+	/* only the kernel is allowed to talk to us. */
+	} else if (out->namelen == sizeof(struct sockaddr_nl) &&
+		   peer->nl_pid == 0) {
+		if (h->async &&
+		    __async_match(h->async, peer + 1, out->payloadlen))
+			ret = __async_process(h, peer + 1, out->payloadlen);
+		else
+			ret = nfnl_process(h->nfnlh,
+					   (const unsigned char *)(peer + 1),
+					   out->payloadlen);
+	}
+
+	uring_buf_add(u, bid);
+	uring_buf_commit(u);
+
+	return ret;
+}
+
+/* hand over what the batch callback or the coalescing window holds, keep
+ * the worst verdict */
+static int uring_flush(struct nfct_handle *h, int ret)
+{
+	int err;
+
+	if (h->batch_cb) {
+		err = __callback_flush(h);
+		if (err < ret)
+			ret = err;
+	}
+	if (h->coalesce) {
+		err = __coalesce_expire(h);
+		if (err < ret)
+			ret = err;
+	}
+	return ret;
+}
+
+/* wait for completions, but not beyond the coalescing window. */
+static int uring_wait(struct nfct_handle *h, struct nfct_uring *u)
+{
+	struct pollfd pfd = {
+		.fd	= u->fd,
+		.events	= POLLIN,
+	};
+	int timeout;
+
+	if (h->coalesce == NULL)
+		return 1;
+
+	timeout = __coalesce_timeout(h->coalesce);
+	if (timeout < 0)
+		return 1;
+
+	return poll(&pfd, 1, timeout);
+}
+
+static uint64_t uring_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Process the completions, waiting for them if `wait' is set. It stops
+ * after `max_msgs' datagrams or once `max_ns' nanoseconds have elapsed,
+ * zero means no limit. The request is posted again if it was terminated.
+ */
+static int uring_catch(struct nfct_handle *h, int wait,
+		       unsigned int max_msgs, uint64_t max_ns)
+{
+	struct nfct_uring *u = h->uring;
+	uint64_t deadline = max_ns ? uring_now() + max_ns : 0;
+	unsigned int head, min, n = 0;
+	int ret;
+
+	while (1) {
+		head = *u->cq_head;
+		while (head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+			/* at least one datagram per call, so that we progress. */
+			if (n > 0 && ((max_msgs && n == max_msgs) ||
+				      (deadline && uring_now() >= deadline)))
+				return uring_flush(h, 1) < 0 ? -1 : 1;
+
+			ret = uring_process(h, u, &u->cqes[head & *u->cq_mask]);
+			head++;
+			__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+			n++;
+			if (ret <= NFNL_CB_STOP) {
+				ret = uring_flush(h, ret);
+				if (ret < 0 || wait)
+					return ret;
+				return __uring_pending(u);
+			}
+		}
+		ret = uring_flush(h, NFNL_CB_CONTINUE);
+		if (ret <= NFNL_CB_STOP)
+			return ret < 0 ? -1 : 0;
+
+		if (!u->armed && !u->queued)
+			uring_arm(h, u);
+		/*
+		 * Completions are posted without our help, unless they did
+		 * not fit in the ring, the kernel then keeps them until we
+		 * ask for them.
+		 */
+		else if (!wait && !(__atomic_load_n(u->sq_flags,
+						    __ATOMIC_ACQUIRE) &
+				    IORING_SQ_CQ_OVERFLOW))
+			return 0;
+
+		else if (wait && !u->queued) {
+			ret = uring_wait(h, u);
+			if (ret == 0) {
+				ret = __coalesce_flush(h);
+				if (ret <= NFNL_CB_STOP)
+					return ret;
+				continue;
+			} else if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				return -1;
+			}
+		}
+
+		/* the request is posted first if we have to wait with a timeout */
+		min = wait ? 1 : 0;
+		if (u->queued && h->coalesce &&
+		    __coalesce_timeout(h->coalesce) >= 0)
+			min = 0;
+
+		if (uring_enter(u->fd, u->queued, min,
+				IORING_ENTER_GETEVENTS) < 0) {
+			/* interrupted syscall must retry */
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (u->queued) {
+			u->queued = 0;
+			u->armed = 1;
+		}
+	}
+}
+
+int __uring_catch(struct nfct_handle *h)
+{
+	return uring_catch(h, 1, 0, 0);
+}
+
+int __uring_catch_budget(struct nfct_handle *h, unsigned int max_msgs,
+			 uint64_t max_ns)
+{
+	return uring_catch(h, 0, max_msgs, max_ns);
+}
+
+#else
+
+struct nfct_uring *__uring_create(unsigned int nbufs, size_t bufsiz)
+{
+	errno = EOPNOTSUPP;
+	return NULL;
+}
+
+void __uring_destroy(struct nfct_uring *u)
+{
+}
+
+int __uring_pending(const struct nfct_uring *u)
+{
+	return 0;
+}
+
+int __uring_catch(struct nfct_handle *h)
+{
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+int __uring_catch_budget(struct nfct_handle *h, unsigned int max_msgs,
+			 uint64_t max_ns)
+{
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+#endif